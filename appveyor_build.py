@@ -6,7 +6,7 @@ import shutil
 from subprocess import check_call
 
 mcell_src = './src'
-build_command = ['gcc.exe', '-mconsole', '-std=c99', '-O3', '-fno-schedule-insns2', '-o', 'mcell.exe', '*.c']
+build_command = ['gcc.exe', '-mconsole', '-std=c99', '-O3', '-fno-schedule-insns2', '-pthread', '-o', 'mcell.exe', '*.c']
 files = ["config.h", "version.h", "mdllex.c", "mdlparse.h", "mdlparse.c"]
 
 for f in files:
@@ -62,6 +62,10 @@ static struct option long_options[] = { { "help", 0, 0, 'h' },
                                         { "errfile", 1, 0, 'e' },
                                         { "quiet", 0, 0, 'q' },
                                         { "with_checks", 1, 0, 'w' },
+                                        { "threads", 1, 0, 't' },
+                                        { "rng", 1, 0, 'r' },
+                                        { "reorder_interval", 1, 0, 'o' },
+                                        { "scheduler", 1, 0, 'S' },
                                         { NULL, 0, 0, 0 } };
 
 /* print_usage: Write the usage message for mcell to a file handle.
@@ -80,7 +84,15 @@ void print_usage(FILE *f, char const *argv0) {
       "and exit\n"
       "     [-seed n]                choose random sequence number "
       "(default: 1)\n"
+      "     [-rng ('isaac64'/'philox', default 'isaac64')]   random number "
+      "generator\n"
       "     [-iterations n]          override iterations in mdl_file_name\n"
+      "     [-threads n]             run memory partitions on n threads "
+      "(default: 0, serial)\n"
+      "     [-reorder_interval n]    sort molecules along a space-filling "
+      "curve every n iterations (default: 0, never)\n"
+      "     [-scheduler ('multiscale'/'ladder', default 'multiscale')]   "
+      "molecule scheduler\n"
       "     [-logfile log_file_name] send output log to file "
       "(default: stdout)\n"
       "     [-logfreq n]             output log frequency\n"
@@ -189,6 +201,33 @@ int argparse_init(int argc, char *const argv[], struct volume *vol) {
       }
       break;
 
+    case 'r': /* -rng */
+      if (strcmp(optarg, "isaac64") == 0)
+        vol->counter_based_rng = 0;
+      else if (strcmp(optarg, "philox") == 0) {
+#ifdef USE_MINIMAL_RNG
+        argerror("The philox generator is not available in this build.");
+        return 1;
+#else
+        vol->counter_based_rng = 1;
+#endif
+      } else {
+        argerror("-rng option should be 'isaac64' or 'philox'.");
+        return 1;
+      }
+      break;
+
+    case 'S': /* -scheduler */
+      if (strcmp(optarg, "multiscale") == 0)
+        vol->ladder_scheduler = 0;
+      else if (strcmp(optarg, "ladder") == 0)
+        vol->ladder_scheduler = 1;
+      else {
+        argerror("-scheduler option should be 'multiscale' or 'ladder'.");
+        return 1;
+      }
+      break;
+
     case 'i': /* -iterations */
       vol->iterations = strtoll(optarg, &endptr, 0);
       if (endptr == optarg || *endptr != '\0') {
@@ -203,6 +242,33 @@ int argparse_init(int argc, char *const argv[], struct volume *vol) {
       }
       break;
 
+    case 't': /* -threads */
+      vol->num_threads = (int)strtol(optarg, &endptr, 0);
+      if (endptr == optarg || *endptr != '\0') {
+        argerror("Thread count must be an integer: %s", optarg);
+        return 1;
+      }
+
+      if (vol->num_threads < 0) {
+        argerror("Thread count %d is less than 0", vol->num_threads);
+        return 1;
+      }
+      break;
+
+    case 'o': /* -reorder_interval */
+      vol->reorder_interval = strtoll(optarg, &endptr, 0);
+      if (endptr == optarg || *endptr != '\0') {
+        argerror("Reorder interval must be an integer: %s", optarg);
+        return 1;
+      }
+
+      if (vol->reorder_interval < 0) {
+        argerror("Reorder interval %lld is less than 0",
+                 vol->reorder_interval);
+        return 1;
+      }
+      break;
+
     case 'c': /* -checkpoint_infile */
       vol->chkpt_infile = strdup(optarg);
       if (vol->chkpt_infile == NULL) {
@@ -243,6 +309,12 @@ int argparse_init(int argc, char *const argv[], struct volume *vol) {
         return 1;
       }
 
+      /* Only the first process of a distributed run writes the log */
+      if (vol->procnum != 0) {
+        log_file_specified = 1;
+        break;
+      }
+
       if ((fhandle = fopen(optarg, "w")) == NULL) {
         argerror("Cannot open output log file: %s", optarg);
         return 1;
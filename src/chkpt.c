@@ -48,7 +48,7 @@
 #include "strfunc.h"
 
 /* MCell checkpoint API version */
-#define CHECKPOINT_API 1
+#define CHECKPOINT_API 2
 
 /* Endian-ness markers */
 #define MCELL_BIG_ENDIAN 16
@@ -211,7 +211,8 @@ static int read_current_iteration(struct volume *world, FILE *fs,
 static int read_chkpt_seq_num(struct volume *world, FILE *fs,
                               struct chkpt_read_state *state);
 static int read_rng_state(struct volume *world, FILE *fs,
-                          struct chkpt_read_state *state);
+                          struct chkpt_read_state *state,
+                          uint32_t api_version);
 static int read_byte_order(FILE *fs, struct chkpt_read_state *state);
 static int read_mcell_version(FILE *fs, struct chkpt_read_state *state);
 static int read_api_version(FILE *fs, struct chkpt_read_state *state,
@@ -225,7 +226,8 @@ static int write_current_time_seconds(FILE *fs, double current_time_seconds);
 static int write_current_iteration(FILE *fs, long long current_iterations,
                                    double current_time_seconds);
 static int write_chkpt_seq_num(FILE *fs, u_int chkpt_seq_num);
-static int write_rng_state(FILE *fs, u_int seed_seq, struct rng_state *rng);
+static int write_rng_state(FILE *fs, u_int seed_seq, struct rng_state *rng,
+                           int n_streams, struct storage_stream *streams);
 static int write_species_table(FILE *fs, int n_species,
                                struct species **species_list);
 static int write_mol_scheduler_state_real(FILE *fs,
@@ -238,7 +240,7 @@ static int write_byte_order(FILE *fs);
 static int write_api_version(FILE *fs);
 
 static int create_molecule_scheduler(struct storage_list *storage_head,
-                                     long long start_iterations);
+                                     long long start_iterations, int ladder);
 
 /********************************************************************
  * this function initializes to global variables
@@ -501,7 +503,8 @@ int write_chkpt(struct volume *world, FILE *fs) {
           write_current_iteration(fs, world->current_iterations,
                                   world->current_time_seconds) ||
           write_chkpt_seq_num(fs, world->chkpt_seq_num) ||
-          write_rng_state(fs, world->seed_seq, world->rng) ||
+          write_rng_state(fs, world->seed_seq, world->rng,
+                          world->n_storage_streams, world->storage_streams) ||
           write_species_table(fs, world->n_species, world->species_list) ||
           write_mol_scheduler_state_real(fs, world->storage_head,
               world->simulation_start_seconds, world->start_iterations,
@@ -605,8 +608,10 @@ int read_chkpt(struct volume *world, FILE *fs) {
 
     case CURRENT_ITERATION_CMD:
       if (read_current_iteration(world, fs, &state) ||
-          create_molecule_scheduler(world->storage_head, world->start_iterations))
+          create_molecule_scheduler(world->storage_head, world->start_iterations,
+                                    world->ladder_scheduler))
         return 1;
+      world->storage_time = world->start_iterations;
       break;
 
     case CHKPT_SEQ_NUM_CMD:
@@ -615,7 +620,7 @@ int read_chkpt(struct volume *world, FILE *fs) {
       break;
 
     case RNG_STATE_CMD:
-      if (read_rng_state(world, fs, &state))
+      if (read_rng_state(world, fs, &state, api_version))
         return 1;
       break;
 
@@ -804,16 +809,22 @@ static int read_current_time_seconds(struct volume *world, FILE *fs,
 
 /***************************************************************************
  create_molecule_scheduler:
- In:  none.
+ In:  list of storages
+      iteration to start at
+      nonzero to use ladder queues
  Out: Creates global molecule scheduler using checkpoint file values.
       Returns 0 on success. Error message and exit on failure.
 ***************************************************************************/
 static int create_molecule_scheduler(struct storage_list *storage_head,
-                                     long long start_iterations) {
+                                     long long start_iterations, int ladder) {
   struct storage_list *stg;
   for (stg = storage_head; stg != NULL; stg = stg->next) {
-    if ((stg->store->timer = create_scheduler(1.0, 100.0, 100, start_iterations)) ==
-        NULL) {
+    if (ladder)
+      stg->store->timer = create_ladder_scheduler(1.0, 100, start_iterations);
+    else
+      stg->store->timer =
+          create_scheduler(1.0, 100.0, 100, start_iterations);
+    if (stg->store->timer == NULL) {
       mcell_error("Out of memory while creating molecule scheduler.");
     }
     stg->store->current_time = start_iterations;
@@ -902,14 +913,26 @@ static int write_an_rng_state(FILE *fs, struct rng_state *rng) {
   WRITEFIELD(rng->c);
   WRITEFIELD(rng->d);
 #else
+  if (rng->counter_based) {
+    /* A Philox stream is fully described by its key and counter */
+    static const char RNG_PHILOX = 'P';
+    WRITEFIELD(RNG_PHILOX);
+    WRITEARRAY(rng->philox.pos.key, 2);
+    WRITEARRAY(rng->philox.pos.ctr, 4);
+    WRITEARRAY(rng->philox.pos.block, PHILOX_BUFFER);
+    WRITEUINT(rng->philox.pos.next);
+    WRITEUINT(rng->philox.pos.filled);
+    return 0;
+  }
+
   static const char RNG_ISAAC = 'I';
   WRITEFIELD(RNG_ISAAC);
-  WRITEUINT(rng->randcnt);
-  WRITEFIELD(rng->aa);
-  WRITEFIELD(rng->bb);
-  WRITEFIELD(rng->cc);
-  WRITEARRAY(rng->randrsl, RANDSIZ);
-  WRITEARRAY(rng->mm, RANDSIZ);
+  WRITEUINT(rng->isaac.randcnt);
+  WRITEFIELD(rng->isaac.aa);
+  WRITEFIELD(rng->isaac.bb);
+  WRITEFIELD(rng->isaac.cc);
+  WRITEARRAY(rng->isaac.randrsl, RANDSIZ);
+  WRITEARRAY(rng->isaac.mm, RANDSIZ);
 #endif
   return 0;
 }
@@ -917,10 +940,15 @@ static int write_an_rng_state(FILE *fs, struct rng_state *rng) {
 /***************************************************************************
  write_rng_state:
  In:  fs - checkpoint file to write to.
+      seed_seq - seed of the run
+      rng - the world random number generator
+      n_streams - number of per-storage streams (0 for serial runs)
+      streams - the per-storage streams
  Out: Writes random number generator state to the checkpoint file.
       Returns 1 on error, and 0 - on success.
 ***************************************************************************/
-static int write_rng_state(FILE *fs, u_int seed_seq, struct rng_state *rng) {
+static int write_rng_state(FILE *fs, u_int seed_seq, struct rng_state *rng,
+                           int n_streams, struct storage_stream *streams) {
   static const char SECTNAME[] = "RNG state";
   static const byte cmd = RNG_STATE_CMD;
 
@@ -928,6 +956,12 @@ static int write_rng_state(FILE *fs, u_int seed_seq, struct rng_state *rng) {
   WRITEUINT(seed_seq);
   if (write_an_rng_state(fs, rng))
     return 1;
+
+  WRITEUINT(n_streams);
+  for (int i = 0; i < n_streams; i++) {
+    if (write_an_rng_state(fs, &streams[i].rng))
+      return 1;
+  }
   return 0;
 }
 
@@ -957,19 +991,40 @@ static int read_an_rng_state(FILE *fs, struct chkpt_read_state *state,
 
 #else
   static const char RNG_ISAAC = 'I';
+  static const char RNG_PHILOX = 'P';
   char rngtype;
   READFIELD(rngtype);
-  DATACHECK(rngtype != RNG_ISAAC, "Invalid RNG type stored in checkpoint file "
-                                  "(in this version of MCell, only ISAAC64 is "
-                                  "supported).");
-
-  READUINT(rng->randcnt);
-  READFIELD(rng->aa);
-  READFIELD(rng->bb);
-  READFIELD(rng->cc);
-  READARRAY(rng->randrsl, RANDSIZ);
-  READARRAY(rng->mm, RANDSIZ);
-  rng->rngblocks = 1;
+  DATACHECK(rngtype != RNG_ISAAC && rngtype != RNG_PHILOX,
+            "Invalid RNG type stored in checkpoint file (in this version of "
+            "MCell, only ISAAC64 and Philox are supported).");
+  if ((rngtype == RNG_PHILOX) != (rng->counter_based != 0)) {
+    mcell_warn("Checkpoint file was written using the %s random number "
+               "generator; restart with '-rng %s'.",
+               rngtype == RNG_PHILOX ? "Philox" : "ISAAC64",
+               rngtype == RNG_PHILOX ? "philox" : "isaac64");
+    return 1;
+  }
+
+  if (rngtype == RNG_PHILOX) {
+    READARRAY(rng->philox.pos.key, 2);
+    READARRAY(rng->philox.pos.ctr, 4);
+    READARRAY(rng->philox.pos.block, PHILOX_BUFFER);
+    READUINT(rng->philox.pos.next);
+    READUINT(rng->philox.pos.filled);
+    DATACHECK(rng->philox.pos.filled > PHILOX_BUFFER ||
+                  rng->philox.pos.next > rng->philox.pos.filled,
+              "Invalid Philox state stored in checkpoint file.");
+    rng->philox.seeked = 0;
+    return 0;
+  }
+
+  READUINT(rng->isaac.randcnt);
+  READFIELD(rng->isaac.aa);
+  READFIELD(rng->isaac.bb);
+  READFIELD(rng->isaac.cc);
+  READARRAY(rng->isaac.randrsl, RANDSIZ);
+  READARRAY(rng->isaac.mm, RANDSIZ);
+  rng->isaac.rngblocks = 1;
 #endif
 
   return 0;
@@ -978,11 +1033,16 @@ static int read_an_rng_state(FILE *fs, struct chkpt_read_state *state,
 /***************************************************************************
  read_rng_state:
  In:  fs - checkpoint file to read from.
+      api_version - checkpoint API version of the file
  Out: Reads random number generator state from the checkpoint file.
+      Per-storage streams (API version 2 and up) are restored only if this
+      run uses the same number of storage streams; otherwise they are read
+      and dropped, and the streams of this run keep their fresh seeding.
       Returns 1 on error, and 0 - on success.
 ***************************************************************************/
 static int read_rng_state(struct volume *world, FILE *fs,
-                          struct chkpt_read_state *state) {
+                          struct chkpt_read_state *state,
+                          uint32_t api_version) {
   static const char SECTNAME[] = "RNG state";
 
   /* Load seed_seq from chkpt file to compare with seed_seq from command line.
@@ -998,9 +1058,31 @@ static int read_rng_state(struct volume *world, FILE *fs,
   if (read_an_rng_state(fs, state, world->rng))
     return 1;
 
+  unsigned int n_streams = 0;
+  if (api_version >= 2)
+    READUINT(n_streams);
+  int keep_streams = (n_streams == (unsigned int)world->n_storage_streams);
+  for (unsigned int i = 0; i < n_streams; i++) {
+    struct rng_state discarded;
+    rng_set_counter_based(&discarded, 1);
+    if (read_an_rng_state(fs, state, keep_streams
+                                         ? &world->storage_streams[i].rng
+                                         : &discarded))
+      return 1;
+  }
+  if (n_streams != 0 && !keep_streams)
+    mcell_warn("Checkpoint file holds %u per-storage random number streams, "
+               "but this run uses %d.  Reseeding the streams.",
+               n_streams, world->n_storage_streams);
+
   /* Reinitialize rngs to beginning of new seed sequence, if necessary. */
-  if (world->seed_seq != old_seed)
+  if (world->seed_seq != old_seed) {
     rng_init(world->rng, world->seed_seq);
+    u_int first = world->n_streams_seeded - world->n_storage_streams;
+    for (int i = 0; i < world->n_storage_streams; i++)
+      rng_init_stream(&world->storage_streams[i].rng, world->seed_seq,
+                      first + i + 1);
+  }
 
   return 0;
 }
@@ -1101,29 +1183,26 @@ static int read_species_table(struct volume *world, FILE *fs) {
 /***************************************************************************
  count_items_in_scheduler:
  In:  None
- Out: Number of non-defunct molecules in the molecule scheduler
+ Out: Number of non-defunct molecules in the molecule scheduler, counting
+      dormant ones
 ***************************************************************************/
 unsigned long long
 count_items_in_scheduler(struct storage_list *storage_head) {
   unsigned long long total_items = 0;
 
   for (struct storage_list *slp = storage_head; slp != NULL; slp = slp->next) {
-    for (struct schedule_helper *shp = slp->store->timer; shp != NULL;
-         shp = shp->next_scale) {
-      for (int i = -1; i < shp->buf_len; i++) {
-        for (struct abstract_element *aep = (i < 0) ? shp->current
-                                                    : shp->circ_buf_head[i];
-             aep != NULL; aep = aep->next) {
-          struct abstract_molecule *amp = (struct abstract_molecule *)aep;
-          if (amp->properties == NULL)
-            continue;
-
-          /* There should never be a surface class in the scheduler... */
-          assert(!(amp->properties->flags & IS_SURFACE));
-          ++total_items;
-        }
-      }
+    struct storage_walk walk;
+    for (struct abstract_molecule *amp = first_storage_molecule(&walk,
+                                                                slp->store);
+         amp != NULL; amp = next_storage_molecule(&walk)) {
+      if (amp->properties == NULL)
+        continue;
+
+      /* There should never be a surface class in the scheduler... */
+      assert(!(amp->properties->flags & IS_SURFACE));
+      ++total_items;
     }
+    end_storage_walk(&walk);
   }
 
   return total_items;
@@ -1151,79 +1230,75 @@ static int write_mol_scheduler_state_real(FILE *fs,
 
   /* Iterate over all molecules in the scheduler to produce checkpoint */
   for (struct storage_list *slp = storage_head; slp != NULL; slp = slp->next) {
-    for (struct schedule_helper *shp = slp->store->timer; shp != NULL;
-         shp = shp->next_scale) {
-      for (int i = -1; i < shp->buf_len; i++) {
-        for (struct abstract_element *aep = (i < 0) ? shp->current
-                                                    : shp->circ_buf_head[i];
-             aep != NULL; aep = aep->next) {
-          struct abstract_molecule *amp = (struct abstract_molecule *)aep;
-          if (amp->properties == NULL)
-            continue;
-
-          /* Grab the location and orientation for this molecule */
-          struct vector3 where;
-          short orient = 0;
-          byte act_newbie_flag =
-              (amp->flags & ACT_NEWBIE) ? HAS_ACT_NEWBIE : HAS_NOT_ACT_NEWBIE;
-          byte act_change_flag =
-              (amp->flags & ACT_CHANGE) ? HAS_ACT_CHANGE : HAS_NOT_ACT_CHANGE;
-          if ((amp->properties->flags & NOT_FREE) == 0) {
-            struct volume_molecule *vmp = (struct volume_molecule *)amp;
-            INTERNALCHECK(vmp->previous_wall != NULL && vmp->index >= 0,
-                          "The value of 'previous_grid' is not NULL.");
-            where.x = vmp->pos.x;
-            where.y = vmp->pos.y;
-            where.z = vmp->pos.z;
-            orient = 0;
-          } else if ((amp->properties->flags & ON_GRID) != 0) {
-            struct surface_molecule *smp = (struct surface_molecule *)amp;
-            uv2xyz(&smp->s_pos, smp->grid->surface, &where);
-            orient = smp->orient;
-          } else
-            continue;
-
-          /* Check for valid chkpt_species ID. */
-          INTERNALCHECK(amp->properties->chkpt_species_id == UINT_MAX,
-                        "Attempted to write out a molecule of species '%s', "
-                        "which has not been assigned a checkpoint species id.",
-                        amp->properties->sym->name);
-
-          /* write molecule fields */
-          WRITEUINT(amp->properties->chkpt_species_id);
-          WRITEFIELD(act_newbie_flag);
-          WRITEFIELD(act_change_flag);
-
-          // NOTE: we write all times as real times (seconds) *not* as
-          // "iterations" (or "scaled times") in order to be able to
-          // re-schedule them properly upon restart
-
-          // The scheduling time (t) is essentially iterations, and since time
-          // steps can change when checkpointing, we can't directly convert
-          // iterations to real time (seconds). We need to correct for this by
-          // only converting the iterations of the current simulation
-          // [(t-start_iterations)*time_unit] and adding the real time at the
-          // start of the simulation (simulation_start_seconds).
-          double t = convert_iterations_to_seconds(
-              start_iterations, time_unit, simulation_start_seconds, amp->t);
-          WRITEFIELD(t);
-          // We do a simple conversion for the lifetime t2, since this
-          // corresponds to some event in the future and can be directly
-          // computed without using an offset.
-          double t2 = amp->t2 * time_unit;
-          WRITEFIELD(t2);
-          // Birthday is now always treated as real time in seconds, not
-          // "scaled" time or iterations.
-          double bday = amp->birthday;
-          WRITEFIELD(bday);
-          WRITEFIELD(where);
-          WRITEINT(orient);
-
-          static const unsigned char NON_COMPLEX = '\0';
-          WRITEFIELD(NON_COMPLEX);
-        }
-      }
+    struct storage_walk walk;
+    for (struct abstract_molecule *amp = first_storage_molecule(&walk,
+                                                                slp->store);
+         amp != NULL; amp = next_storage_molecule(&walk)) {
+      if (amp->properties == NULL)
+        continue;
+
+      /* Grab the location and orientation for this molecule */
+      struct vector3 where;
+      short orient = 0;
+      byte act_newbie_flag =
+          (amp->flags & ACT_NEWBIE) ? HAS_ACT_NEWBIE : HAS_NOT_ACT_NEWBIE;
+      byte act_change_flag =
+          (amp->flags & ACT_CHANGE) ? HAS_ACT_CHANGE : HAS_NOT_ACT_CHANGE;
+      if ((amp->properties->flags & NOT_FREE) == 0) {
+        struct volume_molecule *vmp = (struct volume_molecule *)amp;
+        INTERNALCHECK(vmp->previous_wall != NULL && vmp->index >= 0,
+                      "The value of 'previous_grid' is not NULL.");
+        where.x = vmp->pos.x;
+        where.y = vmp->pos.y;
+        where.z = vmp->pos.z;
+        orient = 0;
+      } else if ((amp->properties->flags & ON_GRID) != 0) {
+        struct surface_molecule *smp = (struct surface_molecule *)amp;
+        uv2xyz(&smp->s_pos, smp->grid->surface, &where);
+        orient = smp->orient;
+      } else
+        continue;
+
+      /* Check for valid chkpt_species ID. */
+      INTERNALCHECK(amp->properties->chkpt_species_id == UINT_MAX,
+                    "Attempted to write out a molecule of species '%s', "
+                    "which has not been assigned a checkpoint species id.",
+                    amp->properties->sym->name);
+
+      /* write molecule fields */
+      WRITEUINT(amp->properties->chkpt_species_id);
+      WRITEFIELD(act_newbie_flag);
+      WRITEFIELD(act_change_flag);
+
+      // NOTE: we write all times as real times (seconds) *not* as
+      // "iterations" (or "scaled times") in order to be able to
+      // re-schedule them properly upon restart
+
+      // The scheduling time (t) is essentially iterations, and since time
+      // steps can change when checkpointing, we can't directly convert
+      // iterations to real time (seconds). We need to correct for this by
+      // only converting the iterations of the current simulation
+      // [(t-start_iterations)*time_unit] and adding the real time at the
+      // start of the simulation (simulation_start_seconds).
+      double t = convert_iterations_to_seconds(
+          start_iterations, time_unit, simulation_start_seconds, amp->t);
+      WRITEFIELD(t);
+      // We do a simple conversion for the lifetime t2, since this
+      // corresponds to some event in the future and can be directly
+      // computed without using an offset.
+      double t2 = amp->t2 * time_unit;
+      WRITEFIELD(t2);
+      // Birthday is now always treated as real time in seconds, not
+      // "scaled" time or iterations.
+      double bday = amp->birthday;
+      WRITEFIELD(bday);
+      WRITEFIELD(where);
+      WRITEINT(orient);
+
+      static const unsigned char NON_COMPLEX = '\0';
+      WRITEFIELD(NON_COMPLEX);
     }
+    end_storage_walk(&walk);
   }
 
   return 0;
@@ -1320,7 +1395,7 @@ static int read_mol_scheduler_state_real(struct volume *world, FILE *fs,
       vmp->pos.x = x_coord;
       vmp->pos.y = y_coord;
       vmp->pos.z = z_coord;
-      amp->periodic_box = &periodic_box;
+      amp->periodic_box = periodic_box;
 
       /* Set molecule flags */
       amp->flags = TYPE_VOL | IN_VOLUME;
@@ -78,6 +78,10 @@ static int find_enclosing_regions(struct volume *world, struct vector3 *loc,
                                   struct region_list **arlp,
                                   struct mem_helper *rmem);
 
+/* The counter data to update in the calling context */
+static union counter_data *local_count_data(struct volume *world,
+                                            struct counter *c);
+
 void count_region_list(
     struct volume *world,
     struct region_list *regions,
@@ -175,7 +179,6 @@ void count_region_update(
     int crossed,
     struct vector3 *loc,
     double t) {
-
   int count_hits = 0;
   double hits_to_ccn = 0;
   if ((sp->flags & COUNT_HITS) && ((sp->flags & NOT_FREE) == 0)) {
@@ -186,6 +189,7 @@ void count_region_update(
                    world->length_unit);
   }
 
+  double t_event = (double)world->current_iterations + t;
   struct counter *hit_count = NULL;
   for (; rl != NULL; rl = rl->next) {
     if (!(rl->reg->flags & COUNT_SOME_MASK)) {
@@ -226,51 +230,51 @@ void count_region_update(
       if (crossed) {
         if (direction == 1) {
           if (hit_count->counter_type & TRIG_COUNTER) {
-            hit_count->data.trig.t_event = (double)world->current_iterations + t;
-            hit_count->data.trig.orient = 0;
             if (rl->reg->flags & sp->flags & COUNT_HITS) {
-              fire_count_event(world, hit_count, 1, loc,
+              fire_count_event(world, hit_count, 1, loc, t_event, 0,
                                REPORT_FRONT_HITS | REPORT_TRIGGER, id);
 
-              fire_count_event(world, hit_count, 1, loc,
+              fire_count_event(world, hit_count, 1, loc, t_event, 0,
                                REPORT_FRONT_CROSSINGS | REPORT_TRIGGER, id);
             }
             if (rl->reg->flags & sp->flags & COUNT_CONTENTS) {
-              fire_count_event(world, hit_count, 1, loc,
+              fire_count_event(world, hit_count, 1, loc, t_event, 0,
                                REPORT_ENCLOSED | REPORT_CONTENTS |
                                    REPORT_TRIGGER, id);
             }
           } else {
+            struct move_counter_data *move =
+                &local_count_data(world, hit_count)->move;
             if (rl->reg->flags & sp->flags & COUNT_HITS) {
-              hit_count->data.move.front_hits++;
-              hit_count->data.move.front_to_back++;
+              move->front_hits++;
+              move->front_to_back++;
             }
             if (rl->reg->flags & sp->flags & COUNT_CONTENTS) {
-              hit_count->data.move.n_enclosed++;
+              move->n_enclosed++;
             }
           }
         } else {
           if (hit_count->counter_type & TRIG_COUNTER) {
-            hit_count->data.trig.t_event = (double)world->current_iterations + t;
-            hit_count->data.trig.orient = 0;
             if (rl->reg->flags & sp->flags & COUNT_HITS) {
-              fire_count_event(world, hit_count, 1, loc,
+              fire_count_event(world, hit_count, 1, loc, t_event, 0,
                                REPORT_BACK_HITS | REPORT_TRIGGER, id);
-              fire_count_event(world, hit_count, 1, loc,
+              fire_count_event(world, hit_count, 1, loc, t_event, 0,
                                REPORT_BACK_CROSSINGS | REPORT_TRIGGER, id);
             }
             if (rl->reg->flags & sp->flags & COUNT_CONTENTS) {
               fire_count_event(
-                  world, hit_count, -1, loc,
+                  world, hit_count, -1, loc, t_event, 0,
                   REPORT_ENCLOSED | REPORT_CONTENTS | REPORT_TRIGGER, id);
             }
           } else {
+            struct move_counter_data *move =
+                &local_count_data(world, hit_count)->move;
             if (rl->reg->flags & sp->flags & COUNT_HITS) {
-              hit_count->data.move.back_hits++;
-              hit_count->data.move.back_to_front++;
+              move->back_hits++;
+              move->back_to_front++;
             }
             if (rl->reg->flags & sp->flags & COUNT_CONTENTS) {
-              hit_count->data.move.n_enclosed--;
+              move->n_enclosed--;
             }
           }
         }
@@ -278,27 +282,24 @@ void count_region_update(
       /* Didn't cross, only hits might update */
         if (direction == 1) {
           if (hit_count->counter_type & TRIG_COUNTER) {
-            hit_count->data.trig.t_event = (double)world->current_iterations + t;
-            hit_count->data.trig.orient = 0;
-            fire_count_event(world, hit_count, 1, loc,
+            fire_count_event(world, hit_count, 1, loc, t_event, 0,
                              REPORT_FRONT_HITS | REPORT_TRIGGER, id);
           } else {
-            hit_count->data.move.front_hits++;
+            local_count_data(world, hit_count)->move.front_hits++;
           }
         } else {
           if (hit_count->counter_type & TRIG_COUNTER) {
-            hit_count->data.trig.t_event = (double)world->current_iterations + t;
-            hit_count->data.trig.orient = 0;
-            fire_count_event(world, hit_count, 1, loc,
+            fire_count_event(world, hit_count, 1, loc, t_event, 0,
                              REPORT_BACK_HITS | REPORT_TRIGGER, id);
           } else
-            hit_count->data.move.back_hits++;
+            local_count_data(world, hit_count)->move.back_hits++;
         }
       }
       if ((count_hits && rl->reg->area != 0.0) &&
           ((sp->flags & NOT_FREE) == 0)) {
         if ((hit_count->counter_type & TRIG_COUNTER) == 0) {
-          hit_count->data.move.scaled_hits += hits_to_ccn / rl->reg->area;
+          local_count_data(world, hit_count)->move.scaled_hits +=
+              hits_to_ccn / rl->reg->area;
         }
       }
     }
@@ -320,7 +321,6 @@ count_region_border_update:
 **************************************************************************/
 void count_region_border_update(struct volume *world, struct species *sp,
                                 struct hit_data *hd_info, u_long id) {
-
   assert((sp->flags & NOT_FREE) != 0);
 
   for (struct hit_data *hd = hd_info; hd != NULL; hd = hd->next) {
@@ -344,33 +344,33 @@ void count_region_border_update(struct volume *world, struct species *sp,
           }
 
           if (hit_count->counter_type & TRIG_COUNTER) {
-            hit_count->data.trig.t_event = hd->t;
-            hit_count->data.trig.orient = 0;
             if (hd->direction == 1) {
-              fire_count_event(world, hit_count, 1, &(hd->loc),
+              fire_count_event(world, hit_count, 1, &(hd->loc), hd->t, 0,
                 REPORT_FRONT_HITS | REPORT_TRIGGER, id);
               if (hd->crossed) {
-                fire_count_event(world, hit_count, 1, &(hd->loc),
+                fire_count_event(world, hit_count, 1, &(hd->loc), hd->t, 0,
                   REPORT_FRONT_CROSSINGS | REPORT_TRIGGER, id);
               }
             } else {
-              fire_count_event(world, hit_count, 1, &(hd->loc),
+              fire_count_event(world, hit_count, 1, &(hd->loc), hd->t, 0,
                 REPORT_BACK_HITS | REPORT_TRIGGER, id);
               if (hd->crossed) {
-                fire_count_event(world, hit_count, 1, &(hd->loc),
+                fire_count_event(world, hit_count, 1, &(hd->loc), hd->t, 0,
                   REPORT_BACK_CROSSINGS | REPORT_TRIGGER, id);
               }
             }
           } else {
+            struct move_counter_data *move =
+                &local_count_data(world, hit_count)->move;
             if (hd->direction == 1) {
-              hit_count->data.move.front_hits++;
+              move->front_hits++;
               if (hd->crossed) {
-                hit_count->data.move.front_to_back++;
+                move->front_to_back++;
               }
             } else {
-              hit_count->data.move.back_hits++;
+              move->back_hits++;
               if (hd->crossed) {
-                hit_count->data.move.back_to_front++;
+                move->back_to_front++;
               }
             }
           }
@@ -461,24 +461,23 @@ void count_region_from_scratch(struct volume *world,
         if (c->target == target && c->reg_type == rl->reg &&
             (c->counter_type & ENCLOSING_COUNTER) == 0) {
           if (c->counter_type & TRIG_COUNTER) {
-            c->data.trig.t_event = t;
-            c->data.trig.orient = orient;
             // XXX: may need to convert loc for PBCs
-            fire_count_event(world, c, n, loc, count_flags | REPORT_TRIGGER, mol_id);
+            fire_count_event(world, c, n, loc, t, orient,
+                             count_flags | REPORT_TRIGGER, mol_id);
           } else if (rxpn == NULL) {
             if (am->properties->flags & ON_GRID) {
               if ((c->orientation == ORIENT_NOT_SET) ||
                   (c->orientation == orient) || (c->orientation == 0)) {
                 // count only in the relevant periodic box
-                if (periodic_boxes_are_identical(am->periodic_box, c->periodic_box)) {
-                  c->data.move.n_at += n;
+                if (periodic_boxes_are_identical(&am->periodic_box, c->periodic_box)) {
+                  local_count_data(world, c)->move.n_at += n;
                 }
               }
             } else {
-              c->data.move.n_at += n;
+              local_count_data(world, c)->move.n_at += n;
             }
           } else if ((rxpn != NULL) && (periodic_boxes_are_identical(periodic_box, c->periodic_box))) {
-            c->data.rx.n_rxn_at += n;
+            local_count_data(world, c)->rx.n_rxn_at += n;
           }
         }
       }
@@ -560,13 +559,13 @@ void count_region_from_scratch(struct volume *world,
 
         if (wl->this_wall->flags & (COUNT_CONTENTS | COUNT_ENCLOSED)) {
           int hit_code = collide_wall(&here, &delta, wl->this_wall, &t_hit,
-                                      &hit, 0, world->rng, world->notify,
-                                      &(world->ray_polygon_tests));
+                                      &hit, 0, local_rng(world), world->notify,
+                                      &local_stats(world)->ray_polygon_tests);
           if (hit_code == COLLIDE_MISS) {
             continue;
           }
 
-          world->ray_polygon_colls++;
+          local_stats(world)->ray_polygon_colls++;
           if (t_hit <= t_sv_hit && (hit.x - loc->x) * delta.x +
             (hit.y - loc->y) * delta.y + (hit.z - loc->z) * delta.z < 0) {
             for (rl = wl->this_wall->counting_regions; rl != NULL;
@@ -627,25 +626,23 @@ void count_region_from_scratch(struct volume *world,
                (am != NULL && (am->properties->flags & NOT_FREE) == 0) ||
                !region_listed(my_wall->counting_regions, rl->reg))) {
             if (c->counter_type & TRIG_COUNTER) {
-              c->data.trig.t_event = t;
-              c->data.trig.orient = orient;
               // Don't count triggers after a dynamic geometry event
               if (!world->dynamic_geometry_flag) {
                 // XXX: may need to convert loc for PBCs
-                fire_count_event(world, c, n * pos_or_neg, loc,
+                fire_count_event(world, c, n * pos_or_neg, loc, t, orient,
                                  count_flags | REPORT_TRIGGER, mol_id);
               }
             } else if (rxpn == NULL) {
               if (am->properties->flags & ON_GRID) {
                 if ((c->orientation == ORIENT_NOT_SET) ||
                     (c->orientation == orient) || (c->orientation == 0)) {
-                  c->data.move.n_enclosed += n * pos_or_neg;
+                  local_count_data(world, c)->move.n_enclosed += n * pos_or_neg;
                 }
               } else {
-                c->data.move.n_enclosed += n * pos_or_neg;
+                local_count_data(world, c)->move.n_enclosed += n * pos_or_neg;
               }
             } else {
-              c->data.rx.n_rxn_enclosed += n * pos_or_neg;
+              local_count_data(world, c)->rx.n_rxn_enclosed += n * pos_or_neg;
             }
           }
         }
@@ -692,7 +689,9 @@ void count_moved_surface_mol(
   struct region_list *prl = NULL;
   struct region_list *rl = NULL;
   struct region_list *rl2 = NULL;
-  struct storage *stor = sm->grid->surface->birthplace;
+  /* The wall may belong to a storage another thread is running */
+  struct storage *stor = thread_can_defer() ? current_thread->store
+                                            : sm->grid->surface->birthplace;
   // Different grids implies different walls, so we might have changed regions 
   /*if (sm->grid != sg) {*/
   if ((sm->grid != sg) ||
@@ -789,7 +788,7 @@ void count_moved_surface_mol(
   uv2xyz(&(sm->s_pos), sm->grid->surface, &origin);
   uv2xyz(loc, sg->surface, &target);
   if ((sm->properties->flags & COUNT_ENCLOSED) &&
-      (periodic_boxes_are_identical(previous_box, sm->periodic_box))) {
+      (periodic_boxes_are_identical(previous_box, &sm->periodic_box))) {
 
     pos_regs = neg_regs = NULL;
     struct vector3 delta = {target.x - origin.x, target.y - origin.y, target.z - origin.z};
@@ -808,8 +807,9 @@ void count_moved_surface_mol(
 
         struct vector3 hit = {0.0, 0.0, 0.0};
         double t = 0.0;
-        j = collide_wall(&here, &delta, wl->this_wall, &t, &hit, 0, world->rng,
-          world->notify, &(world->ray_polygon_tests));
+        j = collide_wall(&here, &delta, wl->this_wall, &t, &hit, 0,
+          local_rng(world), world->notify,
+          &local_stats(world)->ray_polygon_tests);
 
         /* we only consider the collision if it happens in the current subvolume.
            Otherwise we may double count collision for walls that span multiple
@@ -820,7 +820,7 @@ void count_moved_surface_mol(
         }
 
         if (j != COLLIDE_MISS) {
-          (*ray_polygon_colls)++;
+          THREADED_ADD(*ray_polygon_colls, 1);
         }
 
         /* check that hit is encountered before we reach the target */
@@ -898,16 +898,14 @@ void count_moved_surface_mol(
           assert(!region_listed(sg->surface->counting_regions, rl->reg));
 
           if (c->counter_type & TRIG_COUNTER) {
-            c->data.trig.t_event = sm->t;
-            c->data.trig.orient = sm->orient;
-            fire_count_event(world, c, n, where, REPORT_CONTENTS | REPORT_ENCLOSED |
-              REPORT_TRIGGER, sm->id);
+            fire_count_event(world, c, n, where, sm->t, sm->orient,
+              REPORT_CONTENTS | REPORT_ENCLOSED | REPORT_TRIGGER, sm->id);
           } else if ((c->orientation == ORIENT_NOT_SET) ||
                      (c->orientation == sm->orient) ||
                      (c->orientation == 0)) {
             /*c->data.move.n_enclosed += n;*/
-            if (periodic_boxes_are_identical(c->periodic_box, sm->periodic_box)) {
-              c->data.move.n_enclosed += n;
+            if (periodic_boxes_are_identical(c->periodic_box, &sm->periodic_box)) {
+              local_count_data(world, c)->move.n_enclosed += n;
             }
           }
         }
@@ -920,26 +918,73 @@ void count_moved_surface_mol(
       mem_put_list(stor->regl, neg_regs);
   }
   else if ((sm->properties->flags & COUNT_ENCLOSED) &&
-      (!periodic_boxes_are_identical(previous_box, sm->periodic_box))) {
+      (!periodic_boxes_are_identical(previous_box, &sm->periodic_box))) {
     // Increment count of where we are going now (target)
-    count_region_from_scratch(world, (struct abstract_molecule *)sm, NULL, 1, &target, NULL, 1.0, sm->periodic_box);
+    count_region_from_scratch(world, (struct abstract_molecule *)sm, NULL, 1, &target, NULL, 1.0, &sm->periodic_box);
     // Decrement count of where we were before (origin)
     count_region_from_scratch(world, (struct abstract_molecule *)sm, NULL, -1, &origin, NULL, 1.0, previous_box);
   }
 }
 
+/*************************************************************************
+queue_pending_trigger:
+   In: shard: region count updates of a storage
+       pt: the trigger event
+   Out: None.  A copy of the event is appended to the events of the
+        storage, to be reported by flush_pending_triggers.
+*************************************************************************/
+void queue_pending_trigger(struct count_shard *shard,
+                           struct pending_trigger *pt) {
+  if (shard->trigger_mem == NULL)
+    shard->trigger_mem = create_mem_named(sizeof(struct pending_trigger),
+                                          128, "pending trigger events");
+  if (shard->triggers == NULL)
+    shard->triggers_tail = &shard->triggers;
+
+  struct pending_trigger *copy = (struct pending_trigger *)CHECKED_MEM_GET(
+      shard->trigger_mem, "pending trigger event");
+  *copy = *pt;
+  copy->next = NULL;
+  *shard->triggers_tail = copy;
+  shard->triggers_tail = &copy->next;
+}
+
+/*************************************************************************
+report_trigger:
+   In: world: simulation state
+       pt: the trigger event
+   Out: None.  Outside of pool tasks the event goes straight to the
+        trigger output.  Pool tasks append it to the events of the storage
+        they run; flush_pending_triggers reports those later.
+*************************************************************************/
+static void report_trigger(struct volume *world, struct pending_trigger *pt) {
+  if (current_thread != NULL) {
+    queue_pending_trigger(current_thread->counts, pt);
+    return;
+  }
+
+  struct counter *event = pt->event;
+  event->data.trig.t_event = pt->t_event;
+  event->data.trig.loc = pt->loc;
+  event->data.trig.orient = pt->orient;
+  add_trigger_output(world, event, pt->ear, pt->n, pt->flags, pt->id);
+}
+
 /*************************************************************************
 fire_count_event:
    In: world: simulation state
        event: counter of thing that just happened (trigger of some sort)
        n: number of times that thing happened (or hit direction for triggers)
        where: location where it happened
+       t_event: time at which it happened
+       orient: orientation of the molecule (for MOL_COUNTER)
        what: what happened (Report Type Flags)
+       id: id of the molecule involved
    Out: None
 *************************************************************************/
 void fire_count_event(struct volume *world, struct counter *event, int n,
-                      struct vector3 *where, byte what, u_long id) {
-
+                      struct vector3 *where, double t_event, short orient,
+                      byte what, u_long id) {
   short flags;
   if ((what & REPORT_TYPE_MASK) == REPORT_RXNS)
     flags = TRIG_IS_RXN;
@@ -958,29 +1003,212 @@ void fire_count_event(struct volume *world, struct counter *event, int n,
   else if ((what & REPORT_TYPE_MASK) == REPORT_BACK_CROSSINGS)
     whatelse = (what - REPORT_BACK_CROSSINGS) | REPORT_ALL_CROSSINGS;
 
+  struct pending_trigger pt = {
+    .event = event, .t_event = t_event, .loc = *where, .orient = orient,
+    .flags = flags, .id = id
+  };
   struct trigger_request *tr;
   for (tr = event->data.trig.listeners; tr != NULL; tr = tr->next) {
+    pt.ear = tr->ear;
     if (tr->ear->report_type == what) {
-      memcpy(&(event->data.trig.loc), where, sizeof(struct vector3));
       if ((what & REPORT_TYPE_MASK) == REPORT_FRONT_HITS ||
           (what & REPORT_TYPE_MASK) == REPORT_FRONT_CROSSINGS) {
-        add_trigger_output(world, event, tr->ear, n, flags, id);
+        pt.n = n;
       } else if ((what & REPORT_TYPE_MASK) == REPORT_BACK_HITS ||
                  (what & REPORT_TYPE_MASK) == REPORT_BACK_CROSSINGS) {
-        add_trigger_output(world, event, tr->ear, -n, flags, id);
+        pt.n = -n;
       } else {
-        add_trigger_output(world, event, tr->ear, n, flags, id);
+        pt.n = n;
       }
+      report_trigger(world, &pt);
 
     } else if (tr->ear->report_type == whatelse) {
-      memcpy(&(event->data.trig.loc), where, sizeof(struct vector3));
       if ((what & REPORT_TYPE_MASK) == REPORT_FRONT_HITS ||
           (what & REPORT_TYPE_MASK) == REPORT_FRONT_CROSSINGS) {
-        add_trigger_output(world, event, tr->ear, n, flags, id);
+        pt.n = n;
       } else {
-        add_trigger_output(world, event, tr->ear, -n, flags, id);
+        pt.n = -n;
+      }
+      report_trigger(world, &pt);
+    }
+  }
+}
+
+/*************************************************************************
+compare_pending_triggers:
+   In: two pointers to pending trigger events
+   Out: qsort ordering by event time; events at the same time keep the
+        order in which they were collected.
+*************************************************************************/
+static int compare_pending_triggers(const void *a, const void *b) {
+  const struct pending_trigger *pa = *(struct pending_trigger * const *)a;
+  const struct pending_trigger *pb = *(struct pending_trigger * const *)b;
+  if (pa->t_event != pb->t_event)
+    return (pa->t_event < pb->t_event) ? -1 : 1;
+  return (pa->seq < pb->seq) ? -1 : (pa->seq > pb->seq);
+}
+
+/*************************************************************************
+flush_pending_triggers:
+   In: world: simulation state
+   Out: None.  Trigger events queued by pool tasks are reported in order
+        of event time.  Events at the same time are reported by storage,
+        then in the order they were fired, so the output does not depend
+        on the number of threads.  Must not be called while storages are
+        being run.
+*************************************************************************/
+void flush_pending_triggers(struct volume *world) {
+  long n_events = 0;
+  for (int i = 0; i < world->n_storage_streams; i++) {
+    for (struct pending_trigger *pt = world->storage_streams[i].counts.triggers;
+         pt != NULL; pt = pt->next)
+      n_events++;
+  }
+  if (n_events == 0)
+    return;
+
+  struct pending_trigger **order = CHECKED_MALLOC_ARRAY(
+      struct pending_trigger *, n_events, "pending trigger events");
+  n_events = 0;
+  for (int i = 0; i < world->n_storage_streams; i++) {
+    for (struct pending_trigger *pt = world->storage_streams[i].counts.triggers;
+         pt != NULL; pt = pt->next) {
+      pt->seq = n_events;
+      order[n_events++] = pt;
+    }
+  }
+
+  qsort(order, n_events, sizeof(struct pending_trigger *),
+        compare_pending_triggers);
+  for (long i = 0; i < n_events; i++)
+    report_trigger(world, order[i]);
+  free(order);
+
+  for (int i = 0; i < world->n_storage_streams; i++) {
+    struct count_shard *shard = &world->storage_streams[i].counts;
+    if (shard->triggers != NULL)
+      mem_put_list(shard->trigger_mem, shard->triggers);
+    shard->triggers = NULL;
+    shard->triggers_tail = &shard->triggers;
+  }
+}
+
+/*************************************************************************
+grow_count_shard:
+   In: shard: the region count updates of a storage
+   Out: None.  The room for deltas is doubled, so that the hash finding
+        them stays at most half full.
+*************************************************************************/
+static void grow_count_shard(struct count_shard *shard) {
+  int n_slots = (shard->delta_slot == NULL) ? 16 : 2 * (shard->slot_mask + 1);
+  struct count_delta *deltas = CHECKED_MALLOC_ARRAY(
+      struct count_delta, n_slots / 2, "region count deltas");
+  int *delta_slot =
+      CHECKED_MALLOC_ARRAY(int, n_slots, "region count delta hash");
+  memset(delta_slot, 0, n_slots * sizeof(int));
+  for (int k = 0; k < shard->n_deltas; k++) {
+    deltas[k] = shard->deltas[k];
+    int h = deltas[k].counter->index & (n_slots - 1);
+    while (delta_slot[h] != 0)
+      h = (h + 1) & (n_slots - 1);
+    delta_slot[h] = k + 1;
+  }
+  free(shard->deltas);
+  free(shard->delta_slot);
+  shard->deltas = deltas;
+  shard->delta_slot = delta_slot;
+  shard->slot_mask = n_slots - 1;
+}
+
+/*************************************************************************
+local_count_data:
+   In: world: simulation state
+       c: a molecule or reaction counter
+   Out: The counter data that the calling context adds its counts to.
+        Outside of pool tasks this is the counter itself.  A pool task gets
+        the delta kept for the counter by the storage it runs, so threads
+        never write to a shared counter.
+*************************************************************************/
+static union counter_data *local_count_data(struct volume *world,
+                                            struct counter *c) {
+  if (current_thread == NULL)
+    return &c->data;
+
+  struct count_shard *shard = current_thread->counts;
+  if (shard->delta_slot == NULL || 2 * (shard->n_deltas + 1) > shard->slot_mask + 1)
+    grow_count_shard(shard);
+
+  int h = c->index & shard->slot_mask;
+  while (shard->delta_slot[h] != 0) {
+    struct count_delta *d = &shard->deltas[shard->delta_slot[h] - 1];
+    if (d->counter == c)
+      return &d->data;
+    h = (h + 1) & shard->slot_mask;
+  }
+
+  struct count_delta *d = &shard->deltas[shard->n_deltas++];
+  d->counter = c;
+  memset(&d->data, 0, sizeof(union counter_data));
+  shard->delta_slot[h] = shard->n_deltas;
+  return &d->data;
+}
+
+/*************************************************************************
+merge_count_deltas:
+   In: world: simulation state
+   Out: None.  The region count deltas of every storage are added to the
+        counters and reset.  Must not be called while storages are being
+        run.
+   Note: The storages are visited in order, so each counter gets its
+         deltas in the same order and the floating point sums come out the
+         same whatever the number of threads.
+*************************************************************************/
+void merge_count_deltas(struct volume *world) {
+  for (int j = 0; j < world->n_storage_streams; j++) {
+    struct count_shard *shard = &world->storage_streams[j].counts;
+    if (shard->n_deltas == 0)
+      continue;
+
+    for (int k = 0; k < shard->n_deltas; k++) {
+      struct counter *c = shard->deltas[k].counter;
+      union counter_data *d = &shard->deltas[k].data;
+      if (c->counter_type & TRIG_COUNTER)
+        continue;
+
+      if (c->counter_type & RXN_COUNTER) {
+        c->data.rx.n_rxn_at += d->rx.n_rxn_at;
+        c->data.rx.n_rxn_enclosed += d->rx.n_rxn_enclosed;
+      } else if (c->counter_type & MOL_COUNTER) {
+        c->data.move.front_hits += d->move.front_hits;
+        c->data.move.back_hits += d->move.back_hits;
+        c->data.move.front_to_back += d->move.front_to_back;
+        c->data.move.back_to_front += d->move.back_to_front;
+        c->data.move.scaled_hits += d->move.scaled_hits;
+        c->data.move.n_at += d->move.n_at;
+        c->data.move.n_enclosed += d->move.n_enclosed;
       }
     }
+    shard->n_deltas = 0;
+    memset(shard->delta_slot, 0, (shard->slot_mask + 1) * sizeof(int));
+  }
+}
+
+/*************************************************************************
+destroy_count_shards:
+   In: world: simulation state
+   Out: None.  Outstanding deltas and trigger events of every storage are
+        merged and reported, and the memory holding them is freed.
+*************************************************************************/
+void destroy_count_shards(struct volume *world) {
+  merge_count_deltas(world);
+  flush_pending_triggers(world);
+  for (int i = 0; i < world->n_storage_streams; i++) {
+    struct count_shard *shard = &world->storage_streams[i].counts;
+    free(shard->deltas);
+    free(shard->delta_slot);
+    if (shard->trigger_mem != NULL)
+      delete_mem(shard->trigger_mem);
+    memset(shard, 0, sizeof(struct count_shard));
   }
 }
 
@@ -1038,12 +1266,12 @@ static int find_enclosing_regions(struct volume *world,
 
     for (wl = sv->wall_head; wl != NULL; wl = wl->next) {
       int hit_code =
-          collide_wall(&outside, &delta, wl->this_wall, &t, &hit, 0, world->rng,
-                       world->notify, &(world->ray_polygon_tests));
+          collide_wall(&outside, &delta, wl->this_wall, &t, &hit, 0, local_rng(world),
+                       world->notify, &local_stats(world)->ray_polygon_tests);
 
       if ((hit_code != COLLIDE_MISS) &&
           (world->notify->final_summary == NOTIFY_FULL)) {
-        world->ray_polygon_colls++;
+        local_stats(world)->ray_polygon_colls++;
       }
 
       if (hit_code == COLLIDE_REDO) {
@@ -1379,6 +1607,14 @@ int prepare_counters(struct volume *world) {
     }
   }
 
+  /* Number the counters for the per-storage delta arrays */
+  merge_count_deltas(world);
+  world->n_counters = 0;
+  for (int i = 0; i <= world->count_hashmask; i++) {
+    for (struct counter *c = world->count_hash[i]; c != NULL; c = c->next)
+      c->index = world->n_counters++;
+  }
+
   return 0;
 }
 
@@ -2055,12 +2291,12 @@ void count_region_list(
         else if ((c->orientation == ORIENT_NOT_SET) ||
                  (c->orientation == sm->orient) || (c->orientation == 0)) {
           if ((inc == 1) && (periodic_boxes_are_identical(
-              sm->periodic_box, c->periodic_box))) {
-            c->data.move.n_at++;
+              &sm->periodic_box, c->periodic_box))) {
+            local_count_data(world, c)->move.n_at++;
           }
           else if ((inc == -1) && (previous_box != NULL) &&
                    (periodic_boxes_are_identical(previous_box, c->periodic_box))) {
-            c->data.move.n_at--;
+            local_count_data(world, c)->move.n_at--;
           }
         }
       }
@@ -55,7 +55,15 @@ void count_moved_surface_mol(struct volume *world, struct surface_molecule *sm,
   struct periodic_image *previous_box);
 
 void fire_count_event(struct volume *world, struct counter *event, int n,
-                      struct vector3 *where, byte what, u_long id);
+                      struct vector3 *where, double t_event, short orient,
+                      byte what, u_long id);
+
+void queue_pending_trigger(struct count_shard *shard,
+                           struct pending_trigger *pt);
+
+void flush_pending_triggers(struct volume *world);
+void merge_count_deltas(struct volume *world);
+void destroy_count_shards(struct volume *world);
 
 int place_waypoints(struct volume *world);
 
@@ -38,13 +38,7 @@
 #include "react.h"
 
 
-#define FREE_COLLISION_LISTS()                                                 \
-  do {                                                                         \
-    if (shead2 != NULL)                                                        \
-      mem_put_list(sv->local_storage->coll, shead2);                           \
-    if (shead != NULL)                                                         \
-      mem_put_list(sv->local_storage->coll, shead);                            \
-  } while (0)
+#define FREE_COLLISION_LISTS() scratch_release(scratch, step_mark)
 
 
 static const int inert_to_mol = 1;
@@ -107,13 +101,18 @@ void collide_and_react_with_subvol(
   struct volume_molecule** mol, struct collision** tentative, double* t_steps);
 
 void compute_displacement(
-  struct volume* world, struct collision* shead, struct volume_molecule* vm,
+  struct volume* world, int inertness, struct volume_molecule* vm,
   struct vector3* displacement, struct vector3* displacement2,
   double* rate_factor, double* r_rate_factor, double* steps, double* t_steps,
   double max_time);
 
+double nearest_reaction_partner(
+  struct volume* world, struct volume_molecule* vm, int inertness,
+  double d2_enough);
+
 void determine_mol_mol_reactions(
-  struct volume* world, struct volume_molecule* vm, struct collision** shead,
+  struct volume* world, struct volume_molecule* vm,
+  struct vector3* displacement, struct collision** shead,
   struct collision** stail, int interness);
 
 void set_inertness_and_maxtime(
@@ -321,9 +320,11 @@ pick_displacement:
          3D molecule, scaled by the scaling factor.
 *************************************************************************/
 void pick_displacement(struct vector3 *v, double scale, struct rng_state *rng) {
-  v->x = scale * rng_gauss(rng) * .70710678118654752440;
-  v->y = scale * rng_gauss(rng) * .70710678118654752440;
-  v->z = scale * rng_gauss(rng) * .70710678118654752440;
+  double g[3];
+  rng_gauss_block(rng, g, 3);
+  v->x = scale * g[0] * .70710678118654752440;
+  v->y = scale * g[1] * .70710678118654752440;
+  v->z = scale * g[2] * .70710678118654752440;
 }
 
 /*************************************************************************
@@ -382,18 +383,21 @@ struct vector3* reflect_periodic_2D(
           state->z_fineparts, state->ny_parts,
           state->nz_parts)) {
 
-    // Check all the walls in this subvolume
-    for (struct wall_list *wl = sv->wall_head; wl != NULL; wl = wl->next) {
+    // Check the walls in this subvolume that we might cross
+    struct wall_cursor cursor;
+    wall_cursor_segment(&cursor, sv, &updated_xyz, &delta_xyz);
+    struct wall *w;
+    while ((w = wall_cursor_next(&cursor)) != NULL) {
       // Skip it if it's not part of the periodic box
-      if (wl->this_wall->parent_object != state->periodic_box_obj) {
+      if (w->parent_object != state->periodic_box_obj) {
         continue;
       }
 
       struct vector3 *hit_xyz = malloc(sizeof(*hit_xyz));
       double t = 0.0;
       int i = collide_wall(
-          &updated_xyz, &delta_xyz, wl->this_wall, &t, hit_xyz, 0, state->rng,
-          state->notify, &(state->ray_polygon_tests));
+          &updated_xyz, &delta_xyz, w, &t, hit_xyz, 0, local_rng(state),
+          state->notify, &local_stats(state)->ray_polygon_tests);
       if (i != COLLIDE_MISS &&
           (hit_xyz->x - target_xyz.x) * delta_xyz.x +
           (hit_xyz->y - target_xyz.y) * delta_xyz.y +
@@ -447,9 +451,9 @@ void change_boxes_2D(
   double llz = sb->z[0];
   double urz = sb->z[1];
 
-  int x_inc = (sm->periodic_box->x % 2 == 0) ? 1 : -1;
-  int y_inc = (sm->periodic_box->y % 2 == 0) ? 1 : -1;
-  int z_inc = (sm->periodic_box->z % 2 == 0) ? 1 : -1;
+  int x_inc = (sm->periodic_box.x % 2 == 0) ? 1 : -1;
+  int y_inc = (sm->periodic_box.y % 2 == 0) ? 1 : -1;
+  int z_inc = (sm->periodic_box.z % 2 == 0) ? 1 : -1;
   int box_inc_x = 0;
   int box_inc_y = 0;
   int box_inc_z = 0;
@@ -494,9 +498,9 @@ void change_boxes_2D(
   }
 
   if (!(periodic_traditional) && (box_inc_x || box_inc_y || box_inc_z)) {
-    sm->periodic_box->x += box_inc_x;
-    sm->periodic_box->y += box_inc_y;
-    sm->periodic_box->z += box_inc_z;
+    sm->periodic_box.x += box_inc_x;
+    sm->periodic_box.y += box_inc_y;
+    sm->periodic_box.z += box_inc_z;
   }
 }
 
@@ -721,9 +725,9 @@ struct wall *ray_trace_2D(
   struct vector2 this_disp = { .u = disp->u,
                                .v = disp->v
                              };
-  struct periodic_image orig_box = { .x = sm->periodic_box->x,
-                                     .y = sm->periodic_box->y,
-                                     .z = sm->periodic_box->z
+  struct periodic_image orig_box = { .x = sm->periodic_box.x,
+                                     .y = sm->periodic_box.y,
+                                     .z = sm->periodic_box.z
                                    };
   struct vector3 origin_xyz;
   uv2xyz(&this_pos, this_wall, &origin_xyz);
@@ -809,9 +813,9 @@ struct wall *ray_trace_2D(
     if (index_edge_was_hit == -2) {
       sm->s_pos.u = orig_pos.u;
       sm->s_pos.v = orig_pos.v;
-      sm->periodic_box->x = orig_box.x;
-      sm->periodic_box->y = orig_box.y;
-      sm->periodic_box->z = orig_box.z;
+      sm->periodic_box.x = orig_box.x;
+      sm->periodic_box.y = orig_box.y;
+      sm->periodic_box.z = orig_box.z;
       *hit_data_info = hit_data_head;
       return NULL;
     }
@@ -959,7 +963,9 @@ ray_trace:
   Out: collision list of walls and molecules we intersected along our ray
        (current subvolume only), plus the subvolume wall.  Will always
        return at least the subvolume wall--NULL indicates an out of
-       memory error.
+       memory error.  The list is taken from the scratch arena of the
+       calling context, and lasts until the arena is released to a mark
+       saved before the call.
 *************************************************************************/
 struct collision *ray_trace(struct volume *world, struct vector3 *init_pos,
                             struct collision *c, struct subvolume *sv,
@@ -968,39 +974,43 @@ struct collision *ray_trace(struct volume *world, struct vector3 *init_pos,
      will cross the x,y,z partitions, respectively. */
   double tx, ty, tz;
 
-  world->ray_voxel_tests++;
+  local_stats(world)->ray_voxel_tests++;
 
+  struct scratch_arena *scratch = local_scratch(world);
   struct collision *shead = NULL;
-  struct collision *smash = (struct collision *)CHECKED_MEM_GET(
-      sv->local_storage->coll, "collision structure");
-
-  struct wall_list fake_wlp;
-  fake_wlp.next = sv->wall_head;
+  struct collision *smash =
+      CHECKED_SCRATCH_GET(scratch, struct collision, "collision structure");
 
-  // Check wall collisions
-  for (struct wall_list *wlp = sv->wall_head; wlp != NULL; wlp = wlp->next) {
-    if (wlp->this_wall == reflectee)
+  // Check wall collisions, skipping the walls whose plane we don't cross
+  struct wall_cursor cursor;
+  wall_cursor_segment(&cursor, sv, init_pos, v);
+  struct wall *w;
+  while ((w = wall_cursor_next(&cursor)) != NULL) {
+    if (w == reflectee)
       continue;
 
-    int i = collide_wall(init_pos, v, wlp->this_wall, &(smash->t), &(smash->loc),
-                     1, world->rng, world->notify, &(world->ray_polygon_tests));
+    int i = collide_wall(init_pos, v, w, &(smash->t), &(smash->loc),
+                     1, local_rng(world), world->notify,
+                     &local_stats(world)->ray_polygon_tests);
     if (i == COLLIDE_REDO) {
-      if (shead != NULL)
-        mem_put_list(sv->local_storage->coll, shead);
       shead = NULL;
-      wlp = &fake_wlp;
+      if (world->notify->final_summary == NOTIFY_FULL)
+        local_stats(world)->ray_polygon_tests += cursor.n_screened;
+      wall_cursor_segment(&cursor, sv, init_pos, v);
       continue;
     } else if (i != COLLIDE_MISS) {
-      world->ray_polygon_colls++;
+      local_stats(world)->ray_polygon_colls++;
 
       smash->what = COLLIDE_WALL + i;
-      smash->target = (void *)wlp->this_wall;
+      smash->target = (void *)w;
       smash->next = shead;
       shead = smash;
-      smash = (struct collision *)CHECKED_MEM_GET(sv->local_storage->coll,
-                                                  "collision structure");
+      smash = CHECKED_SCRATCH_GET(scratch, struct collision,
+                                  "collision structure");
     }
   }
+  if (world->notify->final_summary == NOTIFY_FULL)
+    local_stats(world)->ray_polygon_tests += cursor.n_screened;
 
   double dx, dy, dz;
   dx = dy = dz = 0.0;
@@ -1128,8 +1138,8 @@ struct collision *ray_trace(struct volume *world, struct vector3 *init_pos,
 
     i = collide_mol(init_pos, v, a, &(c->t), &(c->loc), world->rx_radius_3d);
     if (i != COLLIDE_MISS) {
-      smash = (struct collision *)CHECKED_MEM_GET(sv->local_storage->coll,
-                                                  "collision structure");
+      smash = CHECKED_SCRATCH_GET(scratch, struct collision,
+                                  "collision structure");
       memcpy(smash, c, sizeof(struct collision));
 
       smash->what = COLLIDE_VOL + i;
@@ -1142,6 +1152,66 @@ struct collision *ray_trace(struct volume *world, struct vector3 *init_pos,
   return shead;
 }
 
+/*************************************************************************
+sort_collisions:
+  In: sa: scratch arena to take working space from
+      ae: head of a linked list of collisions (of any kind)
+  Out: head of the list sorted by time.  Collisions with equal times keep
+       their order, as with ae_list_sort, but the list is sorted as an
+       array of pointers so that short lists need no merging.
+*************************************************************************/
+struct abstract_element *sort_collisions(struct scratch_arena *sa,
+                                         struct abstract_element *ae) {
+  int n = 0;
+  for (struct abstract_element *p = ae; p != NULL; p = p->next)
+    n++;
+  if (n < 2)
+    return ae;
+
+  struct abstract_element **a = (struct abstract_element **)scratch_get(
+      sa, 2 * n * sizeof(struct abstract_element *));
+  if (a == NULL)
+    return ae_list_sort(ae);
+  struct abstract_element **b = a + n;
+  n = 0;
+  for (struct abstract_element *p = ae; p != NULL; p = p->next)
+    a[n++] = p;
+
+  /* Insertion sort for runs of a few, then stable merges of the runs */
+  const int run = 8;
+  for (int lo = 0; lo < n; lo += run) {
+    int hi = (lo + run < n) ? lo + run : n;
+    for (int i = lo + 1; i < hi; i++) {
+      struct abstract_element *x = a[i];
+      int j = i;
+      for (; j > lo && a[j - 1]->t > x->t; j--)
+        a[j] = a[j - 1];
+      a[j] = x;
+    }
+  }
+  for (int width = run; width < n; width *= 2) {
+    for (int lo = 0; lo < n; lo += 2 * width) {
+      int mid = (lo + width < n) ? lo + width : n;
+      int hi = (lo + 2 * width < n) ? lo + 2 * width : n;
+      int i = lo, j = mid, k = lo;
+      while (i < mid && j < hi)
+        b[k++] = (a[i]->t <= a[j]->t) ? a[i++] : a[j++];
+      while (i < mid)
+        b[k++] = a[i++];
+      while (j < hi)
+        b[k++] = a[j++];
+    }
+    struct abstract_element **swap = a;
+    a = b;
+    b = swap;
+  }
+
+  for (int i = 0; i < n - 1; i++)
+    a[i]->next = a[i + 1];
+  a[n - 1]->next = NULL;
+  return a[0];
+}
+
 /******************************/
 /** exact_disk stuff follows **/
 /******************************/
@@ -1333,7 +1403,6 @@ double exact_disk(struct volume *world, struct vector3 *loc, struct vector3 *mv,
 #define EXD_TIME_CALC(v1, v2, p)                                               \
   ((p)->u *(v1)->v - (p)->v *(v1)->u) /                                        \
       ((p)->v *((v2)->u - (v1)->u) - (p)->u *((v2)->v - (v1)->v))
-  struct wall_list *wl;
   struct wall *w;
   struct vector3 llf, urb;
 
@@ -1385,8 +1454,11 @@ double exact_disk(struct volume *world, struct vector3 *loc, struct vector3 *mv,
   }
 
   /* Find walls that occlude the interaction disk (or block the reaction) */
-  for (wl = sv->wall_head; wl != NULL; wl = wl->next) {
-    w = wl->this_wall;
+  struct vector3 disk_llf = { loc->x - R, loc->y - R, loc->z - R };
+  struct vector3 disk_urb = { loc->x + R, loc->y + R, loc->z + R };
+  struct wall_cursor cursor;
+  wall_cursor_box(&cursor, sv, &disk_llf, &disk_urb);
+  while ((w = wall_cursor_next(&cursor)) != NULL) {
 
     /* Ignore this wall if it is too far away! */
 
@@ -2218,7 +2290,8 @@ double exact_disk(struct volume *world, struct vector3 *loc, struct vector3 *mv,
 /****************************************************************************
 safe_diffusion_step:
   In: vm: molecule that is moving
-      shead: linked list of potential collisions with molecules from the
+      d2_partner: squared distance to the nearest molecule vm can react with
+                  (GIGANTIC if none)
       radial_subdivisions:
       r_step:
       x_fineparts:
@@ -2239,7 +2312,7 @@ safe_diffusion_step:
         *FIXME*: Add a flag to make this be very conservative or to turn
         this off entirely, aside from the TIME_STEP_MAX= directive.
 ****************************************************************************/
-double safe_diffusion_step(struct volume_molecule *vm, struct collision *shead,
+double safe_diffusion_step(struct volume_molecule *vm, double d2_partner,
                            u_int radial_subdivisions, double *r_step,
                            double *x_fineparts, double *y_fineparts,
                            double *z_fineparts) {
@@ -2247,35 +2320,27 @@ double safe_diffusion_step(struct volume_molecule *vm, struct collision *shead,
   double d2_nearmax;
   double d2min = GIGANTIC;
   struct subvolume *sv = vm->subvol;
-  struct wall *w;
-  struct wall_list *wl;
-  struct collision *smash;
+  struct wall_table *wt = sv->wall_table;
   double steps;
-  struct volume_molecule *mp;
 
   d2_nearmax = vm->properties->space_step *
                r_step[(int)(radial_subdivisions * MULTISTEP_PERCENTILE)];
   d2_nearmax *= d2_nearmax;
 
-  if ((vm->properties->flags & (CAN_VOLVOL | CANT_INITIATE)) == CAN_VOLVOL) {
-    for (smash = shead; smash != NULL; smash = smash->next) {
-      mp = (struct volume_molecule *)smash->target;
-      d2 = (vm->pos.x - mp->pos.x) * (vm->pos.x - mp->pos.x) +
-           (vm->pos.y - mp->pos.y) * (vm->pos.y - mp->pos.y) +
-           (vm->pos.z - mp->pos.z) * (vm->pos.z - mp->pos.z);
+  if ((vm->properties->flags & (CAN_VOLVOL | CANT_INITIATE)) == CAN_VOLVOL &&
+      d2_partner < d2min)
+    d2min = d2_partner;
+  /* Padding planes are too far away to ever be the closest */
+  if (wt != NULL) {
+    for (int k = 0; k < wt->n_walls; k++) {
+      d2 = (wt->nx[k] * vm->pos.x + wt->ny[k] * vm->pos.y +
+            wt->nz[k] * vm->pos.z) -
+           wt->d[k];
+      d2 *= d2;
       if (d2 < d2min)
         d2min = d2;
     }
   }
-  for (wl = sv->wall_head; wl != NULL; wl = wl->next) {
-    w = wl->this_wall;
-    d2 = (w->normal.x * vm->pos.x + w->normal.y * vm->pos.y +
-          w->normal.z * vm->pos.z) -
-         w->d;
-    d2 *= d2;
-    if (d2 < d2min)
-      d2min = d2;
-  }
 
   d2 = (vm->pos.x - x_fineparts[sv->llf.x]);
   d2 *= d2;
@@ -2320,6 +2385,56 @@ double safe_diffusion_step(struct volume_molecule *vm, struct collision *shead,
   return steps;
 }
 
+/****************************************************************************
+add_neighbor_collisions:
+  Helper for expand_collision_list_for_neighbor: add a collision with a
+  molecule of an adjacent subvolume for each reaction it may undergo with the
+  moving molecule.
+
+  In: sv: the "current" subvolume
+      vm: the current molecule
+      mp: molecule in the adjacent subvolume
+      shead1: current list head
+      rx_hashsize:
+      reaction_hash:
+      scratch: scratch arena to take the collisions from
+  Out: Returns the new list head
+****************************************************************************/
+static struct collision *add_neighbor_collisions(
+    struct subvolume *sv, struct volume_molecule *vm,
+    struct volume_molecule *mp, struct collision *shead1, int rx_hashsize,
+    struct rxn **reaction_hash, struct scratch_arena *scratch) {
+  struct rxn *matching_rxns[MAX_MATCHING_RXNS];
+
+  /* Skip defunct molecules */
+  if (mp->properties == NULL)
+    return shead1;
+
+  // count only in the relevant periodic box
+  if (!periodic_boxes_are_identical(&vm->periodic_box, &mp->periodic_box))
+    return shead1;
+
+  /* check for possible reactions */
+  int num_matching_rxns = trigger_bimolecular(
+      reaction_hash, rx_hashsize, vm->properties->hashval,
+      mp->properties->hashval, (struct abstract_molecule *)vm,
+      (struct abstract_molecule *)mp, 0, 0, matching_rxns);
+
+  /* Add a collision for each matching reaction */
+  for (int i = 0; i < num_matching_rxns; i++) {
+    struct collision *smash =
+        CHECKED_SCRATCH_GET(scratch, struct collision, "collision data");
+    smash->target = (void *)mp;
+    smash->intermediate = matching_rxns[i];
+    smash->next = shead1;
+    smash->what = 0;
+    smash->what |= COLLIDE_VOL;
+    shead1 = smash;
+  }
+
+  return shead1;
+}
+
 /****************************************************************************
 expand_collision_list_for_neighbor:
   This is a helper function to reduce duplicated code in expand_collision_list.
@@ -2347,6 +2462,7 @@ expand_collision_list_for_neighbor:
       z_fineparts:
       rx_hashsize:
       reaction_hash:
+      scratch: scratch arena to take the collisions from
   Out: Returns linked list of molecules from neighbor subvolumes
        that are located within "interaction_radius" from the the subvolume
        border.
@@ -2358,10 +2474,8 @@ static struct collision *expand_collision_list_for_neighbor(
     struct vector3 *path_llf, struct vector3 *path_urb,
     struct collision *shead1, double trim_x, double trim_y, double trim_z,
     double *x_fineparts, double *y_fineparts, double *z_fineparts,
-    int rx_hashsize, struct rxn **reaction_hash) {
-  int num_matching_rxns = 0;
-  struct rxn *matching_rxns[MAX_MATCHING_RXNS];
-
+    int rx_hashsize, struct rxn **reaction_hash,
+    struct scratch_arena *scratch) {
   /* Grab the subvolume boundaries */
   struct vector3 new_sv_llf, new_sv_urb;
   new_sv_llf.x = x_fineparts[new_sv->llf.x];
@@ -2410,20 +2524,21 @@ static struct collision *expand_collision_list_for_neighbor(
     z_max = new_sv_urb.z + EPS_C;
   }
 
-  /* scan molecules from this SV */
+  /* rank the lists of this SV holding possible partners */
+  int n_ranked = 0;
   struct per_species_list *psl_next, *psl, **psl_head = &new_sv->species_head;
   for (psl = new_sv->species_head; psl != NULL; psl = psl_next) {
     psl_next = psl->next;
+    psl->scan_rank = -1;
     if (psl->properties == NULL) {
       psl_head = &psl->next;
       continue;
     }
 
     /* Garbage collection of empty per-species lists */
-    if (psl->head == NULL) {
+    if (psl->n_packed == 0) {
       *psl_head = psl->next;
-      ht_remove(&new_sv->mol_by_species, psl);
-      mem_put(new_sv->local_storage->pslv, psl);
+      free_species_list(new_sv, psl);
       continue;
     } else
       psl_head = &psl->next;
@@ -2434,45 +2549,49 @@ static struct collision *expand_collision_list_for_neighbor(
              psl->properties->hashval, vm->properties, psl->properties))
       continue;
 
-    for (struct volume_molecule *mp = psl->head; mp != NULL; mp = mp->next_v) {
-      /* Skip defunct molecules */
-      if (mp->properties == NULL)
-        continue;
+    psl->scan_rank = n_ranked++;
+  }
+  if (n_ranked == 0)
+    return shead1;
 
-      /* skip molecules outside the region of interest */
-      if (mp->pos.x < x_min || mp->pos.x > x_max)
-        continue;
-      if (mp->pos.y < y_min || mp->pos.y > y_max)
-        continue;
-      if (mp->pos.z < z_min || mp->pos.z > z_max)
-        continue;
-      // count only in the relevant periodic box
-      if (!periodic_boxes_are_identical(vm->periodic_box, mp->periodic_box)) {
-        continue;
-      }
+  /* look the molecules up in the grid of this SV if it has one */
+  struct mol_grid_hit found[MAX_GRID_PARTNERS];
+  int n_found = -1;
+  if (new_sv->mol_grid != NULL) {
+    struct vector3 llf = { x_min, y_min, z_min };
+    struct vector3 urb = { x_max, y_max, z_max };
+    n_found = find_grid_partners(new_sv, &llf, &urb, NULL, found,
+                                 MAX_GRID_PARTNERS);
+  }
 
-      /* check for possible reactions */
-      num_matching_rxns = trigger_bimolecular(
-          reaction_hash, rx_hashsize, vm->properties->hashval,
-          mp->properties->hashval, (struct abstract_molecule *)vm,
-          (struct abstract_molecule *)mp, 0, 0, matching_rxns);
-      if (num_matching_rxns <= 0)
+  /* otherwise scan the molecules of this SV */
+  if (n_found < 0) {
+    n_found = 0;
+    for (psl = new_sv->species_head; psl != NULL; psl = psl->next) {
+      if (psl->scan_rank < 0)
         continue;
 
-      /* Add a collision for each matching reaction */
-      for (int i = 0; i < num_matching_rxns; i++) {
-        struct collision *smash = (struct collision *)CHECKED_MEM_GET(
-            sv->local_storage->coll, "collision data");
-        smash->target = (void *)mp;
-        smash->intermediate = matching_rxns[i];
-        smash->next = shead1;
-        smash->what = 0;
-        smash->what |= COLLIDE_VOL;
-        shead1 = smash;
+      for (int j = 0; j < psl->n_packed; j++) {
+        const struct vector3 *pos = PACKED_POS(psl, j);
+        /* skip molecules outside the region of interest */
+        if (pos->x < x_min || pos->x > x_max)
+          continue;
+        if (pos->y < y_min || pos->y > y_max)
+          continue;
+        if (pos->z < z_min || pos->z > z_max)
+          continue;
+
+        shead1 = add_neighbor_collisions(sv, vm, psl->packed[j], shead1,
+                                         rx_hashsize, reaction_hash, scratch);
       }
     }
+    return shead1;
   }
 
+  for (int k = 0; k < n_found; k++)
+    shead1 = add_neighbor_collisions(sv, vm, found[k].mp, shead1, rx_hashsize,
+                                     reaction_hash, scratch);
+
   return shead1;
 }
 
@@ -2487,6 +2606,7 @@ expand_collision_list:
       x_fineparts:
       y_fineparts:
       z_fineparts:
+      scratch: scratch arena to take the collisions from
   Out: Returns list of collisions with molecules from neighbor subvolumes
        that are located within "interaction_radius" from the the subvolume
        border.  The molecules are added only when the molecule displacement
@@ -2497,7 +2617,8 @@ expand_collision_list(struct volume_molecule *vm, struct vector3 *mv,
                       struct subvolume *sv, double rx_radius_3d,
                       int ny_parts, int nz_parts, double *x_fineparts,
                       double *y_fineparts, double *z_fineparts, int rx_hashsize,
-                      struct rxn **reaction_hash) {
+                      struct rxn **reaction_hash,
+                      struct scratch_arena *scratch) {
   struct collision *shead1 = NULL;
   /* neighbors of the current subvolume */
   struct vector3 path_llf, path_urb;
@@ -2526,26 +2647,28 @@ expand_collision_list(struct volume_molecule *vm, struct vector3 *mv,
     struct subvolume *new_sv = sv + (nz_parts - 1) * (ny_parts - 1);
     shead1 = expand_collision_list_for_neighbor(
         sv, vm, new_sv, &path_llf, &path_urb, shead1, R, 0.0, 0.0, x_fineparts,
-        y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+        y_fineparts, z_fineparts, rx_hashsize, reaction_hash, scratch);
 
     /* go +X, +Y) */
     if (y_pos) {
       struct subvolume *new_sv_y = new_sv + (nz_parts - 1);
       shead1 = expand_collision_list_for_neighbor(
           sv, vm, new_sv_y, &path_llf, &path_urb, shead1, R, R, 0.0, x_fineparts,
-          y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          y_fineparts, z_fineparts, rx_hashsize, reaction_hash, scratch);
 
       /* go +X, +Y, +Z) */
       if (z_pos)
         shead1 = expand_collision_list_for_neighbor(
             sv, vm, new_sv_y + 1, &path_llf, &path_urb, shead1, R, R, R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
 
       /* go +X, +Y, -Z */
       if (z_neg)
         shead1 = expand_collision_list_for_neighbor(
             sv, vm, new_sv_y - 1, &path_llf, &path_urb, shead1, R, R, -R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
     }
 
     /* go +X, -Y) */
@@ -2553,32 +2676,37 @@ expand_collision_list(struct volume_molecule *vm, struct vector3 *mv,
       struct subvolume *new_sv_y = new_sv - (nz_parts - 1);
       shead1 = expand_collision_list_for_neighbor(
           sv, vm, new_sv_y, &path_llf, &path_urb, shead1, R, -R, 0.0,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
       /* go +X, -Y, +Z) */
       if (z_pos)
         shead1 = expand_collision_list_for_neighbor(
             sv, vm, new_sv_y + 1, &path_llf, &path_urb, shead1, R, -R, R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
 
       /* go +X, -Y, -Z */
       if (z_neg)
         shead1 = expand_collision_list_for_neighbor(
             sv, vm, new_sv_y - 1, &path_llf, &path_urb, shead1, R, -R, -R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
     }
 
     /* go +X, +Z) */
     if (z_pos)
       shead1 = expand_collision_list_for_neighbor(
           sv, vm, new_sv + 1, &path_llf, &path_urb, shead1, R, 0.0, R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
     /* go +X, -Z */
     if (z_neg)
       shead1 = expand_collision_list_for_neighbor(
           sv, vm, new_sv - 1, &path_llf, &path_urb, shead1, R, 0.0, -R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
   }
 
   /* go in the direction X_NEG */
@@ -2586,26 +2714,29 @@ expand_collision_list(struct volume_molecule *vm, struct vector3 *mv,
     struct subvolume *new_sv = sv - (nz_parts - 1) * (ny_parts - 1);
     shead1 = expand_collision_list_for_neighbor(
         sv, vm, new_sv, &path_llf, &path_urb, shead1, -R, 0.0, 0.0, x_fineparts,
-        y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+        y_fineparts, z_fineparts, rx_hashsize, reaction_hash, scratch);
 
     /* go -X, +Y) */
     if (y_pos) {
       struct subvolume *new_sv_y = new_sv + (nz_parts - 1);
       shead1 = expand_collision_list_for_neighbor(
           sv, vm, new_sv_y, &path_llf, &path_urb, shead1, -R, R, 0.0,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
       /* go -X, +Y, +Z) */
       if (z_pos)
         shead1 = expand_collision_list_for_neighbor(
             sv, vm, new_sv_y + 1, &path_llf, &path_urb, shead1, -R, R, R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
 
       /* go -X, +Y, -Z */
       if (z_neg)
         shead1 = expand_collision_list_for_neighbor(
             sv, vm, new_sv_y - 1, &path_llf, &path_urb, shead1, -R, R, -R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
     }
 
     /* go -X, -Y) */
@@ -2613,32 +2744,37 @@ expand_collision_list(struct volume_molecule *vm, struct vector3 *mv,
       struct subvolume *new_sv_y = new_sv - (nz_parts - 1);
       shead1 = expand_collision_list_for_neighbor(
           sv, vm, new_sv_y, &path_llf, &path_urb, shead1, -R, -R, 0.0,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
       /* go -X, -Y, +Z) */
       if (z_pos)
         shead1 = expand_collision_list_for_neighbor(
             sv, vm, new_sv_y + 1, &path_llf, &path_urb, shead1, -R, -R, R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
 
       /* go -X, -Y, -Z */
       if (z_neg)
         shead1 = expand_collision_list_for_neighbor(
             sv, vm, new_sv_y - 1, &path_llf, &path_urb, shead1, -R, -R, -R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
     }
 
     /* go -X, +Z) */
     if (z_pos)
       shead1 = expand_collision_list_for_neighbor(
           sv, vm, new_sv + 1, &path_llf, &path_urb, shead1, -R, 0.0, R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
     /* go -X, -Z */
     if (z_neg)
       shead1 = expand_collision_list_for_neighbor(
           sv, vm, new_sv - 1, &path_llf, &path_urb, shead1, -R, 0.0, -R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
   }
 
   /* go in the direction Y_POS */
@@ -2646,19 +2782,21 @@ expand_collision_list(struct volume_molecule *vm, struct vector3 *mv,
     struct subvolume *new_sv = sv + (nz_parts - 1);
     shead1 = expand_collision_list_for_neighbor(
         sv, vm, new_sv, &path_llf, &path_urb, shead1, 0.0, R, 0.0, x_fineparts,
-        y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+        y_fineparts, z_fineparts, rx_hashsize, reaction_hash, scratch);
 
     /* go +Y, +Z) */
     if (z_pos)
       shead1 = expand_collision_list_for_neighbor(
           sv, vm, new_sv + 1, &path_llf, &path_urb, shead1, 0.0, R, R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
     /* go +Y, -Z */
     if (z_neg)
       shead1 = expand_collision_list_for_neighbor(
           sv, vm, new_sv - 1, &path_llf, &path_urb, shead1, 0.0, R, -R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
   }
 
   /* go in the direction Y_NEG */
@@ -2666,32 +2804,34 @@ expand_collision_list(struct volume_molecule *vm, struct vector3 *mv,
     struct subvolume *new_sv = sv - (nz_parts - 1);
     shead1 = expand_collision_list_for_neighbor(
         sv, vm, new_sv, &path_llf, &path_urb, shead1, 0.0, -R, 0.0, x_fineparts,
-        y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+        y_fineparts, z_fineparts, rx_hashsize, reaction_hash, scratch);
 
     /* go -Y, +Z) */
     if (z_pos)
       shead1 = expand_collision_list_for_neighbor(
           sv, vm, new_sv + 1, &path_llf, &path_urb, shead1, 0.0, -R, R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
     /* go -Y, -Z */
     if (z_neg)
       shead1 = expand_collision_list_for_neighbor(
           sv, vm, new_sv - 1, &path_llf, &path_urb, shead1, 0.0, -R, -R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
   }
 
   /* go in the direction Z_POS */
   if (z_pos)
     shead1 = expand_collision_list_for_neighbor(
         sv, vm, sv + 1, &path_llf, &path_urb, shead1, 0.0, 0.0, R, x_fineparts,
-        y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+        y_fineparts, z_fineparts, rx_hashsize, reaction_hash, scratch);
 
   /* go in the direction Z_NEG */
   if (z_neg)
     shead1 = expand_collision_list_for_neighbor(
         sv, vm, sv - 1, &path_llf, &path_urb, shead1, 0.0, 0.0, -R, x_fineparts,
-        y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+        y_fineparts, z_fineparts, rx_hashsize, reaction_hash, scratch);
 
   return shead1;
 }
@@ -2720,6 +2860,8 @@ expand_collision_partner_list_for_neighbor:
       double trim_x - X clipping indicator
       double trim_y - Y clipping indicator
       double trim_z - Z clipping indicator
+      struct scratch_arena *scratch - scratch arena to take the collisions
+                                      from
   Out: Returns linked list of molecules from neighbor subvolumes
        that are located within "interaction_radius" from the the subvolume
        border.
@@ -2731,7 +2873,8 @@ struct sp_collision *expand_collision_partner_list_for_neighbor(
     struct subvolume *new_sv, struct vector3 *path_llf,
     struct vector3 *path_urb, struct sp_collision *shead1, double trim_x,
     double trim_y, double trim_z, double *x_fineparts, double *y_fineparts,
-    double *z_fineparts, int rx_hashsize, struct rxn **reaction_hash) {
+    double *z_fineparts, int rx_hashsize, struct rxn **reaction_hash,
+    struct scratch_arena *scratch) {
   struct species *spec = vm->properties;
   struct sp_collision *smash;
 
@@ -2806,10 +2949,9 @@ struct sp_collision *expand_collision_partner_list_for_neighbor(
     }
 
     /* Garbage collection of empty per-species lists */
-    if (psl->head == NULL) {
+    if (psl->n_packed == 0) {
       *psl_head = psl->next;
-      ht_remove(&new_sv->mol_by_species, psl);
-      mem_put(new_sv->local_storage->pslv, psl);
+      free_species_list(new_sv, psl);
       continue;
     } else
       psl_head = &psl->next;
@@ -2828,8 +2970,8 @@ struct sp_collision *expand_collision_partner_list_for_neighbor(
         ((psl->properties->flags & CAN_VOLVOLSURF) == CAN_VOLVOLSURF);
     if (col_bi_molecular_flag || col_tri_molecular_flag ||
         col_mol_mol_grid_flag) {
-      struct volume_molecule *mp;
-      for (mp = psl->head; mp != NULL; mp = mp->next_v) {
+      for (int i = psl->n_packed - 1; i >= 0; i--) {
+        struct volume_molecule *mp = psl->packed[i];
         /* Skip defunct molecules */
         if (mp->properties == NULL)
           continue;
@@ -2842,8 +2984,8 @@ struct sp_collision *expand_collision_partner_list_for_neighbor(
         if (mp->pos.z < z_min || mp->pos.z > z_max)
           continue;
 
-        smash = (struct sp_collision *)CHECKED_MEM_GET(
-            sv->local_storage->sp_coll, "collision data");
+        smash =
+            CHECKED_SCRATCH_GET(scratch, struct sp_collision, "collision data");
         smash->t = 0.0;
         smash->t_start = 0.0;
         smash->pos_start.x = vm->pos.x;
@@ -2908,6 +3050,12 @@ struct volume_molecule *diffuse_3D(
     return vm;
   }
 
+  /* A worker thread may have to hand the step back untouched */
+  int can_defer = thread_can_defer();
+  struct volume_molecule saved_vm;
+  if (can_defer)
+    saved_vm = *vm;
+
   int inertness = 0;
   set_inertness_and_maxtime(world, vm, &max_time, &inertness);
 
@@ -2926,6 +3074,10 @@ struct volume_molecule *diffuse_3D(
   struct vector3 displacement;  /* Molecule moves along this vector */
   struct vector3 displacement2; /* Used for 3D mol-mol unbinding */
 
+  /* Collision lists only last for this step */
+  struct scratch_arena *scratch = local_scratch(world);
+  struct scratch_mark step_mark = scratch_save(scratch);
+
 pretend_to_call_diffuse_3D: ; /* Label to allow fake recursion */
 
   struct subvolume *sv = vm->subvol;
@@ -2934,24 +3086,36 @@ pretend_to_call_diffuse_3D: ; /* Label to allow fake recursion */
                                      tail of the collision linked list) */
   struct collision *shead_exp = NULL; /* Things we might hit (can interact with)
                                          from neighbor subvolumes */
-  /* scan subvolume for possible mol-mol reactions with vm */
-  if ((spec->flags & (CAN_VOLVOL | CANT_INITIATE)) == CAN_VOLVOL &&
-      inertness < inert_to_all) {
-    determine_mol_mol_reactions(world, vm, &shead, &stail, inertness);
-  }
+  int scan_partners = (spec->flags & (CAN_VOLVOL | CANT_INITIATE)) ==
+                          CAN_VOLVOL &&
+                      inertness < inert_to_all;
 
   if (calculate_displacement) {
-    compute_displacement(world, shead, vm, &displacement, &displacement2,
+    compute_displacement(world, inertness, vm, &displacement, &displacement2,
       &rate_factor, &r_rate_factor, &steps, &t_steps, max_time);
+
+    if (can_defer &&
+        !thread_step_is_local(world, &vm->pos, vect_length(&displacement))) {
+      local_stats(world)->diffusion_number--;
+      local_stats(world)->diffusion_cumtime -= steps;
+      *vm = saved_vm;
+      vm->flags |= ACT_DEFER;
+      return vm;
+    }
   }
 
+  /* scan subvolume for mol-mol reactions vm might run into on its way */
+  if (scan_partners)
+    determine_mol_mol_reactions(world, vm, &displacement, &shead, &stail,
+                                inertness);
+
   if (world->use_expanded_list &&
       ((vm->properties->flags & (CAN_VOLVOL | CANT_INITIATE)) == CAN_VOLVOL) &&
       !inertness) {
     shead_exp = expand_collision_list(
       vm, &displacement, sv, world->rx_radius_3d, world->ny_parts,
       world->nz_parts, world->x_fineparts, world->y_fineparts,
-      world->z_fineparts, world->rx_hashsize, world->reaction_hash);
+      world->z_fineparts, world->rx_hashsize, world->reaction_hash, scratch);
     if (stail != NULL)
       stail->next = shead_exp;
     else {
@@ -2971,14 +3135,15 @@ pretend_to_call_diffuse_3D: ; /* Label to allow fake recursion */
       redo_collision_list(world, &shead, &stail, &shead_exp, vm, &displacement, sv);
     }
 
+    struct scratch_mark ray_mark = scratch_save(scratch);
     struct collision* shead2 = ray_trace(world, &(vm->pos), shead, sv, &displacement, reflectee);
     if (shead2 == NULL) {
       mcell_internal_error("ray_trace returned NULL.");
     }
 
     if (shead2->next != NULL) {
-      shead2 =
-          (struct collision *)ae_list_sort((struct abstract_element *)shead2);
+      shead2 = (struct collision *)sort_collisions(
+          scratch, (struct abstract_element *)shead2);
     }
 
     struct vector3* loc_certain = NULL;
@@ -2988,7 +3153,7 @@ pretend_to_call_diffuse_3D: ; /* Label to allow fake recursion */
       if (world->notify->molecule_collision_report == NOTIFY_FULL) {
         if (((smash->what & COLLIDE_VOL) != 0) &&
             (world->rxn_flags.vol_vol_reaction_flag)) {
-          world->vol_vol_colls++;
+          local_stats(world)->vol_vol_colls++;
         }
       }
 
@@ -3076,9 +3241,7 @@ pretend_to_call_diffuse_3D: ; /* Label to allow fake recursion */
       }
     }
 
-    if (shead2 != NULL) {
-      mem_put_list(sv->local_storage->coll, shead2);
-    }
+    scratch_release(scratch, ray_mark);
   } while (smash != NULL);
 
   vm->pos.x += displacement.x;
@@ -3099,8 +3262,7 @@ pretend_to_call_diffuse_3D: ; /* Label to allow fake recursion */
   vm->index = -1;
   vm->previous_wall = NULL;
 
-  if (shead != NULL)
-    mem_put_list(sv->local_storage->coll, shead);
+  scratch_release(scratch, step_mark);
 
   return vm;
 }
@@ -3134,10 +3296,10 @@ int move_sm_on_same_triangle(
                          new_loc->u, new_loc->v, new_idx, sm->grid->n_tiles);
   }
   // We're on a new part of the grid
-  struct surface_molecule_list *sm_list = sm->grid->sm_list[new_idx];
+  struct surface_molecule_list *sm_list = tile_sm_list(sm->grid, new_idx);
   if (new_idx != sm->grid_index) {
-    if ((state->periodic_box_obj && periodicbox_in_surfmol_list(sm->periodic_box, sm_list)) ||
-        (!state->periodic_box_obj && sm_list && sm_list->sm)) {
+    if ((state->periodic_box_obj && periodicbox_in_surfmol_list(&sm->periodic_box, sm_list)) ||
+        (!state->periodic_box_obj && tile_occupied(sm->grid, new_idx))) {
       if (hd_info != NULL) {
         delete_void_list((struct void_list *)hd_info);
         hd_info = NULL;
@@ -3145,20 +3307,22 @@ int move_sm_on_same_triangle(
       return 1; /* Pick again--full here */
     }
 
-    remove_surfmol_from_list(&sm->grid->sm_list[sm->grid_index], sm);
+    remove_surfmol_from_list(tile_sm_slot(sm->grid, sm->grid_index), sm);
+    update_tile_occupancy(sm->grid, sm->grid_index);
     sm->grid_index = new_idx;
-    sm->grid->sm_list[new_idx] = add_surfmol_with_unique_pb_to_list(
-      sm->grid->sm_list[new_idx], sm);
-    assert(sm->grid->sm_list[new_idx] != NULL);
+    *tile_sm_slot(sm->grid, new_idx) = add_surfmol_with_unique_pb_to_list(
+      tile_sm_list(sm->grid, new_idx), sm);
+    assert(tile_sm_list(sm->grid, new_idx) != NULL);
+    update_tile_occupancy(sm->grid, new_idx);
     count_moved_surface_mol(
       state, sm, sm->grid, new_loc, state->count_hashmask,
-      state->count_hash, &state->ray_polygon_colls, previous_box);
+      state->count_hash, &local_stats(state)->ray_polygon_colls, previous_box);
   // We ended up on the same exact grid element! 
   // XXX: do we even need to update counts??
   } else {
     count_moved_surface_mol(
       state, sm, sm->grid, new_loc, state->count_hashmask,
-      state->count_hash, &state->ray_polygon_colls, previous_box);
+      state->count_hash, &local_stats(state)->ray_polygon_colls, previous_box);
   }
 
   sm->s_pos.u = new_loc->u;
@@ -3202,9 +3366,9 @@ int move_sm_to_new_triangle(
         new_loc->u, new_loc->v, new_idx, new_wall->grid->n_tiles);
   }
 
-  struct surface_molecule_list *sm_list = new_wall->grid->sm_list[new_idx];
-  if ((state->periodic_box_obj && periodicbox_in_surfmol_list(sm->periodic_box, sm_list)) ||
-      (!state->periodic_box_obj && sm_list && sm_list->sm)) {
+  struct surface_molecule_list *sm_list = tile_sm_list(new_wall->grid, new_idx);
+  if ((state->periodic_box_obj && periodicbox_in_surfmol_list(&sm->periodic_box, sm_list)) ||
+      (!state->periodic_box_obj && tile_occupied(new_wall->grid, new_idx))) {
     if (hd_info != NULL) {
       delete_void_list((struct void_list *)hd_info);
       hd_info = NULL;
@@ -3214,16 +3378,18 @@ int move_sm_to_new_triangle(
 
   count_moved_surface_mol(
     state, sm, new_wall->grid, new_loc, state->count_hashmask,
-    state->count_hash, &state->ray_polygon_colls, previous_box);
+    state->count_hash, &local_stats(state)->ray_polygon_colls, previous_box);
 
-  remove_surfmol_from_list(&sm->grid->sm_list[sm->grid_index], sm);
-  sm->grid->n_occupied--;
+  remove_surfmol_from_list(tile_sm_slot(sm->grid, sm->grid_index), sm);
+  update_tile_occupancy(sm->grid, sm->grid_index);
+  THREADED_ADD(sm->grid->n_occupied, -1);
   sm->grid = new_wall->grid;
   sm->grid_index = new_idx;
-  sm_list = add_surfmol_with_unique_pb_to_list(sm->grid->sm_list[new_idx], sm);
+  sm_list = add_surfmol_with_unique_pb_to_list(tile_sm_list(sm->grid, new_idx), sm);
   assert(sm_list != NULL);
-  sm->grid->sm_list[sm->grid_index] = sm_list;
-  sm->grid->n_occupied++;
+  *tile_sm_slot(sm->grid, sm->grid_index) = sm_list;
+  update_tile_occupancy(sm->grid, sm->grid_index);
+  THREADED_ADD(sm->grid->n_occupied, 1);
 
   sm->s_pos.u = new_loc->u;
   sm->s_pos.v = new_loc->v;
@@ -3300,12 +3466,12 @@ struct surface_molecule *diffuse_2D(
     space_factor = spec->space_step * sqrt(steps);
   }
 
-  world->diffusion_number++;
-  world->diffusion_cumtime += steps;
+  local_stats(world)->diffusion_number++;
+  local_stats(world)->diffusion_cumtime += steps;
 
-  struct periodic_image previous_box = { .x = sm->periodic_box->x,
-                                         .y = sm->periodic_box->y,
-                                         .z = sm->periodic_box->z
+  struct periodic_image previous_box = { .x = sm->periodic_box.x,
+                                         .y = sm->periodic_box.y,
+                                         .z = sm->periodic_box.z
                                        };
   struct hit_data *hd_info = NULL;
   for (int find_new_position = (SURFACE_DIFFUSION_RETRIES + 1);
@@ -3313,7 +3479,20 @@ struct surface_molecule *diffuse_2D(
     hd_info = NULL;
 
     struct vector2 displacement;
-    pick_2D_displacement(&displacement, space_factor, world->rng);
+    pick_2D_displacement(&displacement, space_factor, local_rng(world));
+
+    if (thread_can_defer()) {
+      struct vector3 pos3d;
+      uv2xyz(&sm->s_pos, sm->grid->surface, &pos3d);
+      if (!thread_step_is_local(world, &pos3d,
+                                sqrt(displacement.u * displacement.u +
+                                     displacement.v * displacement.v))) {
+        local_stats(world)->diffusion_number--;
+        local_stats(world)->diffusion_cumtime -= steps;
+        sm->flags |= ACT_DEFER;
+        return sm;
+      }
+    }
 
     if (sm->properties->flags & SET_MAX_STEP_LENGTH) {
       double disp_length = sqrt(displacement.u * displacement.u +
@@ -3417,22 +3596,22 @@ react_2D_all_neighbors(struct volume *world, struct surface_molecule *sm,
   int num_matching_rxns = 0;
   struct rxn *matching_rxns[MAX_MATCHING_RXNS];
 
-  /* linked list of the tile neighbors */
-  struct tile_neighbor *tile_nbr_head = NULL, *curr;
-  int list_length = 0; /* length of the linked lists above */
+  /* neighbor tiles */
+  struct tile_nbr_list nbr_list;
 
   if ((u_int)sm->grid_index >= sm->grid->n_tiles) {
     mcell_internal_error("tile index %u is greater or equal number_of_tiles %u",
                          (u_int)sm->grid_index, sm->grid->n_tiles);
   }
 
-  find_neighbor_tiles(world, sm, sm->grid, sm->grid_index, 0, 1, &tile_nbr_head,
-                      &list_length);
+  get_tile_neighbors(world, sm, sm->grid, sm->grid_index, 0, 1, &nbr_list);
 
-  if (tile_nbr_head == NULL)
+  if (nbr_list.n == 0) {
+    release_tile_neighbors(&nbr_list);
     return sm; /* no reaction may happen */
+  }
 
-  const int num_nbrs = list_length;
+  const int num_nbrs = nbr_list.n;
   int max_size = num_nbrs * MAX_MATCHING_RXNS;
   struct rxn *rxn_array[max_size]; /* array of reaction objects with neighbor
                                      molecules */
@@ -3455,12 +3634,13 @@ react_2D_all_neighbors(struct volume *world, struct surface_molecule *sm,
   }
 
   /* step through the neighbors */
-  for (curr = tile_nbr_head; curr != NULL; curr = curr->next) {
+  for (int kk = 0; kk < num_nbrs; kk++) {
+    struct tile_nbr *curr = &nbr_list.tiles[kk];
     /* Neighboring molecule */
-    struct surface_molecule_list *sm_list = curr->grid->sm_list[curr->idx]; 
+    struct surface_molecule_list *sm_list = tile_sm_list(curr->grid, curr->idx); 
     if (sm_list == NULL || sm_list->sm == NULL)
       continue;
-    struct surface_molecule *smp = curr->grid->sm_list[curr->idx]->sm;
+    struct surface_molecule *smp = tile_sm_list(curr->grid, curr->idx)->sm;
 
     /* check whether the neighbor molecule is behind
        the restrictive region boundary   */
@@ -3506,19 +3686,19 @@ react_2D_all_neighbors(struct volume *world, struct surface_molecule *sm,
     }
   }
 
-  delete_tile_neighbor_list(tile_nbr_head);
+  release_tile_neighbors(&nbr_list);
 
   if (n == 0) {
     return sm; /* Nobody to react with */
   } else if (n == 1) {
     i = test_bimolecular(rxn_array[0], cf[0], local_prob_factor, NULL, NULL,
-                         world->rng);
+                         local_rng(world));
     j = 0;
   } else {
     // previously "test_many_bimolecular_all_neighbors"
     int all_neighbors_flag = 1;
     j = test_many_bimolecular(rxn_array, cf, local_prob_factor, n, &(i), 
-                              world->rng, all_neighbors_flag);
+                              local_rng(world), all_neighbors_flag);
   }
 
   if ((j == RX_NO_RX) || (i < RX_LEAST_VALID_PATHWAY)) {
@@ -3532,7 +3712,7 @@ react_2D_all_neighbors(struct volume *world, struct surface_molecule *sm,
       NULL, NULL);
 
   if (outcome_bimol_result == RX_DESTROY) {
-    mem_put(sm->birthplace, sm);
+    mem_put(mem_birthplace(sm), sm);
     return NULL;
   }
 
@@ -3542,23 +3722,42 @@ react_2D_all_neighbors(struct volume *world, struct surface_molecule *sm,
 /*************************************************************************
 clean_up_old_molecules:
 
- This function just removes defunct molecules from the scheduler.
+ This function just removes defunct molecules from the scheduler.  Once a
+ few of them have piled up, a bounded number of scheduled molecules is
+ swept every timestep; if that does not keep up, the whole scheduler is
+ cleaned at once.
 *************************************************************************/
 void clean_up_old_molecules(struct storage *local) {
-  if (local->timer->defunct_count > MIN_DEFUNCT_FOR_GC &&
-      MAX_DEFUNCT_FRAC * (local->timer->count) < local->timer->defunct_count) {
-    struct abstract_molecule *am;
-    am = (struct abstract_molecule *)schedule_cleanup(local->timer,
+  struct schedule_helper *timer = local->timer;
+  struct abstract_molecule *am = NULL;
+
+  if (timer->defunct_count > MIN_DEFUNCT_FOR_GC &&
+      MAX_DEFUNCT_FRAC * (timer->count) < timer->defunct_count) {
+    am = (struct abstract_molecule *)schedule_cleanup(timer,
                                                       *is_defunct_molecule);
-    while (am != NULL) {
-      struct abstract_molecule *temp = am;
-      am = am->next;
-      if ((temp->flags & IN_MASK) == IN_SCHEDULE) {
-        temp->next = NULL;
-        mem_put(temp->birthplace, temp);
-      } else {
-        temp->flags &= ~IN_SCHEDULE;
-      }
+    sweep_dormant_molecules(local);
+  } else if (timer->defunct_count > MIN_DEFUNCT_FOR_SWEEP &&
+             SWEEP_DEFUNCT_FRAC * (timer->count) < timer->defunct_count) {
+    int n_removed;
+    am = (struct abstract_molecule *)schedule_sweep(
+        timer, *is_defunct_molecule, SWEEP_VISITS_PER_STEP, &n_removed);
+    /* Nothing left to find here, so the tally is of dormant molecules */
+    if (n_removed == 0)
+      n_removed = sweep_dormant_molecules(local);
+    if (n_removed > timer->defunct_count)
+      n_removed = timer->defunct_count;
+    if (n_removed > 0)
+      THREADED_ADD(timer->defunct_count, -n_removed);
+  }
+
+  while (am != NULL) {
+    struct abstract_molecule *temp = am;
+    am = am->next;
+    if ((temp->flags & IN_MASK) == IN_SCHEDULE) {
+      temp->next = NULL;
+      mem_put(mem_birthplace(temp), temp);
+    } else {
+      temp->flags &= ~IN_SCHEDULE;
     }
   }
 }
@@ -3583,27 +3782,40 @@ void reschedule_surface_molecules(
                                                    "surface molecule");
     memcpy(sm_new, sm, sizeof(struct surface_molecule));
     sm_new->next = NULL;
-    sm_new->birthplace = sv->local_storage->smol;
-    if (sm->grid->sm_list[sm->grid_index] && 
-        (sm->grid->sm_list[sm->grid_index]->sm == sm)) {
-      sm->grid->sm_list[sm->grid_index]->sm = sm_new;
+    if (tile_sm_list(sm->grid, sm->grid_index) && 
+        (tile_sm_list(sm->grid, sm->grid_index)->sm == sm)) {
+      tile_sm_list(sm->grid, sm->grid_index)->sm = sm_new;
       sm->grid = NULL;
       sm->grid_index = 0;
     }
 
-    mem_put(sm->birthplace, sm);
-    if (schedule_add(sv->local_storage->timer, sm_new))
+    mem_put(mem_birthplace(sm), sm);
+    if (storage_schedule_add(state, sv->local_storage, sm_new))
       mcell_allocfailed("Failed to add a '%s' surface molecule to scheduler "
                         "after migrating to a new memory store.",
                         am->properties->sym->name);
   } else {
-    if (schedule_add(local->timer, am))
+    if (storage_schedule_add(state, local, am))
       mcell_allocfailed("Failed to add a '%s' surface molecule to scheduler "
                         "after taking a diffusion step.",
                         am->properties->sym->name);
   }
 }
 
+/*************************************************************************
+defer_molecule:
+
+ Hands a molecule whose step might reach beyond the neighbors of the storage
+ being run back to the main thread, which steps it once no worker thread is
+ running.  The molecule stays logically scheduled.
+*************************************************************************/
+static void defer_molecule(struct storage *local,
+                           struct abstract_molecule *am) {
+  am->flags |= IN_SCHEDULE | ACT_DEFER;
+  am->next = local->deferred;
+  local->deferred = am;
+}
+
 /*************************************************************************
 run_timestep:
   In: state: simulation state
@@ -3632,17 +3844,40 @@ void run_timestep(struct volume *state, struct storage *local,
     {
       if ((am->flags & IN_MASK) == IN_SCHEDULE) {
         am->next = NULL;
-        mem_put(am->birthplace, am);
+        mem_put(mem_birthplace(am), am);
       } else
         am->flags &= ~IN_SCHEDULE;
       if (local->timer->defunct_count > 0)
-        local->timer->defunct_count--;
+        THREADED_ADD(local->timer->defunct_count, -1);
 
       continue;
     }
 
     am->flags &= ~IN_SCHEDULE;
 
+    // Worker threads only handle molecules well inside their storage's reach
+    if (thread_can_defer()) {
+      struct vector3 pos3d;
+      if (am->flags & TYPE_VOL)
+        pos3d = ((struct volume_molecule *)am)->pos;
+      else
+        uv2xyz(&((struct surface_molecule *)am)->s_pos,
+               ((struct surface_molecule *)am)->grid->surface, &pos3d);
+      if (!thread_step_is_local(state, &pos3d, 0.0)) {
+        defer_molecule(local, am);
+        continue;
+      }
+    }
+
+    // The counter-based generator draws from this step's own sequences, one
+    // for unimolecular reactions and one for the rest of the step.  A step
+    // deferred by a worker is rolled back to just after its unimolecular
+    // check, so its replay skips the check and takes the same step with the
+    // same numbers.  Drawing afresh instead would favor short steps, since
+    // only steps reaching far from the worker's storage are deferred.
+    am->flags &= ~ACT_DEFER;
+    rng_seek(local_rng(state), am->id, am->t, RNG_UNIMOLECULAR);
+
     // Check for unimolecular reactions
     // If molec is new or need rescheduled, this just computes a new lifetime
     if (am->t2 < EPS_C || am->t2 < EPS_C * am->t) {
@@ -3650,6 +3885,7 @@ void run_timestep(struct volume *state, struct storage *local,
         continue;
       }
     }
+    rng_seek(local_rng(state), am->id, am->t, RNG_STEP);
 
     // How to advance surface molecule scheduling time
     double surface_mol_advance_time = 0;
@@ -3675,8 +3911,14 @@ void run_timestep(struct volume *state, struct storage *local,
         else
           am = (struct abstract_molecule *)diffuse_3D(
               state, (struct volume_molecule *)am, max_time);
+        if (am != NULL && (am->flags & ACT_DEFER) != 0) {
+          defer_molecule(local, am);
+          continue;
+        }
         if (am != NULL) /* We still exist */
         {
+          ht_update_molecule_position((struct volume_molecule *)am);
+
           // Perform only for unimolecular reactions
           if ((am->flags & ACT_REACT) != 0) {
             am->t2 -= am->t - save_sched_time;
@@ -3699,6 +3941,10 @@ void run_timestep(struct volume *state, struct storage *local,
         if (am == NULL) {
           continue;
         }
+        if ((am->flags & ACT_DEFER) != 0) {
+          defer_molecule(local, am);
+          continue;
+        }
       }
     }
 
@@ -3726,7 +3972,7 @@ void run_timestep(struct volume *state, struct storage *local,
               state, (struct surface_molecule *)am, max_time,
               state->notify->molecule_collision_report,
               state->rxn_flags.surf_surf_reaction_flag,
-              &(state->surf_surf_colls));
+              &local_stats(state)->surf_surf_colls);
           if (am == NULL)
             continue;
         }
@@ -3737,7 +3983,7 @@ void run_timestep(struct volume *state, struct storage *local,
               state->notify->molecule_collision_report,
               state->notify->final_summary,
               state->rxn_flags.surf_surf_surf_reaction_flag,
-              &(state->surf_surf_surf_colls));
+              &local_stats(state)->surf_surf_surf_colls);
           if (am == NULL)
             continue;
         }
@@ -3777,15 +4023,15 @@ void run_timestep(struct volume *state, struct storage *local,
         }
       }
     } else if (!can_diffuse) {
-      // NOTE: t2 should only be 0 at this point if "am" is inert. This is
-      // basically just a clunky way to ignore it, although it's not clear why
-      // we can't just set t to the total number of iterations.
-      if (am->t2 == 0)
-        am->t += MAX_UNI_TIMESKIP;
-      else {
-        am->t += am->t2;
-        am->t2 = 0;
+      // t2 is only 0 at this point if "am" is inert, and FOREVER if none of
+      // its unimolecular reactions applies.  Such a molecule would just come
+      // back again and again, so it is set aside until something needs it.
+      if (am->t2 == 0 || !distinguishable(am->t2, FOREVER, EPS_C)) {
+        storage_make_dormant(local, am);
+        continue;
       }
+      am->t += am->t2;
+      am->t2 = 0;
     }
 
     am->flags |= IN_SCHEDULE;
@@ -3798,8 +4044,8 @@ void run_timestep(struct volume *state, struct storage *local,
     if (am->flags & TYPE_SURF) {
       reschedule_surface_molecules(state, local, am);
     } else {
-      if (schedule_add(
-              ((struct volume_molecule *)am)->subvol->local_storage->timer, am))
+      if (storage_schedule_add(
+              state, ((struct volume_molecule *)am)->subvol->local_storage, am))
         mcell_allocfailed("Failed to add a '%s' volume molecule to scheduler "
                           "after taking a diffusion step.",
                           am->properties->sym->name);
@@ -3808,6 +4054,7 @@ void run_timestep(struct volume *state, struct storage *local,
   if (local->timer->error)
     mcell_internal_error("Scheduler reported an out-of-memory error while "
                          "retrieving molecules, but this should never happen.");
+  rng_resume(local_rng(state));
 }
 
 
@@ -3832,7 +4079,7 @@ void run_concentration_clamp(struct volume *world, double t_now) {
         if (ccdm->orient != 0) {
           n_collisions *= 0.5;
         }
-        int n_emitted = poisson_dist(n_collisions, rng_dbl(world->rng));
+        int n_emitted = poisson_dist(n_collisions, rng_dbl(local_rng(world)));
 
         if (n_emitted == 0)
           continue;
@@ -3843,8 +4090,6 @@ void run_concentration_clamp(struct volume *world, double t_now) {
         vm.flags = IN_SCHEDULE | ACT_NEWBIE | TYPE_VOL | IN_VOLUME |
                   ACT_CLAMPED | ACT_DIFFUSE;
         vm.properties = ccdm->mol;
-        vm.mesh_name = NULL;
-        vm.birthplace = NULL;
         vm.birthday = convert_iterations_to_seconds(
             world->start_iterations, world->time_unit,
             world->simulation_start_seconds, t_now);
@@ -3856,12 +4101,12 @@ void run_concentration_clamp(struct volume *world, double t_now) {
         this_count += n_emitted;
         while (n_emitted > 0) {
           int idx = bisect_high(ccdo->cum_area, ccdo->n_sides,
-                            rng_dbl(world->rng) *
+                            rng_dbl(local_rng(world)) *
                                 ccdo->cum_area[ccd->n_sides - 1]);
           struct wall *w = ccdo->objp->wall_p[ccdo->side_idx[idx]];
 
-          double s1 = sqrt(rng_dbl(world->rng));
-          double s2 = rng_dbl(world->rng) * s1;
+          double s1 = sqrt(rng_dbl(local_rng(world)));
+          double s2 = rng_dbl(local_rng(world)) * s1;
 
           struct vector3 v;
           v.x = w->vert[0]->x + s1 * (w->vert[1]->x - w->vert[0]->x) +
@@ -3878,7 +4123,7 @@ void run_concentration_clamp(struct volume *world, double t_now) {
             vm.index = -1;
           }
           else {
-            vm.index = (rng_uint(world->rng) & 2) - 1;
+            vm.index = (rng_uint(local_rng(world)) & 2) - 1;
           }
 
           double eps = EPS_C * vm.index;
@@ -3907,7 +4152,7 @@ void run_concentration_clamp(struct volume *world, double t_now) {
                                                 .z = 0
                                                };
           
-          vm.periodic_box = &periodic_box;
+          vm.periodic_box = periodic_box;
 
           if (vmp == NULL) {
             vmp = insert_volume_molecule(world, &vm, vmp);
@@ -3949,24 +4194,18 @@ void redo_collision_list(struct volume* world, struct collision** shead,
   struct collision** stail, struct collision** shead_exp, struct volume_molecule* m,
   struct vector3* displacement, struct subvolume* sv) {
 
+  /* The old list stays in the scratch arena until the step is over */
   struct collision* st = *stail;
-  struct collision* sh = *shead_exp;
-  if (st != NULL) {
+  struct collision* sh = NULL;
+  if (st != NULL)
     st->next = NULL;
-    if (sh != NULL) {
-      mem_put_list(sv->local_storage->coll, sh);
-      sh = NULL;
-    }
-  } else if (sh != NULL) {
-    mem_put_list(sv->local_storage->coll, sh);
-    sh = NULL;
+  else if (*shead_exp != NULL)
     *shead = NULL;
-  }
   if ((m->properties->flags & (CAN_VOLVOL | CANT_INITIATE)) == CAN_VOLVOL) {
     sh = expand_collision_list(m, displacement, sv, world->rx_radius_3d,
       world->ny_parts, world->nz_parts, world->x_fineparts,
       world->y_fineparts, world->z_fineparts, world->rx_hashsize,
-      world->reaction_hash);
+      world->reaction_hash, local_scratch(world));
     if (st != NULL)
       st->next = sh;
     else {
@@ -4011,9 +4250,9 @@ static int collide_and_react_with_vol_mol(struct volume* world,
   }
 
   struct species *spec = m->properties;
-  struct periodic_image *periodic_box = m->periodic_box;
+  struct periodic_image *periodic_box = &m->periodic_box;
   int i = test_bimolecular(
-    rx, scaling, 0, am, (struct abstract_molecule *)m, world->rng);
+    rx, scaling, 0, am, (struct abstract_molecule *)m, local_rng(world));
 
   if (i < RX_LEAST_VALID_PATHWAY) {
     return 0;
@@ -4087,11 +4326,11 @@ int collide_and_react_with_surf_mol(struct volume* world, struct collision* smas
   }
 
   int j = xyz2grid(&(smash->loc), w->grid);
-  struct surface_molecule_list *sm_list = w->grid->sm_list[j]; 
+  struct surface_molecule_list *sm_list = tile_sm_list(w->grid, j); 
   if (sm_list == NULL || sm_list->sm == NULL) {
     return -1;
   }
-  struct surface_molecule* sm = w->grid->sm_list[j]->sm;
+  struct surface_molecule* sm = tile_sm_list(w->grid, j)->sm;
   if (m->index == j && m->previous_wall == w) {
     m->index = -1; // Avoided rebinding, but next time it's OK
     return -1;
@@ -4101,7 +4340,7 @@ int collide_and_react_with_surf_mol(struct volume* world, struct collision* smas
   struct rxn *matching_rxns[MAX_MATCHING_RXNS];
   double scaling_coef[MAX_MATCHING_RXNS];
   struct species* spec = m->properties;
-  struct periodic_image *periodic_box = m->periodic_box;
+  struct periodic_image *periodic_box = &m->periodic_box;
   int ii = 0, jj = 0;
   if (mol_grid_flag) {
     num_matching_rxns = trigger_bimolecular(
@@ -4111,7 +4350,7 @@ int collide_and_react_with_surf_mol(struct volume* world, struct collision* smas
     if (num_matching_rxns > 0) {
       if (world->notify->molecule_collision_report == NOTIFY_FULL) {
         if (world->rxn_flags.vol_surf_reaction_flag)
-          world->vol_surf_colls++;
+          local_stats(world)->vol_surf_colls++;
       }
 
       for (int l = 0; l < num_matching_rxns; l++) {
@@ -4123,11 +4362,11 @@ int collide_and_react_with_surf_mol(struct volume* world, struct collision* smas
       if (num_matching_rxns == 1) {
         ii = test_bimolecular(matching_rxns[0], scaling_coef[0], 0,
           (struct abstract_molecule *)m, (struct abstract_molecule *)sm,
-          world->rng);
+          local_rng(world));
         jj = 0;
       } else {
         jj = test_many_bimolecular(matching_rxns, scaling_coef, 0,
-          num_matching_rxns, &(ii), world->rng, 0);
+          num_matching_rxns, &(ii), local_rng(world), 0);
       }
       if ((jj > RX_NO_RX) && (ii >= RX_LEAST_VALID_PATHWAY)) {
         /* Save m flags in case m gets collected in outcome_bimolecular */
@@ -4165,16 +4404,14 @@ int collide_and_react_with_surf_mol(struct volume* world, struct collision* smas
   /* test for the trimolecular reactions of the type MOL_GRID_GRID */
   if (mol_grid_grid_flag) {
     struct surface_molecule *smp; /* Neighboring molecules */
-    struct tile_neighbor *tile_nbr_head = NULL, *curr;
-    int list_length = 0;
+    struct tile_nbr_list nbr_list;
     int n = 0; /* total number of possible reactions for a given
                    molecule with all its neighbors */
 
     /* find neighbor molecules to react with */
-    find_neighbor_tiles(world, sm, sm->grid, sm->grid_index, 0, 1,
-      &tile_nbr_head, &list_length);
-    if (tile_nbr_head != NULL) {
-      const int num_nbrs = (const int)list_length;
+    get_tile_neighbors(world, sm, sm->grid, sm->grid_index, 0, 1, &nbr_list);
+    if (nbr_list.n > 0) {
+      const int num_nbrs = nbr_list.n;
       double local_prob_factor; /*local probability factor for the
                                    reaction */
       int max_size = num_nbrs * MAX_MATCHING_RXNS;
@@ -4195,11 +4432,12 @@ int collide_and_react_with_surf_mol(struct volume* world, struct collision* smas
 
       /* step through the neighbors */
       int ll = 0;
-      for (curr = tile_nbr_head; curr != NULL; curr = curr->next) {
-        sm_list = curr->grid->sm_list[curr->idx];
+      for (int kk = 0; kk < num_nbrs; kk++) {
+        struct tile_nbr *curr = &nbr_list.tiles[kk];
+        sm_list = tile_sm_list(curr->grid, curr->idx);
         if (sm_list == NULL || sm_list->sm == NULL)
           continue;
-        smp = curr->grid->sm_list[curr->idx]->sm;
+        smp = tile_sm_list(curr->grid, curr->idx)->sm;
 
         /* check whether any of potential partners
         are behind restrictive (REFLECTIVE/ABSORPTIVE) boundary */
@@ -4229,7 +4467,7 @@ int collide_and_react_with_surf_mol(struct volume* world, struct collision* smas
         if (num_matching_rxns > 0) {
           if (world->notify->molecule_collision_report == NOTIFY_FULL &&
               world->rxn_flags.vol_surf_surf_reaction_flag) {
-              world->vol_surf_surf_colls++;
+              local_stats(world)->vol_surf_surf_colls++;
           }
           for (j = 0; j < num_matching_rxns; j++) {
             if (matching_rxns[j]->prob_t != NULL) {
@@ -4244,17 +4482,17 @@ int collide_and_react_with_surf_mol(struct volume* world, struct collision* smas
           n += num_matching_rxns;
         }
       }
-      delete_tile_neighbor_list(tile_nbr_head);
+      release_tile_neighbors(&nbr_list);
 
       if (n == 1) {
         ii = test_bimolecular(rxn_array[0], cf[0], local_prob_factor,
-          NULL, NULL, world->rng);
+          NULL, NULL, local_rng(world));
         jj = 0;
       } else if (n > 1) {
         // previously "test_many_bimolecular_all_neighbors"
         int all_neighbors_flag = 1;
         jj = test_many_bimolecular(rxn_array, cf, local_prob_factor,
-          n, &(ii), world->rng, all_neighbors_flag);
+          n, &(ii), local_rng(world), all_neighbors_flag);
       }
 
       if (n > max_size)
@@ -4361,12 +4599,12 @@ int collide_and_react_with_walls(struct volume* world, struct collision* smash,
 
   if ((!is_transp_flag) && (world->notify->molecule_collision_report == NOTIFY_FULL) &&
        world->rxn_flags.vol_wall_reaction_flag) {
-    world->vol_wall_colls++;
+    local_stats(world)->vol_wall_colls++;
   }
 
-  struct periodic_image *periodic_box = m->periodic_box;
+  struct periodic_image *periodic_box = &m->periodic_box;
   if (is_transp_flag) {
-    transp_rx->n_occurred++;
+    THREADED_ADD(transp_rx->n_occurred, 1);
     if ((m->flags & COUNT_ME) != 0 && (spec->flags & COUNT_SOME_MASK) != 0) {
       /* Count as far up as we can unambiguously */
       int destroy_flag = 0;
@@ -4390,11 +4628,11 @@ int collide_and_react_with_walls(struct volume* world, struct collision* smash,
     int jj = 0;
     int i = 0;
     if (num_matching_rxns == 1) {
-      i = test_intersect(matching_rxns[0], r_rate_factor, world->rng);
+      i = test_intersect(matching_rxns[0], r_rate_factor, local_rng(world));
       jj = 0;
     } else {
       jj = test_many_intersect(matching_rxns, r_rate_factor,
-                               num_matching_rxns, &(i), world->rng);
+                               num_matching_rxns, &(i), local_rng(world));
     }
 
     if ((i >= RX_LEAST_VALID_PATHWAY) && (jj > RX_NO_RX)) {
@@ -4501,7 +4739,7 @@ int reflect_or_periodic_bc(
 
   // X direction: reflect or periodic BC
   if (periodic_x) {
-    int x_inc = (vm->periodic_box->x % 2 == 0) ? 1 : -1;
+    int x_inc = (vm->periodic_box.x % 2 == 0) ? 1 : -1;
     if (!distinguishable(vm->pos.x, llx, EPS_C)) {
       x_pos = urx - EPS_C;
       box_inc_x = -x_inc;
@@ -4528,7 +4766,7 @@ int reflect_or_periodic_bc(
 
   // Y direction: reflect or periodic BC
   if (periodic_y) {
-    int y_inc = (vm->periodic_box->y % 2 == 0) ? 1 : -1;
+    int y_inc = (vm->periodic_box.y % 2 == 0) ? 1 : -1;
     if (!distinguishable(vm->pos.y, lly, EPS_C)) {
       y_pos = ury - EPS_C;
       box_inc_y = -y_inc;
@@ -4556,7 +4794,7 @@ int reflect_or_periodic_bc(
 
   // Z direction: reflect or periodic BC
   if (periodic_z) {
-    int z_inc = (vm->periodic_box->z % 2 == 0) ? 1 : -1;
+    int z_inc = (vm->periodic_box.z % 2 == 0) ? 1 : -1;
     if (!distinguishable(vm->pos.z, llz, EPS_C)) {
       z_pos = urz - EPS_C;
       box_inc_z = -z_inc;
@@ -4624,17 +4862,17 @@ int reflect_or_periodic_bc(
       if (vm->properties->flags & (COUNT_CONTENTS | COUNT_ENCLOSED)) {
         count_region_from_scratch(world, (struct abstract_molecule *)vm, NULL,
                                   -1, &(orig_pos), NULL, reflect_t,
-                                  vm->periodic_box);
+                                  &vm->periodic_box);
       }
       struct volume_molecule *new_m = migrate_volume_molecule(vm, nsv);
-      vm->periodic_box->x += box_inc_x;
-      vm->periodic_box->y += box_inc_y;
-      vm->periodic_box->z += box_inc_z;
+      vm->periodic_box.x += box_inc_x;
+      vm->periodic_box.y += box_inc_y;
+      vm->periodic_box.z += box_inc_z;
       // increment counts of regions we are entering
       if (new_m->properties->flags & (COUNT_CONTENTS | COUNT_ENCLOSED)) {
         count_region_from_scratch(world, (struct abstract_molecule *)new_m,
                                   NULL, 1, &(new_m->pos), NULL, reflect_t,
-                                  new_m->periodic_box);
+                                  &new_m->periodic_box);
       }
       *mol = new_m;
     }
@@ -4697,7 +4935,7 @@ int reflect_or_periodic_bc(
             COUNT_SOME_MASK)) {
         continue;
       }
-      count_region_update(world, m->properties, m->id, m->periodic_box,
+      count_region_update(world, m->properties, m->id, &m->periodic_box,
         ((struct wall *)ttv->target)->counting_regions,
         ((ttv->what & COLLIDE_MASK) == COLLIDE_FRONT) ? 1 : -1, 0, &(ttv->loc), ttv->t);
       if (ttv == smash)
@@ -4743,7 +4981,7 @@ void collide_and_react_with_subvol(struct volume* world, struct collision *smash
       if (!(spec->flags & ((struct wall *)ttv->target)->flags & COUNT_SOME_MASK)) {
         continue;
       }
-      count_region_update(world, spec, m->id, m->periodic_box,
+      count_region_update(world, spec, m->id, &m->periodic_box,
           ((struct wall *)ttv->target)->counting_regions,
           ((ttv->what & COLLIDE_MASK) == COLLIDE_FRONT) ? 1 : -1, 1, &(ttv->loc), ttv->t);
     }
@@ -4790,7 +5028,7 @@ void collide_and_react_with_subvol(struct volume* world, struct collision *smash
  * this function does not return anything
  *
  ******************************************************************************/
-void compute_displacement(struct volume* world, struct collision* shead,
+void compute_displacement(struct volume* world, int inertness,
   struct volume_molecule* m, struct vector3* displacement,
   struct vector3* displacement2, double* rate_factor, double* r_rate_factor,
   double* steps, double* t_steps, double max_time) {
@@ -4801,11 +5039,11 @@ void compute_displacement(struct volume* world, struct collision* shead,
       pick_release_displacement(displacement, displacement2, spec->space_step,
         world->r_step_release, world->d_step, world->radial_subdivisions,
         world->directions_mask, world->num_directions, world->rx_radius_3d,
-        world->rng);
+        local_rng(world));
       *t_steps = 0;
     } else { /* Clamping or surface microscopic reversibility */
       pick_clamped_displacement(displacement, m, world->r_step_surface,
-        world->rng, world->radial_subdivisions);
+        local_rng(world), world->radial_subdivisions);
       *t_steps = spec->time_step;
       m->previous_wall = NULL;
       m->index = -1;
@@ -4816,7 +5054,16 @@ void compute_displacement(struct volume* world, struct collision* shead,
     *steps = 1.0;
   } else {
     if (max_time > MULTISTEP_WORTHWHILE) {
-      *steps = safe_diffusion_step(m, shead, world->radial_subdivisions,
+      /* Any partner closer than this limits m to a single step anyway (with
+         some slack for rounding in safe_diffusion_step) */
+      double d2_enough = spec->space_step * MULTISTEP_WORTHWHILE *
+        world->r_step[(int)(world->radial_subdivisions * MULTISTEP_PERCENTILE)];
+      d2_enough *= 0.99 * d2_enough;
+      double d2_partner = GIGANTIC;
+      if ((spec->flags & (CAN_VOLVOL | CANT_INITIATE)) == CAN_VOLVOL &&
+          inertness < inert_to_all)
+        d2_partner = nearest_reaction_partner(world, m, inertness, d2_enough);
+      *steps = safe_diffusion_step(m, d2_partner, world->radial_subdivisions,
         world->r_step, world->x_fineparts, world->y_fineparts, world->z_fineparts);
     } else {
       *steps = 1.0;
@@ -4833,12 +5080,12 @@ void compute_displacement(struct volume* world, struct collision* shead,
     }
 
     if (*steps == 1.0) {
-      pick_displacement(displacement, spec->space_step, world->rng);
+      pick_displacement(displacement, spec->space_step, local_rng(world));
       *r_rate_factor = *rate_factor = 1.0;
     } else {
       *rate_factor = sqrt(*steps);
       *r_rate_factor = 1.0 / *rate_factor;
-      pick_displacement(displacement, *rate_factor * spec->space_step, world->rng);
+      pick_displacement(displacement, *rate_factor * spec->space_step, local_rng(world));
     }
   }
 
@@ -4851,8 +5098,128 @@ void compute_displacement(struct volume* world, struct collision* shead,
       displacement->z *= (spec->max_step_length / disp_length);
     }
   }
-  world->diffusion_number++;
-  world->diffusion_cumtime += *steps;
+  local_stats(world)->diffusion_number++;
+  local_stats(world)->diffusion_cumtime += *steps;
+}
+
+
+/******************************************************************************
+ *
+ * the nearest_reaction_partner helper function is used in
+ * compute_displacement to find how far the diffusing molecule m is from the
+ * closest volume molecule in its subvolume it could react with, streaming over
+ * the packed positions of the per-species lists.  The scan stops at the first
+ * partner closer than sqrt(d2_enough).
+ *
+ * Return values:
+ *
+ * the squared distance to the closest partner (or to one closer than
+ * sqrt(d2_enough)), or GIGANTIC if there is none
+ *
+ ******************************************************************************/
+double nearest_reaction_partner(struct volume* world, struct volume_molecule* m,
+  int inertness, double d2_enough) {
+
+  struct subvolume* sv = m->subvol;
+  struct rxn *matching_rxns[MAX_MATCHING_RXNS];
+  struct species* spec = m->properties;
+  double d2min = GIGANTIC;
+  for (struct per_species_list *psl = sv->species_head; psl != NULL;
+       psl = psl->next) {
+    /* nothing here but m itself? */
+    int self = (psl == m->species_list) ? m->packed_index : -1;
+    if (psl->properties == NULL || psl->n_packed == (self >= 0))
+      continue;
+
+    /* no possible reactions. skip it. */
+    if (!trigger_bimolecular_preliminary(world->reaction_hash, world->rx_hashsize,
+      spec->hashval, psl->properties->hashval, spec, psl->properties)) {
+      continue;
+    }
+
+    /* Whether a pair of volume molecules reacts depends only on the two
+       species, so one lookup serves the whole list */
+    int num_matching_rxns = -1;
+    for (int i = 0; i < psl->n_packed; i++) {
+      const struct vector3 *pos = PACKED_POS(psl, i);
+      double d2 = (m->pos.x - pos->x) * (m->pos.x - pos->x) +
+                  (m->pos.y - pos->y) * (m->pos.y - pos->y) +
+                  (m->pos.z - pos->z) * (m->pos.z - pos->z);
+      if (d2 >= d2min || i == self)
+        continue;
+
+      struct volume_molecule* mp = psl->packed[i];
+
+      if (inertness == inert_to_mol && m->index == mp->index) {
+        continue;
+      }
+
+      // count only in the relevant periodic box
+      if (!periodic_boxes_are_identical(&m->periodic_box, &mp->periodic_box)) {
+        continue;
+      }
+
+      if (num_matching_rxns < 0)
+        num_matching_rxns = trigger_bimolecular(world->reaction_hash,
+          world->rx_hashsize, spec->hashval, psl->properties->hashval,
+          (struct abstract_molecule *)m, (struct abstract_molecule *)mp, 0, 0,
+          matching_rxns);
+      if (num_matching_rxns == 0)
+        break;
+
+      d2min = d2;
+      if (d2min < d2_enough)
+        return d2min;
+    }
+  }
+  return d2min;
+}
+
+
+/******************************************************************************
+ *
+ * the add_mol_mol_collision helper function is used by
+ * determine_mol_mol_reactions to put a collision with a possible partner mp
+ * on the collision list for each reaction the two may undergo.  Candidates
+ * come in per-species runs: *num_matching_rxns is -1 at the start of a run,
+ * and once it is 0 the rest of the run is skipped.
+ *
+ * Return values:
+ *
+ * this function does not return anything
+ *
+ ******************************************************************************/
+static void add_mol_mol_collision(struct volume* world,
+  struct volume_molecule* m, struct volume_molecule* mp, int inertness,
+  struct rxn **matching_rxns, int *num_matching_rxns,
+  struct collision** shead, struct collision** stail) {
+
+  if (inertness == inert_to_mol && m->index == mp->index) {
+    return;
+  }
+
+  // count only in the relevant periodic box
+  if (!periodic_boxes_are_identical(&m->periodic_box, &mp->periodic_box)) {
+    return;
+  }
+
+  if (*num_matching_rxns < 0)
+    *num_matching_rxns = trigger_bimolecular(world->reaction_hash,
+      world->rx_hashsize, m->properties->hashval,
+      mp->species_list->properties->hashval, (struct abstract_molecule *)m,
+      (struct abstract_molecule *)mp, 0, 0, matching_rxns);
+
+  for (int i = 0; i < *num_matching_rxns; i++) {
+    struct collision* smash = CHECKED_SCRATCH_GET(local_scratch(world),
+      struct collision, "collision data");
+    smash->target = (void *)mp;
+    smash->what = COLLIDE_VOL;
+    smash->intermediate = matching_rxns[i];
+    smash->next = *shead;
+    *shead = smash;
+    if (*stail == NULL)
+      *stail = *shead;
+  }
 }
 
 
@@ -4860,7 +5227,12 @@ void compute_displacement(struct volume* world, struct collision* shead,
  *
  * the determine_mol_mol_reactions helper function is used in diffuse_3D to
  * compute all possible molecule molecule reactions between the diffusing
- * molecule m and all other volume molecules in the subvolume.
+ * molecule m and the other volume molecules in the subvolume.  Only molecules
+ * m can reach while moving along displacement are kept: reflections preserve
+ * the length of the path, so anything farther than that plus the interaction
+ * radius cannot be hit before the next scan.  Crowded subvolumes are searched
+ * through their molecule grid, visiting the partners in the same order as a
+ * scan of the per-species lists would.
  *
  * Return values:
  *
@@ -4868,68 +5240,100 @@ void compute_displacement(struct volume* world, struct collision* shead,
  *
  ******************************************************************************/
 void determine_mol_mol_reactions(struct volume* world, struct volume_molecule* m,
-  struct collision** shead, struct collision** stail, int inertness) {
+  struct vector3* displacement, struct collision** shead,
+  struct collision** stail, int inertness) {
 
   struct subvolume* sv = m->subvol;
   struct rxn *matching_rxns[MAX_MATCHING_RXNS];
-  int num_matching_rxns = 0;
-  struct species* spec = m->properties;
+  double reach = (vect_length(displacement) + world->rx_radius_3d) *
+                 (1.0 + 1e-6);
+  double reach2 = reach * reach;
+
+  /* Rank the lists holding possible partners */
+  int n_ranked = 0;
+  int n_candidates = 0;
   struct per_species_list *psl_next, *psl, **psl_head = &sv->species_head;
   for (psl = sv->species_head; psl != NULL; psl = psl_next) {
     psl_next = psl->next;
+    psl->scan_rank = -1;
     if (psl->properties == NULL) {
       psl_head = &psl->next;
       continue;
     }
 
     /* Garbage collection of empty per-species lists */
-    if (psl->head == NULL) {
+    if (psl->n_packed == 0) {
       *psl_head = psl->next;
-      ht_remove(&sv->mol_by_species, psl);
-      mem_put(sv->local_storage->pslv, psl);
+      free_species_list(sv, psl);
       continue;
     } else
       psl_head = &psl->next;
 
+    /* nothing here but m itself? */
+    int self = (psl == m->species_list) ? m->packed_index : -1;
+    if (psl->n_packed == (self >= 0))
+      continue;
+
     /* no possible reactions. skip it. */
     if (!trigger_bimolecular_preliminary(world->reaction_hash, world->rx_hashsize,
       m->properties->hashval, psl->properties->hashval, m->properties, psl->properties)) {
       continue;
     }
 
-    for (struct volume_molecule* mp = psl->head; mp != NULL; mp = mp->next_v) {
-      if (mp == m) {
-        continue;
-      }
+    psl->scan_rank = n_ranked++;
+    n_candidates += psl->n_packed;
+  }
 
-      if (inertness == inert_to_mol && m->index == mp->index) {
-        continue;
-      }
+  if (n_candidates >= MOL_GRID_MIN_MOLECULES && sv->mol_grid == NULL)
+    build_mol_grid(world, sv);
+  if (sv->mol_grid != NULL && n_ranked > 0) {
+    struct mol_grid_hit found[MAX_GRID_PARTNERS];
+    double box = reach * (1.0 + 1e-9) + EPS_C;
+    struct vector3 llf = { m->pos.x - box, m->pos.y - box, m->pos.z - box };
+    struct vector3 urb = { m->pos.x + box, m->pos.y + box, m->pos.z + box };
+    int n_found =
+        find_grid_partners(sv, &llf, &urb, m, found, MAX_GRID_PARTNERS);
+    if (n_found >= 0) {
+      int rank = -1;
+      int num_matching_rxns = -1;
+      for (int k = 0; k < n_found; k++) {
+        struct volume_molecule* mp = found[k].mp;
+        if (found[k].rank != rank) {
+          rank = found[k].rank;
+          num_matching_rxns = -1;
+        } else if (num_matching_rxns == 0)
+          continue;
 
-      // count only in the relevant periodic box
-      if (!periodic_boxes_are_identical(m->periodic_box, mp->periodic_box)) {
-        continue;
+        const struct vector3 *pos = PACKED_POS(mp->species_list, found[k].index);
+        double d2 = (m->pos.x - pos->x) * (m->pos.x - pos->x) +
+                    (m->pos.y - pos->y) * (m->pos.y - pos->y) +
+                    (m->pos.z - pos->z) * (m->pos.z - pos->z);
+        if (d2 > reach2)
+          continue;
+
+        add_mol_mol_collision(world, m, mp, inertness, matching_rxns,
+                              &num_matching_rxns, shead, stail);
       }
+      return;
+    }
+  }
 
-      num_matching_rxns = trigger_bimolecular(world->reaction_hash,
-        world->rx_hashsize, spec->hashval, psl->properties->hashval,
-        (struct abstract_molecule *)m, (struct abstract_molecule *)mp, 0, 0,
-        matching_rxns);
+  for (psl = sv->species_head; psl != NULL; psl = psl->next) {
+    if (psl->scan_rank < 0)
+      continue;
 
-      if (num_matching_rxns > 0) {
-        for (int i = 0; i < num_matching_rxns; i++) {
-          struct collision* smash =
-           (struct collision *)CHECKED_MEM_GET(sv->local_storage->coll,
-            "collision data");
-          smash->target = (void *)mp;
-          smash->what = COLLIDE_VOL;
-          smash->intermediate = matching_rxns[i];
-          smash->next = *shead;
-          *shead = smash;
-          if (*stail == NULL)
-            *stail = *shead;
-        }
-      }
+    int self = (psl == m->species_list) ? m->packed_index : -1;
+    int num_matching_rxns = -1;
+    for (int j = 0; j < psl->n_packed && num_matching_rxns != 0; j++) {
+      const struct vector3 *pos = PACKED_POS(psl, j);
+      double d2 = (m->pos.x - pos->x) * (m->pos.x - pos->x) +
+                  (m->pos.y - pos->y) * (m->pos.y - pos->y) +
+                  (m->pos.z - pos->z) * (m->pos.z - pos->z);
+      if (d2 > reach2 || j == self)
+        continue;
+
+      add_mol_mol_collision(world, m, psl->packed[j], inertness,
+                            matching_rxns, &num_matching_rxns, shead, stail);
     }
   }
 }
@@ -5039,7 +5443,7 @@ bool periodicbox_in_surfmol_list(
        sml_curr != NULL;
        sml_curr = sml_curr->next) {
     struct surface_molecule *sm = sml_curr->sm;
-    if (sm && periodic_boxes_are_identical(periodic_box, sm->periodic_box)) {
+    if (sm && periodic_boxes_are_identical(periodic_box, &sm->periodic_box)) {
       return true;
     }
   }
@@ -30,6 +30,10 @@
 #define MULTISTEP_FRACTION 0.9
 #define MAX_UNI_TIMESKIP 100000
 
+/* Partners a search through a molecule grid may find before it falls back
+   to scanning the per-species lists */
+#define MAX_GRID_PARTNERS 256
+
 struct vector3* reflect_periodic_2D(
     struct volume *state,
     int index_edge_was_hit,
@@ -63,6 +67,9 @@ struct collision *ray_trace(struct volume *world, struct vector3 *init_pos,
                             struct collision *c, struct subvolume *sv,
                             struct vector3 *v, struct wall *reflectee);
 
+struct abstract_element *sort_collisions(struct scratch_arena *sa,
+                                         struct abstract_element *ae);
+
 struct sp_collision *ray_trace_trimol(struct volume *world,
                                       struct volume_molecule *m,
                                       struct sp_collision *c,
@@ -113,9 +120,10 @@ struct sp_collision *expand_collision_partner_list_for_neighbor(
     struct subvolume *new_sv, struct vector3 *path_llf,
     struct vector3 *path_urb, struct sp_collision *shead1, double trim_x,
     double trim_y, double trim_z, double *x_fineparts, double *y_fineparts,
-    double *z_fineparts, int rx_hashsize, struct rxn **reaction_hash);
+    double *z_fineparts, int rx_hashsize, struct rxn **reaction_hash,
+    struct scratch_arena *scratch);
 
-double safe_diffusion_step(struct volume_molecule *m, struct collision *shead,
+double safe_diffusion_step(struct volume_molecule *m, double d2_partner,
                            u_int radial_subdivisions, double *r_step,
                            double *x_fineparts, double *y_fineparts,
                            double *z_fineparts);
@@ -54,7 +54,8 @@ ray_trace_trimol:
   Out: collision list of walls and molecules we intersected along our ray
        (current subvolume only), plus the subvolume wall.  Will always
        return at least the subvolume wall--NULL indicates an out of
-       memory eriror.
+       memory eriror.  The list is taken from the scratch arena of the
+       calling context, like that of ray_trace.
   Note: This is a version of the "ray_trace()" function adapted for
         the case when moving molecule can engage in trimolecular collisions
 
@@ -67,40 +68,42 @@ struct sp_collision *ray_trace_trimol(struct volume *world,
                                       double walk_start_time) {
   struct sp_collision *smash, *shead;
   struct abstract_molecule *a;
-  struct wall_list *wlp;
-  struct wall_list fake_wlp;
   double dx, dy, dz;
   /* time, in units of of the molecule's time step, at which molecule
      will cross the x,y,z partitions, respectively. */
   double tx, ty, tz;
   int i, j, k;
 
-  world->ray_voxel_tests++;
+  local_stats(world)->ray_voxel_tests++;
 
+  struct scratch_arena *scratch = local_scratch(world);
   shead = NULL;
-  smash = (struct sp_collision *)CHECKED_MEM_GET(sv->local_storage->sp_coll,
-                                                 "collision structure");
+  smash =
+      CHECKED_SCRATCH_GET(scratch, struct sp_collision, "collision structure");
 
-  fake_wlp.next = sv->wall_head;
-
-  for (wlp = sv->wall_head; wlp != NULL; wlp = wlp->next) {
-    if (wlp->this_wall == reflectee)
+  /* Check wall collisions, skipping the walls whose plane we don't cross */
+  struct wall_cursor cursor;
+  wall_cursor_segment(&cursor, sv, &(m->pos), v);
+  struct wall *w;
+  while ((w = wall_cursor_next(&cursor)) != NULL) {
+    if (w == reflectee)
       continue;
 
-    i = collide_wall(&(m->pos), v, wlp->this_wall, &(smash->t), &(smash->loc),
-                     1, world->rng, world->notify, &(world->ray_polygon_tests));
+    i = collide_wall(&(m->pos), v, w, &(smash->t), &(smash->loc),
+                     1, local_rng(world), world->notify,
+                     &local_stats(world)->ray_polygon_tests);
     if (i == COLLIDE_REDO) {
-      if (shead != NULL)
-        mem_put_list(sv->local_storage->sp_coll, shead);
       shead = NULL;
-      wlp = &fake_wlp;
+      if (world->notify->final_summary == NOTIFY_FULL)
+        local_stats(world)->ray_polygon_tests += cursor.n_screened;
+      wall_cursor_segment(&cursor, sv, &(m->pos), v);
       continue;
     } else if (i != COLLIDE_MISS) {
-      world->ray_polygon_colls++;
+      local_stats(world)->ray_polygon_colls++;
 
       smash->what = COLLIDE_WALL + i;
       smash->moving = m->properties;
-      smash->target = (void *)wlp->this_wall;
+      smash->target = (void *)w;
       smash->t_start = walk_start_time;
       smash->pos_start.x = m->pos.x;
       smash->pos_start.y = m->pos.y;
@@ -113,10 +116,12 @@ struct sp_collision *ray_trace_trimol(struct volume *world,
 
       smash->next = shead;
       shead = smash;
-      smash = (struct sp_collision *)CHECKED_MEM_GET(sv->local_storage->sp_coll,
-                                                     "collision structure");
+      smash = CHECKED_SCRATCH_GET(scratch, struct sp_collision,
+                                  "collision structure");
     }
   }
+  if (world->notify->final_summary == NOTIFY_FULL)
+    local_stats(world)->ray_polygon_tests += cursor.n_screened;
 
   dx = dy = dz = 0.0;
   i = -10;
@@ -253,8 +258,8 @@ struct sp_collision *ray_trace_trimol(struct volume *world,
 
     i = collide_mol(&(m->pos), v, a, &(c->t), &(c->loc), world->rx_radius_3d);
     if (i != COLLIDE_MISS) {
-      smash = (struct sp_collision *)CHECKED_MEM_GET(sv->local_storage->sp_coll,
-                                                     "collision structure");
+      smash = CHECKED_SCRATCH_GET(scratch, struct sp_collision,
+                                  "collision structure");
       memcpy(smash, c, sizeof(struct sp_collision));
 
       smash->t_start = walk_start_time;
@@ -279,6 +284,7 @@ expand_collision_partner_list:
   In: molecule that is moving
       displacement to the new location
       subvolume that we start in
+      scratch arena to take the collisions from
   Out: Returns linked list of molecules from neighbor subvolumes
        that are located within "interaction_radius" from the the subvolume
        border.
@@ -292,7 +298,8 @@ static struct sp_collision *expand_collision_partner_list(
     struct volume_molecule *m, struct vector3 *mv, struct subvolume *sv,
     double rx_radius_3d, double *x_fineparts, double *y_fineparts,
     double *z_fineparts, int nx_parts, int ny_parts, int nz_parts,
-    int rx_hashsize, struct rxn **reaction_hash) {
+    int rx_hashsize, struct rxn **reaction_hash,
+    struct scratch_arena *scratch) {
   struct sp_collision *shead1 = NULL;
   /* lower left and upper_right corners of the molecule path
      bounding box expanded by R. */
@@ -323,26 +330,30 @@ static struct sp_collision *expand_collision_partner_list(
     struct subvolume *newsv_x = sv + (nz_parts - 1) * (ny_parts - 1);
     shead1 = expand_collision_partner_list_for_neighbor(
         sv, m, mv, newsv_x, &path_llf, &path_urb, shead1, R, 0.0, 0.0,
-        x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+        x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+        scratch);
 
     /* go +X, +Y */
     if (y_pos) {
       struct subvolume *newsv_y = newsv_x + (nz_parts - 1);
       shead1 = expand_collision_partner_list_for_neighbor(
           sv, m, mv, newsv_y, &path_llf, &path_urb, shead1, R, R, 0.0,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
       /* go +X, +Y, +Z */
       if (z_pos)
         shead1 = expand_collision_partner_list_for_neighbor(
             sv, m, mv, newsv_y + 1, &path_llf, &path_urb, shead1, R, R, R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
 
       /* go +X, +Y, -Z */
       if (z_neg)
         shead1 = expand_collision_partner_list_for_neighbor(
             sv, m, mv, newsv_y - 1, &path_llf, &path_urb, shead1, R, R, -R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
     }
 
     /* go +X, -Y */
@@ -350,32 +361,37 @@ static struct sp_collision *expand_collision_partner_list(
       struct subvolume *newsv_y = newsv_x - (nz_parts - 1);
       shead1 = expand_collision_partner_list_for_neighbor(
           sv, m, mv, newsv_y, &path_llf, &path_urb, shead1, R, -R, 0.0,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
       /* go +X, -Y, +Z */
       if (z_pos)
         shead1 = expand_collision_partner_list_for_neighbor(
             sv, m, mv, newsv_y + 1, &path_llf, &path_urb, shead1, R, -R, R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
 
       /* go +X, -Y, -Z */
       if (z_neg)
         shead1 = expand_collision_partner_list_for_neighbor(
             sv, m, mv, newsv_y - 1, &path_llf, &path_urb, shead1, R, -R, -R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
     }
 
     /* go +X, +Z */
     if (z_pos)
       shead1 = expand_collision_partner_list_for_neighbor(
           sv, m, mv, newsv_x + 1, &path_llf, &path_urb, shead1, R, 0.0, R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
     /* go +X, -Z */
     if (z_neg)
       shead1 = expand_collision_partner_list_for_neighbor(
           sv, m, mv, newsv_x - 1, &path_llf, &path_urb, shead1, R, 0.0, -R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
   }
 
   /* go -X */
@@ -383,26 +399,30 @@ static struct sp_collision *expand_collision_partner_list(
     struct subvolume *newsv_x = sv - (nz_parts - 1) * (ny_parts - 1);
     shead1 = expand_collision_partner_list_for_neighbor(
         sv, m, mv, newsv_x, &path_llf, &path_urb, shead1, -R, 0.0, 0.0,
-        x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+        x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+        scratch);
 
     /* go -X, +Y */
     if (y_pos) {
       struct subvolume *newsv_y = newsv_x + (nz_parts - 1);
       shead1 = expand_collision_partner_list_for_neighbor(
           sv, m, mv, newsv_y, &path_llf, &path_urb, shead1, -R, R, 0.0,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
       /* go -X, +Y, +Z */
       if (z_pos)
         shead1 = expand_collision_partner_list_for_neighbor(
             sv, m, mv, newsv_y + 1, &path_llf, &path_urb, shead1, -R, R, R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
 
       /* go -X, +Y, -Z */
       if (z_neg)
         shead1 = expand_collision_partner_list_for_neighbor(
             sv, m, mv, newsv_y - 1, &path_llf, &path_urb, shead1, -R, R, -R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
     }
 
     /* go -X, -Y */
@@ -410,32 +430,37 @@ static struct sp_collision *expand_collision_partner_list(
       struct subvolume *newsv_y = newsv_x - (nz_parts - 1);
       shead1 = expand_collision_partner_list_for_neighbor(
           sv, m, mv, newsv_y, &path_llf, &path_urb, shead1, -R, -R, 0.0,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
       /* go -X, -Y, +Z */
       if (z_pos)
         shead1 = expand_collision_partner_list_for_neighbor(
             sv, m, mv, newsv_y + 1, &path_llf, &path_urb, shead1, -R, -R, R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
 
       /* go -X, -Y, -Z */
       if (z_neg)
         shead1 = expand_collision_partner_list_for_neighbor(
             sv, m, mv, newsv_y - 1, &path_llf, &path_urb, shead1, -R, -R, -R,
-            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+            x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+            scratch);
     }
 
     /* go -X, +Z */
     if (z_pos)
       shead1 = expand_collision_partner_list_for_neighbor(
           sv, m, mv, newsv_x + 1, &path_llf, &path_urb, shead1, -R, 0.0, R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
     /* go -X, -Z */
     if (z_neg)
       shead1 = expand_collision_partner_list_for_neighbor(
           sv, m, mv, newsv_x - 1, &path_llf, &path_urb, shead1, -R, 0.0, -R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
   }
 
   /* go +Y */
@@ -443,19 +468,22 @@ static struct sp_collision *expand_collision_partner_list(
     struct subvolume *newsv_y = sv + (nz_parts - 1);
     shead1 = expand_collision_partner_list_for_neighbor(
         sv, m, mv, newsv_y, &path_llf, &path_urb, shead1, 0.0, R, 0.0,
-        x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+        x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+        scratch);
 
     /* go +Y, +Z */
     if (z_pos)
       shead1 = expand_collision_partner_list_for_neighbor(
           sv, m, mv, newsv_y + 1, &path_llf, &path_urb, shead1, 0.0, R, R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
     /* go +Y, -Z */
     if (z_neg)
       shead1 = expand_collision_partner_list_for_neighbor(
           sv, m, mv, newsv_y - 1, &path_llf, &path_urb, shead1, 0.0, R, -R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
   }
 
   /* go -Y */
@@ -463,32 +491,37 @@ static struct sp_collision *expand_collision_partner_list(
     struct subvolume *newsv_y = sv - (nz_parts - 1);
     shead1 = expand_collision_partner_list_for_neighbor(
         sv, m, mv, newsv_y, &path_llf, &path_urb, shead1, 0.0, -R, 0.0,
-        x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+        x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+        scratch);
 
     /* go -Y, +Z */
     if (z_pos)
       shead1 = expand_collision_partner_list_for_neighbor(
           sv, m, mv, newsv_y + 1, &path_llf, &path_urb, shead1, 0.0, -R, R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
 
     /* go -Y, -Z */
     if (z_neg)
       shead1 = expand_collision_partner_list_for_neighbor(
           sv, m, mv, newsv_y - 1, &path_llf, &path_urb, shead1, 0.0, -R, -R,
-          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+          x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+          scratch);
   }
 
   /* go +Z */
   if (z_pos)
     shead1 = expand_collision_partner_list_for_neighbor(
         sv, m, mv, sv + 1, &path_llf, &path_urb, shead1, 0.0, 0.0, R,
-        x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+        x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+        scratch);
 
   /* go -Z */
   if (z_neg)
     shead1 = expand_collision_partner_list_for_neighbor(
         sv, m, mv, sv - 1, &path_llf, &path_urb, shead1, 0.0, 0.0, -R,
-        x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash);
+        x_fineparts, y_fineparts, z_fineparts, rx_hashsize, reaction_hash,
+        scratch);
 
   return shead1;
 }
@@ -564,7 +597,7 @@ struct volume_molecule *diffuse_3D_big_list(struct volume *world,
       col_mol_mol_grid_flag;
 
   struct species *spec = m->properties;
-  struct periodic_image *periodic_box = m->periodic_box;
+  struct periodic_image *periodic_box = &m->periodic_box;
   if (spec == NULL)
     mcell_internal_error(
         "Attempted to take a diffusion step for a defunct molecule.");
@@ -573,6 +606,13 @@ struct volume_molecule *diffuse_3D_big_list(struct volume *world,
     return m;
   }
 
+  /* snapshot taken so that a step leaving this storage's reach can be undone
+     and replayed during the serial sweep */
+  int can_defer = thread_can_defer();
+  struct volume_molecule saved_m;
+  if (can_defer)
+    saved_m = *m;
+
   /* volume_reversibility and surface_reversibility routines are not valid
      in case of tri-molecular reactions */
   if (world->volume_reversibility || world->surface_reversibility) {
@@ -611,6 +651,10 @@ struct volume_molecule *diffuse_3D_big_list(struct volume *world,
     }
   }
 
+  /* Collision lists only last for this step */
+  struct scratch_arena *scratch = local_scratch(world);
+  struct scratch_mark step_mark = scratch_save(scratch);
+
 /* Done housekeeping, now let's do something fun! */
 
 pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
@@ -632,13 +676,13 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
                                   spec->space_step, world->r_step_release,
                                   world->d_step, world->radial_subdivisions,
                                   world->directions_mask, world->num_directions,
-                                  world->rx_radius_3d, world->rng);
+                                  world->rx_radius_3d, local_rng(world));
 
         t_steps = 0;
       } else /* Clamping or surface microscopic reversibility */
       {
         pick_clamped_displacement(&displacement, m, world->r_step_surface,
-                                  world->rng, world->radial_subdivisions);
+                                  local_rng(world), world->radial_subdivisions);
         t_steps = spec->time_step;
         m->previous_wall = NULL;
         m->index = -1;
@@ -650,7 +694,7 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
       /* XXX: I don't think this is safe.  We probably need to pass in a list
        * of nearby molecules... */
       if (max_time > MULTISTEP_WORTHWHILE)
-        steps = safe_diffusion_step(m, NULL, world->radial_subdivisions,
+        steps = safe_diffusion_step(m, GIGANTIC, world->radial_subdivisions,
                                     world->r_step, world->x_fineparts,
                                     world->y_fineparts, world->z_fineparts);
       else
@@ -667,13 +711,13 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
       }
 
       if (steps == 1.0) {
-        pick_displacement(&displacement, spec->space_step, world->rng);
+        pick_displacement(&displacement, spec->space_step, local_rng(world));
         r_rate_factor = rate_factor = 1.0;
       } else {
         rate_factor = sqrt(steps);
         r_rate_factor = 1.0 / rate_factor;
         pick_displacement(&displacement, rate_factor * spec->space_step,
-                          world->rng);
+                          local_rng(world));
       }
     }
 
@@ -687,8 +731,17 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
       }
     }
 
-    world->diffusion_number++;
-    world->diffusion_cumtime += steps;
+    local_stats(world)->diffusion_number++;
+    local_stats(world)->diffusion_cumtime += steps;
+
+    if (can_defer &&
+        !thread_step_is_local(world, &m->pos, vect_length(&displacement))) {
+      local_stats(world)->diffusion_number--;
+      local_stats(world)->diffusion_cumtime -= steps;
+      *m = saved_m;
+      m->flags |= ACT_DEFER;
+      return m;
+    }
   }
 
   moving_bi_molecular_flag =
@@ -713,10 +766,9 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
       }
 
       /* Garbage collection of empty per-species lists */
-      if (psl->head == NULL) {
+      if (psl->n_packed == 0) {
         *psl_head = psl->next;
-        ht_remove(&sv->mol_by_species, psl);
-        mem_put(sv->local_storage->pslv, psl);
+        free_species_list(sv, psl);
         continue;
       } else
         psl_head = &psl->next;
@@ -750,12 +802,13 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
       /* If we are interested in collisions with this molecule type, add all
        * local molecules to our collision list */
       if (what != 0) {
-        for (mp = psl->head; mp != NULL; mp = mp->next_v) {
+        for (int n = psl->n_packed - 1; n >= 0; n--) {
+          mp = psl->packed[n];
           if (mp == m)
             continue;
 
-          smash = (struct sp_collision *)CHECKED_MEM_GET(
-              sv->local_storage->sp_coll, "collision data");
+          smash = CHECKED_SCRATCH_GET(scratch, struct sp_collision,
+                                      "collision data");
           smash->t = 0.0;
           smash->t_start = 0.0;
           smash->pos_start.x = m->pos.x;
@@ -790,7 +843,7 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
           m, &displacement, sv, world->rx_radius_3d, world->x_fineparts,
           world->y_fineparts, world->z_fineparts, world->nx_parts,
           world->ny_parts, world->nz_parts, world->rx_hashsize,
-          world->reaction_hash);
+          world->reaction_hash, scratch);
 
       if (stail != NULL)
         stail->next = shead_exp;
@@ -809,25 +862,19 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
 
 #define TRI_CLEAN_AND_RETURN(x)                                                \
   do {                                                                         \
-    if (main_tri_shead != NULL)                                                \
-      mem_put_list(sv->local_storage->tri_coll, main_tri_shead);               \
-    if (main_shead2 != NULL)                                                   \
-      mem_put_list(sv->local_storage->sp_coll, main_shead2);                   \
+    scratch_release(scratch, step_mark);                                       \
     return (x);                                                                \
   } while (0)
 
   do {
     if (world->use_expanded_list && redo_expand_collision_list_flag) {
       /* split the combined collision list into two original lists
-         and remove old "shead_exp" */
+         and drop old "shead_exp" (left in the scratch arena) */
       if (shead_exp != NULL) {
-        if (shead == shead_exp) {
-          mem_put_list(sv->local_storage->sp_coll, shead_exp);
+        if (shead == shead_exp)
           shead = NULL;
-        } else if (shead != NULL) {
+        else if (shead != NULL)
           stail->next = NULL;
-          mem_put_list(sv->local_storage->sp_coll, shead_exp);
-        }
         shead_exp = NULL;
       }
 
@@ -837,7 +884,7 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
             m, &displacement, sv, world->rx_radius_3d, world->x_fineparts,
             world->y_fineparts, world->z_fineparts, world->nx_parts,
             world->ny_parts, world->nz_parts, world->rx_hashsize,
-            world->reaction_hash);
+            world->reaction_hash, scratch);
 
         /* combine two collision lists */
         if (shead_exp != NULL) {
@@ -859,8 +906,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
       mcell_internal_error("ray_trace_trimol returned NULL.");
 
     if (shead2->next != NULL) {
-      shead2 = (struct sp_collision *)ae_list_sort(
-          (struct abstract_element *)shead2);
+      shead2 = (struct sp_collision *)sort_collisions(
+          scratch, (struct abstract_element *)shead2);
     }
 
     for (smash = shead2; smash != NULL; smash = smash->next) {
@@ -882,8 +929,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
       if (((smash->what & (COLLIDE_VOL | COLLIDE_VOL_VOL | COLLIDE_VOL_SURF)) !=
            0)) {
 
-        new_coll = (struct sp_collision *)CHECKED_MEM_GET(
-            sv->local_storage->sp_coll, "collision data");
+        new_coll = CHECKED_SCRATCH_GET(scratch, struct sp_collision,
+                                       "collision data");
         memcpy(new_coll, smash, sizeof(struct sp_collision));
 
         new_coll->t += new_coll->t_start;
@@ -891,8 +938,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
         main_shead2 = new_coll;
 
       } else if ((smash->what & COLLIDE_WALL) != 0) {
-        new_coll = (struct sp_collision *)CHECKED_MEM_GET(
-            sv->local_storage->sp_coll, "collision data");
+        new_coll = CHECKED_SCRATCH_GET(scratch, struct sp_collision,
+                                       "collision data");
         memcpy(new_coll, smash, sizeof(struct sp_collision));
 
         new_coll->t += new_coll->t_start;
@@ -1026,14 +1073,10 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
           m = migrate_volume_molecule(m, nsv);
         }
 
-        if (shead2 != NULL) {
-          mem_put_list(sv->local_storage->sp_coll, shead2);
-          shead2 = NULL;
-        }
-        if (shead != NULL) {
-          mem_put_list(sv->local_storage->sp_coll, shead);
-          shead = NULL;
-        }
+        /* shead and shead2 are left in the scratch arena, since they were
+           taken from it along with main_shead2 */
+        shead2 = NULL;
+        shead = NULL;
         calculate_displacement = 0;
 
         if (m->properties == NULL)
@@ -1044,20 +1087,10 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
       }
     } /* end for (smash ...) */
 
-    if (shead2 != NULL) {
-      mem_put_list(sv->local_storage->sp_coll, shead2);
-      shead2 = NULL;
-    }
+    shead2 = NULL;
   } while (smash != NULL);
 
-  if (shead2 != NULL) {
-    mem_put_list(sv->local_storage->sp_coll, shead2);
-    shead2 = NULL;
-  }
-  if (shead != NULL) {
-    mem_put_list(sv->local_storage->sp_coll, shead);
-    shead = NULL;
-  }
+  shead = NULL;
 
   for (smash = main_shead2; smash != NULL; smash = smash->next) {
     smash->t += smash->t_start;
@@ -1065,8 +1098,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
 
   if (main_shead2 != NULL) {
     if (main_shead2->next != NULL) {
-      main_shead2 = (struct sp_collision *)ae_list_sort(
-          (struct abstract_element *)main_shead2);
+      main_shead2 = (struct sp_collision *)sort_collisions(
+          scratch, (struct abstract_element *)main_shead2);
     }
   }
 
@@ -1085,8 +1118,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
 
         if (num_matching_rxns > 0) {
           for (i = 0; i < num_matching_rxns; i++) {
-            tri_smash = (struct tri_collision *)CHECKED_MEM_GET(
-                sv->local_storage->tri_coll, "tri_collision data");
+            tri_smash = CHECKED_SCRATCH_GET(
+                scratch, struct tri_collision, "tri_collision data");
             tri_smash->t = smash->t;
             tri_smash->target1 = (void *)mp;
             tri_smash->target2 = NULL;
@@ -1129,8 +1162,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
 
           if (num_matching_rxns > 0) {
             for (i = 0; i < num_matching_rxns; i++) {
-              tri_smash = (struct tri_collision *)CHECKED_MEM_GET(
-                  sv->local_storage->tri_coll, "collision data");
+              tri_smash = CHECKED_SCRATCH_GET(
+                  scratch, struct tri_collision, "collision data");
               tri_smash->loc = new_smash->loc;
               tri_smash->t = new_smash->t;
               tri_smash->target2 = (void *)new_mp;
@@ -1181,9 +1214,9 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
 
           if (w->grid != NULL) {
             j = xyz2grid(&(new_smash->loc), w->grid);
-            if (w->grid->sm_list[j] && w->grid->sm_list[j]->sm) {
+            if (tile_sm_list(w->grid, j) && tile_sm_list(w->grid, j)->sm) {
               if (m->index != j || m->previous_wall != w) {
-                sm = w->grid->sm_list[j]->sm;
+                sm = tile_sm_list(w->grid, j)->sm;
                 num_matching_rxns = trigger_trimolecular(
                     world->reaction_hash, world->rx_hashsize,
                     smash->moving->hashval, mp->properties->hashval,
@@ -1192,8 +1225,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
 
                 if (num_matching_rxns > 0) {
                   for (i = 0; i < num_matching_rxns; i++) {
-                    tri_smash = (struct tri_collision *)CHECKED_MEM_GET(
-                        sv->local_storage->tri_coll, "tri_collision data");
+                    tri_smash = CHECKED_SCRATCH_GET(
+                        scratch, struct tri_collision, "tri_collision data");
                     tri_smash->t = new_smash->t;
                     tri_smash->target1 = (void *)mp;
                     tri_smash->target2 = (void *)sm;
@@ -1249,9 +1282,9 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
          surface molecules */
       if (w->grid != NULL && (spec->flags & CAN_VOLSURF) != 0) {
         j = xyz2grid(&(smash->loc), w->grid);
-        if (w->grid->sm_list[j] && w->grid->sm_list[j]->sm) {
+        if (tile_sm_list(w->grid, j) && tile_sm_list(w->grid, j)->sm) {
           if (m->index != j || m->previous_wall != w) {
-            sm = w->grid->sm_list[j]->sm;
+            sm = tile_sm_list(w->grid, j)->sm;
             // look for bimolecular reactions between volume and surface mols
             num_matching_rxns = trigger_bimolecular(
                 world->reaction_hash, world->rx_hashsize, spec->hashval,
@@ -1259,8 +1292,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
                 (struct abstract_molecule *)sm, k, sm->orient, matching_rxns);
             if (num_matching_rxns > 0) {
               for (i = 0; i < num_matching_rxns; i++) {
-                tri_smash = (struct tri_collision *)CHECKED_MEM_GET(
-                    sv->local_storage->tri_coll, "collision data");
+                tri_smash = CHECKED_SCRATCH_GET(
+                    scratch, struct tri_collision, "collision data");
                 tri_smash->t = smash->t;
                 tri_smash->target1 = (void *)sm;
                 tri_smash->target2 = NULL;
@@ -1290,29 +1323,29 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
       if (moving_mol_grid_grid_flag) {
         if (w->grid != NULL) {
           j = xyz2grid(&(smash->loc), w->grid);
-          if (w->grid->sm_list[j] && w->grid->sm_list[j]->sm) {
-            sm = w->grid->sm_list[j]->sm;
+          if (tile_sm_list(w->grid, j) && tile_sm_list(w->grid, j)->sm) {
+            sm = tile_sm_list(w->grid, j)->sm;
             if (m->index != j || m->previous_wall != w) {
               /* search for neighbors that can participate
                 in 3-way reaction */
               struct surface_molecule *smp; /* Neighboring molecules */
-              struct tile_neighbor *tile_nbr_head = NULL, *curr;
-              int list_length = 0;
+              struct tile_nbr_list nbr_list;
 
               /* find neighbor molecules to react with */
-              find_neighbor_tiles(world, sm, sm->grid, sm->grid_index, 0, 1,
-                                  &tile_nbr_head, &list_length);
-              if (tile_nbr_head != NULL) {
+              get_tile_neighbors(world, sm, sm->grid, sm->grid_index, 0, 1,
+                                 &nbr_list);
+              if (nbr_list.n > 0) {
                 double local_prob_factor; /*local probability factor for the
                                              reaction */
-                local_prob_factor = 3.0 / list_length;
+                local_prob_factor = 3.0 / nbr_list.n;
 
                 /* step through the neighbors */
-                for (curr = tile_nbr_head; curr != NULL; curr = curr->next) {
-                  struct surface_molecule_list *sm_list = curr->grid->sm_list[curr->idx]; 
+                for (int nn = 0; nn < nbr_list.n; nn++) {
+                  struct tile_nbr *curr = &nbr_list.tiles[nn];
+                  struct surface_molecule_list *sm_list = tile_sm_list(curr->grid, curr->idx); 
                   if (sm_list == NULL || sm_list->sm == NULL)
                     continue;
-                  smp = curr->grid->sm_list[curr->idx]->sm;
+                  smp = tile_sm_list(curr->grid, curr->idx)->sm;
 
                   /* check whether any of potential partners
                 are behind restrictive (REFLECTIVE/ABSORPTIVE) boundary */
@@ -1341,8 +1374,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
                       matching_rxns);
                   if (num_matching_rxns > 0) {
                     for (i = 0; i < num_matching_rxns; i++) {
-                      tri_smash = (struct tri_collision *)CHECKED_MEM_GET(
-                          sv->local_storage->tri_coll, "collision data");
+                      tri_smash = CHECKED_SCRATCH_GET(
+                          scratch, struct tri_collision, "collision data");
                       tri_smash->t = smash->t;
                       tri_smash->target1 = (void *)sm;
                       tri_smash->target2 = (void *)smp;
@@ -1366,9 +1399,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
                     }
                   }
                 }
-                if (tile_nbr_head != NULL)
-                  delete_tile_neighbor_list(tile_nbr_head);
               }
+              release_tile_neighbors(&nbr_list);
             }
           }
         }
@@ -1386,8 +1418,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
 
         for (i = 0; i < num_matching_rxns; i++) {
           rx = matching_rxns[i];
-          tri_smash = (struct tri_collision *)CHECKED_MEM_GET(
-              sv->local_storage->tri_coll, "tri_collision data");
+          tri_smash = CHECKED_SCRATCH_GET(
+              scratch, struct tri_collision, "tri_collision data");
           tri_smash->t = smash->t;
           tri_smash->target1 = (void *)w;
           tri_smash->target2 = NULL;
@@ -1416,8 +1448,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
            (default wall behavior).
            We want to keep it in the "tri_smash"
            list just in order to account for the hits with it */
-        tri_smash = (struct tri_collision *)CHECKED_MEM_GET(
-            sv->local_storage->tri_coll, "tri_collision data");
+        tri_smash = CHECKED_SCRATCH_GET(
+            scratch, struct tri_collision, "tri_collision data");
         tri_smash->t = smash->t;
         tri_smash->target1 = (void *)w;
         tri_smash->target2 = NULL;
@@ -1442,7 +1474,8 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
 
   if (main_tri_shead != NULL) {
     if (main_tri_shead->next != NULL) {
-      main_tri_shead = (struct tri_collision *)ae_list_sort(
+      main_tri_shead = (struct tri_collision *)sort_collisions(
+          scratch,
           (struct abstract_element *)main_tri_shead);
     }
   }
@@ -1457,19 +1490,19 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
     if (world->notify->molecule_collision_report == NOTIFY_FULL) {
       if (((tri_smash->what & COLLIDE_VOL) != 0) &&
           (world->rxn_flags.vol_vol_reaction_flag)) {
-        world->vol_vol_colls++;
+        local_stats(world)->vol_vol_colls++;
       } else if (((tri_smash->what & COLLIDE_SURF) != 0) &&
                  (world->rxn_flags.vol_surf_reaction_flag)) {
-        world->vol_surf_colls++;
+        local_stats(world)->vol_surf_colls++;
       } else if (((tri_smash->what & COLLIDE_VOL_VOL) != 0) &&
                  (world->rxn_flags.vol_vol_vol_reaction_flag)) {
-        world->vol_vol_vol_colls++;
+        local_stats(world)->vol_vol_vol_colls++;
       } else if (((tri_smash->what & COLLIDE_VOL_SURF) != 0) &&
                  (world->rxn_flags.vol_vol_surf_reaction_flag)) {
-        world->vol_vol_surf_colls++;
+        local_stats(world)->vol_vol_surf_colls++;
       } else if (((tri_smash->what & COLLIDE_SURF_SURF) != 0) &&
                  (world->rxn_flags.vol_surf_surf_reaction_flag)) {
-        world->vol_surf_surf_colls++;
+        local_stats(world)->vol_surf_surf_colls++;
       }
     }
 
@@ -1507,7 +1540,7 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
       /* XXX: Change required here to support macromol+trimol */
       i = test_bimolecular(rx, tri_smash->factor, tri_smash->local_prob_factor,
                            NULL, NULL,
-                           world->rng);
+                           local_rng(world));
 
       if (i < RX_LEAST_VALID_PATHWAY)
         continue;
@@ -1593,11 +1626,11 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
           if ((rx->n_pathways > RX_SPECIAL) &&
               (world->notify->molecule_collision_report == NOTIFY_FULL)) {
             if (world->rxn_flags.vol_wall_reaction_flag)
-              world->vol_wall_colls++;
+              local_stats(world)->vol_wall_colls++;
           }
 
           if (rx->n_pathways == RX_TRANSP) {
-            rx->n_occurred++;
+            THREADED_ADD(rx->n_occurred, 1);
             if ((m->flags & COUNT_ME) != 0 &&
                 (spec->flags & COUNT_SOME_MASK) != 0) {
               /* Count as far up as we can unambiguously */
@@ -1619,7 +1652,7 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
           } else if (rx->n_pathways != RX_REFLEC) {
             if (rx->prob_t != NULL)
               update_probs(world, rx, m->t);
-            i = test_intersect(rx, r_rate_factor, world->rng);
+            i = test_intersect(rx, r_rate_factor, local_rng(world));
             if (i > RX_NO_RX) {
               /* Save m flags in case it gets collected in outcome_intersect */
               int mflags = m->flags;
@@ -1721,10 +1754,7 @@ pretend_to_call_diffuse_3D_big_list: /* Label to allow fake recursion */
   m->index = -1;
   m->previous_wall = NULL;
 
-  if (main_tri_shead != NULL)
-    mem_put_list(sv->local_storage->tri_coll, main_tri_shead);
-  if (main_shead2 != NULL)
-    mem_put_list(sv->local_storage->sp_coll, main_shead2);
+  scratch_release(scratch, step_mark);
 
   return m;
 }
@@ -1759,9 +1789,8 @@ struct surface_molecule *react_2D_trimol_all_neighbors(
   struct rxn *matching_rxns[MAX_MATCHING_RXNS];
 
   /* linked lists of the tile neighbors (first and second level) */
-  struct tile_neighbor *tile_nbr_head_f = NULL, *tile_nbr_head_s = NULL,
-                       *curr_f, *curr_s;
-  int list_length_f, list_length_s; /* length of the linked lists above */
+  struct tile_nbr_list nbr_list_f, nbr_list_s;
+  struct tile_nbr *curr_f, *curr_s;
 
   int max_size = 12 * 12 * MAX_MATCHING_RXNS; /* reasonable assumption */
   struct rxn *rxn_array[max_size]; /* array of reaction objects with neighbor
@@ -1784,20 +1813,22 @@ struct surface_molecule *react_2D_trimol_all_neighbors(
   }
 
   /* find first level neighbor molecules to react with */
-  find_neighbor_tiles(world, sm, sm->grid, sm->grid_index, 0, 1,
-                      &tile_nbr_head_f, &list_length_f);
+  get_tile_neighbors(world, sm, sm->grid, sm->grid_index, 0, 1, &nbr_list_f);
 
-  if (tile_nbr_head_f == NULL)
+  if (nbr_list_f.n == 0) {
+    release_tile_neighbors(&nbr_list_f);
     return sm;
+  }
 
   /* Calculate local_prob_factor for the reaction probability.
      Here we convert from 3 neighbor tiles (upper probability
      limit) to the real number of neighbor tiles. */
-  local_prob_factor_f = 1.0 / list_length_f;
+  local_prob_factor_f = 1.0 / nbr_list_f.n;
 
   /* step through the neighbors */
-  for (curr_f = tile_nbr_head_f; curr_f != NULL; curr_f = curr_f->next) {
-    struct surface_molecule_list *sm_list = curr_f->grid->sm_list[curr_f->idx]; 
+  for (curr_f = nbr_list_f.tiles; curr_f != nbr_list_f.tiles + nbr_list_f.n;
+       curr_f++) {
+    struct surface_molecule_list *sm_list = tile_sm_list(curr_f->grid, curr_f->idx); 
     if (sm_list == NULL || sm_list->sm == NULL)
       continue;
     gm_f = sm_list->sm;
@@ -1819,19 +1850,22 @@ struct surface_molecule *react_2D_trimol_all_neighbors(
     }
 
     /* find nearest neighbor molecules to react with (2nd level) */
-    find_neighbor_tiles(world, gm_f, gm_f->grid, gm_f->grid_index, 0, 1,
-                        &tile_nbr_head_s, &list_length_s);
+    get_tile_neighbors(world, gm_f, gm_f->grid, gm_f->grid_index, 0, 1,
+                       &nbr_list_s);
 
-    if (tile_nbr_head_s == NULL)
+    if (nbr_list_s.n == 0) {
+      release_tile_neighbors(&nbr_list_s);
       continue;
+    }
 
-    local_prob_factor_s = 1.0 / (list_length_s - 1);
+    local_prob_factor_s = 1.0 / (nbr_list_s.n - 1);
 
-    for (curr_s = tile_nbr_head_s; curr_s != NULL; curr_s = curr_s->next) {
-      sm_list = curr_s->grid->sm_list[curr_s->idx]; 
+    for (curr_s = nbr_list_s.tiles; curr_s != nbr_list_s.tiles + nbr_list_s.n;
+         curr_s++) {
+      sm_list = tile_sm_list(curr_s->grid, curr_s->idx); 
       if (sm_list == NULL || sm_list->sm == NULL)
         continue;
-      gm_s = curr_s->grid->sm_list[curr_s->idx]->sm;
+      gm_s = tile_sm_list(curr_s->grid, curr_s->idx)->sm;
       if (gm_s == NULL)
         continue;
       if (gm_s == gm_f)
@@ -1895,12 +1929,10 @@ struct surface_molecule *react_2D_trimol_all_neighbors(
         n += num_matching_rxns;
       }
     }
-    if (tile_nbr_head_s != NULL)
-      delete_tile_neighbor_list(tile_nbr_head_s);
+    release_tile_neighbors(&nbr_list_s);
   }
 
-  if (tile_nbr_head_f != NULL)
-    delete_tile_neighbor_list(tile_nbr_head_f);
+  release_tile_neighbors(&nbr_list_f);
 
   if (n > max_size)
     mcell_internal_error("The size of the reactions array in the function "
@@ -1911,13 +1943,13 @@ struct surface_molecule *react_2D_trimol_all_neighbors(
     return sm; /* Nobody to react with */
   } else if (n == 1) {
     /* XXX: Change required here to support macromol+trimol */
-    i = test_bimolecular(rxn_array[0], cf[0], local_prob_factor[0], NULL, NULL, world->rng);
+    i = test_bimolecular(rxn_array[0], cf[0], local_prob_factor[0], NULL, NULL, local_rng(world));
     j = 0;
   } else {
     /* XXX: Change required here to support macromol+trimol */
 
     j = test_many_reactions_all_neighbors(rxn_array, cf, local_prob_factor, n,
-                                          &(i), world->rng);
+                                          &(i), local_rng(world));
   }
 
   if ((j == RX_NO_RX) || (i < RX_LEAST_VALID_PATHWAY)) {
@@ -1932,7 +1964,7 @@ struct surface_molecule *react_2D_trimol_all_neighbors(
       first_partner[j]->orient, second_partner[j]->orient, sm->t, NULL, NULL);
 
   if (k == RX_DESTROY) {
-    mem_put(sm->birthplace, sm);
+    mem_put(mem_birthplace(sm), sm);
     return NULL;
   }
 
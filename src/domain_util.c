@@ -0,0 +1,1560 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2006-2017 by
+ * The Salk Institute for Biological Studies and
+ * Pittsburgh Supercomputing Center, Carnegie Mellon University
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ *
+******************************************************************************/
+
+/**************************************************************************\
+ ** File: domain_util.c                                                  **
+ **                                                                      **
+ ** Purpose: Runs a simulation on several processes.  The columns of     **
+ **   memory partitions (storages) along x are split into slabs, one     **
+ **   per process, and every molecule lives on the process owning its    **
+ **   slab.  Steps that might reach into a neighboring slab are deferred **
+ **   as in threaded runs and stepped in face passes, during which the   **
+ **   columns next to a face are lent to the process on its lower side.  **
+ **                                                                      **
+ **   Message passing is confined to the few primitives at the top of    **
+ **   this file; without MCELL_MPI a run always has a single process.    **
+\**************************************************************************/
+
+#include "config.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MCELL_MPI
+#include <mpi.h>
+#endif
+
+#include "logging.h"
+#include "mcell_structs.h"
+#include "mem_util.h"
+#include "sched_util.h"
+#include "vol_util.h"
+#include "count_util.h"
+#include "grid_util.h"
+#include "diffuse.h"
+#include "init.h"
+#include "thread_util.h"
+#include "domain_util.h"
+
+/* A molecule on its way to another process */
+struct domain_molecule {
+  struct vector3 pos;   /* Volume molecules only */
+  struct vector2 s_pos; /* Surface molecules only, on their wall */
+  double t;
+  double t2;
+  double birthday;
+  u_long id;
+  int species;
+  int index;               /* Volume molecules only */
+  int wall;                /* Surface molecules: index (see wall_index),
+                              or -1 for volume molecules */
+  unsigned int grid_index; /* Surface molecules only */
+  short orient;            /* Surface molecules only */
+  short flags;
+};
+
+/* A polygon object, and the index of its first wall among the walls of all
+   objects */
+struct domain_object {
+  struct object *obj;
+  int first_wall;
+};
+
+/* A trigger event on its way to the first process */
+struct domain_trigger {
+  double t_event;
+  struct vector3 loc;
+  u_long id;
+  int store;   /* Index of the storage whose events it belongs to */
+  int counter; /* Index of the counter that fired */
+  int ear;     /* Position of the listener among the counter's listeners */
+  int n;
+  short orient;
+  short flags;
+};
+
+/* Growable array of molecules to send */
+struct molecule_buffer {
+  struct domain_molecule *mols;
+  int n;
+  int max;
+};
+
+static void drop_foreign_molecules(struct volume *world);
+
+/**************************************************************************
+ * Message passing primitives
+ **************************************************************************/
+
+#ifdef MCELL_MPI
+static MPI_Datatype molecule_type;
+static MPI_Datatype trigger_type;
+static int finalized = 0;
+
+/*************************************************************************
+abort_unfinished_run:
+  In: No arguments.
+  Out: No return value.  Registered with atexit: if this process exits
+       without finishing the run (for instance after an error), the other
+       processes are taken down as well instead of waiting for it forever.
+*************************************************************************/
+static void abort_unfinished_run(void) {
+  int running = 0;
+  MPI_Initialized(&running);
+  if (running && !finalized)
+    MPI_Abort(MPI_COMM_WORLD, 1);
+}
+#endif
+
+/*************************************************************************
+sum_doubles, sum_longs, max_longs:
+  In: v: values of this process
+      n: number of values
+  Out: No return value.  v holds the sums (or maxima) over all processes.
+*************************************************************************/
+static void sum_doubles(double *v, int n) {
+#ifdef MCELL_MPI
+  MPI_Allreduce(MPI_IN_PLACE, v, n, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+#endif
+}
+
+static void sum_longs(long long *v, int n) {
+#ifdef MCELL_MPI
+  MPI_Allreduce(MPI_IN_PLACE, v, n, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+#endif
+}
+
+static void max_longs(long long *v, int n) {
+#ifdef MCELL_MPI
+  MPI_Allreduce(MPI_IN_PLACE, v, n, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+#endif
+}
+
+/*************************************************************************
+send_molecules:
+  In: to: process to send to
+      buf: the molecules
+  Out: No return value.  Blocks until the molecules are on their way.
+*************************************************************************/
+static void send_molecules(int to, struct molecule_buffer *buf) {
+#ifdef MCELL_MPI
+  MPI_Send(buf->mols, buf->n, molecule_type, to, 0, MPI_COMM_WORLD);
+#else
+  mcell_internal_error("Cannot send molecules to process %d.", to);
+#endif
+}
+
+/*************************************************************************
+receive_molecules:
+  In: from: process to receive from
+      buf: buffer to receive into, grown as needed
+  Out: No return value.  buf holds the molecules sent by the process.
+*************************************************************************/
+static void receive_molecules(int from, struct molecule_buffer *buf) {
+#ifdef MCELL_MPI
+  MPI_Status status;
+  int n;
+  MPI_Probe(from, 0, MPI_COMM_WORLD, &status);
+  MPI_Get_count(&status, molecule_type, &n);
+  if (n > buf->max) {
+    free(buf->mols);
+    buf->max = n;
+    buf->mols = CHECKED_MALLOC_ARRAY(struct domain_molecule, n,
+                                     "molecules received");
+  }
+  MPI_Recv(buf->mols, n, molecule_type, from, 0, MPI_COMM_WORLD,
+           MPI_STATUS_IGNORE);
+  buf->n = n;
+#else
+  mcell_internal_error("Cannot receive molecules from process %d.", from);
+#endif
+}
+
+/*************************************************************************
+exchange_molecules:
+  In: out: molecules for each process (the entry of this process is empty)
+      n_ranks: number of processes
+      in: buffer to receive into
+  Out: No return value.  in holds the molecules every other process had
+       for this one.
+*************************************************************************/
+static void exchange_molecules(struct molecule_buffer *out, int n_ranks,
+                               struct molecule_buffer *in) {
+#ifdef MCELL_MPI
+  int n_out[n_ranks], n_in[n_ranks], at_out[n_ranks], at_in[n_ranks];
+  int total_out = 0, total_in = 0;
+  for (int r = 0; r < n_ranks; r++) {
+    n_out[r] = out[r].n;
+    at_out[r] = total_out;
+    total_out += out[r].n;
+  }
+  MPI_Alltoall(n_out, 1, MPI_INT, n_in, 1, MPI_INT, MPI_COMM_WORLD);
+  for (int r = 0; r < n_ranks; r++) {
+    at_in[r] = total_in;
+    total_in += n_in[r];
+  }
+
+  struct domain_molecule *send = CHECKED_MALLOC_ARRAY(
+      struct domain_molecule, total_out + 1, "molecules to send");
+  for (int r = 0; r < n_ranks; r++) {
+    if (out[r].n > 0)
+      memcpy(send + at_out[r], out[r].mols,
+             out[r].n * sizeof(struct domain_molecule));
+  }
+  if (total_in > in->max) {
+    free(in->mols);
+    in->max = total_in;
+    in->mols = CHECKED_MALLOC_ARRAY(struct domain_molecule, total_in,
+                                    "molecules received");
+  }
+  MPI_Alltoallv(send, n_out, at_out, molecule_type, in->mols, n_in, at_in,
+                molecule_type, MPI_COMM_WORLD);
+  in->n = total_in;
+  free(send);
+#else
+  in->n = 0;
+#endif
+}
+
+/*************************************************************************
+gather_triggers:
+  In: mine: trigger events of this process
+      n: number of events
+      n_all: set to the number of events gathered
+  Out: On the first process, the events of all other processes (which
+       send theirs), or NULL if there are none.  NULL on other processes.
+*************************************************************************/
+static struct domain_trigger *gather_triggers(struct domain_trigger *mine,
+                                              int n, int *n_all) {
+  *n_all = 0;
+#ifdef MCELL_MPI
+  int rank, n_ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &n_ranks);
+  int counts[n_ranks], at[n_ranks];
+  MPI_Gather(&n, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  struct domain_trigger *all = NULL;
+  if (rank == 0) {
+    for (int r = 0; r < n_ranks; r++) {
+      at[r] = *n_all;
+      *n_all += counts[r];
+    }
+    if (*n_all == 0)
+      return NULL;
+    all = CHECKED_MALLOC_ARRAY(struct domain_trigger, *n_all,
+                               "gathered trigger events");
+  } else if (n == 0)
+    return NULL;
+  else {
+    MPI_Send(mine, n, trigger_type, 0, 1, MPI_COMM_WORLD);
+    return NULL;
+  }
+
+  for (int r = 1; r < n_ranks; r++) {
+    if (counts[r] > 0)
+      MPI_Recv(all + at[r], counts[r], trigger_type, r, 1, MPI_COMM_WORLD,
+               MPI_STATUS_IGNORE);
+  }
+  return all;
+#else
+  return NULL;
+#endif
+}
+
+/*************************************************************************
+domain_startup:
+  In: argc, argv: command line
+      world: simulation state
+  Out: No return value.  Message passing is started if MCell was built for
+       it, and the rank and number of processes are recorded.  Only the
+       first process writes the log.
+*************************************************************************/
+void domain_startup(int *argc, char ***argv, struct volume *world) {
+  world->procnum = 0;
+  world->n_procs = 1;
+#ifdef MCELL_MPI
+  int provided;
+  if (MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided) !=
+      MPI_SUCCESS)
+    mcell_error("Failed to start MPI.");
+  atexit(abort_unfinished_run);
+  if (provided < MPI_THREAD_FUNNELED)
+    mcell_error("The MPI library does not allow worker threads.");
+  MPI_Comm_rank(MPI_COMM_WORLD, &world->procnum);
+  MPI_Comm_size(MPI_COMM_WORLD, &world->n_procs);
+
+  MPI_Type_contiguous(sizeof(struct domain_molecule), MPI_BYTE,
+                      &molecule_type);
+  MPI_Type_commit(&molecule_type);
+  MPI_Type_contiguous(sizeof(struct domain_trigger), MPI_BYTE, &trigger_type);
+  MPI_Type_commit(&trigger_type);
+
+  if (world->procnum != 0) {
+    FILE *quiet = fopen("/dev/null", "w");
+    if (quiet != NULL)
+      mcell_set_log_file(quiet);
+  }
+#endif
+}
+
+/*************************************************************************
+domain_shutdown:
+  In: No arguments.
+  Out: No return value.  Message passing is shut down once every process
+       has finished the run.
+*************************************************************************/
+void domain_shutdown(void) {
+#ifdef MCELL_MPI
+  MPI_Type_free(&molecule_type);
+  MPI_Type_free(&trigger_type);
+  MPI_Finalize();
+  finalized = 1;
+#endif
+}
+
+/**************************************************************************
+ * Setup
+ **************************************************************************/
+
+/*************************************************************************
+reject_feature:
+  In: what: a feature of the model that distributed runs do not support
+  Out: Does not return.
+*************************************************************************/
+static void reject_feature(char const *what) {
+  mcell_error("Runs distributed over several processes do not support %s.  "
+              "They run volume and surface molecules, without visualization "
+              "output, checkpoints, volume output, concentration clamps, "
+              "periodic boundary conditions, dynamic geometry, surface "
+              "reversibility or releases triggered by reactions.  Please run "
+              "this model with a single process.",
+              what);
+}
+
+/*************************************************************************
+check_model:
+  In: world: simulation state
+  Out: No return value.  Fails for models using features whose data is
+       not distributed along with the molecules.
+*************************************************************************/
+static void check_model(struct volume *world) {
+  if (world->periodic_box_obj != NULL)
+    reject_feature("periodic boundary conditions");
+  if (world->dynamic_geometry_head != NULL ||
+      world->dynamic_geometry_filename != NULL)
+    reject_feature("dynamic geometry");
+  if (world->viz_blocks != NULL)
+    reject_feature("visualization output");
+  if (world->volume_output_head != NULL)
+    reject_feature("volume output");
+  if (world->clamp_list != NULL)
+    reject_feature("concentration clamps");
+  if (world->chkpt_infile != NULL || world->chkpt_iterations != 0)
+    reject_feature("checkpoints");
+  if (world->surface_reversibility)
+    reject_feature("surface reversibility");
+
+  for (int i = 0; i < world->rx_hashsize; i++) {
+    for (struct rxn *rx = world->reaction_hash[i]; rx != NULL; rx = rx->next) {
+      for (int j = 0; j < rx->n_pathways; j++) {
+        if (rx->info[j].pathname != NULL &&
+            rx->info[j].pathname->magic != NULL)
+          reject_feature("releases triggered by reactions");
+      }
+    }
+  }
+}
+
+/*************************************************************************
+column_x:
+  In: world: simulation state
+      dom: the domain
+      c: a column of storages, 0 to n_columns
+  Out: The x coordinate where column c starts, open towards the edges of
+       the world as for the reach boxes of storages.
+*************************************************************************/
+static double column_x(struct volume *world, struct domain *dom, int c) {
+  if (c <= 0)
+    return -GIGANTIC;
+  if (c >= dom->n_columns)
+    return GIGANTIC;
+  return world->x_partitions[c * world->mem_part_x];
+}
+
+/*************************************************************************
+list_objects:
+  In: dom: the domain, with room in objects for every polygon object
+      obj: an object
+      n_walls: number of walls of the objects listed so far
+  Out: No return value.  The polygon objects in the tree below obj are
+       appended to the objects of the domain, in the order in which
+       distribute_object visits them.
+*************************************************************************/
+static void list_objects(struct domain *dom, struct object *obj,
+                         int *n_walls) {
+  if (obj->object_type == BOX_OBJ || obj->object_type == POLY_OBJ) {
+    if (dom->objects != NULL) {
+      dom->objects[dom->n_objects].obj = obj;
+      dom->objects[dom->n_objects].first_wall = *n_walls;
+    }
+    dom->n_objects++;
+    *n_walls += obj->n_walls;
+  } else if (obj->object_type == META_OBJ) {
+    for (struct object *o = obj->first_child; o != NULL; o = o->next)
+      list_objects(dom, o, n_walls);
+  }
+}
+
+static int compare_object_address(void const *a, void const *b) {
+  uintptr_t oa = (uintptr_t)((struct domain_object const *)a)->obj;
+  uintptr_t ob = (uintptr_t)((struct domain_object const *)b)->obj;
+  return (oa > ob) - (oa < ob);
+}
+
+/*************************************************************************
+index_walls:
+  In: world: simulation state
+      dom: the domain
+  Out: No return value.  The polygon objects are listed so that walls can
+       be referred to by an index that is the same on every process.
+*************************************************************************/
+static void index_walls(struct volume *world, struct domain *dom) {
+  int n_walls = 0;
+  for (struct object *o = world->root_instance; o != NULL; o = o->next)
+    list_objects(dom, o, &n_walls);
+
+  dom->objects = CHECKED_MALLOC_ARRAY(struct domain_object, dom->n_objects + 1,
+                                      "objects by position");
+  dom->by_address = CHECKED_MALLOC_ARRAY(
+      struct domain_object, dom->n_objects + 1, "objects by address");
+  dom->n_objects = 0;
+  n_walls = 0;
+  for (struct object *o = world->root_instance; o != NULL; o = o->next)
+    list_objects(dom, o, &n_walls);
+
+  memcpy(dom->by_address, dom->objects,
+         dom->n_objects * sizeof(struct domain_object));
+  qsort(dom->by_address, dom->n_objects, sizeof(struct domain_object),
+        compare_object_address);
+}
+
+/*************************************************************************
+wall_index:
+  In: dom: the domain
+      w: a wall
+  Out: The index of the wall, the same on every process.
+*************************************************************************/
+static int wall_index(struct domain *dom, struct wall *w) {
+  struct domain_object key = { w->parent_object, 0 };
+  struct domain_object *o = (struct domain_object *)bsearch(
+      &key, dom->by_address, dom->n_objects, sizeof(struct domain_object),
+      compare_object_address);
+  if (o == NULL)
+    mcell_internal_error("Wall of an unknown object in a distributed run.");
+  return o->first_wall + w->side;
+}
+
+/*************************************************************************
+wall_by_index:
+  In: dom: the domain
+      index: index of a wall, as given by wall_index
+  Out: The wall.
+*************************************************************************/
+static struct wall *wall_by_index(struct domain *dom, int index) {
+  int lo = 0, hi = dom->n_objects - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (dom->objects[mid].first_wall <= index)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  struct domain_object *o = &dom->objects[lo];
+  if (index < o->first_wall || index - o->first_wall >= o->obj->n_walls ||
+      o->obj->wall_p[index - o->first_wall] == NULL)
+    mcell_internal_error("Molecule received on unknown wall %d.", index);
+  return o->obj->wall_p[index - o->first_wall];
+}
+
+/*************************************************************************
+long_step:
+  In: world: simulation state, with the step length tables set up
+  Out: The length of a long (99th percentile) step of the fastest species,
+       as used to decide whether multiple steps are worthwhile.
+*************************************************************************/
+static double long_step(struct volume *world) {
+  if (world->r_step == NULL)
+    return 0.0;
+
+  double max_step = 0.0;
+  for (int i = 0; i < world->n_species; i++) {
+    if (world->species_list[i]->space_step > max_step)
+      max_step = world->species_list[i]->space_step;
+  }
+  return max_step *
+      world->r_step[(int)(world->radial_subdivisions * MULTISTEP_PERCENTILE)];
+}
+
+/*************************************************************************
+domain_init:
+  In: world: simulation state, with storages, streams and thread pool set up
+  Out: No return value.  In a run on several processes the columns of
+       storages are split into slabs, the reach boxes of owned storages are
+       clipped to the slab, and random number streams and molecule ids are
+       made distinct across processes.  The molecules placed while
+       initializing are kept only by the process owning them.  Nothing is
+       done for a single process.
+  Note: The first process keeps the streams of a threaded run.  Ids are
+        interleaved as in init_storage_streams, with one block of counters
+        per process.
+*************************************************************************/
+void domain_init(struct volume *world) {
+  if (world->n_procs <= 1)
+    return;
+  check_model(world);
+
+  struct domain *dom = CHECKED_MALLOC_STRUCT(struct domain, "domain");
+  memset(dom, 0, sizeof(struct domain));
+  dom->n_ranks = world->n_procs;
+  dom->rank = world->procnum;
+
+  int nx = (world->nx_parts + world->mem_part_x - 2) / world->mem_part_x;
+  int ny = (world->ny_parts + world->mem_part_y - 2) / world->mem_part_y;
+  int nz = (world->nz_parts + world->mem_part_z - 2) / world->mem_part_z;
+  dom->n_columns = nx;
+  dom->n_stores = nx * ny * nz;
+  if (world->n_storage_streams != dom->n_stores)
+    mcell_internal_error("Distributed run without a stream per storage.");
+
+  /* Lent columns must hold a long step that reaches across the face, and
+   * what the step may touch, on both sides of the face.  Rarer, longer
+   * steps stay deferred until domain_run_faces lends more columns. */
+  double width = 2.0 * (world->thread_pool->margin + long_step(world));
+  dom->band = storage_reach_count(world->x_partitions, world->nx_parts,
+                                  world->mem_part_x, nx, width);
+  dom->lend = dom->band;
+
+  dom->first_column =
+      CHECKED_MALLOC_ARRAY(int, dom->n_ranks + 1, "columns per process");
+  for (int r = 0; r <= dom->n_ranks; r++)
+    dom->first_column[r] = (int)((long long)r * nx / dom->n_ranks);
+  for (int r = 0; r < dom->n_ranks; r++) {
+    if (dom->first_column[r + 1] - dom->first_column[r] < dom->band)
+      mcell_error("Too many processes for this model: each of the %d "
+                  "processes needs at least %d of the %d columns of memory "
+                  "partitions along x.  Please use fewer processes or "
+                  "smaller memory partitions.",
+                  dom->n_ranks, dom->band, nx);
+  }
+
+  dom->slab_llf.x = column_x(world, dom, dom->first_column[dom->rank]);
+  dom->slab_urb.x = column_x(world, dom, dom->first_column[dom->rank + 1]);
+  dom->slab_llf.y = dom->slab_llf.z = -GIGANTIC;
+  dom->slab_urb.y = dom->slab_urb.z = GIGANTIC;
+
+  dom->stores = CHECKED_MALLOC_ARRAY(struct storage *, dom->n_stores,
+                                     "storages by index");
+  dom->owned = CHECKED_MALLOC_ARRAY(char, dom->n_stores, "owned storages");
+  for (struct storage_list *l = world->storage_head; l != NULL; l = l->next) {
+    struct storage *store = l->store;
+    int c = store->index % nx;
+    dom->stores[store->index] = store;
+    dom->owned[store->index] = (c >= dom->first_column[dom->rank] &&
+                                c < dom->first_column[dom->rank + 1]);
+    if (dom->owned[store->index]) {
+      if (store->reach_llf.x < dom->slab_llf.x)
+        store->reach_llf.x = dom->slab_llf.x;
+      if (store->reach_urb.x > dom->slab_urb.x)
+        store->reach_urb.x = dom->slab_urb.x;
+    }
+  }
+
+  /* Streams and ids of the other processes follow those of the first */
+  int n_stores = dom->n_stores;
+  if (dom->rank > 0) {
+    for (int i = 0; i < n_stores; i++)
+      rng_init_stream(&world->storage_streams[i].rng, world->seed_seq,
+                      world->n_streams_seeded + (dom->rank - 1) * n_stores +
+                          i + 1);
+  }
+  world->n_streams_seeded += (dom->n_ranks - 1) * n_stores;
+
+  u_long block = n_stores + 1;
+  u_long base = world->current_mol_id + dom->rank * block;
+  world->mol_id_stride = block * dom->n_ranks;
+  world->current_mol_id = base;
+  for (int i = 0; i < n_stores; i++)
+    world->storage_streams[i].next_mol_id = base + i + 1;
+
+  index_walls(world, dom);
+  world->domain = dom;
+  drop_foreign_molecules(world);
+  if (world->notify->progress_report != NOTIFY_NONE)
+    mcell_log("Distributing %d columns of memory partitions over %d "
+              "processes (%d columns lent across faces).",
+              nx, dom->n_ranks, dom->band);
+
+#ifdef MCELL_MPI
+  /* Output files were opened by every process while parsing; make sure
+   * that is over before the first process writes to them */
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif
+}
+
+/**************************************************************************
+ * Moving molecules between processes
+ **************************************************************************/
+
+/*************************************************************************
+buffer_slot:
+  In: buf: buffer of molecules to send
+  Out: A new molecule at the end of the buffer, cleared.
+*************************************************************************/
+static struct domain_molecule *buffer_slot(struct molecule_buffer *buf) {
+  if (buf->n == buf->max) {
+    buf->max = (buf->max > 0) ? 2 * buf->max : 256;
+    struct domain_molecule *mols = CHECKED_MALLOC_ARRAY(
+        struct domain_molecule, buf->max, "molecules to send");
+    if (buf->n > 0)
+      memcpy(mols, buf->mols, buf->n * sizeof(struct domain_molecule));
+    free(buf->mols);
+    buf->mols = mols;
+  }
+
+  struct domain_molecule *m = &buf->mols[buf->n++];
+  memset(m, 0, sizeof(struct domain_molecule));
+  return m;
+}
+
+/*************************************************************************
+pack_molecule:
+  In: buf: buffer of molecules to send
+      vm: the molecule
+  Out: No return value.  The molecule is appended to the buffer.
+*************************************************************************/
+static void pack_molecule(struct molecule_buffer *buf,
+                          struct volume_molecule *vm) {
+  struct domain_molecule *m = buffer_slot(buf);
+  m->pos = vm->pos;
+  m->t = vm->t;
+  m->t2 = vm->t2;
+  m->birthday = vm->birthday;
+  m->id = vm->id;
+  m->species = vm->properties->species_id;
+  m->index = vm->index;
+  m->wall = -1;
+  m->flags = vm->flags & ~IN_MASK;
+}
+
+/*************************************************************************
+pack_surface_molecule:
+  In: dom: the domain
+      buf: buffer of molecules to send
+      sm: the molecule
+  Out: No return value.  The molecule is appended to the buffer.
+*************************************************************************/
+static void pack_surface_molecule(struct domain *dom,
+                                  struct molecule_buffer *buf,
+                                  struct surface_molecule *sm) {
+  struct domain_molecule *m = buffer_slot(buf);
+  m->s_pos = sm->s_pos;
+  m->t = sm->t;
+  m->t2 = sm->t2;
+  m->birthday = sm->birthday;
+  m->id = sm->id;
+  m->species = sm->properties->species_id;
+  m->wall = wall_index(dom, sm->grid->surface);
+  m->grid_index = sm->grid_index;
+  m->orient = sm->orient;
+  /* Whether it is on the tile list is kept, as it decides how it is freed */
+  m->flags = sm->flags & ~(IN_SCHEDULE | IN_VOLUME);
+}
+
+/*************************************************************************
+evict_surface_molecules:
+  In: world: simulation state
+      sv: a subvolume
+      buf: buffer of molecules to send
+      uncount: whether to take the molecules out of the region counts
+  Out: No return value.  Every surface molecule within the subvolume is
+       appended to the buffer and taken off its tile.
+*************************************************************************/
+static void evict_surface_molecules(struct volume *world,
+                                    struct subvolume *sv,
+                                    struct molecule_buffer *buf,
+                                    int uncount) {
+  struct schedule_helper *timer = sv->local_storage->timer;
+  for (struct wall_list *wl = sv->wall_head; wl != NULL; wl = wl->next) {
+    struct surface_grid *g = wl->this_wall->grid;
+    if (g == NULL || g->n_occupied == 0)
+      continue;
+
+    for (u_int word = 0; word < TILE_OCCUPANCY_WORDS(g->n_tiles); word++) {
+      unsigned long long bits = g->occupancy[word];
+      for (; bits != 0; bits &= bits - 1) {
+        u_int idx = (word << 6) + __builtin_ctzll(bits);
+        struct surface_molecule_list *sml = tile_sm_list(g, idx);
+        while (sml != NULL) {
+          struct surface_molecule *sm = sml->sm;
+          sml = sml->next;
+          if (sm == NULL || sm->properties == NULL)
+            continue;
+
+          /* Molecules belong to the storage their position is in, as in
+           * reschedule_surface_molecules */
+          struct vector3 pos;
+          uv2xyz(&sm->s_pos, g->surface, &pos);
+          if (find_subvolume(world, &pos, sv) != sv)
+            continue;
+
+          pack_surface_molecule(world->domain, buf, sm);
+          if (uncount &&
+              (sm->properties->flags & (COUNT_CONTENTS | COUNT_ENCLOSED)))
+            count_region_from_scratch(world, (struct abstract_molecule *)sm,
+                                      NULL, -1, NULL, g->surface, sm->t,
+                                      &sm->periodic_box);
+          remove_surfmol_from_list(tile_sm_slot(g, idx), sm);
+          update_tile_occupancy(g, idx);
+          g->n_occupied--;
+          sm->properties->population--;
+          if ((sm->flags & IN_SCHEDULE) && timer != NULL)
+            timer->defunct_count++;
+          sm->properties = NULL;
+          sm->flags &= ~IN_SURFACE;
+          if ((sm->flags & IN_MASK) == 0)
+            mem_put(mem_birthplace(sm), sm);
+        }
+      }
+    }
+  }
+}
+
+/*************************************************************************
+evict_storage:
+  In: world: simulation state
+      store: a storage
+      buf: buffer of molecules to send
+      uncount: whether to take the molecules out of the region counts
+  Out: No return value.  Every molecule of the storage, volume molecules
+       first, is appended to the buffer and removed.  Deferred steps stay
+       deferred.
+*************************************************************************/
+static void evict_storage(struct volume *world, struct storage *store,
+                          struct molecule_buffer *buf, int uncount) {
+  struct schedule_helper *timer = store->timer;
+
+  /* Molecules due in the current time slot leave the scheduler now */
+  while (timer != NULL && timer->current != NULL) {
+    struct abstract_molecule *am =
+        (struct abstract_molecule *)schedule_next(timer);
+    if (am->properties == NULL) {
+      if ((am->flags & IN_MASK) == IN_SCHEDULE) {
+        am->next = NULL;
+        mem_put(mem_birthplace(am), am);
+      } else
+        am->flags &= ~IN_SCHEDULE;
+      if (timer->defunct_count > 0)
+        timer->defunct_count--;
+    } else
+      am->flags &= ~IN_SCHEDULE;
+  }
+  for (struct abstract_molecule *am = store->deferred; am != NULL;
+       am = am->next)
+    am->flags &= ~IN_SCHEDULE;
+  store->deferred = NULL;
+
+  int nx = world->domain->n_columns;
+  int ny = (world->ny_parts + world->mem_part_y - 2) / world->mem_part_y;
+  int sx = store->index % nx;
+  int sy = (store->index / nx) % ny;
+  int sz = store->index / nx / ny;
+  int i_end = (sx + 1) * world->mem_part_x;
+  int j_end = (sy + 1) * world->mem_part_y;
+  int k_end = (sz + 1) * world->mem_part_z;
+  if (i_end > world->nx_parts - 1)
+    i_end = world->nx_parts - 1;
+  if (j_end > world->ny_parts - 1)
+    j_end = world->ny_parts - 1;
+  if (k_end > world->nz_parts - 1)
+    k_end = world->nz_parts - 1;
+
+  for (int i = sx * world->mem_part_x; i < i_end; i++)
+    for (int j = sy * world->mem_part_y; j < j_end; j++)
+      for (int k = sz * world->mem_part_z; k < k_end; k++) {
+        int h = k + (world->nz_parts - 1) * (j + (world->ny_parts - 1) * i);
+        struct subvolume *sv = &world->subvol[h];
+        for (struct per_species_list *psl = sv->species_head; psl != NULL;
+             psl = psl->next) {
+          while (psl->n_packed > 0) {
+            struct volume_molecule *vm = psl->packed[psl->n_packed - 1];
+            pack_molecule(buf, vm);
+            if (vm->flags & IN_SCHEDULE)
+              timer->defunct_count++;
+            sv->mol_count--;
+            vm->properties->population--;
+            collect_molecule(vm);
+          }
+        }
+      }
+
+  for (int i = sx * world->mem_part_x; i < i_end; i++)
+    for (int j = sy * world->mem_part_y; j < j_end; j++)
+      for (int k = sz * world->mem_part_z; k < k_end; k++) {
+        int h = k + (world->nz_parts - 1) * (j + (world->ny_parts - 1) * i);
+        evict_surface_molecules(world, &world->subvol[h], buf, uncount);
+      }
+
+  /* Drop the molecules left in later time slots, so that the storage is
+   * empty while it belongs to another process */
+  if (timer != NULL && timer->defunct_count > 0) {
+    struct abstract_molecule *am = (struct abstract_molecule *)
+        schedule_cleanup(timer, *is_defunct_molecule);
+    while (am != NULL) {
+      struct abstract_molecule *temp = am;
+      am = am->next;
+      if ((temp->flags & IN_MASK) == IN_SCHEDULE) {
+        temp->next = NULL;
+        mem_put(mem_birthplace(temp), temp);
+      } else
+        temp->flags &= ~IN_SCHEDULE;
+    }
+  }
+  sweep_dormant_molecules(store);
+}
+
+/*************************************************************************
+release_storage:
+  In: world: simulation state
+      store: a storage of another process, emptied by evict_storage
+  Out: No return value.  The storage leaves the list of active storages,
+       and its scheduler and the chunks of its molecule pools are freed.
+       It gets new ones if molecules are lent to it again.
+*************************************************************************/
+static void release_storage(struct volume *world, struct storage *store) {
+  if (store->active) {
+    int n = 0;
+    for (int i = 0; i < world->n_active_stores; i++) {
+      if (world->active_stores[i] != store)
+        world->active_stores[n++] = world->active_stores[i];
+    }
+    world->n_active_stores = n;
+    store->active = 0;
+  }
+  delete_scheduler(store->timer);
+  store->timer = NULL;
+  empty_mem(store->mol);
+  empty_mem(store->smol);
+}
+
+/*************************************************************************
+evict_columns:
+  In: world: simulation state
+      c_lo, c_hi: range of columns of storages
+      buf: buffer of molecules to send
+      c_keep: storages of other processes from this column on are
+              released once empty (see release_storage)
+  Out: No return value.  The molecules of all storages in the columns are
+       appended to the buffer, in storage order, and removed.
+*************************************************************************/
+static void evict_columns(struct volume *world, int c_lo, int c_hi,
+                          struct molecule_buffer *buf, int c_keep) {
+  struct domain *dom = world->domain;
+  for (int i = 0; i < dom->n_stores; i++) {
+    int c = i % dom->n_columns;
+    /* Storages without a scheduler hold no molecules */
+    if (c < c_lo || c >= c_hi || dom->stores[i]->timer == NULL)
+      continue;
+    evict_storage(world, dom->stores[i], buf, 0);
+    if (c >= c_keep && !dom->owned[i])
+      release_storage(world, dom->stores[i]);
+  }
+}
+
+/*************************************************************************
+drop_foreign_molecules:
+  In: world: simulation state, with the domain set up
+  Out: No return value.  The molecules placed on every process while
+       initializing (surface molecules on regions) are removed from the
+       storages of other processes, and from the region counts, where
+       they were counted as well.  Those storages are released.
+*************************************************************************/
+static void drop_foreign_molecules(struct volume *world) {
+  struct domain *dom = world->domain;
+  struct molecule_buffer dropped = { NULL, 0, 0 };
+  for (int i = 0; i < dom->n_stores; i++) {
+    if (dom->owned[i] || dom->stores[i]->timer == NULL)
+      continue;
+    evict_storage(world, dom->stores[i], &dropped, 1);
+    release_storage(world, dom->stores[i]);
+    dropped.n = 0;
+  }
+  free(dropped.mols);
+}
+
+/*************************************************************************
+schedule_received:
+  In: world: simulation state
+      local: the storage of the molecule
+      am: a molecule received from another process
+  Out: No return value.  The molecule is scheduled, or put back on the
+       deferred list of its storage if its step was deferred.
+*************************************************************************/
+static void schedule_received(struct volume *world, struct storage *local,
+                              struct abstract_molecule *am) {
+  if (am->flags & ACT_DEFER) {
+    am->next = local->deferred;
+    local->deferred = am;
+  } else if (storage_schedule_add(world, local, am))
+    mcell_allocfailed("Failed to add a molecule received from another "
+                      "process to the scheduler.");
+}
+
+/*************************************************************************
+insert_surface:
+  In: world: simulation state
+      m: a surface molecule received from another process
+  Out: No return value.  The molecule is put on its tile and scheduled.
+  Note: Releases run on the first process, which does not see the
+        molecules of the others, so a released molecule may come to a tile
+        taken here.  It goes to the nearest free tile of its wall instead,
+        which keeps it in the regions it was counted in.  If there is none
+        in the storages of this process it is dropped, like molecules that
+        find no room in serial runs.
+*************************************************************************/
+static void insert_surface(struct volume *world, struct domain_molecule *m) {
+  struct wall *w = wall_by_index(world->domain, m->wall);
+  if (create_grid(world, w, NULL))
+    mcell_allocfailed("Failed to create a grid for a surface molecule "
+                      "received from another process.");
+  struct surface_grid *g = w->grid;
+  struct species *spec = world->species_list[m->species];
+
+  unsigned int idx = m->grid_index;
+  struct vector2 s_pos = m->s_pos;
+  struct vector3 pos;
+  uv2xyz(&s_pos, w, &pos);
+  struct storage *local = find_subvolume(world, &pos, g->subvol)->local_storage;
+
+  if (tile_occupied(g, idx)) {
+    double d2;
+    int free_idx = nearest_free(g, &m->s_pos, GIGANTIC, &d2);
+    if (free_idx >= 0) {
+      idx = free_idx;
+      if (world->randomize_smol_pos)
+        grid2uv_random(g, idx, &s_pos, &local->stream->rng);
+      else
+        grid2uv(g, idx, &s_pos);
+      uv2xyz(&s_pos, w, &pos);
+      local = find_subvolume(world, &pos, g->subvol)->local_storage;
+    }
+    if (free_idx < 0 || !domain_owns(world, local)) {
+      mcell_warn("Could not place a %s molecule received from another "
+                 "process: no free tile near it on this process.",
+                 spec->sym->name);
+      struct surface_molecule lost = { .t = m->t, .flags = m->flags,
+                                       .properties = spec,
+                                       .grid_index = m->grid_index,
+                                       .orient = m->orient, .grid = g,
+                                       .s_pos = m->s_pos };
+      if (spec->flags & (COUNT_CONTENTS | COUNT_ENCLOSED))
+        count_region_from_scratch(world, (struct abstract_molecule *)&lost,
+                                  NULL, -1, NULL, w, lost.t,
+                                  &lost.periodic_box);
+      return;
+    }
+  }
+
+  struct surface_molecule *sm =
+      CHECKED_MEM_GET(local->smol, "surface molecule");
+  memset(sm, 0, sizeof(struct surface_molecule));
+  sm->t = m->t;
+  sm->t2 = m->t2;
+  sm->flags = m->flags | IN_SCHEDULE;
+  sm->properties = spec;
+  sm->birthday = m->birthday;
+  sm->id = m->id;
+  sm->grid_index = idx;
+  sm->orient = m->orient;
+  sm->grid = g;
+  sm->s_pos = s_pos;
+
+  *tile_sm_slot(g, idx) =
+      add_surfmol_with_unique_pb_to_list(tile_sm_list(g, idx), sm);
+  update_tile_occupancy(g, idx);
+  g->n_occupied++;
+  spec->population++;
+
+  schedule_received(world, local, (struct abstract_molecule *)sm);
+}
+
+/*************************************************************************
+insert_molecules:
+  In: world: simulation state
+      buf: molecules received from another process
+  Out: No return value.  The molecules are added to their subvolumes or
+       tiles and scheduled, or put back on the deferred list of their
+       storage.  Region counts are left alone: the molecules were counted
+       where they came from.
+*************************************************************************/
+static void insert_molecules(struct volume *world,
+                             struct molecule_buffer *buf) {
+  for (int i = 0; i < buf->n; i++) {
+    struct domain_molecule *m = &buf->mols[i];
+    if (m->wall >= 0) {
+      insert_surface(world, m);
+      continue;
+    }
+    struct subvolume *sv = find_subvolume(world, &m->pos, NULL);
+    struct storage *local = sv->local_storage;
+
+    struct volume_molecule *vm =
+        CHECKED_MEM_GET(local->mol, "volume molecule");
+    memset(vm, 0, sizeof(struct volume_molecule));
+    vm->t = m->t;
+    vm->t2 = m->t2;
+    vm->flags = (m->flags & ~IN_MASK) | IN_VOLUME | IN_SCHEDULE;
+    vm->properties = world->species_list[m->species];
+    vm->birthday = m->birthday;
+    vm->id = m->id;
+    memset(&vm->periodic_box, 0, sizeof(struct periodic_image));
+    vm->pos = m->pos;
+    vm->subvol = sv;
+    vm->index = m->index;
+
+    ht_add_molecule_to_list(&sv->mol_by_species, vm);
+    sv->mol_count++;
+    vm->properties->population++;
+
+    schedule_received(world, local, (struct abstract_molecule *)vm);
+  }
+}
+
+/*************************************************************************
+domain_migrate_molecules:
+  In: world: simulation state
+  Out: No return value.  Molecules in storages owned by another process
+       (those placed by releases, which only the first process runs) are
+       handed over to their owners, and the storages they were in are
+       released.
+*************************************************************************/
+void domain_migrate_molecules(struct volume *world) {
+  struct domain *dom = world->domain;
+  struct molecule_buffer out[dom->n_ranks];
+  memset(out, 0, sizeof(out));
+  long long n_out = 0;
+  for (int r = 0; r < dom->n_ranks; r++) {
+    if (r != dom->rank)
+      evict_columns(world, dom->first_column[r], dom->first_column[r + 1],
+                    &out[r], 0);
+    n_out += out[r].n;
+  }
+
+  struct molecule_buffer in = { NULL, 0, 0 };
+  exchange_molecules(out, dom->n_ranks, &in);
+  insert_molecules(world, &in);
+  dom->n_migrated += n_out;
+
+  for (int r = 0; r < dom->n_ranks; r++)
+    free(out[r].mols);
+  free(in.mols);
+}
+
+/*************************************************************************
+domain_broadcast_time:
+  In: world: simulation state
+      t: a time known to the first process
+  Out: The time of the first process.
+*************************************************************************/
+double domain_broadcast_time(struct volume *world, double t) {
+#ifdef MCELL_MPI
+  MPI_Bcast(&t, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#endif
+  return t;
+}
+
+/**************************************************************************
+ * Face passes
+ **************************************************************************/
+
+/*************************************************************************
+face_lend:
+  In: dom: the domain
+      f: the face between process f and f + 1
+  Out: The number of columns process f + 1 lends across the face: the
+       current width of the lent band, or all of its columns if it has
+       fewer.
+*************************************************************************/
+static int face_lend(struct domain *dom, int f) {
+  int n = dom->first_column[f + 2] - dom->first_column[f + 1];
+  return (dom->lend < n) ? dom->lend : n;
+}
+
+/*************************************************************************
+run_face:
+  In: world: simulation state, with the columns above the face lent
+      f: the face between process f (this one) and f + 1
+      release_time: time of the next release event
+      checkpt_time: time of the next checkpoint
+  Out: No return value.  Deferred steps of the slab of this process and of
+       the lent columns are run serially, in storage order, as long as they
+       stay within the slab plus the lent columns.  Steps reaching further
+       are deferred again.
+*************************************************************************/
+static void run_face(struct volume *world, int f, double release_time,
+                     double checkpt_time) {
+  struct domain *dom = world->domain;
+  int c_lo = dom->first_column[f];
+  int c_hi = dom->first_column[f + 1] + face_lend(dom, f);
+  struct vector3 llf = { column_x(world, dom, c_lo), -GIGANTIC, -GIGANTIC };
+  struct vector3 urb = { column_x(world, dom, c_hi), GIGANTIC, GIGANTIC };
+
+  for (int i = 0; i < dom->n_stores; i++) {
+    struct storage *local = dom->stores[i];
+    int c = i % dom->n_columns;
+    if (c < c_lo || c >= c_hi)
+      continue;
+    while (local->deferred != NULL) {
+      struct abstract_molecule *am = local->deferred;
+      local->deferred = am->next;
+      if (storage_schedule_add(world, local, am))
+        mcell_allocfailed("Failed to add a molecule to scheduler after "
+                          "deferring its timestep.");
+    }
+  }
+
+  int done = 0;
+  while (!done) {
+    done = 1;
+    for (int i = 0; i < dom->n_stores; i++) {
+      struct storage *local = dom->stores[i];
+      int c = i % dom->n_columns;
+      if (c < c_lo || c >= c_hi || local->timer == NULL ||
+          local->timer->current == NULL)
+        continue;
+
+      struct thread_state face = { .pool = world->thread_pool,
+                                   .store = local,
+                                   .reach_llf = llf,
+                                   .reach_urb = urb,
+                                   .rng = &local->stream->rng,
+                                   .stats = &local->stream->stats,
+                                   .counts = &local->stream->counts };
+      face.scratch = world->scratch; /* handed back below, so nothing leaks */
+      current_thread = &face;
+      run_timestep(world, local, release_time, checkpt_time);
+      current_thread = NULL;
+      world->scratch = face.scratch;
+      done = 0;
+    }
+  }
+}
+
+/*************************************************************************
+count_owned:
+  In: world: simulation state
+      left: set to the number of owned storages with molecules due in the
+            current time slot (0) and of deferred molecules (1)
+  Out: No return value.
+*************************************************************************/
+static void count_owned(struct volume *world, long long left[2]) {
+  struct domain *dom = world->domain;
+  left[0] = left[1] = 0;
+  for (int i = 0; i < dom->n_stores; i++) {
+    if (!dom->owned[i])
+      continue;
+    if (dom->stores[i]->timer != NULL &&
+        dom->stores[i]->timer->current != NULL)
+      left[0]++;
+    for (struct abstract_molecule *am = dom->stores[i]->deferred; am != NULL;
+         am = am->next)
+      left[1]++;
+  }
+}
+
+/*************************************************************************
+domain_run_faces:
+  In: world: simulation state, with every owned storage run up to the end
+             of the current time slot except for deferred steps
+      release_time: time of the next release event
+      checkpt_time: time of the next checkpoint
+  Out: 1 if some process still has molecules to step in the current time
+       slot, 0 once all are done.  Must be called by every process.
+  Note: Faces between processes are handled even ones first, then odd
+        ones, so that each process takes part in one face at a time.  For
+        a face, the upper process lends the columns next to it to the lower
+        process, which runs the deferred steps of both and sends the
+        columns back.  Steps reaching past the lent columns are left for
+        the next round, which lends twice as many.
+*************************************************************************/
+int domain_run_faces(struct volume *world, double release_time,
+                     double checkpt_time) {
+  struct domain *dom = world->domain;
+  int n_faces = dom->n_ranks - 1;
+  int me = dom->rank;
+
+  /* Only faces next to deferred molecules need a pass */
+  long long left[2];
+  count_owned(world, left);
+  long long wanted[n_faces];
+  memset(wanted, 0, sizeof(wanted));
+  if (left[1] > 0) {
+    if (me > 0)
+      wanted[me - 1] = 1;
+    if (me < n_faces)
+      wanted[me] = 1;
+  }
+  max_longs(wanted, n_faces);
+
+  struct molecule_buffer buf = { NULL, 0, 0 };
+  for (int parity = 0; parity < 2; parity++) {
+    for (int f = parity; f < n_faces; f += 2) {
+      if (!wanted[f])
+        continue;
+      int face = dom->first_column[f + 1];
+      if (me == f + 1) {
+        buf.n = 0;
+        evict_columns(world, face, face + face_lend(dom, f), &buf,
+                      dom->n_columns);
+        dom->n_lent += buf.n;
+        send_molecules(f, &buf);
+        receive_molecules(f, &buf);
+        insert_molecules(world, &buf);
+      } else if (me == f) {
+        receive_molecules(f + 1, &buf);
+        insert_molecules(world, &buf);
+        run_face(world, f, release_time, checkpt_time);
+        /* Columns lent past the usual band are only borrowed now and
+         * then, so their storages are released */
+        buf.n = 0;
+        evict_columns(world, face, face + face_lend(dom, f), &buf,
+                      face + dom->band);
+        send_molecules(f + 1, &buf);
+      }
+    }
+  }
+  free(buf.mols);
+  dom->n_rounds++;
+
+  count_owned(world, left);
+  sum_longs(left, 2);
+  if (left[0] == 0 && left[1] == 0) {
+    dom->n_stalled = 0;
+    dom->lend = dom->band;
+    return 0;
+  }
+
+  /* Without molecules due elsewhere, the steps still deferred reach past
+   * the lent columns, so more are lent in the next round.  Once whole
+   * slabs are lent, a round that steps none of them will be repeated
+   * forever. */
+  if (left[0] == 0 && dom->lend < dom->n_columns) {
+    dom->lend *= 2;
+    if (dom->lend > dom->n_columns)
+      dom->lend = dom->n_columns;
+    dom->n_widened++;
+    dom->n_stalled = 0;
+  } else if (left[0] == 0 && left[1] >= dom->stalled_deferred) {
+    if (++dom->n_stalled >= 3)
+      mcell_error("%lld molecule steps reach further than the columns of "
+                  "memory partitions of the neighboring processes.  "
+                  "Please use fewer processes or larger memory partitions.",
+                  left[1]);
+  } else
+    dom->n_stalled = 0;
+  dom->stalled_deferred = left[1];
+  return 1;
+}
+
+/**************************************************************************
+ * Triggers, output and statistics
+ **************************************************************************/
+
+/*************************************************************************
+index_counters:
+  In: world: simulation state, with the counters numbered
+  Out: No return value.  The counters are listed by index, and whether
+       any of them is a trigger is noted.
+*************************************************************************/
+static void index_counters(struct volume *world) {
+  struct domain *dom = world->domain;
+  dom->n_counters = world->n_counters;
+  dom->counters = CHECKED_MALLOC_ARRAY(struct counter *, dom->n_counters + 1,
+                                       "counters by index");
+  for (int i = 0; world->count_hash != NULL && i <= world->count_hashmask;
+       i++) {
+    for (struct counter *c = world->count_hash[i]; c != NULL; c = c->next) {
+      dom->counters[c->index] = c;
+      if (c->counter_type & TRIG_COUNTER)
+        dom->has_triggers = 1;
+    }
+  }
+}
+
+/*************************************************************************
+domain_gather_triggers:
+  In: world: simulation state
+  Out: No return value.  Trigger events queued on other processes are
+       sent to the first process and queued there with the events of the
+       same storage, to be reported by flush_pending_triggers.  Must be
+       called by every process.
+*************************************************************************/
+void domain_gather_triggers(struct volume *world) {
+  struct domain *dom = world->domain;
+  if (dom->counters == NULL)
+    index_counters(world);
+  if (!dom->has_triggers)
+    return;
+
+  int n = 0;
+  struct domain_trigger *mine = NULL;
+  if (dom->rank != 0) {
+    for (int i = 0; i < world->n_storage_streams; i++) {
+      for (struct pending_trigger *pt =
+               world->storage_streams[i].counts.triggers;
+           pt != NULL; pt = pt->next)
+        n++;
+    }
+    if (n > 0)
+      mine = CHECKED_MALLOC_ARRAY(struct domain_trigger, n,
+                                  "trigger events to send");
+
+    n = 0;
+    for (int i = 0; i < world->n_storage_streams; i++) {
+      struct count_shard *shard = &world->storage_streams[i].counts;
+      for (struct pending_trigger *pt = shard->triggers; pt != NULL;
+           pt = pt->next) {
+        struct domain_trigger *dt = &mine[n++];
+        dt->t_event = pt->t_event;
+        dt->loc = pt->loc;
+        dt->id = pt->id;
+        dt->store = i;
+        dt->counter = pt->event->index;
+        dt->ear = 0;
+        for (struct trigger_request *tr = pt->event->data.trig.listeners;
+             tr != NULL && tr->ear != pt->ear; tr = tr->next)
+          dt->ear++;
+        dt->n = pt->n;
+        dt->orient = pt->orient;
+        dt->flags = pt->flags;
+      }
+      if (shard->triggers != NULL)
+        mem_put_list(shard->trigger_mem, shard->triggers);
+      shard->triggers = NULL;
+      shard->triggers_tail = &shard->triggers;
+    }
+  }
+
+  int n_all;
+  struct domain_trigger *all = gather_triggers(mine, n, &n_all);
+  for (int i = 0; i < n_all; i++) {
+    struct domain_trigger *dt = &all[i];
+    struct counter *event = dom->counters[dt->counter];
+    struct trigger_request *tr = event->data.trig.listeners;
+    for (int j = 0; j < dt->ear; j++)
+      tr = tr->next;
+
+    struct pending_trigger pt = {
+      .event = event, .ear = tr->ear, .t_event = dt->t_event, .loc = dt->loc,
+      .orient = dt->orient, .flags = dt->flags, .n = dt->n, .id = dt->id
+    };
+    queue_pending_trigger(&world->storage_streams[dt->store].counts, &pt);
+  }
+  free(all);
+  free(mine);
+}
+
+/*************************************************************************
+add_leaf:
+  In: dom: the domain
+      leaf: value read by an output expression
+      is_int: whether the value is an int (otherwise a double)
+  Out: No return value.  The leaf is listed.
+*************************************************************************/
+static void add_leaf(struct domain *dom, void *leaf, int is_int) {
+  if (dom->n_leaves == dom->max_leaves) {
+    int max = (dom->max_leaves > 0) ? 2 * dom->max_leaves : 64;
+    void **leaves = CHECKED_MALLOC_ARRAY(void *, max, "output leaves");
+    int *is_ints = CHECKED_MALLOC_ARRAY(int, max, "output leaves");
+    if (dom->n_leaves > 0) {
+      memcpy(leaves, dom->leaves, dom->n_leaves * sizeof(void *));
+      memcpy(is_ints, dom->leaf_is_int, dom->n_leaves * sizeof(int));
+    }
+    free(dom->leaves);
+    free(dom->leaf_is_int);
+    free(dom->leaf_local);
+    free(dom->leaf_sum);
+    dom->leaves = leaves;
+    dom->leaf_is_int = is_ints;
+    dom->leaf_local = CHECKED_MALLOC_ARRAY(double, max, "output leaves");
+    dom->leaf_sum = CHECKED_MALLOC_ARRAY(double, max, "output leaves");
+    dom->max_leaves = max;
+  }
+  dom->leaves[dom->n_leaves] = leaf;
+  dom->leaf_is_int[dom->n_leaves] = is_int;
+  dom->n_leaves++;
+}
+
+/*************************************************************************
+collect_leaves:
+  In: dom: the domain
+      root: an output expression
+  Out: No return value.  The counts read by the expression are listed,
+       in the same order on every process.
+*************************************************************************/
+static void collect_leaves(struct domain *dom, struct output_expression *root) {
+  if (root->left != NULL) {
+    if ((root->expr_flags & OEXPR_LEFT_MASK) == OEXPR_LEFT_INT)
+      add_leaf(dom, root->left, 1);
+    else if ((root->expr_flags & OEXPR_LEFT_MASK) == OEXPR_LEFT_DBL)
+      add_leaf(dom, root->left, 0);
+    else if ((root->expr_flags & OEXPR_LEFT_MASK) == OEXPR_LEFT_OEXPR)
+      collect_leaves(dom, (struct output_expression *)root->left);
+  }
+  if (root->right != NULL) {
+    if ((root->expr_flags & OEXPR_RIGHT_MASK) == OEXPR_RIGHT_INT)
+      add_leaf(dom, root->right, 1);
+    else if ((root->expr_flags & OEXPR_RIGHT_MASK) == OEXPR_RIGHT_DBL)
+      add_leaf(dom, root->right, 0);
+    else if ((root->expr_flags & OEXPR_RIGHT_MASK) == OEXPR_RIGHT_OEXPR)
+      collect_leaves(dom, (struct output_expression *)root->right);
+  }
+}
+
+/*************************************************************************
+domain_sum_output:
+  In: world: simulation state
+      block: an output block about to be evaluated
+      buf_index: the buffer slot being filled
+  Out: No return value.  Every count read by the non-trigger columns of
+       the block is replaced by its sum over all processes, until
+       domain_restore_output is called.  Must be called by every process.
+*************************************************************************/
+void domain_sum_output(struct volume *world, struct output_block *block,
+                       int buf_index) {
+  struct domain *dom = world->domain;
+  dom->n_leaves = 0;
+  for (struct output_set *set = block->data_set_head; set != NULL;
+       set = set->next) {
+    for (struct output_column *column = set->column_head; column != NULL;
+         column = column->next) {
+      if (column->buffer[buf_index].data_type != COUNT_TRIG_STRUCT)
+        collect_leaves(dom, column->expr);
+    }
+  }
+  if (dom->n_leaves == 0)
+    return;
+
+  /* A leaf read in several places is listed once per place; every copy
+   * gets the same sum */
+  for (int i = 0; i < dom->n_leaves; i++) {
+    if (dom->leaf_is_int[i])
+      dom->leaf_local[i] = (double)*(int *)dom->leaves[i];
+    else
+      dom->leaf_local[i] = *(double *)dom->leaves[i];
+    dom->leaf_sum[i] = dom->leaf_local[i];
+  }
+  sum_doubles(dom->leaf_sum, dom->n_leaves);
+  for (int i = 0; i < dom->n_leaves; i++) {
+    if (dom->leaf_is_int[i])
+      *(int *)dom->leaves[i] = (int)lround(dom->leaf_sum[i]);
+    else
+      *(double *)dom->leaves[i] = dom->leaf_sum[i];
+  }
+}
+
+/*************************************************************************
+domain_restore_output:
+  In: world: simulation state
+  Out: No return value.  The counts replaced by domain_sum_output get the
+       values of this process back.
+*************************************************************************/
+void domain_restore_output(struct volume *world) {
+  struct domain *dom = world->domain;
+  for (int i = dom->n_leaves - 1; i >= 0; i--) {
+    if (dom->leaf_is_int[i])
+      *(int *)dom->leaves[i] = (int)dom->leaf_local[i];
+    else
+      *(double *)dom->leaves[i] = dom->leaf_local[i];
+  }
+  dom->n_leaves = 0;
+}
+
+/*************************************************************************
+domain_sum_statistics:
+  In: world: simulation state, with the storage statistics merged
+      rng_total: random numbers used by this process
+  Out: No return value.  The event counters of the world, the random
+       number use and the exchange statistics become sums over all
+       processes.  Must be called by every process.
+*************************************************************************/
+void domain_sum_statistics(struct volume *world, long long *rng_total) {
+  struct domain *dom = world->domain;
+  struct sim_stats *s = &world->stats;
+  long long v[] = {
+    s->diffusion_number,   s->ray_voxel_tests,      s->ray_polygon_tests,
+    s->ray_polygon_colls,  s->vol_vol_colls,        s->vol_surf_colls,
+    s->surf_surf_colls,    s->vol_wall_colls,       s->vol_vol_vol_colls,
+    s->vol_vol_surf_colls, s->vol_surf_surf_colls,  s->surf_surf_surf_colls,
+    *rng_total,            dom->n_lent,             dom->n_migrated
+  };
+  sum_longs(v, sizeof(v) / sizeof(v[0]));
+  sum_doubles(&s->diffusion_cumtime, 1);
+
+  s->diffusion_number = v[0];
+  s->ray_voxel_tests = v[1];
+  s->ray_polygon_tests = v[2];
+  s->ray_polygon_colls = v[3];
+  s->vol_vol_colls = v[4];
+  s->vol_surf_colls = v[5];
+  s->surf_surf_colls = v[6];
+  s->vol_wall_colls = v[7];
+  s->vol_vol_vol_colls = v[8];
+  s->vol_vol_surf_colls = v[9];
+  s->vol_surf_surf_colls = v[10];
+  s->surf_surf_surf_colls = v[11];
+  *rng_total = v[12];
+  dom->n_lent = v[13];
+  dom->n_migrated = v[14];
+}
+
+/*************************************************************************
+domain_print_statistics:
+  In: world: simulation state, after domain_sum_statistics
+  Out: No return value.  How much work the exchanges between processes
+       took is logged.
+*************************************************************************/
+void domain_print_statistics(struct volume *world) {
+  struct domain *dom = world->domain;
+  mcell_log("Distributed over %d processes: %lld rounds of face passes, "
+            "%lld molecules lent across faces, %lld handed over after "
+            "releases.",
+            dom->n_ranks, dom->n_rounds, dom->n_lent, dom->n_migrated);
+  if (dom->n_widened > 0)
+    mcell_log("The columns lent across faces were widened %lld times for "
+              "long steps.",
+              dom->n_widened);
+}
@@ -0,0 +1,102 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2006-2017 by
+ * The Salk Institute for Biological Studies and
+ * Pittsburgh Supercomputing Center, Carnegie Mellon University
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ *
+******************************************************************************/
+
+#pragma once
+
+#include "vector.h"
+
+struct volume;
+struct storage;
+struct counter;
+struct output_block;
+struct domain_object;
+
+/* Columns of storages (along x) owned by the processes of a distributed run.
+   Geometry and the grid of storages are replicated on every process; each
+   molecule, volume or surface, lives on the process owning the column of
+   storages it is in.  Storages of other processes only get schedulers and
+   molecules while their columns are lent to this process. */
+struct domain {
+  int n_ranks;       /* Processes taking part in the run */
+  int rank;          /* This process */
+  int n_columns;     /* Storages along x */
+  int *first_column; /* Columns of rank r: first_column[r..r+1) */
+  int band;          /* Columns lent across a face for the face passes */
+  int lend;          /* Columns lent in this time slot, at least band */
+
+  int n_stores;
+  struct storage **stores; /* Indexed by storage index */
+  char *owned;             /* Per storage index: owned by this process? */
+  struct vector3 slab_llf; /* Region owned by this process */
+  struct vector3 slab_urb;
+
+  /* Walls, numbered by object and side alike on every process */
+  struct domain_object *objects;    /* In the order of the object tree */
+  struct domain_object *by_address; /* The same, sorted by object address */
+  int n_objects;
+
+  /* Face passes: rounds in which nothing was left to step */
+  long long stalled_deferred;
+  int n_stalled;
+
+  /* Trigger events: counters by index, built on first use */
+  struct counter **counters;
+  int n_counters;
+  int has_triggers;
+
+  /* Output: expression leaves showing global sums, and their own values */
+  void **leaves;
+  int *leaf_is_int;
+  double *leaf_local;
+  double *leaf_sum;
+  int n_leaves;
+  int max_leaves;
+
+  /* Statistics */
+  long long n_rounds;     /* Rounds of face passes */
+  long long n_lent;       /* Molecules lent across faces */
+  long long n_widened;    /* Times the lent band was widened */
+  long long n_migrated;   /* Molecules handed over after releases */
+};
+
+/* Whether the molecules of a storage live on this process */
+#define domain_owns(world, store)                                              \
+  ((world)->domain == NULL || (world)->domain->owned[(store)->index])
+
+void domain_startup(int *argc, char ***argv, struct volume *world);
+void domain_shutdown(void);
+
+void domain_init(struct volume *world);
+
+void domain_migrate_molecules(struct volume *world);
+double domain_broadcast_time(struct volume *world, double t);
+int domain_run_faces(struct volume *world, double release_time,
+                     double checkpt_time);
+void domain_gather_triggers(struct volume *world);
+
+void domain_sum_output(struct volume *world, struct output_block *block,
+                       int buf_index);
+void domain_restore_output(struct volume *world);
+
+void domain_sum_statistics(struct volume *world, long long *rng_total);
+void domain_print_statistics(struct volume *world);
@@ -54,6 +54,8 @@
 struct molecule_info **save_all_molecules(struct volume *state,
                                           struct storage_list *storage_head) {
 
+  wake_all_dormant_molecules(state);
+
   // Find total number of molecules in the scheduler.
   unsigned long long num_all_molecules = count_items_in_scheduler(storage_head);
   int ctr = 0;
@@ -136,7 +138,7 @@ void save_common_molecule_properties(struct molecule_info *mol_info,
   mol_info->molecule->birthday = am_ptr->birthday;
   mol_info->molecule->id = am_ptr->id;
   mol_info->molecule->periodic_box = am_ptr->periodic_box;
-  mol_info->molecule->mesh_name = CHECKED_STRDUP(mesh_name, "mesh name");
+  mol_info->mesh_name = CHECKED_STRDUP(mesh_name, "mesh name");
   // Only free temporary object names we just allocated above.
   // Don't want to accidentally free symbol names of objects.
   if (mesh_name && (strcmp(mesh_name, NO_MESH) != 0) &&
@@ -207,7 +209,8 @@ int save_surface_molecule(struct molecule_info *mol_info,
   if (reg_name_list_head != NULL) {
     remove_molecules_name_list(&reg_name_list_head);
   }
-  remove_surfmol_from_list(&sm_ptr->grid->sm_list[sm_ptr->grid_index], sm_ptr);
+  remove_surfmol_from_list(tile_sm_slot(sm_ptr->grid, sm_ptr->grid_index), sm_ptr);
+  update_tile_occupancy(sm_ptr->grid, sm_ptr->grid_index);
   return 0;
 }
 
@@ -223,7 +226,7 @@ void cleanup_names_molecs(
     int num_all_molecules,
     struct molecule_info **all_molecules) {
   for (int i = 0; i < num_all_molecules; i++) {
-    char *mesh_name = all_molecules[i]->molecule->mesh_name;
+    char *mesh_name = all_molecules[i]->mesh_name;
     if (mesh_name && (strcmp(mesh_name, NO_MESH) != 0)) {
       free(mesh_name);
     }
@@ -291,12 +294,11 @@ int place_all_molecules(
     }
     // Insert surface molecule into world.
     else if ((am_ptr->properties->flags & ON_GRID) != 0) {
-      char *mesh_name = am_ptr->mesh_name;
+      char *mesh_name = mol_info->mesh_name;
       struct surface_molecule *sm = insert_surface_molecule(
           state, am_ptr->properties, &mol_info->pos, mol_info->orient,
           state->vacancy_search_dist2, am_ptr->t, mesh_name,
-          mol_info->reg_names, regions_to_ignore, am_ptr->periodic_box);
-      free(am_ptr->periodic_box);
+          mol_info->reg_names, regions_to_ignore, &am_ptr->periodic_box);
       if (sm == NULL) {
         mcell_warn("Unable to find surface upon which to place molecule %s.",
                    am_ptr->properties->sym->name);
@@ -598,9 +600,7 @@ struct volume_molecule *insert_volume_molecule_encl_mesh(
   struct volume_molecule *new_vm = CHECKED_MEM_GET(
     sv->local_storage->mol, "volume molecule");
   memcpy(new_vm, vm, sizeof(struct volume_molecule));
-  new_vm->mesh_name = NULL;
-  new_vm->prev_v = NULL;
-  new_vm->next_v = NULL;
+  new_vm->species_list = NULL;
   new_vm->next = NULL;
   new_vm->subvol = sv;
   new_vm->periodic_box = vm->periodic_box;
@@ -654,7 +654,6 @@ struct volume_molecule *insert_volume_molecule_encl_mesh(
   destroy_string_buffer(nested_mesh_names_new);
   free(nested_mesh_names_new);
 
-  new_vm->birthplace = new_vm->subvol->local_storage->mol;
   ht_add_molecule_to_list(&(new_vm->subvol->mol_by_species), new_vm);
   new_vm->subvol->mol_count++;
   new_vm->properties->population++;
@@ -666,10 +665,10 @@ struct volume_molecule *insert_volume_molecule_encl_mesh(
   if (new_vm->properties->flags & (COUNT_CONTENTS | COUNT_ENCLOSED)) {
     count_region_from_scratch(state, (struct abstract_molecule *)new_vm, NULL,
                               1, &(new_vm->pos), NULL, new_vm->t,
-                              new_vm->periodic_box);
+                              &new_vm->periodic_box);
   }
 
-  if (schedule_add(new_vm->subvol->local_storage->timer, new_vm))
+  if (storage_schedule_add(state, new_vm->subvol->local_storage, new_vm))
     mcell_allocfailed("Failed to add volume molecule to scheduler.");
 
   return new_vm;
@@ -786,7 +785,6 @@ hit_subvol:
   In:  state: MCell state
        mesh_names: meshes that the molecule is inside of
        smash: the thing that the current molecule has collided with
-       shead: the head of a list of what the current molecule has collided with
        name_hits_head: the head of a list that tracks the meshes we've hit and
          how many times they've been hit
        sv: subvolume
@@ -798,7 +796,6 @@ void hit_subvol(
     struct n_parts *np,
     struct string_buffer *mesh_names,
     struct collision *smash,
-    struct collision *shead,
     struct name_hits *name_hits_head,
     struct subvolume *sv,
     struct volume_molecule *virt_mol) {
@@ -813,9 +810,6 @@ void hit_subvol(
       np->ny_parts, np->nz_parts);
   // Hit the edge of the world
   if (new_sv == NULL) {
-    if (shead != NULL)
-      mem_put_list(sv->local_storage->coll, shead);
-
     // Compile the final list of meshes (names and counts) that we are inside
     for (struct name_hits *nhl = name_hits_head; nhl != NULL; nhl = nhl->next) {
       if (nhl->hits % 2 != 0) {
@@ -837,8 +831,6 @@ void hit_subvol(
     return;
   }
 
-  if (shead != NULL)
-    mem_put_list(sv->local_storage->coll, shead);
   virt_mol->subvol = new_sv;
 }
 
@@ -858,8 +850,7 @@ struct string_buffer *find_enclosing_meshes(
   // We create a virtual molecule, so that we don't displace the real one (vm).
   struct volume_molecule virt_mol;
   memcpy(&virt_mol, vm, sizeof(struct volume_molecule));
-  virt_mol.prev_v = NULL;
-  virt_mol.next_v = NULL;
+  virt_mol.species_list = NULL;
   virt_mol.next = NULL;
 
   // This is where we will store the names of the meshes we are nested in.
@@ -890,16 +881,18 @@ struct string_buffer *find_enclosing_meshes(
   struct collision *shead = NULL; // Head of the linked list of collisions
   struct subvolume *sv = virt_mol.subvol;
   struct name_hits *nh_head = NULL, *nh_tail = NULL;
+  struct scratch_arena *scratch = local_scratch(state);
   do {
     // Get collision list for walls and a subvolume. We don't care about
     // colliding with other molecules like we do with reactions
+    struct scratch_mark mark = scratch_save(scratch);
     shead = ray_trace(state, &(virt_mol.pos), NULL, sv, &displace_vector, NULL);
     if (shead == NULL)
       mcell_internal_error("ray_trace() returned NULL.");
 
     if (shead->next != NULL) {
-      shead =
-          (struct collision *)ae_list_sort((struct abstract_element *)shead);
+      shead = (struct collision *)sort_collisions(
+          scratch, (struct abstract_element *)shead);
     }
 
     for (smash = shead; smash != NULL; smash = smash->next) {
@@ -924,15 +917,17 @@ struct string_buffer *find_enclosing_meshes(
         // Numbers of coarse partitions
         struct n_parts np = {
           state->nx_parts, state->ny_parts, state->nz_parts};
-        hit_subvol(&np, mesh_names, smash, shead, nh_head, sv, &virt_mol);
+        hit_subvol(&np, mesh_names, smash, nh_head, sv, &virt_mol);
         // We hit the edge of the world
         if (virt_mol.subvol == NULL) {
+          scratch_release(scratch, mark);
           return mesh_names; 
         }
         sv = virt_mol.subvol;
         break;
       }
     }
+    scratch_release(scratch, mark);
 
   } while (smash != NULL);
 
@@ -1207,9 +1202,18 @@ int destroy_everything(struct volume *state) {
   destroy_walls(state);
 
   // Destroy memory helpers
-  delete_mem(state->coll_mem);
+  delete_scratch(&state->scratch);
   delete_mem(state->exdv_mem);
 
+  // Packed arrays of per-species lists which outgrew their own room
+  for (int i = 0; i < state->n_subvols; i++) {
+    struct per_species_list *psl;
+    for (psl = state->subvol[i].species_head; psl != NULL; psl = psl->next) {
+      if (psl->max_packed > MIN_PACKED_MOLECULES)
+        free(psl->packed);
+    }
+  }
+
   struct storage_list *mem;
   for (mem = state->storage_head; mem != NULL; mem = mem->next) {
     delete_mem(mem->store->list);
@@ -1220,12 +1224,16 @@ int destroy_everything(struct volume *state) {
     delete_mem(mem->store->grids);
     delete_mem(mem->store->regl);
     delete_mem(mem->store->pslv);
+    if (mem->store->exdv != state->exdv_mem)
+      delete_mem(mem->store->exdv);
   }
 
   // Destroy subvolumes
   for (int i = 0; i < state->n_subvols; i++) {
     struct subvolume *sv = &state->subvol[i];
     pointer_hash_destroy(&sv->mol_by_species);
+    destroy_wall_table(sv);
+    destroy_mol_grid(sv);
     sv->local_storage->wall_head = NULL;
     sv->local_storage->wall_count = 0;
     sv->local_storage->vert_count = 0;
@@ -1240,8 +1248,6 @@ int destroy_everything(struct volume *state) {
   state->storage_head = NULL;
 
   delete_mem(state->storage_allocator);
-  delete_mem(state->sp_coll_mem);
-  delete_mem(state->tri_coll_mem);
 
   destroy_partitions(state);
 
@@ -1350,6 +1356,9 @@ int destroy_poly_object(struct object *obj_ptr, int free_poly_flag) {
       if (w->grid) {
         /*free(w->grid->mol);*/
         delete_void_list((struct void_list *)w->grid->sm_list);
+        free_sparse_tiles(w->grid);
+        free_tile_nbr_table(w->grid);
+        free(w->grid->occupancy);
       } 
       delete_void_list((struct void_list *)w->surf_class_head);
     }
@@ -119,8 +119,7 @@ int hit_wall(
 
 void hit_subvol(
     struct n_parts *np, struct string_buffer *mesh_names,
-    struct collision *smash, struct collision *shead,
-    struct name_hits *name_head, struct subvolume *sv,
+    struct collision *smash, struct name_hits *name_head, struct subvolume *sv,
     struct volume_molecule *virt_mol);
 
 struct string_buffer *find_enclosing_meshes(
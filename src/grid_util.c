@@ -42,6 +42,7 @@
 #include "wall_util.h"
 #include "react.h"
 #include "init.h"
+#include "thread_util.h"
 
 /*************************************************************************
 xyz2uv and uv2xyz:
@@ -302,6 +303,40 @@ void init_grid_geometry(struct surface_grid *g) {
   g->n_tiles = g->n * g->n;
 }
 
+/*************************************************************************
+grid_size:
+  In: the area of a wall
+  Out: the number of tiles along each edge of the wall's grid, so that a
+       tile covers at most one square length unit
+*************************************************************************/
+static int grid_size(double area) {
+  int n = (int)ceil(sqrt(area));
+  return (n < 1) ? 1 : n;
+}
+
+/*************************************************************************
+max_tile_edge:
+  In: simulation state, with its walls
+  Out: the longest edge of a tile on any wall, whether or not the wall has
+       its grid yet.  Tiles are copies of their wall scaled down by the
+       grid size, so slivers may have tiles much longer than they are wide.
+*************************************************************************/
+double max_tile_edge(struct volume *world) {
+  double longest = 0.0;
+  for (struct storage_list *sl = world->storage_head; sl != NULL;
+       sl = sl->next) {
+    for (struct wall *w = sl->store->wall_head; w != NULL; w = w->next) {
+      int n = grid_size(w->area);
+      for (int k = 0; k < 3; k++) {
+        double edge = distance_vec3(w->vert[k], w->vert[(k + 1) % 3]) / n;
+        if (edge > longest)
+          longest = edge;
+      }
+    }
+  }
+  return longest;
+}
+
 /*************************************************************************
 create_grid:
   In: a wall pointer that needs to have its grid created
@@ -316,10 +351,19 @@ int create_grid(struct volume *world, struct wall *w, struct subvolume *guess) {
   if (w->grid != NULL)
     return 0;
 
+  /* The grid pool belongs to the wall's storage, which may be far away */
+  thread_shared_lock(world);
+  if (w->grid != NULL) {
+    thread_shared_unlock(world);
+    return 0;
+  }
+
   sg = (struct surface_grid *)CHECKED_MEM_GET(w->birthplace->grids,
                                               "surface grid");
-  if (sg == NULL)
+  if (sg == NULL) {
+    thread_shared_unlock(world);
     return 1;
+  }
 
   center.x = 0.33333333333 * (w->vert[0]->x + w->vert[1]->x + w->vert[2]->x);
   center.y = 0.33333333333 * (w->vert[0]->y + w->vert[1]->y + w->vert[2]->y);
@@ -328,9 +372,7 @@ int create_grid(struct volume *world, struct wall *w, struct subvolume *guess) {
   sg->surface = w;
   sg->subvol = find_subvolume(world, &center, guess);
 
-  sg->n = (int)ceil(sqrt(w->area));
-  if (sg->n < 1)
-    sg->n = 1;
+  sg->n = grid_size(w->area);
 
   sg->n_tiles = sg->n * sg->n;
   sg->n_occupied = 0;
@@ -338,18 +380,237 @@ int create_grid(struct volume *world, struct wall *w, struct subvolume *guess) {
   sg->binding_factor = ((double)sg->n_tiles) / w->area;
   init_grid_geometry(sg);
 
-  sg->sm_list = CHECKED_MALLOC_ARRAY(struct surface_molecule_list *, sg->n_tiles,
-                                     "surface grid");
-
-  for (unsigned int i = 0; i < sg->n_tiles; i++) {
-    sg->sm_list[i] = NULL;
-  }
+  /* large grids start out sparse and only become dense once enough of
+     their chunks are in use (see tile_sm_slot) */
+  if (sg->n_tiles >= SPARSE_GRID_MIN_TILES) {
+    sg->sm_list = NULL;
+    sg->sm_chunks = CHECKED_MALLOC_ARRAY(struct surface_molecule_list **,
+                                         TILE_CHUNKS(sg->n_tiles),
+                                         "sparse surface grid");
+    for (unsigned int i = 0; i < TILE_CHUNKS(sg->n_tiles); i++)
+      sg->sm_chunks[i] = NULL;
+  } else {
+    sg->sm_list = CHECKED_MALLOC_ARRAY(struct surface_molecule_list *,
+                                       sg->n_tiles, "surface grid");
+    for (unsigned int i = 0; i < sg->n_tiles; i++)
+      sg->sm_list[i] = NULL;
+    sg->sm_chunks = NULL;
+  }
+  sg->n_chunks_used = 0;
+  sg->spare_chunk = NULL;
+  sg->nbr_table = NULL;
+  sg->occupancy = CHECKED_MALLOC_ARRAY(unsigned long long,
+                                       TILE_OCCUPANCY_WORDS(sg->n_tiles),
+                                       "surface grid occupancy");
+  memset(sg->occupancy, 0,
+         TILE_OCCUPANCY_WORDS(sg->n_tiles) * sizeof(unsigned long long));
 
   w->grid = sg;
+  thread_shared_unlock(world);
 
   return 0;
 }
 
+/*************************************************************************
+densify_grid:
+  In: a sparse surface grid
+  Out: no return value.  The chunks are copied into a dense sm_list and
+       freed.  Only safe while no other thread can be reading the grid.
+*************************************************************************/
+static void densify_grid(struct surface_grid *g) {
+  struct surface_molecule_list **sm_list = CHECKED_MALLOC_ARRAY(
+      struct surface_molecule_list *, g->n_tiles, "surface grid");
+
+  for (u_int idx = 0; idx < g->n_tiles; idx++)
+    sm_list[idx] = tile_sm_list(g, idx);
+
+  free_sparse_tiles(g);
+  g->sm_list = sm_list;
+}
+
+/*************************************************************************
+tile_sm_slot:
+  In: a surface grid
+      index of a tile on that grid
+  Out: address of the tile's surface molecule list, for updating it.
+       On sparse grids the tile's chunk is allocated if needed, and the
+       grid is made dense once enough chunks are in use.
+  Note: the address is only valid until the next call to this function
+        on the same grid.
+*************************************************************************/
+struct surface_molecule_list **tile_sm_slot(struct surface_grid *g,
+                                            unsigned int idx) {
+  struct surface_molecule_list **chunk, **expected = NULL;
+  u_int n_used, c = idx / TILE_CHUNK_SIZE;
+
+  if (g->sm_list != NULL)
+    return &g->sm_list[idx];
+
+  chunk = __atomic_load_n(&g->sm_chunks[c], __ATOMIC_ACQUIRE);
+  if (chunk != NULL)
+    return &chunk[idx % TILE_CHUNK_SIZE];
+
+  if (g->spare_chunk != NULL && !thread_can_defer()) {
+    chunk = g->spare_chunk;
+    g->spare_chunk = NULL;
+  } else {
+    chunk = CHECKED_MALLOC_ARRAY(struct surface_molecule_list *,
+                                 TILE_CHUNK_SIZE, "sparse surface grid");
+  }
+  for (int i = 0; i < TILE_CHUNK_SIZE; i++)
+    chunk[i] = NULL;
+
+  /* another thread may have allocated the same chunk meanwhile */
+  if (!__atomic_compare_exchange_n(&g->sm_chunks[c], &expected, chunk, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    free(chunk);
+    return &expected[idx % TILE_CHUNK_SIZE];
+  }
+
+  n_used = __atomic_add_fetch(&g->n_chunks_used, 1, __ATOMIC_RELAXED);
+  if (n_used * SPARSE_GRID_FILL_RATIO > TILE_CHUNKS(g->n_tiles) &&
+      !thread_can_defer()) {
+    densify_grid(g);
+    return &g->sm_list[idx];
+  }
+
+  return &chunk[idx % TILE_CHUNK_SIZE];
+}
+
+/*************************************************************************
+trim_tile_chunk:
+  In: a sparse surface grid
+      index of a tile on that grid
+  Out: no return value.  The tile's chunk is freed if none of its tiles
+       has a surface molecule list any more, so that molecules diffusing
+       across a sparse grid do not leave allocated chunks behind.  Only
+       safe while no other thread can be reading the grid.
+*************************************************************************/
+static void trim_tile_chunk(struct surface_grid *g, unsigned int idx) {
+  u_int c = idx / TILE_CHUNK_SIZE;
+  struct surface_molecule_list **chunk = g->sm_chunks[c];
+
+  if (chunk == NULL)
+    return;
+  for (int i = 0; i < TILE_CHUNK_SIZE; i++) {
+    if (chunk[i] != NULL)
+      return;
+  }
+
+  /* molecules hopping between chunks would otherwise free and allocate
+     a chunk on almost every move */
+  if (g->spare_chunk == NULL)
+    g->spare_chunk = chunk;
+  else
+    free(chunk);
+  g->sm_chunks[c] = NULL;
+  g->n_chunks_used--;
+}
+
+/*************************************************************************
+free_sparse_tiles:
+  In: a surface grid
+  Out: no return value.  The chunks of a sparse grid are freed.  The
+       surface molecule lists they point to are left alone.
+*************************************************************************/
+void free_sparse_tiles(struct surface_grid *g) {
+  if (g->sm_chunks == NULL)
+    return;
+
+  for (u_int c = 0; c < TILE_CHUNKS(g->n_tiles); c++)
+    free(g->sm_chunks[c]);
+  free(g->sm_chunks);
+  g->sm_chunks = NULL;
+  free(g->spare_chunk);
+  g->spare_chunk = NULL;
+}
+
+/*************************************************************************
+update_tile_occupancy:
+  In: a surface grid
+      index of a tile on that grid
+  Out: no return value.  The occupancy bit of the tile is set if the
+       tile's sm_list holds a molecule and cleared otherwise.  Must be
+       called whenever the head of sm_list[idx] changes.  On sparse grids
+       a chunk left without molecule lists is freed.
+*************************************************************************/
+void update_tile_occupancy(struct surface_grid *g, unsigned int idx) {
+  unsigned long long bit = 1ULL << (idx & 63);
+
+  /* neighboring tiles share a word and may be updated from other threads */
+  if (tile_sm_list(g, idx) != NULL && tile_sm_list(g, idx)->sm != NULL) {
+    __atomic_fetch_or(&g->occupancy[idx >> 6], bit, __ATOMIC_RELAXED);
+  } else {
+    __atomic_fetch_and(&g->occupancy[idx >> 6], ~bit, __ATOMIC_RELAXED);
+    if (g->sm_list == NULL && !thread_can_defer())
+      trim_tile_chunk(g, idx);
+  }
+}
+
+/*************************************************************************
+tally_defunct_surface_molecule:
+  In: a scheduled surface molecule that was just taken off its tile
+  Out: no return value.  The molecule is tallied for garbage collection of
+       the scheduler of its grid's storage.  In distributed runs that
+       storage may belong to another process and have no scheduler, in
+       which case nothing is tallied.
+*************************************************************************/
+void tally_defunct_surface_molecule(struct surface_molecule *sm) {
+  struct schedule_helper *timer = sm->grid->subvol->local_storage->timer;
+
+  if (timer != NULL)
+    THREADED_ADD(timer->defunct_count, 1);
+}
+
+/*************************************************************************
+recount_tile_occupancy:
+  In: a surface grid
+  Out: no return value.  The occupancy bits are rebuilt from sm_list and
+       n_occupied is reset to the number of occupied tiles.  Used after
+       tiles were filled in bulk without going through
+       update_tile_occupancy.
+*************************************************************************/
+void recount_tile_occupancy(struct surface_grid *g) {
+  u_int n_words = TILE_OCCUPANCY_WORDS(g->n_tiles);
+  u_int n_occupied = 0;
+
+  memset(g->occupancy, 0, n_words * sizeof(unsigned long long));
+  for (u_int idx = 0; idx < g->n_tiles; idx++) {
+    if (tile_sm_list(g, idx) != NULL && tile_sm_list(g, idx)->sm != NULL)
+      g->occupancy[idx >> 6] |= 1ULL << (idx & 63);
+  }
+  for (u_int i = 0; i < n_words; i++)
+    n_occupied += __builtin_popcountll(g->occupancy[i]);
+
+  g->n_occupied = n_occupied;
+}
+
+/*************************************************************************
+next_free_tile:
+  In: a surface grid
+      index of the tile to start from
+  Out: index of the first unoccupied tile at or after idx, or n_tiles if
+       there is none.  Occupied stretches are skipped a word at a time.
+*************************************************************************/
+unsigned int next_free_tile(struct surface_grid *g, unsigned int idx) {
+  u_int n_words = TILE_OCCUPANCY_WORDS(g->n_tiles);
+  u_int word = idx >> 6;
+  unsigned long long vacant;
+
+  if (idx >= g->n_tiles)
+    return g->n_tiles;
+
+  vacant = ~g->occupancy[word] & (~0ULL << (idx & 63));
+  while (vacant == 0) {
+    if (++word == n_words)
+      return g->n_tiles;
+    vacant = ~g->occupancy[word];
+  }
+
+  idx = (word << 6) + __builtin_ctzll(vacant);
+  return (idx < g->n_tiles) ? idx : g->n_tiles;
+}
+
 /*************************************************************************
 grid_neighbors:
   In: a surface grid
@@ -406,8 +667,8 @@ void grid_neighbors(struct volume *world, struct surface_grid *grid, int idx,
           mcell_allocfailed("Failed to create grid for wall.");
       }
 
-      if (grid->sm_list[idx]->sm != NULL)
-        uv2xyz(&grid->sm_list[idx]->sm->s_pos, grid->surface, &loc_3d);
+      if (tile_sm_list(grid, idx)->sm != NULL)
+        uv2xyz(&tile_sm_list(grid, idx)->sm->s_pos, grid->surface, &loc_3d);
       else
         grid2xyz(grid, idx, &loc_3d);
       d = closest_interior_point(&loc_3d, grid->surface->nb_walls[2], &near_2d,
@@ -437,8 +698,8 @@ void grid_neighbors(struct volume *world, struct surface_grid *grid, int idx,
         if (create_grid(world, grid->surface->nb_walls[1], NULL))
           mcell_allocfailed("Failed to create grid for wall.");
       }
-      if (grid->sm_list[idx]->sm != NULL)
-        uv2xyz(&grid->sm_list[idx]->sm->s_pos, grid->surface, &loc_3d);
+      if (tile_sm_list(grid, idx)->sm != NULL)
+        uv2xyz(&tile_sm_list(grid, idx)->sm->s_pos, grid->surface, &loc_3d);
       else
         grid2xyz(grid, idx, &loc_3d);
       d = closest_interior_point(&loc_3d, grid->surface->nb_walls[1], &near_2d,
@@ -473,8 +734,8 @@ void grid_neighbors(struct volume *world, struct surface_grid *grid, int idx,
           mcell_allocfailed("Failed to create grid for wall.");
       }
 
-      if (grid->sm_list[idx]->sm != NULL)
-        uv2xyz(&grid->sm_list[idx]->sm->s_pos, grid->surface, &loc_3d);
+      if (tile_sm_list(grid, idx)->sm != NULL)
+        uv2xyz(&tile_sm_list(grid, idx)->sm->s_pos, grid->surface, &loc_3d);
       else
         grid2xyz(grid, idx, &loc_3d);
       d = closest_interior_point(&loc_3d, grid->surface->nb_walls[0], &near_2d,
@@ -546,7 +807,7 @@ int nearest_free(struct surface_grid *g, struct vector2 *v, double max_d2,
           h = (g->n - k) - 1;
           h = h * h + 2 * j + i;
 
-          if (!g->sm_list[h] || !g->sm_list[h]->sm) {
+          if (!tile_occupied(g, h)) {
             idx = h;
             d2 = fff;
           } else if (idx == -1) {
@@ -2978,26 +3239,18 @@ void find_shared_vertices_for_neighbor_walls(struct wall *orig_wall,
 }
 
 /**************************************************************************
-find_neighbor_tiles:
-  In: a surface molecule
-      surface grid of the wall where hit happens, or
-          surface molecule is located
-      index of the tile where hit happens, or surface molecule is located
-      flag that tells whether we need to create a grid on a neighbor wall
-      flag that tells whether we are searching for reactant
-          (value = 1) or doing product placement (value = 0)
-      a linked list of  neighbor tiles (return value)
-      a length of the linked list above (return value)
-  Out: The list of nearest neighbors are returned,
-       Neighbors should share either common edge or common vertex.
-  Note: This version allows looking for the neighbors at the neighbor walls
-       that are connected to the start wall through vertices only.
+compute_neighbor_tiles:
+  In: same as find_neighbor_tiles
+  Out: The list of nearest neighbors are returned, computed from the
+       geometry of the grid and of its neighbor walls.
 ****************************************************************************/
-void find_neighbor_tiles(struct volume *world, struct surface_molecule *sm,
-                         struct surface_grid *grid, int idx,
-                         int create_grid_flag, int search_for_reactant,
-                         struct tile_neighbor **tile_nbr_head,
-                         int *list_length) {
+static void compute_neighbor_tiles(struct volume *world,
+                                   struct surface_molecule *sm,
+                                   struct surface_grid *grid, int idx,
+                                   int create_grid_flag,
+                                   int search_for_reactant,
+                                   struct tile_neighbor **tile_nbr_head,
+                                   int *list_length) {
   int kk;
   struct tile_neighbor *tile_nbr_head_vert = NULL, *tmp_head = NULL;
   int list_length_vert = 0; /* length of the linked list */
@@ -3064,4 +3317,456 @@ void find_neighbor_tiles(struct volume *world, struct surface_molecule *sm,
   *list_length = tmp_list_length;
 }
 
+/* Neighbors of the tiles of one chunk of TILE_CHUNK_SIZE tiles, stored
+   row by row: the neighbors of the chunk's tile i are nbrs[first[i]] ..
+   nbrs[first[i + 1] - 1], in the order compute_neighbor_tiles() lists
+   them. */
+struct tile_nbr_rows {
+  u_int first[TILE_CHUNK_SIZE + 1];
+  struct tile_nbr nbrs[];
+};
+
+/* Neighbors of the tiles of one surface grid.  Rows are built a chunk at
+   a time on first lookup, so that a large sparse grid only pays for the
+   chunks molecules actually visit.  Neighbor walls that had no grid when
+   the table was created are kept in "missing"; once any of them gets a
+   grid the table is stale. */
+struct tile_nbr_table {
+  struct tile_nbr_rows **rows;
+  int n_missing;
+  struct wall **missing;
+};
+
+/**************************************************************************
+collect_missing_walls:
+  In: surface grid
+      array of walls (return value)
+  Out: Number of walls in the array.  These are the walls sharing an edge
+       or a vertex with the grid's wall that have no grid of their own.
+****************************************************************************/
+static int collect_missing_walls(struct volume *world,
+                                 struct surface_grid *grid,
+                                 struct wall ***missing) {
+  long long shared_vert[3] = { -1, -1, -1 };
+  u_int corners[3] = { 0, grid->n_tiles - 2 * grid->n + 1,
+                       grid->n_tiles - 1 };
+  struct wall_list *wall_nbr_head, *wl;
+  int kk, n = 0;
+
+  for (kk = 0; kk < 3; kk++)
+    find_shared_vertices_corner_tile_parent_wall(world, grid, corners[kk],
+                                                 shared_vert);
+  wall_nbr_head =
+      find_nbr_walls_shared_one_vertex(world, grid->surface, shared_vert);
+
+  for (kk = 0; kk < 3; kk++) {
+    if (grid->surface->nb_walls[kk] != NULL &&
+        grid->surface->nb_walls[kk]->grid == NULL)
+      n++;
+  }
+  for (wl = wall_nbr_head; wl != NULL; wl = wl->next) {
+    if (wl->this_wall->grid == NULL)
+      n++;
+  }
+
+  *missing = NULL;
+  if (n > 0) {
+    *missing = CHECKED_MALLOC_ARRAY(struct wall *, n, "tile neighbor table");
+    n = 0;
+    for (kk = 0; kk < 3; kk++) {
+      if (grid->surface->nb_walls[kk] != NULL &&
+          grid->surface->nb_walls[kk]->grid == NULL)
+        (*missing)[n++] = grid->surface->nb_walls[kk];
+    }
+    for (wl = wall_nbr_head; wl != NULL; wl = wl->next) {
+      if (wl->this_wall->grid == NULL)
+        (*missing)[n++] = wl->this_wall;
+    }
+  }
+
+  if (wall_nbr_head != NULL)
+    delete_wall_list(wall_nbr_head);
+
+  return n;
+}
+
+/**************************************************************************
+build_tile_nbr_table:
+  In: surface grid
+  Out: Empty neighbor table for the grid, with the neighbor walls that
+       have no grid recorded.
+****************************************************************************/
+static struct tile_nbr_table *build_tile_nbr_table(struct volume *world,
+                                                   struct surface_grid *grid) {
+  struct tile_nbr_table *table =
+      CHECKED_MALLOC_STRUCT(struct tile_nbr_table, "tile neighbor table");
+
+  table->rows = CHECKED_MALLOC_ARRAY(struct tile_nbr_rows *,
+                                     TILE_CHUNKS(grid->n_tiles),
+                                     "tile neighbor table");
+  for (u_int c = 0; c < TILE_CHUNKS(grid->n_tiles); c++)
+    table->rows[c] = NULL;
+
+  /* collected before any rows are built so that a grid created meanwhile
+     by another thread leaves the table stale rather than incomplete */
+  table->n_missing = collect_missing_walls(world, grid, &table->missing);
+  return table;
+}
+
+/**************************************************************************
+build_tile_nbr_rows:
+  In: surface grid
+      index of a chunk of tiles on that grid
+  Out: Neighbors of the tiles in the chunk.  They are looked up without
+       creating grids and without region border checks, which
+       get_tile_neighbors applies on top of the table.
+****************************************************************************/
+static struct tile_nbr_rows *build_tile_nbr_rows(struct volume *world,
+                                                 struct surface_grid *grid,
+                                                 u_int c) {
+  struct tile_neighbor *heads[TILE_CHUNK_SIZE], *curr;
+  struct tile_nbr_rows *rows;
+  u_int i, k, n, total = 0;
+  int list_length;
+
+  n = grid->n_tiles - c * TILE_CHUNK_SIZE;
+  if (n > TILE_CHUNK_SIZE)
+    n = TILE_CHUNK_SIZE;
+
+  for (i = 0; i < n; i++) {
+    compute_neighbor_tiles(world, NULL, grid, c * TILE_CHUNK_SIZE + i, 0, 0,
+                           &heads[i], &list_length);
+    total += list_length;
+  }
+
+  rows = (struct tile_nbr_rows *)CHECKED_MALLOC(
+      sizeof(struct tile_nbr_rows) + total * sizeof(struct tile_nbr),
+      "tile neighbor table");
+  for (i = 0, k = 0; i < n; i++) {
+    rows->first[i] = k;
+    for (curr = heads[i]; curr != NULL; curr = curr->next) {
+      rows->nbrs[k].grid = curr->grid;
+      rows->nbrs[k].idx = curr->idx;
+      k++;
+    }
+    delete_tile_neighbor_list(heads[i]);
+  }
+  for (; i <= TILE_CHUNK_SIZE; i++)
+    rows->first[i] = k;
+
+  return rows;
+}
+
+/**************************************************************************
+tile_nbr_table_is_current:
+  In: tile neighbor table
+  Out: 1 if none of the walls that lacked a grid at build time got one
+       since, 0 otherwise.
+****************************************************************************/
+static int tile_nbr_table_is_current(struct tile_nbr_table *table) {
+  for (int i = 0; i < table->n_missing; i++) {
+    if (table->missing[i]->grid != NULL)
+      return 0;
+  }
+  return 1;
+}
+
+/**************************************************************************
+free_tile_nbr_table:
+  In: surface grid
+  Out: The grid's tile neighbor table, if any, is freed.  It is rebuilt
+       on the next lookup.
+****************************************************************************/
+void free_tile_nbr_table(struct surface_grid *grid) {
+  struct tile_nbr_table *table = grid->nbr_table;
+  if (table == NULL)
+    return;
+
+  for (u_int c = 0; c < TILE_CHUNKS(grid->n_tiles); c++)
+    free(table->rows[c]);
+  free(table->rows);
+  free(table->missing);
+  free(table);
+  grid->nbr_table = NULL;
+}
+
+/**************************************************************************
+current_tile_nbr_table:
+  In: surface grid
+  Out: Up to date neighbor table of the grid, built or rebuilt if needed.
+       NULL if the table is stale but other threads may still be reading
+       it, in which case the caller computes the neighbors directly.
+****************************************************************************/
+static struct tile_nbr_table *current_tile_nbr_table(struct volume *world,
+                                                     struct surface_grid *grid) {
+  struct tile_nbr_table *table =
+      __atomic_load_n(&grid->nbr_table, __ATOMIC_ACQUIRE);
+
+  if (table != NULL && tile_nbr_table_is_current(table))
+    return table;
+  if (table != NULL && thread_can_defer())
+    return NULL;
+
+  thread_shared_lock(world);
+  table = grid->nbr_table;
+  if (table == NULL || !tile_nbr_table_is_current(table)) {
+    if (table != NULL && thread_can_defer()) {
+      thread_shared_unlock(world);
+      return NULL;
+    }
+    free_tile_nbr_table(grid);
+    table = build_tile_nbr_table(world, grid);
+    __atomic_store_n(&grid->nbr_table, table, __ATOMIC_RELEASE);
+  }
+  thread_shared_unlock(world);
+
+  return table;
+}
+
+/**************************************************************************
+current_tile_nbr_rows:
+  In: surface grid
+      its current neighbor table
+      index of a chunk of tiles on the grid
+  Out: Neighbor rows of the chunk, built if needed.
+****************************************************************************/
+static struct tile_nbr_rows *
+current_tile_nbr_rows(struct volume *world, struct surface_grid *grid,
+                      struct tile_nbr_table *table, u_int c) {
+  struct tile_nbr_rows *rows =
+      __atomic_load_n(&table->rows[c], __ATOMIC_ACQUIRE);
+
+  if (rows != NULL)
+    return rows;
+
+  thread_shared_lock(world);
+  rows = table->rows[c];
+  if (rows == NULL) {
+    rows = build_tile_nbr_rows(world, grid, c);
+    __atomic_store_n(&table->rows[c], rows, __ATOMIC_RELEASE);
+  }
+  thread_shared_unlock(world);
+
+  return rows;
+}
+
+/**************************************************************************
+create_neighbor_grids:
+  In: surface grid
+      index of the tile on that grid
+  Out: Grids are created on the neighbor walls of a border tile, the same
+       ones compute_neighbor_tiles() creates when asked to.
+****************************************************************************/
+static void create_neighbor_grids(struct volume *world,
+                                  struct surface_grid *grid, int idx) {
+  long long shared_vert[3] = { -1, -1, -1 };
+  struct wall_list *wall_nbr_head, *wl;
+  int kk;
+
+  if (is_corner_tile(grid, idx)) {
+    find_shared_vertices_corner_tile_parent_wall(world, grid, idx,
+                                                 shared_vert);
+    wall_nbr_head =
+        find_nbr_walls_shared_one_vertex(world, grid->surface, shared_vert);
+    for (wl = wall_nbr_head; wl != NULL; wl = wl->next) {
+      if (wl->this_wall->grid == NULL) {
+        if (create_grid(world, wl->this_wall, NULL))
+          mcell_allocfailed("Failed to allocate grid for wall.");
+      }
+    }
+    if (wall_nbr_head != NULL)
+      delete_wall_list(wall_nbr_head);
+  }
+
+  for (kk = 0; kk < 3; kk++) {
+    if ((grid->surface->nb_walls[kk] != NULL) &&
+        (grid->surface->nb_walls[kk]->grid == NULL)) {
+      if (create_grid(world, grid->surface->nb_walls[kk], NULL))
+        mcell_allocfailed("Failed to create grid for wall.");
+    }
+  }
+}
+
+/**************************************************************************
+tile_nbr_wall_blocked:
+  In: a surface molecule that can interact with region borders
+      restricted regions of the molecule's wall (may be NULL)
+      a neighbor wall
+  Out: 1 if the neighbor wall lies behind a restrictive region border
+       as seen by the molecule (INSIDE-OUT or OUTSIDE-IN), 0 otherwise.
+****************************************************************************/
+static int tile_nbr_wall_blocked(struct volume *world,
+                                 struct surface_molecule *sm,
+                                 struct region_list *rlp_head_own_wall,
+                                 struct wall *w) {
+  struct region_list *rlp_head_nbr_wall;
+  int blocked = 0;
+
+  if ((rlp_head_own_wall != NULL) &&
+      !wall_belongs_to_all_regions_in_region_list(w, rlp_head_own_wall))
+    return 1;
+
+  rlp_head_nbr_wall = find_restricted_regions_by_wall(world, w, sm);
+  if (rlp_head_nbr_wall != NULL) {
+    blocked = !wall_belongs_to_all_regions_in_region_list(sm->grid->surface,
+                                                          rlp_head_nbr_wall);
+    delete_void_list((struct void_list *)rlp_head_nbr_wall);
+  }
+
+  return blocked;
+}
+
+/**************************************************************************
+get_tile_neighbors:
+  In: same as find_neighbor_tiles
+      neighbor list (return value)
+  Out: The nearest neighbors of the tile, in the same order
+       find_neighbor_tiles lists them.  They are read from the grid's
+       neighbor table, whose rows are built per chunk of tiles on first
+       use.  Region borders are applied on top of the table for molecules
+       that can interact with them.  The list must be passed to
+       release_tile_neighbors.
+****************************************************************************/
+void get_tile_neighbors(struct volume *world, struct surface_molecule *sm,
+                        struct surface_grid *grid, int idx,
+                        int create_grid_flag, int search_for_reactant,
+                        struct tile_nbr_list *list) {
+  struct tile_nbr_table *table;
+  struct tile_nbr_rows *rows;
+  struct tile_nbr *nbrs;
+  int check_borders, n, i, k;
+
+  if ((u_int)idx >= grid->n_tiles) {
+    mcell_internal_error("Surface molecule tile index %u is greater than or "
+                         "equal of the number of tiles on the grid %u\n",
+                         (u_int)idx, grid->n_tiles);
+  }
+
+  table = __atomic_load_n(&grid->nbr_table, __ATOMIC_ACQUIRE);
+  if (create_grid_flag && (table == NULL || table->n_missing > 0) &&
+      !is_inner_tile(grid, idx))
+    create_neighbor_grids(world, grid, idx);
+
+  check_borders = search_for_reactant && (sm != NULL) &&
+                  (sm->properties->flags & CAN_REGION_BORDER);
+
+  /* the border checks are made against the molecule's own wall */
+  table = NULL;
+  if (!check_borders || grid == sm->grid)
+    table = current_tile_nbr_table(world, grid);
+
+  if (table == NULL) {
+    struct tile_neighbor *head = NULL, *curr;
+    compute_neighbor_tiles(world, sm, grid, idx, 0, search_for_reactant,
+                           &head, &n);
+    list->tiles = NULL;
+    list->n = n;
+    list->copied = 0;
+    if (n > 0) {
+      list->tiles =
+          CHECKED_MALLOC_ARRAY(struct tile_nbr, n, "tile neighbor list");
+      list->copied = 1;
+      for (curr = head, k = 0; curr != NULL; curr = curr->next, k++) {
+        list->tiles[k].grid = curr->grid;
+        list->tiles[k].idx = curr->idx;
+      }
+    }
+    delete_tile_neighbor_list(head);
+    return;
+  }
+
+  rows = current_tile_nbr_rows(world, grid, table, idx / TILE_CHUNK_SIZE);
+  i = idx % TILE_CHUNK_SIZE;
+  nbrs = rows->nbrs + rows->first[i];
+  n = rows->first[i + 1] - rows->first[i];
+  list->tiles = nbrs;
+  list->n = n;
+  list->copied = 0;
+
+  if (!check_borders)
+    return;
+
+  for (i = 0; i < n; i++) {
+    if (nbrs[i].grid != grid)
+      break;
+  }
+  if (i == n)
+    return;
+
+  /* some neighbors are on other walls */
+  struct region_list *rlp_head_own_wall =
+      find_restricted_regions_by_wall(world, grid->surface, sm);
+  struct wall *last_wall = NULL;
+  int last_blocked = 0;
+
+  list->tiles = CHECKED_MALLOC_ARRAY(struct tile_nbr, n, "tile neighbor list");
+  list->copied = 1;
+  for (i = 0, k = 0; i < n; i++) {
+    struct wall *w = nbrs[i].grid->surface;
+    if (w != grid->surface) {
+      if (w != last_wall) {
+        last_wall = w;
+        last_blocked = tile_nbr_wall_blocked(world, sm, rlp_head_own_wall, w);
+      }
+      if (last_blocked)
+        continue;
+    }
+    list->tiles[k++] = nbrs[i];
+  }
+  list->n = k;
+  if (k == 0)
+    release_tile_neighbors(list);
+
+  if (rlp_head_own_wall != NULL)
+    delete_void_list((struct void_list *)rlp_head_own_wall);
+}
+
+/**************************************************************************
+release_tile_neighbors:
+  In: neighbor list filled in by get_tile_neighbors
+  Out: none.  Memory owned by the list is freed.
+****************************************************************************/
+void release_tile_neighbors(struct tile_nbr_list *list) {
+  if (list->copied)
+    free(list->tiles);
+  list->tiles = NULL;
+  list->n = 0;
+  list->copied = 0;
+}
+
+/**************************************************************************
+find_neighbor_tiles:
+  In: a surface molecule
+      surface grid of the wall where hit happens, or
+          surface molecule is located
+      index of the tile where hit happens, or surface molecule is located
+      flag that tells whether we need to create a grid on a neighbor wall
+      flag that tells whether we are searching for reactant
+          (value = 1) or doing product placement (value = 0)
+      a linked list of  neighbor tiles (return value)
+      a length of the linked list above (return value)
+  Out: The list of nearest neighbors are returned,
+       Neighbors should share either common edge or common vertex.
+  Note: This version allows looking for the neighbors at the neighbor walls
+       that are connected to the start wall through vertices only.
+****************************************************************************/
+void find_neighbor_tiles(struct volume *world, struct surface_molecule *sm,
+                         struct surface_grid *grid, int idx,
+                         int create_grid_flag, int search_for_reactant,
+                         struct tile_neighbor **tile_nbr_head,
+                         int *list_length) {
+  struct tile_neighbor *head = NULL;
+  struct tile_nbr_list list;
+
+  get_tile_neighbors(world, sm, grid, idx, create_grid_flag,
+                     search_for_reactant, &list);
+
+  for (int i = list.n - 1; i >= 0; i--)
+    push_tile_neighbor_to_list(&head, list.tiles[i].grid, list.tiles[i].idx);
+
+  *tile_nbr_head = head;
+  *list_length = list.n;
+  release_tile_neighbors(&list);
+}
+
 
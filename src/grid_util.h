@@ -28,6 +28,22 @@
 
 #define TILE_CHECKED 0x01
 
+/* Number of 64-bit words in the occupancy bitset of a grid */
+#define TILE_OCCUPANCY_WORDS(n_tiles) (((n_tiles) + 63) / 64)
+
+/* Tiles per chunk of a sparse grid.  Small chunks keep scattered
+   molecules from touching most of the chunks. */
+#define TILE_CHUNK_SIZE 16
+#define TILE_CHUNKS(n_tiles) (((n_tiles) + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE)
+
+/* Grids with at least this many tiles are created sparse */
+#define SPARSE_GRID_MIN_TILES 1024
+
+/* A sparse grid becomes dense once more than 1/SPARSE_GRID_FILL_RATIO of
+   its chunks are allocated, i.e. at about 4% occupancy when molecules
+   are scattered at random */
+#define SPARSE_GRID_FILL_RATIO 2
+
 /* contains information about the neigbors of the tile */
 struct tile_neighbor {
   struct surface_grid *grid; /* surface grid the tile is on */
@@ -36,6 +52,22 @@ struct tile_neighbor {
   struct tile_neighbor *next;
 };
 
+/* One entry of a tile neighbor table */
+struct tile_nbr {
+  struct surface_grid *grid; /* surface grid the tile is on */
+  unsigned int idx;          /* index on that tile */
+};
+
+/* Neighbors of a single tile as returned by get_tile_neighbors.  "tiles"
+   points either into the grid's neighbor table or, when the table could
+   not be used as is, into a private copy that release_tile_neighbors
+   frees. */
+struct tile_nbr_list {
+  struct tile_nbr *tiles;
+  int n;
+  int copied;
+};
+
 void xyz2uv(struct vector3 *a, struct wall *w, struct vector2 *b);
 
 void uv2xyz(struct vector2 *a, struct wall *w, struct vector3 *b);
@@ -53,6 +85,8 @@ void grid2uv_random(struct surface_grid *sm, int idx, struct vector2 *v,
 
 void init_grid_geometry(struct surface_grid *sm);
 
+double max_tile_edge(struct volume *world);
+
 int create_grid(struct volume *world, struct wall *w, struct subvolume *guess);
 
 void grid_neighbors(struct volume *world, struct surface_grid *grid, int idx,
@@ -113,6 +147,47 @@ void find_neighbor_tiles(struct volume *world, struct surface_molecule *sm,
                          struct tile_neighbor **tile_nbr_head,
                          int *list_length);
 
+/* List of surface molecules on a tile, for dense and sparse grids alike */
+static inline struct surface_molecule_list *
+tile_sm_list(struct surface_grid *g, unsigned int idx) {
+  struct surface_molecule_list **chunk;
+
+  if (g->sm_list != NULL)
+    return g->sm_list[idx];
+
+  chunk = __atomic_load_n(&g->sm_chunks[idx / TILE_CHUNK_SIZE],
+                          __ATOMIC_ACQUIRE);
+  return (chunk != NULL) ? chunk[idx % TILE_CHUNK_SIZE] : NULL;
+}
+
+struct surface_molecule_list **tile_sm_slot(struct surface_grid *g,
+                                            unsigned int idx);
+
+void free_sparse_tiles(struct surface_grid *g);
+
+/* Nonzero if the tile holds a surface molecule (see update_tile_occupancy) */
+static inline int tile_occupied(struct surface_grid *g, unsigned int idx) {
+  return (__atomic_load_n(&g->occupancy[idx >> 6], __ATOMIC_RELAXED) >>
+          (idx & 63)) & 1;
+}
+
+void update_tile_occupancy(struct surface_grid *g, unsigned int idx);
+
+void recount_tile_occupancy(struct surface_grid *g);
+
+void tally_defunct_surface_molecule(struct surface_molecule *sm);
+
+unsigned int next_free_tile(struct surface_grid *g, unsigned int idx);
+
+void get_tile_neighbors(struct volume *world, struct surface_molecule *sm,
+                        struct surface_grid *grid, int tile_idx,
+                        int create_grid_flag, int search_for_reactant,
+                        struct tile_nbr_list *list);
+
+void release_tile_neighbors(struct tile_nbr_list *list);
+
+void free_tile_nbr_table(struct surface_grid *grid);
+
 void grid_all_neighbors_for_inner_tile(struct volume *world,
                                        struct surface_grid *grid, int idx,
                                        struct vector2 *pos,
@@ -49,6 +49,7 @@
 #include "viz_output.h"
 #include "react.h"
 #include "react_output.h"
+#include "diffuse.h"
 #include "chkpt.h"
 #include "init.h"
 #include "mdlparse_aux.h"
@@ -244,22 +245,10 @@ int init_variables(struct volume *world) {
   world->chkpt_flag = 0;
   world->disable_polygon_objects = 0;
   world->viz_blocks = NULL;
-  world->ray_voxel_tests = 0;
-  world->ray_polygon_tests = 0;
-  world->ray_polygon_colls = 0;
+  memset(&world->stats, 0, sizeof(struct sim_stats));
   world->dyngeom_molec_displacements = 0;
-  world->vol_vol_colls = 0;
-  world->vol_surf_colls = 0;
-  world->surf_surf_colls = 0;
-  world->vol_wall_colls = 0;
-  world->vol_vol_vol_colls = 0;
-  world->vol_vol_surf_colls = 0;
-  world->vol_surf_surf_colls = 0;
-  world->surf_surf_surf_colls = 0;
   world->chkpt_start_time_seconds = 0;
   world->chkpt_byte_order_mismatch = 0;
-  world->diffusion_number = 0;
-  world->diffusion_cumtime = 0.0;
   world->current_iterations = 0;
   world->elapsed_time = 0;
   world->time_unit = 0;
@@ -271,6 +260,8 @@ int init_variables(struct volume *world) {
   world->r_length_unit = sqrt(world->grid_density);
   world->length_unit = 1.0 / world->r_length_unit;
   world->rx_radius_3d = 0;
+  world->mol_grid_cell = 0;
+  world->max_tile_edge = 0;
   world->radial_directions = 16384;
   world->radial_subdivisions = 1024;
   world->fully_random = 0;
@@ -286,6 +277,9 @@ int init_variables(struct volume *world) {
   world->volume_output_scheduler = NULL;
   world->storage_head = NULL;
   world->storage_allocator = NULL;
+  world->active_stores = NULL;
+  world->n_active_stores = 0;
+  world->storage_time = 0.0;
   world->x_partitions = NULL;
   world->y_partitions = NULL;
   world->z_partitions = NULL;
@@ -308,6 +302,7 @@ int init_variables(struct volume *world) {
   world->volume_reversibility = 0;
   world->n_reactions = 0;
   world->current_mol_id = 0;
+  world->mol_id_stride = 1;
   world->dynamic_geometry_molecule_placement = 0;
 
   world->rxn_flags.vol_vol_reaction_flag = 0;
@@ -346,11 +341,15 @@ int init_data_structures(struct volume *world) {
   if (world->seed_seq < 1 || world->seed_seq > INT_MAX)
     mcell_error(
         "Random sequence number must be in the range 1 to 2^31-1 [2147483647]");
+  rng_set_counter_based(world->rng, world->counter_based_rng);
   rng_init(world->rng, world->seed_seq);
   if (world->notify->progress_report != NOTIFY_NONE)
-    mcell_log("MCell[%d]: random sequence %d", world->procnum, world->seed_seq);
+    mcell_log("MCell[%d]: random sequence %d%s", world->procnum,
+              world->seed_seq,
+              world->counter_based_rng ? " (Philox generator)" : "");
 
   world->count_hashmask = COUNT_HASHMASK;
+  world->n_counters = 0;
   if (!(world->count_hash =
             CHECKED_MALLOC_ARRAY(struct counter *, (world->count_hashmask + 1),
                                  "counter hash table"))) {
@@ -1261,9 +1260,11 @@ static int init_species_defaults(struct volume *world) {
     an approximate relation between, say, the number of edges and the number of
     walls (roughly a factor of 1.5 for triangular walls on a manifold surface).
 
-    Another possible improvement here might be to adaptively size the memory
-    arenas in the pooled allocators as we create objects.  The first arena may
-    be small, but each subsequent arena would be larger.
+    The pooled allocators do adapt a little: each arena is twice as large as
+    the one before it, until arenas fill a huge page, from which point they
+    are mapped in huge pages (see mem_util.c).  MEMORY_PARTITION_POOL sets
+    the size of the first arena directly, without the usual upper limit, so
+    a run known to be large can start out with huge-page arenas.
 
     Obviously, there are many more complicated things we could do, but it's not
     clear that they would gain us much.
@@ -1279,20 +1280,23 @@ static struct storage *create_storage(struct volume *world, int nsubvols) {
 
   if (world->mem_part_pool != 0)
     nsubvols = world->mem_part_pool;
+  else if (nsubvols > 4096)
+    nsubvols = 4096;
   if (nsubvols < 8)
     nsubvols = 8;
-  if (nsubvols > 4096)
-    nsubvols = 4096;
+  if (nsubvols > MAX_MEM_PART_POOL)
+    nsubvols = MAX_MEM_PART_POOL;
   /* We should tune the algorithm for selecting allocation block sizes.  */
   /* XXX: Round up to power of 2?  Shouldn't matter, I think. */
   if ((shared_mem->list = create_mem_named(sizeof(struct wall_list), nsubvols,
                                            "wall list")) == NULL)
     mcell_allocfailed("Failed to create memory pool for wall list.");
-  if ((shared_mem->mol = create_mem_named(sizeof(struct volume_molecule),
-                                          nsubvols, "vol mol")) == NULL)
+  /* Molecules find their pool from their address (see mem_birthplace) */
+  if ((shared_mem->mol = create_mem_tagged(sizeof(struct volume_molecule),
+                                           nsubvols, "vol mol")) == NULL)
     mcell_allocfailed("Failed to create memory pool for volume molecules.");
-  if ((shared_mem->smol = create_mem_named(sizeof(struct surface_molecule),
-                                           nsubvols, "surface mol")) == NULL)
+  if ((shared_mem->smol = create_mem_tagged(sizeof(struct surface_molecule),
+                                            nsubvols, "surface mol")) == NULL)
     mcell_allocfailed("Failed to create memory pool for surface molecules.");
   if ((shared_mem->face =
            create_mem_named(sizeof(struct wall), nsubvols, "wall")) == NULL)
@@ -1310,13 +1314,24 @@ static struct storage *create_storage(struct volume *world, int nsubvols) {
                                            "per species list")) == NULL)
     mcell_allocfailed(
         "Failed to create memory pool for per-species molecule lists.");
-  shared_mem->coll = world->coll_mem;
-  shared_mem->sp_coll = world->sp_coll_mem;
-  shared_mem->tri_coll = world->tri_coll_mem;
-  shared_mem->exdv = world->exdv_mem;
+  if (world->num_threads > 0) {
+    /* Storages run on different threads need their own scratch pools */
+    if ((shared_mem->exdv = create_mem_named(sizeof(struct exd_vertex), 64,
+                                             "exact disk vertex")) == NULL)
+      mcell_allocfailed("Failed to create memory pool for exact disk "
+                        "calculation vertices.");
+  } else {
+    shared_mem->exdv = world->exdv_mem;
+  }
 
-  if (world->chkpt_init) {
-    if ((shared_mem->timer = create_scheduler(1.0, 100.0, 100, 0.0)) == NULL)
+  /* In runs on several processes storages get their scheduler when first
+   * woken (see wake_storage), so that those of other processes never do */
+  if (world->chkpt_init && world->n_procs <= 1) {
+    if (world->ladder_scheduler)
+      shared_mem->timer = create_ladder_scheduler(1.0, 100, 0.0);
+    else
+      shared_mem->timer = create_scheduler(1.0, 100.0, 100, 0.0);
+    if (shared_mem->timer == NULL)
       mcell_allocfailed("Failed to create molecule scheduler.");
     shared_mem->current_time = 0.0;
   }
@@ -1360,6 +1375,216 @@ static void sanity_check_memory_subdivision(struct volume *world) {
   }
 }
 
+/********************************************************************
+ storage_reach_count:
+
+    Finds how many neighboring storages the reach box of a storage has to
+    include on either side along one axis, so that the reach box extends
+    at least the interaction margin beyond the storage.
+
+    In:  partitions: the partitions along the axis
+         n_parts: number of partitions along the axis
+         mem_part: number of subvolumes per storage along the axis
+         n_stores: number of storages along the axis
+         margin: interaction range that has to fit between a storage and
+                 the edge of its reach box
+    Out: The smallest r >= 1 such that any r consecutive storages span at
+         least margin, or n_stores if there is no such r.
+ *******************************************************************/
+int storage_reach_count(double const *partitions, int n_parts,
+                        int mem_part, int n_stores, double margin) {
+  for (int r = 1; r < n_stores; r++) {
+    int wide_enough = 1;
+    for (int s = 0; s + r <= n_stores && wide_enough; s++) {
+      int end = (s + r) * mem_part;
+      if (end > n_parts - 1)
+        end = n_parts - 1;
+      if (partitions[end] - partitions[s * mem_part] < margin)
+        wide_enough = 0;
+    }
+    if (wide_enough)
+      return r;
+  }
+  return (n_stores > 1) ? n_stores : 1;
+}
+
+/********************************************************************
+ mol_grid_cell_size:
+
+    Picks the edge of the cells of subvolume molecule grids (see
+    build_mol_grid): the interaction radius plus a long (99th percentile)
+    step of the fastest volume molecule that reacts with other volume
+    molecules.
+
+    In:  world: simulation state
+    Out: The edge of a cell, or 0 if no volume molecules react with each
+         other.
+ *******************************************************************/
+static double mol_grid_cell_size(struct volume *world) {
+  if (world->r_step == NULL)
+    return 0.0;
+
+  double max_step = 0.0;
+  for (int i = 0; i < world->n_species; i++) {
+    struct species *sp = world->species_list[i];
+    if (sp == world->all_mols || sp == world->all_volume_mols ||
+        sp == world->all_surface_mols)
+      continue;
+    if ((sp->flags & (ON_GRID | IS_SURFACE)) != 0 ||
+        (sp->flags & CAN_VOLVOL) == 0)
+      continue;
+    if (sp->space_step > max_step)
+      max_step = sp->space_step;
+  }
+  if (max_step == 0.0)
+    return 0.0;
+
+  max_step *=
+      world->r_step[(int)(world->radial_subdivisions * MULTISTEP_PERCENTILE)];
+  return world->rx_radius_3d + max_step;
+}
+
+/********************************************************************
+ set_storage_reach:
+
+    Records where a storage sits in the grid of storages.  The reach box
+    of a storage covers the storage itself plus world->storage_reach
+    neighboring storages on every side (extending to infinity at the edge
+    of the world).  Storages are colored by their position modulo
+    2 * reach + 1 along each axis, so two storages with the same color
+    never have overlapping reach boxes, which is what allows their
+    timesteps to run on different threads.
+
+    In:  world: simulation state
+         store: the storage
+         sx, sy, sz: position of the storage along each axis
+         nx, ny, nz: number of storages along each axis
+    Out: No return value.  The color and reach box of the storage are set.
+ *******************************************************************/
+static void set_storage_reach(struct volume *world, struct storage *store,
+                              int sx, int sy, int sz, int nx, int ny, int nz) {
+  int rx = world->storage_reach.x;
+  int ry = world->storage_reach.y;
+  int rz = world->storage_reach.z;
+  int cx = 2 * rx + 1, cy = 2 * ry + 1, cz = 2 * rz + 1;
+  store->color = (sx % cx) + cx * ((sy % cy) + cy * (sz % cz));
+
+  store->reach_llf.x = (sx - rx >= 0)
+      ? world->x_partitions[(sx - rx) * world->mem_part_x] : -GIGANTIC;
+  store->reach_llf.y = (sy - ry >= 0)
+      ? world->y_partitions[(sy - ry) * world->mem_part_y] : -GIGANTIC;
+  store->reach_llf.z = (sz - rz >= 0)
+      ? world->z_partitions[(sz - rz) * world->mem_part_z] : -GIGANTIC;
+  store->reach_urb.x = (sx + rx + 1 < nx)
+      ? world->x_partitions[(sx + rx + 1) * world->mem_part_x] : GIGANTIC;
+  store->reach_urb.y = (sy + ry + 1 < ny)
+      ? world->y_partitions[(sy + ry + 1) * world->mem_part_y] : GIGANTIC;
+  store->reach_urb.z = (sz + rz + 1 < nz)
+      ? world->z_partitions[(sz + rz + 1) * world->mem_part_z] : GIGANTIC;
+}
+
+/********************************************************************
+ init_storage_colors:
+
+    Colors the storages so that same-colored ones are out of reach of
+    each other (see set_storage_reach).  How far a step may touch depends
+    on the size of the surface tiles, so this waits until the walls are
+    in place, and is redone whenever they are replaced.
+
+    In:  world: simulation state, with its storages and walls
+    Out: No return value.  The reach and colors of the storages are set,
+         and the margin of the thread pool if there is one.
+ *******************************************************************/
+void init_storage_colors(struct volume *world) {
+  int nx = (world->nx_parts + (world->mem_part_x) - 2) / (world->mem_part_x);
+  int ny = (world->ny_parts + (world->mem_part_y) - 2) / (world->mem_part_y);
+  int nz = (world->nz_parts + (world->mem_part_z) - 2) / (world->mem_part_z);
+
+  world->max_tile_edge = max_tile_edge(world);
+  double margin = thread_interaction_margin(world);
+  if (world->thread_pool != NULL)
+    world->thread_pool->margin = margin;
+
+  world->storage_reach.x = storage_reach_count(
+      world->x_partitions, world->nx_parts, world->mem_part_x, nx, margin);
+  world->storage_reach.y = storage_reach_count(
+      world->y_partitions, world->ny_parts, world->mem_part_y, ny, margin);
+  world->storage_reach.z = storage_reach_count(
+      world->z_partitions, world->nz_parts, world->mem_part_z, nz, margin);
+  world->n_storage_colors = (2 * world->storage_reach.x + 1) *
+                            (2 * world->storage_reach.y + 1) *
+                            (2 * world->storage_reach.z + 1);
+  if (world->num_threads > 0 &&
+      world->notify->progress_report != NOTIFY_NONE)
+    mcell_log("Running memory partitions in %d colors (reach %d,%d,%d).",
+              world->n_storage_colors, world->storage_reach.x,
+              world->storage_reach.y, world->storage_reach.z);
+
+  /* Storages are numbered along x first, like in init_partitions */
+  for (struct storage_list *sl = world->storage_head; sl != NULL;
+       sl = sl->next) {
+    int i = sl->store->index;
+    set_storage_reach(world, sl->store, i % nx, (i / nx) % ny, i / (nx * ny),
+                      nx, ny, nz);
+  }
+}
+
+/********************************************************************
+ init_storage_streams:
+
+    Hands every storage its own random number stream and molecule id
+    counter, so that a threaded run gives the same results no matter how
+    many threads execute it.  Ids are interleaved: the world counter (used
+    by releases and other serial code) gives out multiples of the stride
+    and storage i gives out ids equal to i + 1 modulo the stride.
+
+    The streams always use the counter-based generator (where the build
+    has it), whatever the world's generator: a step deferred by a worker
+    has to be replayed with the numbers it first drew (see run_timestep).
+
+    The streams are kept by the world rather than by the storages, since
+    dynamic geometry rebuilds the storages.  If the number of storages
+    changes, fresh streams are seeded and the id counters restart above
+    every id given out so far.
+
+    In:  world: simulation state
+         stores: the storages, indexed by position in the grid of storages
+         n_stores: number of storages
+    Out: No return value.
+ *******************************************************************/
+static void init_storage_streams(struct volume *world, struct storage **stores,
+                                 int n_stores) {
+  if (world->n_storage_streams != n_stores) {
+    u_long next_id = world->current_mol_id;
+    for (int i = 0; i < world->n_storage_streams; i++) {
+      if (world->storage_streams[i].next_mol_id > next_id)
+        next_id = world->storage_streams[i].next_mol_id;
+    }
+    merge_storage_stats(world);
+    destroy_count_shards(world);
+    free(world->storage_streams);
+
+    world->storage_streams = CHECKED_MALLOC_ARRAY(
+        struct storage_stream, n_stores, "storage random number streams");
+    memset(world->storage_streams, 0,
+           n_stores * sizeof(struct storage_stream));
+    world->n_storage_streams = n_stores;
+    world->mol_id_stride = n_stores + 1;
+    if (next_id % world->mol_id_stride != 0)
+      next_id += world->mol_id_stride - next_id % world->mol_id_stride;
+    world->current_mol_id = next_id;
+    for (int i = 0; i < n_stores; i++) {
+      rng_set_counter_based(&world->storage_streams[i].rng, 1);
+      rng_init_stream(&world->storage_streams[i].rng, world->seed_seq,
+                      ++world->n_streams_seeded);
+      world->storage_streams[i].next_mol_id = next_id + i + 1;
+    }
+  }
+
+  for (int i = 0; i < n_stores; i++)
+    stores[i]->stream = &world->storage_streams[i];
+}
+
 /********************************************************************
  init_partitions:
 
@@ -1428,17 +1653,6 @@ int init_partitions(struct volume *world) {
   sanity_check_memory_subdivision(world);
 
   /* Allocate the data structures which are shared between storages */
-  if ((world->coll_mem = create_mem_named(sizeof(struct collision), 128,
-                                          "collision")) == NULL)
-    mcell_allocfailed("Failed to create memory pool for collisions.");
-  if ((world->sp_coll_mem = create_mem_named(sizeof(struct sp_collision), 128,
-                                             "sp collision")) == NULL)
-    mcell_allocfailed(
-        "Failed to create memory pool for trimolecular-pathway collisions.");
-  if ((world->tri_coll_mem = create_mem_named(sizeof(struct tri_collision), 128,
-                                              "tri collision")) == NULL)
-    mcell_allocfailed(
-        "Failed to create memory pool for trimolecular collisions.");
   if ((world->exdv_mem = create_mem_named(sizeof(struct exd_vertex), 64,
                                           "exact disk vertex")) == NULL)
     mcell_allocfailed(
@@ -1458,7 +1672,11 @@ int init_partitions(struct volume *world) {
                             "storage allocator")) == NULL)
     mcell_allocfailed("Failed to create memory pool for storage list.");
 
-  /* Allocate the storages */
+  /* Allocate the storages.  They all start out idle. */
+  free(world->active_stores);
+  world->active_stores = CHECKED_MALLOC_ARRAY(
+      struct storage *, nx * ny * nz, "list of active storages");
+  world->n_active_stores = 0;
   struct storage *shared_mem[nx * ny * nz];
   int cx = 0, cy = 0, cz = 0;
   for (int i = 0; i < nx * ny * nz; ++i) {
@@ -1481,6 +1699,7 @@ int init_partitions(struct volume *world) {
     /* Allocate this storage */
     if ((shared_mem[i] = create_storage(world, xd * yd * zd)) == NULL)
       mcell_internal_error("Unknown error while creating a storage.");
+    shared_mem[i]->index = i;
 
     /* Add to the storage list */
     struct storage_list *l = (struct storage_list *)CHECKED_MEM_GET(
@@ -1489,6 +1708,8 @@ int init_partitions(struct volume *world) {
     l->store = shared_mem[i];
     world->storage_head = l;
   }
+  if (world->num_threads > 0)
+    init_storage_streams(world, shared_mem, nx * ny * nz);
 
   /* Initialize each subvolume */
   for (int i = 0; i < world->nx_parts - 1; i++)
@@ -1497,6 +1718,8 @@ int init_partitions(struct volume *world) {
         int h = k + (world->nz_parts - 1) * (j + (world->ny_parts - 1) * i);
         struct subvolume *sv = &(world->subvol[h]);
         sv->wall_head = NULL;
+        sv->wall_table = NULL;
+        sv->mol_grid = NULL;
         memset(&sv->mol_by_species, 0, sizeof(struct pointer_hash));
         sv->species_head = NULL;
         sv->mol_count = 0;
@@ -1537,6 +1760,8 @@ int init_partitions(struct volume *world) {
             nx * (j / (world->mem_part_y) + ny * (k / (world->mem_part_z)));
         sv->local_storage = shared_mem[shidx];
       }
+
+  world->mol_grid_cell = mol_grid_cell_size(world);
   return 0;
 }
 
@@ -2762,7 +2987,7 @@ int init_surf_mols_by_density(struct volume *world, struct wall *w,
 
   if (world->chkpt_init) {
     for (unsigned int n_tile = 0; n_tile < n_tiles; ++n_tile) {
-      if (sg->sm_list[n_tile] && sg->sm_list[n_tile]->sm)
+      if (tile_occupied(sg, n_tile))
         continue;
 
       int p_index = -1;
@@ -2877,13 +3102,14 @@ int init_surf_mols_by_number(struct volume *world, struct object *objp,
           struct wall *w = objp->wall_p[n_wall];
           struct surface_grid *sg = w->grid;
           if (sg != NULL) {
-            for (unsigned int n_tile = 0; n_tile < sg->n_tiles; n_tile++) {
-              if (sg->sm_list[n_tile] == NULL || sg->sm_list[n_tile]->sm == NULL) {
-                sg->sm_list[n_tile] = add_surfmol_with_unique_pb_to_list(sg->sm_list[n_tile], NULL);
-                tiles[n_slot] = &(sg->sm_list[n_tile]->sm);
-                idx[n_slot] = n_tile;
-                walls[n_slot++] = w;
-              }
+            for (unsigned int n_tile = next_free_tile(sg, 0);
+                 n_tile < sg->n_tiles;
+                 n_tile = next_free_tile(sg, n_tile + 1)) {
+              *tile_sm_slot(sg, n_tile) = add_surfmol_with_unique_pb_to_list(
+                  tile_sm_list(sg, n_tile), NULL);
+              tiles[n_slot] = &(tile_sm_list(sg, n_tile)->sm);
+              idx[n_slot] = n_tile;
+              walls[n_slot++] = w;
             }
           }
         }
@@ -3027,17 +3253,12 @@ int init_surf_mols_by_number(struct volume *world, struct object *objp,
             n_free_sm = n_free_sm - n_set;
           }
 
-          /* update n_occupied for each surface molecule grid */
+          /* update n_occupied and the occupancy bits of each grid */
           for (int n_wall = 0; n_wall < rp->membership->nbits; n_wall++) {
             if (get_bit(rp->membership, n_wall)) {
               struct surface_grid *sg = objp->wall_p[n_wall]->grid;
-              if (sg != NULL) {
-                sg->n_occupied = 0;
-                for (unsigned int n_tile = 0; n_tile < sg->n_tiles; ++n_tile) {
-                  if (sg->sm_list[n_tile]->sm != NULL)
-                    sg->n_occupied++;
-                }
-              }
+              if (sg != NULL)
+                recount_tile_occupancy(sg);
             }
           }
         }
@@ -3181,18 +3402,12 @@ int init_surf_mols_by_number(struct volume *world, struct object *objp,
               n_free_sm = n_free_sm - n_set;
             }
 
-            /* update n_occupied for each surface molecule grid */
+            /* update n_occupied and the occupancy bits of each grid */
             for (int n_wall = 0; n_wall < rp->membership->nbits; n_wall++) {
               if (get_bit(rp->membership, n_wall)) {
                 struct surface_grid *sg = objp->wall_p[n_wall]->grid;
-                if (sg != NULL) {
-                  sg->n_occupied = 0;
-                  for (unsigned int n_tile = 0; n_tile < sg->n_tiles;
-                       ++n_tile) {
-                    if (sg->sm_list[n_tile]->sm != NULL)
-                      sg->n_occupied++;
-                  }
-                }
+                if (sg != NULL)
+                  recount_tile_occupancy(sg);
               }
             }
           }
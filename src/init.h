@@ -32,7 +32,10 @@ int init_data_structures(struct volume *world);
 int init_species(struct volume *world);
 int init_bounding_box(struct volume *world);
 int init_partitions(struct volume *world);
+int storage_reach_count(double const *partitions, int n_parts,
+                        int mem_part, int n_stores, double margin);
 int init_vertices_walls(struct volume *world);
+void init_storage_colors(struct volume *world);
 int init_regions(struct volume *world);
 int init_checkpoint_state(struct volume *world, long long *exec_iterations);
 int init_viz_data(struct volume *world);
@@ -93,6 +93,12 @@ void isaac64_generate(struct isaac64_state *rng) {
 }
 
 void isaac64_init(struct isaac64_state *rng, ub4 seed) {
+  isaac64_init_stream(rng, seed, 0);
+}
+
+/* Seeds one of many independent sequences derived from the same seed;
+   stream 0 is the sequence produced by isaac64_init. */
+void isaac64_init_stream(struct isaac64_state *rng, ub4 seed, ub4 stream) {
   ub8 *r, *m;
   ub8 a, b, c, d, e, f, g, h;
   ub4 i;
@@ -112,6 +118,7 @@ void isaac64_init(struct isaac64_state *rng, ub4 seed) {
     r[i] = (ub8)0;
 
   r[0] = seed;
+  r[1] = stream;
 
   for (i = 0; i < 4; ++i) /* scramble it */
   {
@@ -59,6 +59,7 @@ struct isaac64_state {
 };
 
 void isaac64_init(struct isaac64_state *rng, ub4 seed);
+void isaac64_init_stream(struct isaac64_state *rng, ub4 seed, ub4 stream);
 
 void isaac64_generate(struct isaac64_state *rng);
 
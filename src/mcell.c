@@ -28,6 +28,7 @@
 #include "mcell_init.h"
 #include "mcell_misc.h"
 #include "mcell_run.h"
+#include "domain_util.h"
 //#include "api_test.h"
 
 #define CHECKED_CALL_EXIT(function, error_message)                             \
@@ -39,15 +40,16 @@
   }
 
 int main(int argc, char **argv) {
-  u_int procnum = 0;
-
   // initialize the mcell simulation
   MCELL_STATE *state = mcell_create();
   CHECKED_CALL_EXIT(!state, "Failed to initialize MCell simulation.");
 
+  // Join the other processes of a distributed run, if any.
+  domain_startup(&argc, &argv, state);
+
   // Parse the command line arguments and print out errors if necessary.
   if (mcell_argparse(argc, argv, state)) {
-    if (procnum == 0) {
+    if (state->procnum == 0) {
       mcell_print_version();
       mcell_print_usage(argv[0]);
     }
@@ -87,5 +89,6 @@ int main(int argc, char **argv) {
 
   mcell_print_stats();
 
+  domain_shutdown();
   exit(0);
 }
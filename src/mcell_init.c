@@ -47,8 +47,10 @@
 #include "mcell_init.h"
 #include "mcell_misc.h"
 #include "mcell_reactions.h"
+#include "react.h"
 #include "dyngeom.h"
 #include "chkpt.h"
+#include "domain_util.h"
 
 /* simple wrapper for executing the supplied function call. In case
  * of an error returns with MCELL_FAIL and prints out error_message */
@@ -66,6 +68,8 @@ static int install_usr_signal_handlers(void);
 static bool has_micro_rev_and_trimol_rxns(struct species **species_list,
   int n_species, byte has_vol_rev, byte has_surf_rev);
 
+static bool has_rxn_triggered_releases(struct object *objp);
+
 /************************************************************************
  *
  * function for initializing the main mcell simulator. MCELL_STATE
@@ -95,6 +99,7 @@ MCELL_STATE *mcell_create() {
 #endif
 
   state->procnum = 0;
+  state->n_procs = 1;
   state->rx_hashsize = 0;
   state->iterations = INT_MIN; /* indicates iterations not set */
   state->chkpt_infile = NULL;
@@ -103,6 +108,7 @@ MCELL_STATE *mcell_create() {
   state->log_freq =
       ULONG_MAX; /* Indicates that this value has not been set by user */
   state->seed_seq = 1;
+  state->num_threads = -1; /* indicates number of threads not set */
   state->with_checks_flag = 1;
 
   time_t begin_time_of_day;
@@ -177,6 +183,10 @@ mcell_init_simulation(MCELL_STATE *state) {
 
   CHECKED_CALL(init_species(state), "Error initializing species.");
 
+  CHECKED_CALL(init_reaction_pairs(state->reaction_hash, state->rx_hashsize,
+                                   state->species_list, state->n_species),
+               "Error tabulating reaction partners.");
+
   if (has_micro_rev_and_trimol_rxns(state->species_list, state->n_species,
     state->volume_reversibility, state->surface_reversibility)) {
     mcell_error("Tri-molecular reactions can not be combined with microscopic "
@@ -186,10 +196,29 @@ mcell_init_simulation(MCELL_STATE *state) {
   if (state->notify->progress_report != NOTIFY_NONE)
     mcell_log("Creating geometry (this may take some time)");
 
+  if (state->num_threads < 0)
+    state->num_threads = 0;
+  /* Distributed runs step their storages the way threaded runs do */
+  if (state->n_procs > 1 && state->num_threads == 0)
+    state->num_threads = 1;
+  if (state->num_threads > 0 && state->periodic_box_obj != NULL) {
+    mcell_warn("Periodic boundary conditions do not support threaded "
+               "execution. Running serially.");
+    state->num_threads = 0;
+  }
+  /* A triggered release may place molecules anywhere in the world */
+  if (state->num_threads > 0 &&
+      has_rxn_triggered_releases(state->root_instance)) {
+    mcell_warn("Releases triggered by reactions do not support threaded "
+               "execution. Running serially.");
+    state->num_threads = 0;
+  }
+
   CHECKED_CALL(init_bounding_box(state), "Error initializing bounding box.");
   CHECKED_CALL(init_partitions(state), "Error initializing partitions.");
   CHECKED_CALL(init_vertices_walls(state),
                "Error initializing vertices and walls.");
+  init_storage_colors(state);
   CHECKED_CALL(init_regions(state), "Error initializing regions.");
 
   if (state->place_waypoints_flag) {
@@ -213,6 +242,14 @@ mcell_init_simulation(MCELL_STATE *state) {
   CHECKED_CALL(init_counter_name_hash(
       &state->counter_by_name, state->output_block_head),
       "Error while initializing counter name hash.");
+
+  if (state->num_threads > 0) {
+    if (state->notify->progress_report != NOTIFY_NONE)
+      mcell_log("Running memory partitions on %d threads.",
+                state->num_threads);
+    state->thread_pool = create_thread_pool(state, state->num_threads);
+  }
+  domain_init(state);
   
   /*CHECKED_CALL(init_dynamic_geometry(state),*/
   /*             "Error while initializing scheduled changes in geometry.");*/
@@ -241,6 +278,7 @@ mcell_redo_geom(MCELL_STATE *state) {
   // memory cleanup.
   state->dynamic_geometry_flag = 1;
 
+  merge_count_deltas(state);
   CHECKED_CALL(reset_current_counts(
     state->mol_sym_table,
     state->count_hashmask,
@@ -277,6 +315,7 @@ mcell_redo_geom(MCELL_STATE *state) {
   CHECKED_CALL(init_partitions(state), "Error initializing partitions.");
   CHECKED_CALL(init_vertices_walls(state),
                "Error initializing vertices and walls.");
+  init_storage_colors(state);
   CHECKED_CALL(init_regions(state), "Error initializing regions.");
 
 
@@ -465,6 +504,78 @@ mcell_set_time_step(MCELL_STATE *state, double step) {
   return MCELL_SUCCESS;
 }
 
+/*************************************************************************
+ mcell_set_num_threads:
+    Set the number of threads used to run the timesteps of the memory
+    partitions.
+
+ In: state: the simulation state
+     num_threads: number of threads (0 runs everything on the main thread)
+ Out: 0 on success; 1 on failure.
+      number of threads is set.
+*************************************************************************/
+MCELL_STATUS
+mcell_set_num_threads(MCELL_STATE *state, int num_threads) {
+  if (num_threads < 0) {
+    return MCELL_FAIL;
+  }
+  state->num_threads = num_threads;
+  return MCELL_SUCCESS;
+}
+
+/*************************************************************************
+ mcell_set_counter_based_rng:
+    Choose between the isaac64 and the counter-based Philox random number
+    generator.  Must be called before the simulation is initialized.
+
+ In: state: the simulation state
+     counter_based: 1 for Philox, 0 for isaac64
+ Out: 0 on success; 1 on failure (Philox is not available in builds using
+      the minimal generator).
+*************************************************************************/
+MCELL_STATUS
+mcell_set_counter_based_rng(MCELL_STATE *state, int counter_based) {
+#ifdef USE_MINIMAL_RNG
+  if (counter_based)
+    return MCELL_FAIL;
+#endif
+  state->counter_based_rng = (counter_based != 0);
+  return MCELL_SUCCESS;
+}
+
+/*************************************************************************
+ mcell_set_ladder_scheduler:
+    Choose between the multi-scale scheduler and a ladder queue for the
+    molecules of every memory partition.  Must be called before the
+    simulation is initialized.
+
+ In: state: the simulation state
+     ladder: 1 for ladder queues, 0 for the multi-scale scheduler
+ Out: 0 on success; 1 on failure.
+*************************************************************************/
+MCELL_STATUS
+mcell_set_ladder_scheduler(MCELL_STATE *state, int ladder) {
+  state->ladder_scheduler = (ladder != 0);
+  return MCELL_SUCCESS;
+}
+
+/*************************************************************************
+ mcell_set_reorder_interval:
+    Set how often the scheduled molecules are sorted along a space-filling
+    curve (see reorder_molecules).
+
+ In: state: the simulation state
+     interval: iterations between two passes (0 never sorts them)
+ Out: 0 on success; 1 on failure.
+*************************************************************************/
+MCELL_STATUS
+mcell_set_reorder_interval(MCELL_STATE *state, long long interval) {
+  if (interval < 0)
+    return MCELL_FAIL;
+  state->reorder_interval = interval;
+  return MCELL_SUCCESS;
+}
+
 /*****************************************************************************
  *
  * static helper functions
@@ -523,3 +634,29 @@ bool has_micro_rev_and_trimol_rxns(struct species **species_list,
   }
   return false;
 }
+
+
+/*
+ * has_rxn_triggered_releases tests if any release site instantiated below
+ * objp is triggered by a reaction (has a reaction as its release pattern).
+ * In that case it returns true and false otherwise.
+ */
+bool has_rxn_triggered_releases(struct object *objp) {
+  if (objp == NULL)
+    return false;
+
+  if (objp->object_type == REL_SITE_OBJ) {
+    struct release_site_obj *rsop = (struct release_site_obj *)objp->contents;
+    return !distinguishable(rsop->release_prob, MAGIC_PATTERN_PROBABILITY,
+                            EPS_C);
+  }
+
+  if (objp->object_type == META_OBJ) {
+    for (struct object *child_objp = objp->first_child; child_objp != NULL;
+         child_objp = child_objp->next) {
+      if (has_rxn_triggered_releases(child_objp))
+        return true;
+    }
+  }
+  return false;
+}
@@ -54,3 +54,13 @@ MCELL_STATUS mcell_set_partition(MCELL_STATE *state, int dim,
 MCELL_STATUS mcell_set_time_step(MCELL_STATE *state, double step);
 
 MCELL_STATUS mcell_set_iterations(MCELL_STATE *state, long long iterations);
+
+MCELL_STATUS mcell_set_num_threads(MCELL_STATE *state, int num_threads);
+
+MCELL_STATUS mcell_set_counter_based_rng(MCELL_STATE *state,
+                                         int counter_based);
+
+MCELL_STATUS mcell_set_ladder_scheduler(MCELL_STATE *state, int ladder);
+
+MCELL_STATUS mcell_set_reorder_interval(MCELL_STATE *state,
+                                        long long interval);
@@ -24,6 +24,8 @@
 #include <assert.h>
 #include <float.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #ifndef _WIN32
@@ -36,6 +38,7 @@
 #include "sym_table.h"
 #include "logging.h"
 #include "vol_util.h"
+#include "count_util.h"
 #include "react_output.h"
 #include "viz_output.h"
 #include "volume_output.h"
@@ -44,6 +47,7 @@
 #include "chkpt.h"
 #include "argparse.h"
 #include "dyngeom.h"
+#include "domain_util.h"
 
 #include "mcell_run.h"
 
@@ -296,6 +300,340 @@ static int print_molecule_collision_report(
   return 0;
 }
 
+/* How many percent fewer 'after' is than 'before' */
+static double percent_fewer(long long before, long long after) {
+  if (before == 0)
+    return 0.0;
+  return 100.0 * (double)(before - after) / (double)before;
+}
+
+/***********************************************************************
+ print_molecule_memory_report:
+
+    Log every byte a live volume and surface molecule takes: its record,
+    its slot in the packed arrays of its species list, its slot in the
+    molecule grid of its subvolume, and the tile list entry of a surface
+    molecule.  Then log how much memory the storages have reserved for
+    all of these, and what that comes to per live molecule.  If molecules
+    were reordered, also log how much closer together that brought the
+    molecules run one after the other.
+ ***********************************************************************/
+static void print_molecule_memory_report(struct volume *world) {
+  long long n_vol = 0, n_gridded = 0, n_surf = 0;
+  size_t packed_reserved = 0, grid_reserved = 0;
+  for (int i = 0; i < world->n_subvols; i++) {
+    struct subvolume *sv = &world->subvol[i];
+    for (struct per_species_list *psl = sv->species_head; psl != NULL;
+         psl = psl->next) {
+      n_vol += psl->n_packed;
+      if (sv->mol_grid != NULL)
+        n_gridded += psl->n_packed;
+      if (psl->max_packed > MIN_PACKED_MOLECULES)
+        packed_reserved += psl->max_packed * PACKED_SLOT_SIZE;
+    }
+
+    struct mol_grid *grid = sv->mol_grid;
+    if (grid == NULL)
+      continue;
+    int n_cells = grid->nx * grid->ny * grid->nz;
+    grid_reserved += sizeof(struct mol_grid) + n_cells * sizeof(struct mol_cell);
+    for (int c = 0; c < n_cells; c++)
+      grid_reserved += grid->cells[c].max_mols * CELL_SLOT_SIZE;
+  }
+  for (int i = 0; i < world->n_species; i++) {
+    struct species *spec = world->species_list[i];
+    if (spec->flags & ON_GRID)
+      n_surf += spec->population;
+  }
+
+  size_t record_reserved = 0, list_reserved = 0, surf_reserved = 0;
+  for (struct storage_list *sl = world->storage_head; sl != NULL;
+       sl = sl->next) {
+    record_reserved += mem_footprint(sl->store->mol);
+    list_reserved += mem_footprint(sl->store->pslv);
+    surf_reserved += mem_footprint(sl->store->smol);
+  }
+  size_t vol_reserved =
+      record_reserved + list_reserved + packed_reserved + grid_reserved;
+  surf_reserved += n_surf * sizeof(struct surface_molecule_list);
+
+  mcell_log_raw("\n");
+  mcell_log("\tMolecule Memory");
+  mcell_log("Volume molecule: %zu bytes, plus %zu in its species list "
+            "and %zu in a molecule grid",
+            sizeof(struct volume_molecule), (size_t)PACKED_SLOT_SIZE,
+            (size_t)CELL_SLOT_SIZE);
+  mcell_log("Surface molecule: %zu bytes, plus %zu in its tile list",
+            sizeof(struct surface_molecule),
+            sizeof(struct surface_molecule_list));
+  mcell_log("Volume molecules: %lld live (%lld in molecule grids), "
+            "%.1f MB live, %.1f MB reserved",
+            n_vol, n_gridded,
+            (n_vol * (sizeof(struct volume_molecule) + PACKED_SLOT_SIZE) +
+             n_gridded * CELL_SLOT_SIZE) / 1048576.0,
+            vol_reserved / 1048576.0);
+  mcell_log("  reserved: %.1f MB records, %.1f MB species lists, "
+            "%.1f MB packed arrays, %.1f MB molecule grids",
+            record_reserved / 1048576.0, list_reserved / 1048576.0, packed_reserved / 1048576.0,
+            grid_reserved / 1048576.0);
+  if (n_vol > 0)
+    mcell_log("  %.1f bytes reserved per live volume molecule",
+              (double)vol_reserved / n_vol);
+  mcell_log("Surface molecules: %lld live, %.1f MB reserved", n_surf,
+            surf_reserved / 1048576.0);
+  if (n_surf > 0)
+    mcell_log("  %.1f bytes reserved per live surface molecule",
+              (double)surf_reserved / n_surf);
+
+  struct reorder_stats *rs = &world->reorder_stats;
+  if (rs->passes > 0) {
+    mcell_log("Reordered %lld molecules in %lld passes", rs->molecules,
+              rs->passes);
+    mcell_log("Page switches along the scheduling order: %lld before, "
+              "%lld after (%.1f%% fewer)",
+              rs->page_switches_before, rs->page_switches_after,
+              percent_fewer(rs->page_switches_before,
+                            rs->page_switches_after));
+    mcell_log("Subvolume switches along the scheduling order: %lld before, "
+              "%lld after (%.1f%% fewer)",
+              rs->subvol_switches_before, rs->subvol_switches_after,
+              percent_fewer(rs->subvol_switches_before,
+                            rs->subvol_switches_after));
+  }
+  mcell_log_raw("\n");
+}
+
+/* Batch of same-colored storages whose timesteps run concurrently */
+struct timestep_batch {
+  struct volume *world;
+  struct storage **stores; /* Most scheduled molecules first */
+  double release_time;
+  double checkpt_time;
+};
+
+/***********************************************************************
+ compare_storage_load:
+
+    qsort comparison putting storages with more molecules due in the
+    current time slot first, and storages with equal load by index.
+ ***********************************************************************/
+static int compare_storage_load(const void *a, const void *b) {
+  struct storage *sa = *(struct storage * const *)a;
+  struct storage *sb = *(struct storage * const *)b;
+  if (sa->timer->current_count != sb->timer->current_count)
+    return (sa->timer->current_count > sb->timer->current_count) ? -1 : 1;
+  return (sa->index > sb->index) - (sa->index < sb->index);
+}
+
+/***********************************************************************
+ run_timestep_task:
+
+    Thread pool task running the timestep of one storage of a batch.
+
+ In: data: the timestep_batch
+     task: index of the storage within the batch
+     ts: state of the thread running the task
+ Out: none.  Molecules whose steps might reach beyond the storage's
+      neighbors are left on the storage's deferred list.
+ ***********************************************************************/
+static void run_timestep_task(void *data, int task, struct thread_state *ts) {
+  struct timestep_batch *batch = (struct timestep_batch *)data;
+  ts->store = batch->stores[task];
+  ts->reach_llf = ts->store->reach_llf;
+  ts->reach_urb = ts->store->reach_urb;
+  ts->rng = &ts->store->stream->rng;
+  ts->stats = &ts->store->stream->stats;
+  ts->counts = &ts->store->stream->counts;
+  run_timestep(batch->world, ts->store, batch->release_time,
+               batch->checkpt_time);
+  ts->store = NULL;
+  ts->rng = NULL;
+  ts->stats = NULL;
+  ts->counts = NULL;
+}
+
+/***********************************************************************
+ run_timesteps_threaded:
+
+    Threaded counterpart of run_timesteps_serial, running the timesteps of
+    the active storages until no molecule is left in the current time
+    slot.  Storages are run one color at a time, all storages of a color
+    concurrently.  After each color, molecules that were deferred by the
+    workers are stepped serially on the calling thread, in a fixed order
+    and drawing from the random number stream of their storage, so the
+    results do not depend on the number of threads.  Triggers fired along
+    the way are reported, in time order, at the end.
+
+    In a run distributed over several processes only owned storages are
+    run, the serial pass keeps to the slab of this process, and the steps
+    deferred near the faces between slabs are run by domain_run_faces.
+
+ In: world: the world
+     release_time: time of the next release event
+     checkpt_time: time of the next checkpoint
+ Out: none.
+ ***********************************************************************/
+static void run_timesteps_threaded(struct volume *world, double release_time,
+                                   double checkpt_time) {
+  struct domain *dom = world->domain;
+  int done = 0;
+  while (!done) {
+    done = 1;
+    for (int color = 0; color < world->n_storage_colors; color++) {
+      struct storage *stores[world->n_active_stores + 1];
+      struct storage *by_load[world->n_active_stores + 1];
+      struct timestep_batch batch = { world, by_load, release_time,
+                                      checkpt_time };
+      int n_batch = 0;
+      for (int i = 0; i < world->n_active_stores; i++) {
+        struct storage *local = world->active_stores[i];
+        if (local->color == color && local->timer->current != NULL &&
+            domain_owns(world, local))
+          stores[n_batch++] = local;
+      }
+      if (n_batch == 0)
+        continue;
+      done = 0;
+
+      /* Hand out the busiest storages first so that the threads left idle
+       * at the end of the batch have only small tasks to steal */
+      memcpy(by_load, stores, n_batch * sizeof(struct storage *));
+      qsort(by_load, n_batch, sizeof(struct storage *), compare_storage_load);
+      thread_pool_run(world->thread_pool, n_batch, run_timestep_task, &batch);
+
+      for (int i = 0; i < n_batch; i++) {
+        struct storage *local = stores[i];
+        if (local->deferred == NULL)
+          continue;
+
+        /* Nothing else is running now, so these steps may reach anywhere
+         * on this process */
+        struct thread_state serial = { .pool = world->thread_pool,
+                                       .rng = &local->stream->rng,
+                                       .stats = &local->stream->stats,
+                                       .counts = &local->stream->counts };
+        if (dom != NULL) {
+          serial.store = local;
+          serial.reach_llf = dom->slab_llf;
+          serial.reach_urb = dom->slab_urb;
+        }
+        while (local->deferred != NULL) {
+          struct abstract_molecule *am = local->deferred;
+          local->deferred = am->next;
+          if (storage_schedule_add(world, local, am))
+            mcell_allocfailed("Failed to add a molecule to scheduler after "
+                              "deferring its timestep.");
+        }
+        /* Borrow the arena of the main thread, which is idle meanwhile */
+        serial.scratch = world->scratch;
+        current_thread = &serial;
+        run_timestep(world, local, release_time, checkpt_time);
+        current_thread = NULL;
+        world->scratch = serial.scratch;
+      }
+    }
+
+    /* Once every owned storage is through, steps deferred near the faces
+     * between processes are left */
+    if (done && dom != NULL &&
+        domain_run_faces(world, release_time, checkpt_time))
+      done = 0;
+  }
+
+  if (dom != NULL)
+    domain_gather_triggers(world);
+  flush_pending_triggers(world);
+}
+
+/***********************************************************************
+ run_timesteps_serial:
+
+    Runs the timesteps of the active storages, in the order of
+    world->storage_head, until no molecule is left in the current time
+    slot.  Idle storages have nothing to run and are not visited.
+
+ In: world: the world
+     release_time: time of the next release event
+     checkpt_time: time of the next checkpoint
+ Out: none.
+ ***********************************************************************/
+static void run_timesteps_serial(struct volume *world, double release_time,
+                                 double checkpt_time) {
+  int done = 0;
+  while (!done) {
+    done = 1;
+    for (int i = 0; i < world->n_active_stores; i++) {
+      struct storage *local = world->active_stores[i];
+      if (local->timer->current == NULL)
+        continue;
+      run_timestep(world, local, release_time, checkpt_time);
+      done = 0;
+
+      /* Storages woken up by the timestep were inserted in order, those
+       * coming after this one get their turn in this sweep */
+      while (world->active_stores[i] != local)
+        i++;
+    }
+  }
+}
+
+/***********************************************************************
+ advance_active_storages:
+
+    Moves the active storages on to the next time slot, and drops the
+    storages left with nothing scheduled from the list of active ones.
+    Idle storages stay behind and catch up when they are woken up again
+    (see storage_schedule_add).
+
+ In: world: the world
+ Out: none.
+ ***********************************************************************/
+static void advance_active_storages(struct volume *world) {
+  int n_active = 0;
+  for (int i = 0; i < world->n_active_stores; i++) {
+    struct storage *local = world->active_stores[i];
+    /* Not using the return value -- just trying to advance the scheduler */
+    void *o = schedule_next(local->timer);
+    if (o != NULL)
+      mcell_internal_error("Scheduler dropped a molecule on the floor!");
+    local->current_time += 1.0;
+
+    if (local->timer->current == NULL && local->timer->count == 0 &&
+        local->deferred == NULL)
+      local->active = 0;
+    else
+      world->active_stores[n_active++] = local;
+  }
+  world->n_active_stores = n_active;
+  world->storage_time += 1.0;
+}
+
+/***********************************************************************
+ report_defunct_molecules:
+
+    Adds the share of scheduler entries that belong to defunct molecules,
+    if there are any, to the iteration report.
+
+ In: world: the world
+ Out: none.
+ ***********************************************************************/
+static void report_defunct_molecules(struct volume *world) {
+  long long n_defunct = 0;
+  long long n_entries = 0;
+  for (struct storage_list *sl = world->storage_head; sl != NULL;
+       sl = sl->next) {
+    if (sl->store->timer == NULL)
+      continue;
+    n_defunct += sl->store->timer->defunct_count;
+    n_entries += sl->store->timer->count + sl->store->timer->current_count;
+  }
+  if (n_defunct > n_entries)
+    n_defunct = n_entries;
+  if (n_defunct > 0)
+    mcell_log_raw(" (%.3g%% of scheduled molecules defunct)",
+                  100.0 * n_defunct / n_entries);
+}
+
 /***********************************************************************
  run_sim:
 
@@ -346,6 +684,11 @@ mcell_run_simulation(MCELL_STATE *world) {
     status = 1;
   }
 
+  if (world->thread_pool != NULL) {
+    destroy_thread_pool(world->thread_pool);
+    world->thread_pool = NULL;
+  }
+
   return status;
 }
 
@@ -376,8 +719,12 @@ mcell_run_iteration(MCELL_STATE *world, long long frequency,
     /* Change geometry if needed */
     process_geometry_changes(world, not_yet);
 
-    /* Release molecules */
-    process_molecule_releases(world, not_yet);
+    /* Release molecules.  In a distributed run the first process releases
+     * them all and hands each to the process owning its storage. */
+    if (world->procnum == 0)
+      process_molecule_releases(world, not_yet);
+    if (world->domain != NULL)
+      domain_migrate_molecules(world);
 
     /* Produce output */
     process_reaction_output(world, not_yet);
@@ -391,6 +738,7 @@ mcell_run_iteration(MCELL_STATE *world, long long frequency,
     /* Produce iteration report */
     if (iter_report_phase == 0 &&
         world->notify->iteration_report != NOTIFY_NONE) {
+      merge_storage_stats(world);
       mcell_log_raw("Iterations: %lld of %lld ", world->current_iterations,
                     world->iterations);
 
@@ -411,6 +759,7 @@ mcell_run_iteration(MCELL_STATE *world, long long frequency,
           world->last_timing_time = cur_time;
         }
       }
+      report_defunct_molecules(world);
 
       mcell_log_raw("\n");
     }
@@ -455,6 +804,9 @@ mcell_run_iteration(MCELL_STATE *world, long long frequency,
   if (!schedule_anticipate(world->releaser, &next_release_time))
     next_release_time = world->iterations + 1;
 
+  if (world->domain != NULL)
+    next_release_time = domain_broadcast_time(world, next_release_time);
+
   if (next_release_time < world->current_iterations + 1)
     next_release_time = world->current_iterations + 1;
 
@@ -465,31 +817,21 @@ mcell_run_iteration(MCELL_STATE *world, long long frequency,
   double next_barrier =
       min3d(next_release_time, next_vol_output, next_viz_output);
 
-  while (world->storage_head != NULL &&
-         world->storage_head->store->current_time <= not_yet) {
-    int done = 0;
-    while (!done) {
-      done = 1;
-      for (struct storage_list *local = world->storage_head; local != NULL;
-           local = local->next) {
-        if (local->store->timer->current != NULL) {
-          run_timestep(world, local->store, next_barrier,
-                       (double)world->iterations + 1.0);
-          done = 0;
-        }
-      }
-    }
-
-    for (struct storage_list *local = world->storage_head; local != NULL;
-         local = local->next) {
-      /* Not using the return value -- just trying to advance the scheduler */
-      void *o = schedule_next(local->store->timer);
-      if (o != NULL)
-        mcell_internal_error("Scheduler dropped a molecule on the floor!");
-      local->store->current_time += 1.0;
+  while (world->storage_head != NULL && world->storage_time <= not_yet) {
+    if (world->thread_pool != NULL) {
+      run_timesteps_threaded(world, next_barrier,
+                             (double)world->iterations + 1.0);
+    } else {
+      run_timesteps_serial(world, next_barrier,
+                           (double)world->iterations + 1.0);
     }
+    advance_active_storages(world);
   }
 
+  if (world->reorder_interval > 0 &&
+      (world->current_iterations + 1) % world->reorder_interval == 0)
+    reorder_molecules(world);
+
   world->current_iterations++;
 
   return 0;
@@ -660,34 +1002,42 @@ mcell_print_final_statistics(MCELL_STATE *world) {
                "block enabled to get more detail.\n");
 
   if (world->notify->final_summary == NOTIFY_FULL) {
+    merge_storage_stats(world);
     mcell_log("iterations = %lld ; elapsed time = %1.15g seconds",
               world->current_iterations,
               world->chkpt_start_time_seconds +
                   ((world->current_iterations - world->start_iterations) * world->time_unit));
 
-    if (world->diffusion_number > 0)
+    struct sim_stats *stats = &world->stats;
+    if (stats->diffusion_number > 0)
       mcell_log("Average diffusion jump was %.2f timesteps\n",
-                world->diffusion_cumtime / (double)world->diffusion_number);
-    mcell_log("Total number of random number use: %lld", rng_uses(world->rng));
+                stats->diffusion_cumtime / (double)stats->diffusion_number);
+    long long rng_total = rng_uses(world->rng);
+    for (int i = 0; i < world->n_storage_streams; i++)
+      rng_total += rng_uses(&world->storage_streams[i].rng);
+    if (world->domain != NULL)
+      domain_sum_statistics(world, &rng_total);
+    mcell_log("Total number of random number use: %lld", rng_total);
     mcell_log("Total number of ray-subvolume intersection tests: %lld",
-              world->ray_voxel_tests);
+              stats->ray_voxel_tests);
     mcell_log("Total number of ray-polygon intersection tests: %lld",
-              world->ray_polygon_tests);
+              stats->ray_polygon_tests);
     mcell_log("Total number of ray-polygon intersections: %lld",
-              world->ray_polygon_colls);
+              stats->ray_polygon_colls);
     mcell_log("Total number of dynamic geometry molecule displacements: %lld",
               world->dyngeom_molec_displacements);
     print_molecule_collision_report(
         world->notify->molecule_collision_report,
-        world->vol_vol_colls,
-        world->vol_surf_colls,
-        world->surf_surf_colls,
-        world->vol_wall_colls,
-        world->vol_vol_vol_colls,
-        world->vol_vol_surf_colls,
-        world->vol_surf_surf_colls,
-        world->surf_surf_surf_colls,
+        stats->vol_vol_colls,
+        stats->vol_surf_colls,
+        stats->surf_surf_colls,
+        stats->vol_wall_colls,
+        stats->vol_vol_vol_colls,
+        stats->vol_vol_surf_colls,
+        stats->vol_surf_surf_colls,
+        stats->surf_surf_surf_colls,
         &world->rxn_flags);
+    print_molecule_memory_report(world);
 
     struct rusage run_time = { .ru_utime = { 0, 0 }, .ru_stime = { 0, 0 } };
     time_t t_end; /* global end time of MCell run */
@@ -714,6 +1064,10 @@ mcell_print_final_statistics(MCELL_STATE *world) {
     t_end = time(NULL);
     mcell_log("Total wall clock time = %ld seconds",
               (long)difftime(t_end, world->t_start));
+    if (world->thread_pool != NULL)
+      print_thread_utilization(world->thread_pool);
+    if (world->domain != NULL)
+      domain_print_statistics(world);
   }
 
   return 0;
@@ -37,6 +37,7 @@
 #include "mem_util.h"
 #include "sched_util.h"
 #include "util.h"
+#include "thread_util.h"
 
 /*****************************************************/
 /**  Brand new constants created for use in MCell3  **/
@@ -126,6 +127,11 @@
 /* Flag indicating that a molecule is old enough to take the maximum timestep */
 #define MATURE_MOLECULE 0x2000
 
+/* Flag indicating that a worker thread left the molecule's step to be run
+   serially, because the step might reach outside the worker's storage.
+   Cleared when the step is run again. */
+#define ACT_DEFER 0x4000
+
 /* End of Abstract Molecule Flags. */
 
 /* Output Report Flags */
@@ -333,6 +339,17 @@ enum release_shape_t {
 #define MIN_DEFUNCT_FOR_GC 1024
 #define MAX_DEFUNCT_FRAC 0.2
 
+/* Constants for the incremental sweep of defunct molecules, which looks at */
+/* a bounded number of scheduled molecules per timestep once a smaller */
+/* fraction of them is defunct */
+#define MIN_DEFUNCT_FOR_SWEEP 64
+#define SWEEP_DEFUNCT_FRAC 0.05
+#define SWEEP_VISITS_PER_STEP 1024
+
+/* Largest number of records in the first arena of a storage's memory */
+/* pools (see MEMORY_PARTITION_POOL) */
+#define MAX_MEM_PART_POOL (1 << 20)
+
 /* Constants for notification levels */
 enum notify_level_t {
   NOTIFY_NONE,  /* no output */
@@ -546,11 +563,91 @@ typedef unsigned int u_int;
 typedef unsigned long u_long;
 #endif
 
+/* Room in the packed arrays kept inside a per-species list itself */
+#define MIN_PACKED_MOLECULES 4
+
 /* Linked list used to separate molecules by species */
 struct per_species_list {
   struct per_species_list *next; /* pointer to next p-s-l */
   struct species *properties;    /* species for items in this bin */
-  struct volume_molecule *head;  /* linked list of mols */
+
+  /* The molecules, packed into arrays in no particular order, for the scans
+     for reaction partners (see ht_add_molecule_to_list) */
+  int n_packed;
+  int max_packed;
+  struct volume_molecule **packed; /* small_packed, or one malloc'd block... */
+  struct volume_molecule *small_packed[MIN_PACKED_MOLECULES];
+#ifdef MCELL_COMPACT_MOLECULES
+  int *packed_cell; /* ...holding their cells of the molecule grid next */
+  int small_cell[MIN_PACKED_MOLECULES];
+#else
+  struct vector3 *packed_pos; /* ...holding copies of their positions next */
+  struct vector3 small_pos[MIN_PACKED_MOLECULES];
+#endif
+
+  int scan_rank; /* Order among the lists a partner search looks at, or -1 */
+};
+
+/* Where the partner scans read the position of the i-th molecule of a
+   per-species list.  Compact builds keep no copies of the positions. */
+#ifdef MCELL_COMPACT_MOLECULES
+#define PACKED_POS(psl, i) (&(psl)->packed[i]->pos)
+#else
+#define PACKED_POS(psl, i) (&(psl)->packed_pos[i])
+#endif
+
+/* Molecules a partner search in a subvolume must look through before the
+   subvolume gets a molecule grid */
+#define MOL_GRID_MIN_MOLECULES 64
+
+/* Largest number of cells in a molecule grid */
+#define MOL_GRID_MAX_CELLS 4096
+
+/* The volume molecules in one cell of a molecule grid */
+struct mol_cell {
+  int n_mols;
+  int max_mols;
+  struct volume_molecule **mols; /* One malloc'd block holding molecules... */
+#ifndef MCELL_COMPACT_MOLECULES
+  struct vector3 *pos; /* ...and then copies of their positions */
+#endif
+};
+
+#ifdef MCELL_COMPACT_MOLECULES
+#define MOL_CELL_POS(cell, i) (&(cell)->mols[i]->pos)
+#else
+#define MOL_CELL_POS(cell, i) (&(cell)->pos[i])
+#endif
+
+/* Bytes a volume molecule takes up in the packed arrays of its species list,
+   and in its cell if its subvolume has a molecule grid */
+#ifdef MCELL_COMPACT_MOLECULES
+#define PACKED_SLOT_SIZE (sizeof(struct volume_molecule *) + sizeof(int))
+#define CELL_SLOT_SIZE (sizeof(struct volume_molecule *))
+#else
+#define PACKED_SLOT_SIZE                                                       \
+  (sizeof(struct volume_molecule *) + sizeof(struct vector3))
+#define CELL_SLOT_SIZE PACKED_SLOT_SIZE
+#endif
+
+/* The volume molecules of a subvolume binned into cells about as wide as the
+   reach of one diffusion step, so that partner searches only have to look
+   at the cells around the moving molecule */
+struct mol_grid {
+  int nx, ny, nz;            /* Cells along each axis */
+  struct vector3 llf;        /* Corner of the subvolume */
+  struct vector3 cell_scale; /* Cells per unit length along each axis */
+  struct mol_cell *cells;    /* x-major, like the subvolumes */
+};
+
+/* Reactions a species may undergo together with one partner species, in the
+   order a walk of the reaction hash chain would find them */
+struct rxn_pair {
+  u_int partner;            /* species_id of the partner */
+  struct rxn **rxns;        /* Reactions naming the two as their first two
+                               reactants, NULL-terminated */
+  struct rxn **trimol_rxns; /* Trimolecular reactions naming both,
+                               NULL-terminated */
 };
 
 /* Properties of one type of molecule or surface */
@@ -584,6 +681,12 @@ struct species {
   struct name_orient *absorb_mols; // names of the mols that ABSORB at surface
   struct name_orient *clamp_conc_mols; /* names of mols that CLAMP_CONC at
                                           surface */
+
+  int n_rx_pairs;             /* Partner species with reactions, or -1 if the
+                                 reactions have not been tabulated */
+  struct rxn_pair *rx_pairs;  /* Sorted by partner species_id */
+  u_int *rx_partner_bits;     /* Bit per species_id set if rx_pairs has
+                                 reactions naming the two first, or NULL */
 };
 
 /* All pathways leading away from a given intermediate */
@@ -677,6 +780,8 @@ struct molecule_info {
   struct abstract_molecule *molecule;
   struct string_buffer *reg_names;   /* Region names */
   struct string_buffer *mesh_names;  /* Mesh names that molec is nested in */
+  char *mesh_name;                   /* Mesh the molecule is on (surface
+                                        molecules) */
   struct vector3 pos;                /* Position in space */
   short orient;                      /* Which way do we point? */
 };
@@ -693,18 +798,18 @@ struct periodic_image {
 
 /* Abstract structure that starts all molecule structures */
 /* Used to make C structs act like C++ objects */
+/* Molecules are allocated from the tagged mol and smol pools of a storage,
+   so they find their way back with mem_birthplace */
 struct abstract_molecule {
   struct abstract_molecule *next; /* Next molecule in scheduling queue */
   double t;                      /* Scheduling time. */
   double t2;                     /* Time of next unimolecular reaction */
   short flags; /* Abstract Molecule Flags: Who am I, what am I doing, etc. */
+  struct periodic_image periodic_box; /* track the periodic box a molecule is
+                                         in; fits beside flags */
   struct species *properties;       /* What type of molecule are we? */
-  struct mem_helper *birthplace;    /* What was I allocated from? */
   double birthday;                  /* Time at which this particle was born */
   u_long id;                        /* unique identifier of this molecule */
-  struct periodic_image* periodic_box;  /* track the periodic box a molecule is in */
-  char *mesh_name;                // Name of mesh that molecule is either in
-                                  // (volume molecule) or on (surface molecule)
 };
 
 /* Volume molecules: freely diffusing or fixed in solution */
@@ -713,20 +818,19 @@ struct volume_molecule {
   double t;
   double t2;
   short flags;
+  struct periodic_image periodic_box;
   struct species *properties;
-  struct mem_helper *birthplace;
   double birthday;
   u_long id;
-  struct periodic_image* periodic_box;
-  char *mesh_name;                // Name of mesh that the molecule is in
+  int index;                /* Index on previous_wall (don't rebind) */
+  int packed_index;         /* Slot in the packed arrays of species_list */
   struct vector3 pos;       /* Position in space */
   struct subvolume *subvol; /* Partition we are in */
 
   struct wall *previous_wall; /* Wall we were released from */
-  int index;                  /* Index on that wall (don't rebind) */
 
-  struct volume_molecule **prev_v; /* Previous molecule in this subvolume */
-  struct volume_molecule *next_v;  /* Next molecule in this subvolume */
+  struct per_species_list *species_list; /* List holding this molecule, or
+                                            NULL */
 };
 
 /* Fixed molecule on a grid on a surface */
@@ -735,12 +839,10 @@ struct surface_molecule {
   double t;
   double t2;
   short flags;
+  struct periodic_image periodic_box;
   struct species *properties;
-  struct mem_helper *birthplace;
   double birthday;
   u_long id;
-  struct periodic_image* periodic_box;
-  char *mesh_name;                // Name of mesh that the molecule is on 
   unsigned int grid_index;   /* Which gridpoint do we occupy? */
   short orient;              /* Which way do we point? */
   struct surface_grid *grid; /* Our grid (which tells us our surface) */
@@ -834,11 +936,23 @@ struct surface_grid {
   u_int n_tiles; /* Number of tiles in effector grid (triangle: grid_size^2,
                     rectangle: 2*grid_size^2) */
   u_int n_occupied; /* Number of tiles occupied by surface_molecules */
-  /* Array of pointers to surface_molecule_list for each tile */
+  /* Array of pointers to surface_molecule_list for each tile, NULL while
+     the grid is sparse.  Use tile_sm_list/tile_sm_slot to access tiles. */
   struct surface_molecule_list **sm_list; 
+  /* Sparse grids: the same pointers in chunks of TILE_CHUNK_SIZE tiles,
+     each allocated when one of its tiles is first written */
+  struct surface_molecule_list ***sm_chunks;
+  u_int n_chunks_used; /* Number of chunks in use */
+  struct surface_molecule_list **spare_chunk; /* Last chunk freed, kept for
+                                                 reuse */
+  /* One bit per tile, set while the tile's sm_list holds a molecule */
+  unsigned long long *occupancy;
 
   struct subvolume *subvol; /* Best match for which subvolume we're in */
   struct wall *surface;     /* The wall that we are in */
+
+  struct tile_nbr_table *nbr_table; /* Neighbors of every tile, built on
+                                       first use (see get_tile_neighbors) */
 };
 
 /* 3D vector of integers */
@@ -865,10 +979,6 @@ struct storage {
   struct mem_helper *face;    /* Walls */
   struct mem_helper *join;    /* Edges */
   struct mem_helper *grids;   /* Effector grids */
-  struct mem_helper *coll;    /* Collision list */
-  struct mem_helper *sp_coll; /* Collision list - helps in trimolecular
-                                 reactions*/
-  struct mem_helper *tri_coll; /* Collision list for trimolecular collisions */
   struct mem_helper *regl;     /* Region lists */
   struct mem_helper *exdv; /* Vertex lists for exact interaction disk area */
   struct mem_helper *pslv; /* Per-species-lists for vol mols */
@@ -877,9 +987,88 @@ struct storage {
   int wall_count;         /* How many local walls? */
   int vert_count;         /* How many vertices? */
 
-  struct schedule_helper *timer; /* Local scheduler */
-  double current_time;           /* Local time */
+  struct schedule_helper *timer; /* Local scheduler, NULL in distributed
+                                    runs until the storage is woken */
+  double current_time;           /* Local time, behind the world's storage
+                                    time while the storage is idle */
   double max_timestep;           /* Local maximum timestep */
+
+  /* Threaded execution: storages with the same color never have
+     overlapping reach boxes, so their timesteps may run concurrently */
+  int color;
+  struct vector3 reach_llf; /* This storage plus its neighbor storages */
+  struct vector3 reach_urb;
+  struct abstract_molecule *deferred; /* Molecules left for the serial pass */
+  struct abstract_molecule *dormant;  /* Inert molecules kept out of the
+                                         timer (see storage_make_dormant) */
+  int active; /* On the world's list of active storages? */
+
+  int index;                     /* Position in the grid of storages */
+  struct storage_stream *stream; /* Private randomness, NULL in serial runs */
+};
+
+/* Counters of simulation events, printed with the final statistics */
+struct sim_stats {
+  long long diffusion_number; /* Total number of times molecules have had their
+                                 positions updated */
+  double diffusion_cumtime;  /* Total time spent diffusing by all molecules */
+  long long ray_voxel_tests; /* How many ray-subvolume intersection tests have
+                                we performed */
+  long long ray_polygon_tests; /* How many ray-polygon intersection tests have
+                                  we performed */
+  long long ray_polygon_colls; /* How many ray-polygon intersections have
+                                  occured */
+  /* below "vol" means volume molecule, "surf" means surface molecule */
+  long long vol_vol_colls;     /* How many vol-vol collisions have occured */
+  long long vol_surf_colls;    /* How many vol-surf collisions have occured */
+  long long surf_surf_colls;   /* How many surf-surf collisions have occured */
+  long long vol_wall_colls;    /* How many vol-wall collisions have occured */
+  long long vol_vol_vol_colls; // How many vol-vol-vol collisions have occured
+  long long
+  vol_vol_surf_colls; /* How many vol-vol-surf collisions have occured */
+  long long vol_surf_surf_colls; /* How many vol-surf-surf collisions have
+                                    occured */
+  long long surf_surf_surf_colls; /* How many surf-surf-surf collisions have
+                                     occured */
+};
+
+/* What the passes sorting scheduled molecules along a space-filling curve
+   did (see reorder_molecules).  A switch is a step along the scheduling
+   order onto another memory page, or into another subvolume, than the
+   molecule before; they are counted before and after every pass. */
+struct reorder_stats {
+  long long passes;
+  long long molecules; /* Molecules sorted, summed over all passes */
+  long long page_switches_before;
+  long long page_switches_after;
+  long long subvol_switches_before;
+  long long subvol_switches_after;
+};
+
+/* Region count updates made while a storage is run.  Deltas are added to the
+   counters when reaction output is updated; triggers are reported, in time
+   order, after every threaded timestep.  Only the counters a storage touched
+   have a delta, found through a small open-addressed hash. */
+struct count_shard {
+  struct count_delta *deltas; /* In the order the counters were touched */
+  int n_deltas;
+  int *delta_slot; /* By counter->index: 1 + position in deltas, or 0 */
+  int slot_mask;   /* Entries of delta_slot minus one */
+  struct pending_trigger *triggers; /* In the order they were fired */
+  struct pending_trigger **triggers_tail;
+  struct mem_helper *trigger_mem;
+};
+
+/* Random number stream, molecule id counter and event counters owned by one
+   storage, so that threaded runs do not depend on the order in which storages
+   are run.  The padding keeps the counters of neighboring streams, which are
+   updated by different threads, off each other's cache lines. */
+struct storage_stream {
+  struct rng_state rng;
+  u_long next_mol_id; /* Advances by mol_id_stride */
+  struct sim_stats stats; /* Not yet merged into the world's counters */
+  struct count_shard counts;
+  char pad[CACHE_LINE_SIZE];
 };
 
 /* Linked list of storage areas. */
@@ -888,9 +1077,46 @@ struct storage_list {
   struct storage *store;
 };
 
+/* Walls per batch of a wall_table; the tables are padded to a multiple */
+#define WALL_BATCH 8
+
+/* Walls a subvolume needs before its wall_table gets a bounding volume
+   hierarchy */
+#define WALL_BVH_MIN_WALLS 64
+
+/* Node of a bounding volume hierarchy over a wall_table.  Each leaf owns one
+   batch of table entries; the two children of an inner node are stored next
+   to each other. */
+struct wall_bvh_node {
+  struct vector3 llf; /* Bounds of the walls below, padded slightly */
+  struct vector3 urb;
+  int first;          /* Leaf: first table entry.  Inner: first child */
+  int leaf;           /* Is this a leaf? */
+};
+
+/* The planes of a subvolume's walls packed into arrays, so that ray tracing
+   can reject walls it cannot hit a batch at a time.  Small tables are in
+   wall_head order; large ones are in the leaf order of a hierarchy, and
+   remember the wall_head order of each entry.  Padding entries have a NULL
+   wall and a plane far from every point. */
+struct wall_table {
+  int n_walls;        /* Entries, including padding */
+  struct wall **walls;
+  double *nx;         /* Wall normals... */
+  double *ny;
+  double *nz;
+  double *d;          /* ...and distances from the origin */
+
+  struct wall_bvh_node *nodes; /* Hierarchy (root first), or NULL */
+  int n_nodes;
+  int *order;         /* Position of each entry in wall_head, with nodes */
+};
+
 /* Walls and molecules in a spatial subvolume */
 struct subvolume {
   struct wall_list *wall_head; /* Head of linked list of intersecting walls */
+  struct wall_table *wall_table; /* Packed copy of wall_head, or NULL */
+  struct mol_grid *mol_grid;     /* Molecules binned finer, or NULL */
 
   struct pointer_hash mol_by_species; /* table of species->molecule list */
   struct per_species_list *species_head;
@@ -930,6 +1156,20 @@ struct trig_counter_data {
   struct trigger_request *listeners; /* Places waiting to be notified */
 };
 
+/* Trigger event fired by a pool task, reported once the timestep is over */
+struct pending_trigger {
+  struct pending_trigger *next;
+  struct counter *event;     /* Trigger counter that fired */
+  struct output_request *ear; /* Who wants to hear about it */
+  double t_event;            /* Event time (exact) */
+  struct vector3 loc;        /* Real position of event */
+  short orient;
+  short flags;               /* TRIG_IS_* flags */
+  int n;
+  u_long id;                 /* Molecule id */
+  long seq;                  /* Breaks ties between events at the same time */
+};
+
 /* List of output items that need to know about this specific trigger event */
 struct trigger_request {
   struct trigger_request *next; /* Next request */
@@ -943,6 +1183,12 @@ union counter_data {
   struct trig_counter_data trig;
 };
 
+/* What a storage has added to one counter since the deltas were merged */
+struct count_delta {
+  struct counter *counter;
+  union counter_data data;
+};
+
 /* Struct to count rxns or molecules within regions (where "within" includes */
 /* on the inside of a fully closed surface) */
 struct counter {
@@ -954,6 +1200,7 @@ struct counter {
   short orientation;       /* requested surface molecule orientation */
   struct periodic_image *periodic_box; /* periodic box we are counting in; NULL
                                           means that we don't care and count everywhere */
+  int index;               /* Position in the count_shard delta arrays */
   union counter_data data; /* data for the count:
                               reference data.move for move counter
                               reference data.rx for rxn counter
@@ -1042,6 +1289,7 @@ struct volume {
 
   int count_hashmask;          /* Mask for looking up count hash table */
   struct counter **count_hash; /* Count hash table */
+  int n_counters;              /* Counters numbered by prepare_counters */
   struct schedule_helper *count_scheduler; // When to generate reaction output
   struct sym_table_head *counter_by_name;
 
@@ -1069,8 +1317,16 @@ struct volume {
   struct mem_helper *storage_allocator; /* Memory for storage list */
   struct storage_list *storage_head;    /* Linked list of all local
                                            memory/schedulers */
+  struct storage **active_stores; /* Storages with molecules scheduled, in
+                                    the order of storage_head */
+  int n_active_stores;
+  double storage_time; /* Local time of the active storages */
+  long long reorder_interval; /* Iterations between reorder_molecules passes
+                                 (0: never) */
+  struct reorder_stats reorder_stats;
 
   u_long current_mol_id; /* next unique molecule id to use*/
+  u_long mol_id_stride;  /* spacing of ids given out by one id counter */
 
   double speed_limit; // How far can the fastest particle get in one timestep?
 
@@ -1127,6 +1383,7 @@ struct volume {
   double r_length_unit; /* Reciprocal of length_unit to avoid division */
   double rx_radius_3d;  /* Interaction radius for reactions between volume
                          molecules */
+  double mol_grid_cell; /* Edge of the cells of subvolume molecule grids */
 
   double space_step; /* User-supplied desired average diffusion distance for
                         volume molecules */
@@ -1166,29 +1423,10 @@ struct volume {
   /* simulation start time (in seconds) or time of most recent checkpoint */
   double simulation_start_seconds; 
 
-  long long diffusion_number; /* Total number of times molecules have had their
-                                 positions updated */
-  double diffusion_cumtime;  /* Total time spent diffusing by all molecules */
-  long long ray_voxel_tests; /* How many ray-subvolume intersection tests have
-                                we performed */
-  long long ray_polygon_tests; /* How many ray-polygon intersection tests have
-                                  we performed */
-  long long ray_polygon_colls; /* How many ray-polygon intersections have
-                                  occured */
+  struct sim_stats stats; /* Event counters (in threaded runs, only the ones
+                             merged from the storages so far) */
   long long dyngeom_molec_displacements; /* Total number of dynamic geometry
                                             molecule displacements */
-  /* below "vol" means volume molecule, "surf" means surface molecule */
-  long long vol_vol_colls;     /* How many vol-vol collisions have occured */
-  long long vol_surf_colls;    /* How many vol-surf collisions have occured */
-  long long surf_surf_colls;   /* How many surf-surf collisions have occured */
-  long long vol_wall_colls;    /* How many vol-wall collisions have occured */
-  long long vol_vol_vol_colls; // How many vol-vol-vol collisions have occured
-  long long
-  vol_vol_surf_colls; /* How many vol-vol-surf collisions have occured */
-  long long vol_surf_surf_colls; /* How many vol-surf-surf collisions have
-                                    occured */
-  long long surf_surf_surf_colls; /* How many surf-surf-surf collisions have
-                                     occured */
 
   struct vector3 bb_llf; /* llf corner of world bounding box */
   struct vector3 bb_urb; /* urb corner of world bounding box */
@@ -1205,12 +1443,23 @@ struct volume {
   long long last_timing_iteration; /* during the main run_iteration loop */
 
   int procnum;          /* Processor number for a parallel run */
+  int n_procs;          /* Number of processes in a parallel run */
+  int num_threads;      /* Worker threads for storage timesteps (0: serial,
+                           -1: not set yet) */
+  struct thread_pool *thread_pool; /* NULL when running serially */
+  struct domain *domain; /* Storages owned by this process, NULL unless the
+                            run is distributed over several processes */
+  struct storage_stream *storage_streams; /* One per storage when threaded */
+  struct int3D storage_reach; /* Neighbor storages in a reach box per axis */
+  int n_storage_colors;       /* Storages of one color may run concurrently */
+  double max_tile_edge;       /* Longest edge of a surface tile on any wall */
+  int n_storage_streams;
+  u_int n_streams_seeded; /* Streams handed out so far (never reused) */
   int quiet_flag;       /* Quiet mode */
   int with_checks_flag; /* Check geometry for overlapped walls? */
 
-  struct mem_helper *coll_mem;     /* Collision list */
-  struct mem_helper *sp_coll_mem;  /* Collision list (trimol) */
-  struct mem_helper *tri_coll_mem; /* Collision list (trimol) */
+  struct scratch_arena scratch; /* Collision lists of the diffusion step
+                                   being taken outside of pool tasks */
   struct mem_helper *exdv_mem; // Vertex lists for exact interaction disk area
 
   /* Current version number. Format is "3.XX.YY" where XX is major release
@@ -1236,6 +1485,8 @@ struct volume {
 
   /* MCell startup command line arguments */
   u_int seed_seq;         /* Seed for random number generator */
+  int counter_based_rng;  /* Draw from Philox instead of isaac64 */
+  int ladder_scheduler;   /* Schedule molecules in ladder queues */
   long long iterations;   /* How many iterations to run */
   unsigned long log_freq; /* Interval between simulation progress reports,
                              default scales as sqrt(iterations) */
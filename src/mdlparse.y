@@ -284,6 +284,7 @@ struct arg_list printfargs;
 %token       NOT_EQUAL
 %token       NOTIFICATIONS
 %token       NUMBER_OF_SUBUNITS
+%token       NUMBER_OF_THREADS
 %token       NUMBER_OF_TRAINS
 %token       NUMBER_TO_RELEASE
 %token       OBJECT
@@ -1047,6 +1048,7 @@ parameter_def:
         | SPACE_STEP '=' num_expr                     { CHECK(mdl_set_space_step(parse_state, $3)); }
         | TIME_STEP_MAX '=' num_expr                  { CHECK(mdl_set_max_time_step(parse_state, $3)); }
         | ITERATIONS '=' num_expr { CHECK(mdl_set_num_iterations(parse_state, (long long) $3)); }
+        | NUMBER_OF_THREADS '=' num_expr              { CHECK(mdl_set_num_threads(parse_state, (int) $3)); }
         | CENTER_MOLECULES_ON_GRID '=' boolean        { parse_state->vol->randomize_smol_pos = !($3); }
         | ACCURATE_3D_REACTIONS '=' boolean           { parse_state->vol->use_expanded_list = $3; }
         | VACANCY_SEARCH_DISTANCE '=' num_expr        { parse_state->vol->vacancy_search_dist2 = max2d($3, 0.0); }
@@ -2022,6 +2022,26 @@ int mdl_set_num_iterations(struct mdlparse_vars *parse_state,
   return 0;
 }
 
+/*************************************************************************
+ mdl_set_num_threads:
+    Set the number of threads used to run the memory partitions.
+
+ In:  parse_state: parser state
+      num_threads: number of threads to use
+ Out: 0 on success, 1 on failure
+*************************************************************************/
+int mdl_set_num_threads(struct mdlparse_vars *parse_state, int num_threads) {
+  if (num_threads < 0) {
+    mdlerror(parse_state, "NUMBER_OF_THREADS value is negative");
+    return 1;
+  }
+  /* If the thread count was not overridden on the command-line... */
+  if (parse_state->vol->num_threads == -1)
+    parse_state->vol->num_threads = num_threads;
+  no_printf("Threads = %d\n", parse_state->vol->num_threads);
+  return 0;
+}
+
 /*************************************************************************
  mdl_set_num_radial_directions:
     Set the number of radial directions.
@@ -207,6 +207,9 @@ int mdl_set_space_step(struct mdlparse_vars *parse_state, double step);
 int mdl_set_num_iterations(struct mdlparse_vars *parse_state,
                            long long numiters);
 
+/* Set the number of threads used to run the memory partitions. */
+int mdl_set_num_threads(struct mdlparse_vars *parse_state, int num_threads);
+
 /* Set the number of radial directions. */
 int mdl_set_num_radial_directions(struct mdlparse_vars *parse_state,
                                   int numdirs);
@@ -33,9 +33,13 @@
 #include "config.h"
 
 #include <inttypes.h>
+#include <limits.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 #include "strfunc.h"
 #include "logging.h"
@@ -314,15 +318,182 @@ void mem_dump_stats(FILE *out) {
 
 #endif
 
+/**************************************************************************\
+ ** Arena chunks: an arena holding at least MEM_HUGE_PAGE_SIZE bytes is  **
+ **   mapped directly rather than malloc'ed, aligned to and rounded up   **
+ **   to whole huge pages.  Explicit (hugetlbfs) pages are used if the   **
+ **   system has some reserved, otherwise transparent huge pages are     **
+ **   requested.  Nothing in a mapped chunk is touched until mem_get     **
+ **   hands it out, so each page is placed on the NUMA node of the first **
+ **   thread to use it, which is the thread running the storage that     **
+ **   owns the arena.                                                    **
+\**************************************************************************/
+
+#define MEM_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+#ifdef MEM_UTIL_TRACK_FREED
+#define MEM_STRIDE(mh) ((mh)->record_size + sizeof(int))
+#else
+#define MEM_STRIDE(mh) ((mh)->record_size)
+#endif
+
+/* Records of tagged mem_helpers are laid out in blocks of MEM_BLOCK_SIZE
+   bytes, aligned to their size.  Each block starts with a pointer to the
+   mem_helper the records were allocated from (see mem_birthplace), written
+   by mem_get when it hands out the first record of the block.  One
+   page, so that mapped chunks are aligned too and small pools stay small. */
+#define MEM_BLOCK_SIZE ((size_t)4096)
+#define MEM_BLOCK_HEADER ((size_t)16)
+
+#if !defined(_WIN32) && defined(MAP_ANONYMOUS)
+/* Cleared once a request for explicit huge pages has failed */
+static int mem_try_hugetlb = 1;
+#endif
+
 /*************************************************************************
-create_mem_named:
+map_chunk:
+   In: number of bytes wanted, a multiple of MEM_HUGE_PAGE_SIZE
+   Out: A block of zeroed memory aligned to MEM_HUGE_PAGE_SIZE, or NULL if
+        it could not be mapped.
+*************************************************************************/
+static void *map_chunk(size_t bytes) {
+#if !defined(_WIN32) && defined(MAP_ANONYMOUS)
+  void *p;
+#ifdef MAP_HUGETLB
+  if (__atomic_load_n(&mem_try_hugetlb, __ATOMIC_RELAXED)) {
+    p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED)
+      return p;
+    __atomic_store_n(&mem_try_hugetlb, 0, __ATOMIC_RELAXED);
+  }
+#endif
+
+  /* Over-allocate so that an aligned run of huge pages fits, then give
+     back the ends */
+  p = mmap(NULL, bytes + MEM_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    return NULL;
+  unsigned char *start = (unsigned char *)p;
+  size_t lead = (MEM_HUGE_PAGE_SIZE - (uintptr_t)start % MEM_HUGE_PAGE_SIZE) %
+                MEM_HUGE_PAGE_SIZE;
+  if (lead > 0)
+    munmap(start, lead);
+  munmap(start + lead + bytes, MEM_HUGE_PAGE_SIZE - lead);
+  start += lead;
+#ifdef MADV_HUGEPAGE
+  madvise(start, bytes, MADV_HUGEPAGE);
+#endif
+  return start;
+#else
+  UNUSED(bytes);
+  return NULL;
+#endif
+}
+
+/*************************************************************************
+chunk_bytes:
+   In: A mem_helper whose record_size, buf_len and per_block are set
+   Out: The number of bytes a chunk of buf_len records takes up.
+*************************************************************************/
+static size_t chunk_bytes(struct mem_helper *mh) {
+  if (mh->per_block == 0)
+    return (size_t)mh->buf_len * MEM_STRIDE(mh);
+  size_t blocks = ((size_t)mh->buf_len + mh->per_block - 1) / mh->per_block;
+  return blocks * MEM_BLOCK_SIZE;
+}
+
+/*************************************************************************
+record_offset:
+   In: A mem_helper
+       Index of a record in its chunk
+   Out: The offset of the record from the start of the chunk.
+*************************************************************************/
+static size_t record_offset(struct mem_helper *mh, int index) {
+  if (mh->per_block == 0)
+    return (size_t)index * MEM_STRIDE(mh);
+  return (size_t)(index / mh->per_block) * MEM_BLOCK_SIZE + MEM_BLOCK_HEADER +
+         (size_t)(index % mh->per_block) * MEM_STRIDE(mh);
+}
+
+/*************************************************************************
+alloc_chunk:
+   In: A mem_helper whose record_size, buf_len and per_block are set
+   Out: 0 on success, 1 on failure.  heap_array and heap_mapped are set;
+        buf_len is raised to fill up the last huge page of a mapped chunk,
+        or the last block of a tagged one.
+*************************************************************************/
+static int alloc_chunk(struct mem_helper *mh) {
+  size_t bytes = chunk_bytes(mh);
+  mh->heap_mapped = 0;
+  if (bytes >= MEM_HUGE_PAGE_SIZE) {
+    size_t mapped = (bytes + MEM_HUGE_PAGE_SIZE - 1) / MEM_HUGE_PAGE_SIZE *
+                    MEM_HUGE_PAGE_SIZE;
+    mh->heap_array = (unsigned char *)map_chunk(mapped);
+    if (mh->heap_array != NULL) {
+      mh->heap_mapped = mapped;
+      size_t len = (mh->per_block == 0)
+                       ? mapped / MEM_STRIDE(mh)
+                       : mapped / MEM_BLOCK_SIZE * mh->per_block;
+      if (len <= INT_MAX)
+        mh->buf_len = (int)len;
+      return 0;
+    }
+  }
+
+  if (mh->per_block != 0) {
+    /* Blocks must be aligned for mem_birthplace to find their start */
+#ifdef _WIN32
+    mh->heap_array = (unsigned char *)_aligned_malloc(bytes, MEM_BLOCK_SIZE);
+#else
+    void *p = NULL;
+    if (posix_memalign(&p, MEM_BLOCK_SIZE, bytes) != 0)
+      p = NULL;
+    mh->heap_array = (unsigned char *)p;
+#endif
+    mh->buf_len = (int)(bytes / MEM_BLOCK_SIZE * mh->per_block);
+  } else
+    mh->heap_array = (unsigned char *)Malloc(bytes);
+  if (mh->heap_array == NULL)
+    return 1;
+#ifdef MEM_UTIL_TRACK_FREED
+  memset(mh->heap_array, 0, bytes);
+#endif
+  return 0;
+}
+
+/*************************************************************************
+free_chunk:
+   In: A mem_helper
+   Out: No return value.  The chunk of records of the mem_helper is freed.
+*************************************************************************/
+static void free_chunk(struct mem_helper *mh) {
+#if !defined(_WIN32) && defined(MAP_ANONYMOUS)
+  if (mh->heap_mapped != 0) {
+    munmap(mh->heap_array, mh->heap_mapped);
+    return;
+  }
+#endif
+#ifdef _WIN32
+  if (mh->per_block != 0) {
+    _aligned_free(mh->heap_array);
+    return;
+  }
+#endif
+  free(mh->heap_array);
+}
+
+/*************************************************************************
+new_mem_helper:
    In: Size of a single element (including the leading "next" pointer)
        Number of elements to allocate at once
        Name of "arena" (used for statistics)
+       Whether the records should find the mem_helper (see mem_birthplace)
    Out: Pointer to a new mem_helper struct.
 *************************************************************************/
-
-struct mem_helper *create_mem_named(size_t size, int length, char const *name) {
+static struct mem_helper *new_mem_helper(size_t size, int length,
+                                         char const *name, int tagged) {
   struct mem_helper *mh;
   mh = (struct mem_helper *)Malloc(sizeof(struct mem_helper));
 
@@ -333,25 +504,17 @@ struct mem_helper *create_mem_named(size_t size, int length, char const *name) {
   mh->record_size =
       (size > (int)sizeof(void *)) ? (size_t)size : sizeof(void *);
   mh->buf_index = 0;
+  mh->per_block =
+      tagged ? (int)((MEM_BLOCK_SIZE - MEM_BLOCK_HEADER) / MEM_STRIDE(mh)) : 0;
   mh->defunct = NULL;
   mh->next_helper = NULL;
 
-#ifndef MEM_UTIL_NO_POOLING
-#ifdef MEM_UTIL_TRACK_FREED
-  mh->heap_array =
-      (unsigned char *)Malloc(mh->buf_len * (mh->record_size + sizeof(int)));
-  memset(mh->heap_array, 0, mh->buf_len * (mh->record_size + sizeof(int)));
-#else
-  mh->heap_array = (unsigned char *)Malloc(mh->buf_len * mh->record_size);
-#endif
-
-  if (mh->heap_array == NULL) {
-    free(mh);
-    return NULL;
-  }
-#else
+  /* The first chunk is only allocated by mem_get, so that pools which are
+     never used (like those of storages owned by another process) cost
+     nothing, and the chunk is touched first by the thread using it */
   mh->heap_array = NULL;
-#endif
+  mh->heap_mapped = 0;
+  mh->buf_index = mh->buf_len;
 
 #ifdef MEM_UTIL_KEEP_STATS
   struct mem_stats *s = mh->stats = get_stats(name, size);
@@ -359,13 +522,14 @@ struct mem_helper *create_mem_named(size_t size, int length, char const *name) {
   ++s->total_arenas;
   if (s->num_arenas_unfreed > s->max_arenas)
     s->max_arenas = s->num_arenas_unfreed;
-  s->unfreed_length += length;
+  s->unfreed_length += mh->buf_len;
   if (s->unfreed_length > s->max_length)
     s->max_length = s->unfreed_length;
-  s->cur_free += length;
+  s->cur_free += mh->buf_len;
   if (s->cur_free > s->max_free)
     s->max_free = s->cur_free;
-  if ((mem_cur_overall_wastage += size * length) > mem_max_overall_wastage)
+  if ((mem_cur_overall_wastage += mh->record_size * mh->buf_len) >
+      mem_max_overall_wastage)
     mem_max_overall_wastage = mem_cur_overall_wastage;
 #else
   UNUSED(name);
@@ -374,6 +538,33 @@ struct mem_helper *create_mem_named(size_t size, int length, char const *name) {
   return mh;
 }
 
+/*************************************************************************
+create_mem_named:
+   In: Size of a single element (including the leading "next" pointer)
+       Number of elements to allocate at once
+       Name of "arena" (used for statistics)
+   Out: Pointer to a new mem_helper struct.
+*************************************************************************/
+
+struct mem_helper *create_mem_named(size_t size, int length, char const *name) {
+  return new_mem_helper(size, length, name, 0);
+}
+
+/*************************************************************************
+create_mem_tagged:
+   In: Size of a single element (including the leading "next" pointer)
+       Number of elements to allocate at once
+       Name of "arena" (used for statistics)
+   Out: Pointer to a new mem_helper struct, whose records can be given
+        back without keeping track of where they came from: mem_birthplace
+        finds it from their address.
+*************************************************************************/
+
+struct mem_helper *create_mem_tagged(size_t size, int length,
+                                     char const *name) {
+  return new_mem_helper(size, length, name, 1);
+}
+
 /*************************************************************************
 create_mem:
    In: Size of a single element (including the leading "next" pointer)
@@ -437,11 +628,11 @@ void *mem_get(struct mem_helper *mh) {
 #endif
     return (void *)retval;
   } else if (mh->buf_index < mh->buf_len) {
-#ifdef MEM_UTIL_TRACK_FREED
-    size_t offset = mh->buf_index * (mh->record_size + sizeof(int));
-#else
-    size_t offset = mh->buf_index * mh->record_size;
-#endif
+    size_t offset = record_offset(mh, mh->buf_index);
+    /* Tag each block as its first record is handed out, by the thread
+       that will use it, so that a mapped chunk stays untouched till then */
+    if (mh->per_block != 0 && mh->buf_index % mh->per_block == 0)
+      *(struct mem_helper **)(mh->heap_array + offset - MEM_BLOCK_HEADER) = mh;
     mh->buf_index++;
 #ifdef MEM_UTIL_KEEP_STATS
     struct mem_stats *s = mh->stats;
@@ -465,21 +656,36 @@ void *mem_get(struct mem_helper *mh) {
 #else
     return (void *)(mh->heap_array + offset);
 #endif
+  } else if (mh->heap_array == NULL) {
+    if (alloc_chunk(mh))
+      return NULL;
+    mh->buf_index = 0;
+    return mem_get(mh);
   } else {
     struct mem_helper *mhnext;
     unsigned char *temp;
+
+    /* Each chunk is twice as large as the last, until chunks fill a huge
+       page */
+    int len = mh->buf_len;
+    if ((size_t)len * MEM_STRIDE(mh) < MEM_HUGE_PAGE_SIZE)
+      len *= 2;
 #ifdef MEM_UTIL_KEEP_STATS
     struct mem_stats *s = mh->stats;
-    mhnext = create_mem_named(mh->record_size, mh->buf_len, s->name);
+    mhnext = new_mem_helper(mh->record_size, len, s->name, mh->per_block != 0);
     ++s->non_head_arenas;
     if (s->non_head_arenas > s->max_non_head_arenas)
       s->max_non_head_arenas = s->non_head_arenas;
     ++s->total_non_head_arenas;
 #else
-    mhnext = create_mem(mh->record_size, mh->buf_len);
+    mhnext = new_mem_helper(mh->record_size, len, NULL, mh->per_block != 0);
 #endif
     if (mhnext == NULL)
       return NULL;
+    if (alloc_chunk(mhnext)) {
+      free(mhnext);
+      return NULL;
+    }
 
     /* Swap contents of this mem_helper with new one */
     /* Keeps mh at top of list but with freshly allocated space */
@@ -487,6 +693,12 @@ void *mem_get(struct mem_helper *mh) {
     temp = mhnext->heap_array;
     mhnext->heap_array = mh->heap_array;
     mh->heap_array = temp;
+    size_t mapped = mhnext->heap_mapped;
+    mhnext->heap_mapped = mh->heap_mapped;
+    mh->heap_mapped = mapped;
+    len = mhnext->buf_len;
+    mhnext->buf_len = mh->buf_len;
+    mh->buf_len = len;
     mhnext->buf_index = mh->buf_index;
     mh->next_helper = mhnext;
 
@@ -597,6 +809,63 @@ void mem_put_list(struct mem_helper *mh, void *defunct) {
 #endif
 }
 
+/*************************************************************************
+mem_footprint:
+   In: A mem_helper
+   Out: The number of bytes of element storage reserved by this
+        mem_helper and the used-up ones chained behind it.
+*************************************************************************/
+
+size_t mem_footprint(struct mem_helper *mh) {
+  size_t bytes = 0;
+  for (; mh != NULL; mh = mh->next_helper) {
+    if (mh->heap_array != NULL)
+      bytes += chunk_bytes(mh);
+  }
+  return bytes;
+}
+
+/*************************************************************************
+empty_mem:
+   In: A mem_helper none of whose records are in use any more
+   Out: No return value.  Its chunks, and the mem_helpers chained behind
+        it, are freed; the next mem_get allocates a fresh chunk.
+   Note: Records given back to another mem_helper must not come from this
+         one, as they are freed too.  mem_birthplace takes care of that.
+*************************************************************************/
+
+void empty_mem(struct mem_helper *mh) {
+#ifndef MEM_UTIL_NO_POOLING
+  if (mh->next_helper != NULL) {
+    delete_mem(mh->next_helper);
+    mh->next_helper = NULL;
+  }
+  free_chunk(mh);
+  mh->heap_array = NULL;
+  mh->heap_mapped = 0;
+  mh->buf_index = mh->buf_len;
+  mh->defunct = NULL;
+#else
+  UNUSED(mh);
+#endif
+}
+
+/*************************************************************************
+mem_birthplace:
+   In: A record allocated from a mem_helper made by create_mem_tagged
+   Out: That mem_helper, to give the record back to with mem_put.
+*************************************************************************/
+
+struct mem_helper *mem_birthplace(void *record) {
+#ifdef MEM_UTIL_NO_POOLING
+  UNUSED(record);
+  return NULL;
+#else
+  uintptr_t block = (uintptr_t)record & ~(uintptr_t)(MEM_BLOCK_SIZE - 1);
+  return *(struct mem_helper **)block;
+#endif
+}
+
 /*************************************************************************
 delete_mem:
    In: A mem_helper
@@ -625,7 +894,128 @@ void delete_mem(struct mem_helper *mh) {
   if (mh->next_helper)
     delete_mem(mh->next_helper);
 #endif
-  free(mh->heap_array);
+  free_chunk(mh);
 #endif
   free(mh);
 }
+
+/**************************************************************************\
+ ** scratch section: bump-pointer storage for short-lived records of any **
+ **   size, all of which are given back at once by releasing to a mark.  **
+\**************************************************************************/
+
+/* Header of a block of scratch memory; the records follow it */
+struct scratch_block {
+  struct scratch_block *prev; /* Block filled before this one */
+  char *end;                  /* End of the block */
+};
+
+#define SCRATCH_ALIGN 16
+#define SCRATCH_BLOCK_SIZE 65536
+#define SCRATCH_HEADER_SIZE                                                    \
+  ((sizeof(struct scratch_block) + SCRATCH_ALIGN - 1) & ~(SCRATCH_ALIGN - 1))
+
+/*************************************************************************
+scratch_get:
+   In: A scratch arena
+       The number of bytes needed
+   Out: Pointer to the bytes, aligned for any record, or NULL if out of
+        memory.  The memory stays valid until the arena is released to a
+        mark taken before this call.
+*************************************************************************/
+
+void *scratch_get(struct scratch_arena *sa, size_t size) {
+  size = (size + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1);
+  if ((size_t)(sa->end - sa->next) < size) {
+    /* Start a new block, reusing the last one given back if it fits */
+    struct scratch_block *sb = sa->spare;
+    if (sb != NULL &&
+        (size_t)(sb->end - ((char *)sb + SCRATCH_HEADER_SIZE)) >= size) {
+      sa->spare = sb->prev;
+    } else {
+      size_t bytes = SCRATCH_HEADER_SIZE + size;
+      if (bytes < SCRATCH_BLOCK_SIZE)
+        bytes = SCRATCH_BLOCK_SIZE;
+      sb = (struct scratch_block *)malloc(bytes);
+      if (sb == NULL)
+        return NULL;
+      sb->end = (char *)sb + bytes;
+    }
+    sb->prev = sa->block;
+    sa->block = sb;
+    sa->next = (char *)sb + SCRATCH_HEADER_SIZE;
+    sa->end = sb->end;
+  }
+
+  void *data = sa->next;
+  sa->next += size;
+  return data;
+}
+
+/*************************************************************************
+checked_scratch_get:
+   In: A scratch arena
+       The number of bytes needed
+       The file and line of the caller, a description of the record and
+         whether to exit on failure (as for checked_mem_get)
+   Out: Pointer to the bytes, as for scratch_get.
+*************************************************************************/
+
+void *checked_scratch_get(struct scratch_arena *sa, size_t size,
+                          char const *file, unsigned int line,
+                          char const *desc, int onfailure) {
+  void *data = scratch_get(sa, size);
+  if (data == NULL)
+    memalloc_failure(file, line, size, desc, onfailure);
+  return data;
+}
+
+/*************************************************************************
+scratch_save:
+   In: A scratch arena
+   Out: A mark of how much of the arena is in use.
+*************************************************************************/
+
+struct scratch_mark scratch_save(struct scratch_arena *sa) {
+  struct scratch_mark mark = { sa->block, sa->next };
+  return mark;
+}
+
+/*************************************************************************
+scratch_release:
+   In: A scratch arena
+       A mark returned by scratch_save on the arena
+   Out: No return value.  Everything taken from the arena since the mark
+        was saved is given back.  The emptied blocks are kept for reuse.
+*************************************************************************/
+
+void scratch_release(struct scratch_arena *sa, struct scratch_mark mark) {
+  while (sa->block != mark.block) {
+    struct scratch_block *sb = sa->block;
+    sa->block = sb->prev;
+    sb->prev = sa->spare;
+    sa->spare = sb;
+  }
+  if (sa->block != NULL) {
+    sa->next = mark.next;
+    sa->end = sa->block->end;
+  } else
+    sa->next = sa->end = NULL;
+}
+
+/*************************************************************************
+delete_scratch:
+   In: A scratch arena
+   Out: No return value.  All memory of the arena is freed, and the arena
+        is left empty.
+*************************************************************************/
+
+void delete_scratch(struct scratch_arena *sa) {
+  struct scratch_mark none = { NULL, NULL };
+  scratch_release(sa, none);
+  while (sa->spare != NULL) {
+    struct scratch_block *sb = sa->spare;
+    sa->spare = sb->prev;
+    free(sb);
+  }
+}
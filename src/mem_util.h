@@ -50,6 +50,11 @@ struct mem_helper;
 void *checked_mem_get(struct mem_helper *mh, char const *file,
                       unsigned int line, char const *desc, int onfailure);
 
+struct scratch_arena;
+void *checked_scratch_get(struct scratch_arena *sa, size_t size,
+                          char const *file, unsigned int line,
+                          char const *desc, int onfailure);
+
 #define CM_EXIT (1)
 #define CHECKED_STRDUP_NODIE(s, desc)                                          \
   checked_strdup((s), __FILE__, __LINE__, desc, 0)
@@ -71,6 +76,9 @@ void *checked_mem_get(struct mem_helper *mh, char const *file,
   checked_mem_get((mh), __FILE__, __LINE__, desc, 0)
 #define CHECKED_MEM_GET(mh, desc)                                              \
   checked_mem_get((mh), __FILE__, __LINE__, desc, CM_EXIT)
+#define CHECKED_SCRATCH_GET(sa, tp, desc)                                      \
+  (tp *) checked_scratch_get((sa), sizeof(tp), __FILE__, __LINE__, desc,       \
+                             CM_EXIT)
 #define CHECKED_SPRINTF_NODIE(fmt, ...)                                        \
   checked_alloc_sprintf(__FILE__, __LINE__, 0, fmt, ##__VA_ARGS__)
 #define CHECKED_SPRINTF(fmt, ...)                                              \
@@ -87,7 +95,12 @@ struct mem_helper {
   int buf_len;               /* Number of elements to allocate at once  */
   int buf_index;             /* Index of the next unused element in the array */
   size_t record_size;           /* Size of the element to allocate */
-  unsigned char *heap_array; /* Block of memory for elements */
+  unsigned char *heap_array; /* Block of memory for elements, NULL until
+                                mem_get first needs it */
+  size_t heap_mapped;        /* Bytes mapped for heap_array, or 0 if it was
+                                malloc'ed */
+  int per_block;             /* Records in each tagged block of heap_array,
+                                or 0 if it is not tagged */
   struct abstract_list *defunct; /* Linked list of elements that may be reused
                                     for next memory request */
   struct mem_helper *next_helper; /* Next (fully-used) mem_helper */
@@ -105,10 +118,35 @@ void mem_dump_stats(FILE *out);
 #endif
 
 struct mem_helper *create_mem_named(size_t size, int length, char const *name);
+struct mem_helper *create_mem_tagged(size_t size, int length,
+                                     char const *name);
 struct mem_helper *create_mem(size_t size, int length);
 void *mem_get(struct mem_helper *mh);
 void mem_put(struct mem_helper *mh, void *defunct);
 void mem_put_list(struct mem_helper *mh, void *defunct);
+size_t mem_footprint(struct mem_helper *mh);
+void empty_mem(struct mem_helper *mh);
+struct mem_helper *mem_birthplace(void *record);
 void delete_mem(struct mem_helper *mh);
 
+/* Bump-pointer storage for records needed only for a short while, such as
+   the collision lists of one diffusion step.  A zeroed arena is empty. */
+struct scratch_arena {
+  struct scratch_block *block; /* Block being filled, or NULL */
+  char *next;                  /* Free space left in that block */
+  char *end;
+  struct scratch_block *spare; /* Emptied blocks kept for reuse */
+};
+
+/* How much of a scratch arena was in use (see scratch_save) */
+struct scratch_mark {
+  struct scratch_block *block;
+  char *next;
+};
+
+void *scratch_get(struct scratch_arena *sa, size_t size);
+struct scratch_mark scratch_save(struct scratch_arena *sa);
+void scratch_release(struct scratch_arena *sa, struct scratch_mark mark);
+void delete_scratch(struct scratch_arena *sa);
+
 #define stack_nonempty(sh) ((sh)->index > 0 || (sh)->next != NULL)
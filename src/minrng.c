@@ -35,8 +35,15 @@ ub4 mrng_generate(struct mrng_state *x) {
 }
 
 void mrng_init(struct mrng_state *x, ub4 seed) {
+  mrng_init_stream(x, seed, 0);
+}
+
+/* Seeds one of many independent sequences derived from the same seed;
+   stream 0 is the sequence produced by mrng_init. */
+void mrng_init_stream(struct mrng_state *x, ub4 seed, ub4 stream) {
   ub4 i;
-  x->a = 0xf1ea5eed, x->b = x->c = x->d = seed;
+  x->a = 0xf1ea5eed, x->b = seed;
+  x->c = x->d = seed ^ (stream * 0x9e3779b9);
   for (i = 0; i < 20; ++i) {
     (void)mrng_generate(x);
   }
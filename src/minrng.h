@@ -38,6 +38,7 @@ struct mrng_state {
 
 ub4 mrng_generate(struct mrng_state *x);
 void mrng_init(struct mrng_state *x, ub4 seed);
+void mrng_init_stream(struct mrng_state *x, ub4 seed, ub4 stream);
 #define mrng_uint32(rng) (mrng_generate(rng))
 
 #define mrng_dbl32(rng) (DBL32 *(double)mrng_uint32(rng))
@@ -0,0 +1,284 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2006-2017 by
+ * The Salk Institute for Biological Studies and
+ * Pittsburgh Supercomputing Center, Carnegie Mellon University
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ *
+******************************************************************************/
+
+/*
+------------------------------------------------------------------------------
+philox.c: Philox4x32-10 counter-based random number generator.
+------------------------------------------------------------------------------
+*/
+#include "config.h"
+
+#include <string.h>
+
+#include "philox.h"
+
+/* The AVX2 kernel is built whatever the compiler's target flags and is
+   picked at run time when the processor supports it */
+#if (defined(__GNUC__) || defined(__clang__)) &&                              \
+    (defined(__x86_64__) || defined(__i386__)) && PHILOX_BUFFER_BLOCKS == 4
+#define PHILOX_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+/* Marks counters of molecule sequences, which sequential streams never reach */
+#define PHILOX_SEEKED 0x80000000U
+
+/*************************************************************************
+philox4x32:
+  In: ctr: 128-bit counter
+      key: 64-bit key
+      out: where to store the result
+  Out: No return value.  out holds the 4 random words for (ctr, key).
+*************************************************************************/
+void philox4x32(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]) {
+  uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+  uint32_t k0 = key[0], k1 = key[1];
+
+  for (int round = 0; round < 10; ++round) {
+    uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+    uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+    uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_t)p1;
+    c3 = (uint32_t)p0;
+    c0 = n0;
+    c2 = n2;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+/*************************************************************************
+philox_rounds:
+  In: c0, c1, c2, c3: words of PHILOX_BUFFER_BLOCKS counters
+      k0, k1: key
+  Out: No return value.  The counters are replaced by their blocks.  This
+       is a plain loop over the blocks, which the compiler is free to
+       vectorize.
+*************************************************************************/
+static void philox_rounds(uint32_t c0[PHILOX_BUFFER_BLOCKS],
+                          uint32_t c1[PHILOX_BUFFER_BLOCKS],
+                          uint32_t c2[PHILOX_BUFFER_BLOCKS],
+                          uint32_t c3[PHILOX_BUFFER_BLOCKS], uint32_t k0,
+                          uint32_t k1) {
+  for (int round = 0; round < 10; ++round) {
+    for (int j = 0; j < PHILOX_BUFFER_BLOCKS; ++j) {
+      uint64_t p0 = (uint64_t)PHILOX_M0 * c0[j];
+      uint64_t p1 = (uint64_t)PHILOX_M1 * c2[j];
+      uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1[j] ^ k0;
+      uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3[j] ^ k1;
+      c1[j] = (uint32_t)p1;
+      c3[j] = (uint32_t)p0;
+      c0[j] = n0;
+      c2[j] = n2;
+    }
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+}
+
+#ifdef PHILOX_AVX2_KERNEL
+/*************************************************************************
+philox_rounds_avx2:
+  In: c0, c1, c2, c3: words of the 4 counters
+      k0, k1: key
+  Out: No return value.  Same as philox_rounds, with each word of the 4
+       blocks held in the 64-bit lanes of one AVX2 register so that
+       _mm256_mul_epu32 gives the full products.  Only to be called when
+       the processor supports AVX2.
+*************************************************************************/
+__attribute__((target("avx2"))) static void
+philox_rounds_avx2(uint32_t c0[4], uint32_t c1[4], uint32_t c2[4],
+                   uint32_t c3[4], uint32_t k0, uint32_t k1) {
+  const __m256i m0 = _mm256_set1_epi64x(PHILOX_M0);
+  const __m256i m1 = _mm256_set1_epi64x(PHILOX_M1);
+  const __m256i low = _mm256_set1_epi64x(0xFFFFFFFFLL);
+  __m256i v0 = _mm256_setr_epi64x(c0[0], c0[1], c0[2], c0[3]);
+  __m256i v1 = _mm256_setr_epi64x(c1[0], c1[1], c1[2], c1[3]);
+  __m256i v2 = _mm256_setr_epi64x(c2[0], c2[1], c2[2], c2[3]);
+  __m256i v3 = _mm256_setr_epi64x(c3[0], c3[1], c3[2], c3[3]);
+
+  for (int round = 0; round < 10; ++round) {
+    __m256i p0 = _mm256_mul_epu32(v0, m0);
+    __m256i p1 = _mm256_mul_epu32(v2, m1);
+    __m256i n0 = _mm256_xor_si256(
+        _mm256_xor_si256(_mm256_srli_epi64(p1, 32), v1),
+        _mm256_set1_epi64x(k0));
+    __m256i n2 = _mm256_xor_si256(
+        _mm256_xor_si256(_mm256_srli_epi64(p0, 32), v3),
+        _mm256_set1_epi64x(k1));
+    v1 = _mm256_and_si256(p1, low);
+    v3 = _mm256_and_si256(p0, low);
+    v0 = n0;
+    v2 = n2;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  uint64_t lanes[4][4];
+  _mm256_storeu_si256((__m256i *)lanes[0], v0);
+  _mm256_storeu_si256((__m256i *)lanes[1], v1);
+  _mm256_storeu_si256((__m256i *)lanes[2], v2);
+  _mm256_storeu_si256((__m256i *)lanes[3], v3);
+  for (int j = 0; j < 4; ++j) {
+    c0[j] = (uint32_t)lanes[0][j];
+    c1[j] = (uint32_t)lanes[1][j];
+    c2[j] = (uint32_t)lanes[2][j];
+    c3[j] = (uint32_t)lanes[3][j];
+  }
+}
+#endif
+
+/*************************************************************************
+philox4x32_blocks:
+  In: ctr: 128-bit counter of the first block
+      key: 64-bit key
+      out: where to store the result
+  Out: No return value.  out holds the PHILOX_BUFFER_BLOCKS blocks for
+       counters ctr, ctr + 1, ..., one block after the other, exactly as
+       philox4x32 would compute them.  The blocks are independent, so each
+       round is done for all of them at once, with the AVX2 kernel if the
+       processor has it.
+*************************************************************************/
+void philox4x32_blocks(const uint32_t ctr[4], const uint32_t key[2],
+                       uint32_t out[PHILOX_BUFFER]) {
+  uint32_t c0[PHILOX_BUFFER_BLOCKS], c1[PHILOX_BUFFER_BLOCKS];
+  uint32_t c2[PHILOX_BUFFER_BLOCKS], c3[PHILOX_BUFFER_BLOCKS];
+
+  /* Same carries as philox_generate */
+  for (int j = 0; j < PHILOX_BUFFER_BLOCKS; ++j) {
+    c0[j] = ctr[0] + j;
+    c1[j] = ctr[1] + (c0[j] < ctr[0]);
+    c2[j] = ctr[2] + (c0[j] < ctr[0] && c1[j] == 0);
+    c3[j] = ctr[3];
+  }
+
+#ifdef PHILOX_AVX2_KERNEL
+  if (__builtin_cpu_supports("avx2"))
+    philox_rounds_avx2(c0, c1, c2, c3, key[0], key[1]);
+  else
+    philox_rounds(c0, c1, c2, c3, key[0], key[1]);
+#else
+  philox_rounds(c0, c1, c2, c3, key[0], key[1]);
+#endif
+
+  for (int j = 0; j < PHILOX_BUFFER_BLOCKS; ++j) {
+    out[4 * j] = c0[j];
+    out[4 * j + 1] = c1[j];
+    out[4 * j + 2] = c2[j];
+    out[4 * j + 3] = c3[j];
+  }
+}
+
+/*************************************************************************
+philox_init:
+  In: rng: generator to set up
+      seed: seed of the run
+      stream: which of the independent sequential streams to use
+  Out: No return value.  rng is at the start of the stream.
+*************************************************************************/
+void philox_init(struct philox_state *rng, uint32_t seed, uint32_t stream) {
+  memset(rng, 0, sizeof(struct philox_state));
+  rng->pos.key[0] = seed;
+  rng->pos.key[1] = stream;
+}
+
+/*************************************************************************
+philox_generate:
+  In: rng: generator
+  Out: No return value.  The buffer is refilled with the next blocks of
+       output and the counter advanced past them.  A molecule's step
+       rarely uses more than one block, so sequences reached by
+       philox_seek are refilled one block at a time.  Either way the
+       outputs come in counter order, so the numbers drawn do not depend
+       on how the buffer was filled.
+*************************************************************************/
+void philox_generate(struct philox_state *rng) {
+  struct philox_position *p = &rng->pos;
+  unsigned int blocks = 1;
+  if (rng->seeked) {
+    philox4x32(p->ctr, p->key, p->block);
+  } else {
+    philox4x32_blocks(p->ctr, p->key, p->block);
+    blocks = PHILOX_BUFFER_BLOCKS;
+  }
+  p->next = 0;
+  p->filled = 4 * blocks;
+
+  uint32_t old = p->ctr[0];
+  p->ctr[0] += blocks;
+  if (p->ctr[0] < old && ++p->ctr[1] == 0)
+    ++p->ctr[2];
+}
+
+/*************************************************************************
+philox_seek:
+  In: rng: generator
+      id: molecule id
+      t: scheduled time of the molecule's step
+      substream: which sequence of the step to draw from (see rng.h)
+  Out: No return value.  Subsequent draws come from the sequence belonging
+       to this step of this molecule, which does not depend on what was
+       drawn before.  The sequential position is kept for philox_resume.
+*************************************************************************/
+void philox_seek(struct philox_state *rng, unsigned long long id, double t,
+                 int substream) {
+  uint64_t t_bits;
+  memcpy(&t_bits, &t, sizeof(t_bits));
+
+  if (!rng->seeked) {
+    rng->stream = rng->pos;
+    rng->seeked = 1;
+  }
+
+  struct philox_position *p = &rng->pos;
+  p->key[1] = (uint32_t)id;
+  p->ctr[0] = substream ? PHILOX_SEEKED : 0;
+  p->ctr[1] = (uint32_t)t_bits;
+  p->ctr[2] = (uint32_t)(t_bits >> 32);
+  p->ctr[3] = PHILOX_SEEKED | (uint32_t)(id >> 32);
+  p->next = p->filled = 0;
+}
+
+/*************************************************************************
+philox_resume:
+  In: rng: generator
+  Out: No return value.  Returns to the sequential stream after
+       philox_seek.
+*************************************************************************/
+void philox_resume(struct philox_state *rng) {
+  if (rng->seeked) {
+    rng->pos = rng->stream;
+    rng->seeked = 0;
+  }
+}
@@ -0,0 +1,77 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2006-2017 by
+ * The Salk Institute for Biological Studies and
+ * Pittsburgh Supercomputing Center, Carnegie Mellon University
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ *
+******************************************************************************/
+
+/*
+------------------------------------------------------------------------------
+philox.h: Philox4x32-10 counter-based random number generator
+(Salmon, Moraes, Dror and Shaw, "Parallel random numbers: as easy as 1, 2, 3",
+SC11).  Every block of four 32-bit outputs is a pure function of a 128-bit
+counter and a 64-bit key, so any position of any stream can be reached
+directly instead of by stepping through the sequence.
+------------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <inttypes.h>
+
+#define PHILOX_DBL32 (2.3283064365386962890625e-10)
+
+/* Sequential streams are refilled this many blocks at a time, which lets the
+   rounds of all blocks run side by side in vector registers */
+#define PHILOX_BUFFER_BLOCKS 4
+#define PHILOX_BUFFER (4 * PHILOX_BUFFER_BLOCKS)
+
+/* Position within the Philox sequence */
+struct philox_position {
+  uint32_t key[2];              /* (seed, stream) or (seed, low word of id) */
+  uint32_t ctr[4];              /* Counter of the next block */
+  uint32_t block[PHILOX_BUFFER]; /* Buffered output, in sequence order */
+  unsigned int next;            /* Index of the next output in block */
+  unsigned int filled;          /* Number of valid outputs in block */
+};
+
+struct philox_state {
+  struct philox_position pos;
+  struct philox_position stream; /* Sequential position saved while seeked */
+  int seeked;                    /* Drawing from a molecule's sequence */
+  long long used;                /* Outputs drawn so far */
+};
+
+void philox4x32(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]);
+void philox4x32_blocks(const uint32_t ctr[4], const uint32_t key[2],
+                       uint32_t out[PHILOX_BUFFER]);
+
+void philox_init(struct philox_state *rng, uint32_t seed, uint32_t stream);
+void philox_generate(struct philox_state *rng);
+void philox_seek(struct philox_state *rng, unsigned long long id, double t,
+                 int substream);
+void philox_resume(struct philox_state *rng);
+
+#define philox_uint32(rng)                                                     \
+  ((rng)->used++,                                                              \
+   (rng)->pos.next < (rng)->pos.filled                                         \
+       ? (rng)->pos.block[(rng)->pos.next++]                                   \
+       : (philox_generate(rng), (rng)->pos.block[(rng)->pos.next++]))
+
+#define philox_dbl32(rng) (PHILOX_DBL32 * philox_uint32(rng))
@@ -45,6 +45,9 @@ enum {
 
 #define IS_SURF_MOL(g) ((g) != NULL && ((g)->properties->flags & ON_GRID))
 
+/* Largest model whose reaction partners are also kept as a bit matrix */
+#define RX_PAIR_BITS_MAX_SPECIES 8192
+
 /* In react_trig.c */
 struct rxn *trigger_unimolecular(struct rxn **reaction_hash, int hashsize,
                                  u_int hash, struct abstract_molecule *reac);
@@ -73,6 +76,9 @@ int trigger_trimolecular(struct rxn **reaction_hash, int rx_hashsize,
                          struct species *reacC, int orientA, int orientB,
                          int orientC, struct rxn **matching_rxns);
 
+int init_reaction_pairs(struct rxn **reaction_hash, int rx_hashsize,
+                        struct species **species_list, int n_species);
+
 int trigger_intersect(struct rxn **reaction_hash, int rx_hashsize,
                       struct species *all_mols, struct species *all_volume_mols,
                       struct species *all_surface_mols, u_int hashA,
@@ -110,7 +110,7 @@ int test_bimolecular(struct rxn *rx, double scaling, double local_prob_factor,
                      struct abstract_molecule *a1, struct abstract_molecule *a2,
                      struct rng_state *rng) {
   if (a1 != NULL && a2 != NULL) {
-    assert(periodic_boxes_are_identical(a1->periodic_box, a2->periodic_box));
+    assert(periodic_boxes_are_identical(&a1->periodic_box, &a2->periodic_box));
   }
 
   /* rescale probabilities for the case of the reaction
@@ -140,9 +140,9 @@ int test_bimolecular(struct rxn *rx, double scaling, double local_prob_factor,
     {
       /* How may reactions will we miss? */
       if (scaling == 0.0)
-        rx->n_skipped += GIGANTIC;
+        THREADED_ADD_DOUBLE(rx->n_skipped, GIGANTIC);
       else
-        rx->n_skipped += (max_p / scaling) - 1.0;
+        THREADED_ADD_DOUBLE(rx->n_skipped, (max_p / scaling) - 1.0);
 
       /* Keep the proportions of outbound pathways the same. */
       p = rng_dbl(rng) * max_p;
@@ -231,12 +231,12 @@ int test_many_bimolecular(struct rxn **rx, double *scaling,
     for (i = 0; i < n; i++) /* Distribute failures */
     {
       if (all_neighbors_flag && local_prob_factor > 0) {
-        rx[i]->n_skipped += f * ((rx[i]->cum_probs[rx[i]->n_pathways - 1]) *
-                                 local_prob_factor) /
-                            rxp[n - 1];
+        THREADED_ADD_DOUBLE(rx[i]->n_skipped,
+                            f * ((rx[i]->cum_probs[rx[i]->n_pathways - 1]) *
+                                 local_prob_factor) / rxp[n - 1]);
       } else {
-        rx[i]->n_skipped +=
-            f * (rx[i]->cum_probs[rx[i]->n_pathways - 1]) / rxp[n - 1];
+        THREADED_ADD_DOUBLE(rx[i]->n_skipped,
+            f * (rx[i]->cum_probs[rx[i]->n_pathways - 1]) / rxp[n - 1]);
       }
     }
     p = rng_dbl(rng) * rxp[n - 1];
@@ -285,9 +285,10 @@ int test_intersect(struct rxn *rx, double scaling, struct rng_state *rng) {
 
   if (rx->cum_probs[rx->n_pathways - 1] > scaling) {
     if (scaling <= 0.0)
-      rx->n_skipped += GIGANTIC;
+      THREADED_ADD_DOUBLE(rx->n_skipped, GIGANTIC);
     else
-      rx->n_skipped += rx->cum_probs[rx->n_pathways - 1] / scaling - 1.0;
+      THREADED_ADD_DOUBLE(rx->n_skipped,
+                          rx->cum_probs[rx->n_pathways - 1] / scaling - 1.0);
     p = rng_dbl(rng) * rx->cum_probs[rx->n_pathways - 1];
   } else {
     p = rng_dbl(rng) * scaling;
@@ -339,8 +340,8 @@ int test_many_intersect(struct rxn **rx, double scaling, int n,
     double f = rxp[n - 1] - 1.0; /* Number of failed reactions */
     for (i = 0; i < n; i++)      /* Distribute failures */
     {
-      rx[i]->n_skipped +=
-          f * (rx[i]->cum_probs[rx[i]->n_pathways - 1]) / rxp[n - 1];
+      THREADED_ADD_DOUBLE(rx[i]->n_skipped,
+          f * (rx[i]->cum_probs[rx[i]->n_pathways - 1]) / rxp[n - 1]);
     }
     p = rng_dbl(rng) * rxp[n - 1];
   } else {
@@ -421,6 +422,11 @@ void update_probs(struct volume *world, struct rxn *rx, double t) {
   int did_something = 0;
   double new_prob = 0;
 
+  if (rx->prob_t == NULL || rx->prob_t->time >= t)
+    return;
+
+  /* Reactions are shared between worker threads */
+  thread_shared_lock(world);
   for (tv = rx->prob_t; tv != NULL && tv->time < t; tv = tv->next) {
     j = tv->path;
     if (j == 0)
@@ -479,6 +485,7 @@ void update_probs(struct volume *world, struct rxn *rx, double t) {
   }
 
   rx->prob_t = tv;
+  thread_shared_unlock(world);
 
   if (!did_something)
     return;
@@ -575,12 +582,12 @@ int test_many_reactions_all_neighbors(struct rxn **rx, double *scaling,
     for (int i = 0; i < n; i++)  /* Distribute failures */
     {
       if (local_prob_factor[i] > 0) {
-        rx[i]->n_skipped += f * ((rx[i]->cum_probs[rx[i]->n_pathways - 1]) *
-                                 local_prob_factor[i]) /
-                            rxp[n - 1];
+        THREADED_ADD_DOUBLE(rx[i]->n_skipped,
+                            f * ((rx[i]->cum_probs[rx[i]->n_pathways - 1]) *
+                                 local_prob_factor[i]) / rxp[n - 1]);
       } else {
-        rx[i]->n_skipped +=
-            f * (rx[i]->cum_probs[rx[i]->n_pathways - 1]) / rxp[n - 1];
+        THREADED_ADD_DOUBLE(rx[i]->n_skipped,
+            f * (rx[i]->cum_probs[rx[i]->n_pathways - 1]) / rxp[n - 1]);
       }
     }
     p = rng_dbl(rng) * rxp[n - 1];
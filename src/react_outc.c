@@ -125,10 +125,13 @@ void tiny_diffuse_3D(
     .y = displacement->y,
     .z = displacement->z
   };
+  struct scratch_arena *scratch = local_scratch(world);
+  struct scratch_mark mark = scratch_save(scratch);
   struct collision *shead = ray_trace(
       world, pos, NULL, subvol, &temp_displacement, w);
   if (shead->next != NULL) {
-    shead = (struct collision *)ae_list_sort((struct abstract_element *)shead);
+    shead = (struct collision *)sort_collisions(
+        scratch, (struct abstract_element *)shead);
   }
 
   struct collision *smash = NULL;
@@ -139,6 +142,7 @@ void tiny_diffuse_3D(
       break;
     }
   }
+  scratch_release(scratch, mark);
   pos->x += displacement->x;
   pos->y += displacement->y;
   pos->z += displacement->z;
@@ -167,23 +171,17 @@ place_volume_product(struct volume *world, struct species *product_species,
   struct volume_molecule *new_volume_mol;
   new_volume_mol =
       CHECKED_MEM_GET(subvol->local_storage->mol, "volume molecule");
-  new_volume_mol->birthplace = subvol->local_storage->mol;
   new_volume_mol->birthday = convert_iterations_to_seconds(
       world->start_iterations, world->time_unit,
       world->simulation_start_seconds, t);
-  new_volume_mol->id = world->current_mol_id++;
+  new_volume_mol->id = next_molecule_id(world);
   new_volume_mol->t = t;
   new_volume_mol->t2 = 0.0;
 
-  new_volume_mol->periodic_box = CHECKED_MALLOC_STRUCT(struct periodic_image,
-    "periodic image descriptor");
-  new_volume_mol->periodic_box->x = periodic_box->x;
-  new_volume_mol->periodic_box->y = periodic_box->y;
-  new_volume_mol->periodic_box->z = periodic_box->z;
+  new_volume_mol->periodic_box = *periodic_box;
 
   new_volume_mol->properties = product_species;
-  new_volume_mol->prev_v = NULL;
-  new_volume_mol->next_v = NULL;
+  new_volume_mol->species_list = NULL;
   new_volume_mol->pos = pos;
   new_volume_mol->subvol = subvol;
   new_volume_mol->index = 0;
@@ -225,7 +223,8 @@ place_volume_product(struct volume *world, struct species *product_species,
       new_volume_mol->flags |= ACT_CLAMPED;
     }
   } else if (world->volume_reversibility) {
-    new_volume_mol->index = world->dissociation_index;
+    new_volume_mol->index =
+        __atomic_load_n(&world->dissociation_index, __ATOMIC_RELAXED);
     new_volume_mol->flags |= ACT_CLAMPED;
   }
 
@@ -235,7 +234,7 @@ place_volume_product(struct volume *world, struct species *product_species,
   ++new_volume_mol->subvol->mol_count;
 
   /* Add to the schedule. */
-  if (schedule_add(subvol->local_storage->timer, new_volume_mol))
+  if (storage_schedule_add(world, subvol->local_storage, new_volume_mol))
     mcell_allocfailed("Failed to add newly created %s molecule to scheduler.",
                       product_species->sym->name);
   return new_volume_mol;
@@ -253,19 +252,14 @@ place_sm_product(struct volume *world, struct species *product_species,
   /* Allocate and initialize the molecule. */
   struct surface_molecule *new_surf_mol;
   new_surf_mol = CHECKED_MEM_GET(sv->local_storage->smol, "surface molecule");
-  new_surf_mol->birthplace = sv->local_storage->smol;
   new_surf_mol->birthday = convert_iterations_to_seconds(
       world->start_iterations, world->time_unit,
       world->simulation_start_seconds, t);
-  new_surf_mol->id = world->current_mol_id++;
+  new_surf_mol->id = next_molecule_id(world);
   new_surf_mol->t = t;
   new_surf_mol->t2 = 0.0;
   new_surf_mol->properties = product_species;
-  new_surf_mol->periodic_box = CHECKED_MALLOC_STRUCT(struct periodic_image,
-    "periodic image descriptor");
-  new_surf_mol->periodic_box->x = periodic_box->x;
-  new_surf_mol->periodic_box->y = periodic_box->y;
-  new_surf_mol->periodic_box->z = periodic_box->z;
+  new_surf_mol->periodic_box = *periodic_box;
 
   new_surf_mol->flags = TYPE_SURF | ACT_NEWBIE | IN_SCHEDULE;
   if (product_species->space_step > 0)
@@ -285,16 +279,17 @@ place_sm_product(struct volume *world, struct species *product_species,
     new_surf_mol->flags |= ACT_REACT;
 
   /* Add to the grid. */
-  ++grid->n_occupied;
-  if (grid->sm_list[grid_index]) {
+  THREADED_ADD(grid->n_occupied, 1);
+  if (tile_sm_list(grid, grid_index)) {
     remove_surfmol_from_list(
-        &grid->sm_list[grid_index], grid->sm_list[grid_index]->sm);
+        tile_sm_slot(grid, grid_index), tile_sm_list(grid, grid_index)->sm);
   }
-  grid->sm_list[grid_index] = add_surfmol_with_unique_pb_to_list(
-    grid->sm_list[grid_index], new_surf_mol);
+  *tile_sm_slot(grid, grid_index) = add_surfmol_with_unique_pb_to_list(
+    tile_sm_list(grid, grid_index), new_surf_mol);
+  update_tile_occupancy(grid, grid_index);
 
   /* Add to the schedule. */
-  if (schedule_add(sv->local_storage->timer, new_surf_mol))
+  if (storage_schedule_add(world, sv->local_storage, new_surf_mol))
     mcell_allocfailed("Failed to add newly created %s molecule to scheduler.",
                       product_species->sym->name);
 
@@ -486,8 +481,7 @@ static int outcome_products_random(struct volume *world, struct wall *w,
       /* Create list of vacant tiles */
       for (struct tile_neighbor *tile_nbr = tile_nbr_head; tile_nbr != NULL;
            tile_nbr = tile_nbr->next) {
-        struct surface_molecule_list *sm_list = tile_nbr->grid->sm_list[tile_nbr->idx]; 
-        if (sm_list == NULL || sm_list->sm == NULL) {
+        if (!tile_occupied(tile_nbr->grid, tile_nbr->idx)) {
           num_vacant_tiles++;
           push_tile_neighbor_to_list(&tile_vacant_nbr_head, tile_nbr->grid, tile_nbr->idx);
         }
@@ -518,7 +512,7 @@ static int outcome_products_random(struct volume *world, struct wall *w,
 
       /* Geometry of 0 means "random orientation" */
       if (this_geometry == 0) {
-        product_orient[n_product] = (rng_uint(world->rng) & 1) ? 1 : -1;
+        product_orient[n_product] = (rng_uint(local_rng(world)) & 1) ? 1 : -1;
       } else {
         if (this_geometry > (int)rx->n_reactants) {
           product_orient[n_product] = relative_orient *
@@ -709,7 +703,7 @@ static int outcome_products_random(struct volume *world, struct wall *w,
 
           int count = 0;
           while (count < max_static_count) {
-            unsigned int rnd_num = rng_uint(world->rng) % n_players;
+            unsigned int rnd_num = rng_uint(local_rng(world)) % n_players;
             /* pass reactants */
             if ((rnd_num < rx->n_reactants) || (rx_players[rnd_num] == NULL) ||
                 ((rx_players[rnd_num]->flags & NOT_FREE) == 0) ||
@@ -764,7 +758,7 @@ static int outcome_products_random(struct volume *world, struct wall *w,
           }
           int count = 0;
           while (count < num_to_place) {
-            unsigned int rnd_num = rng_uint(world->rng) % n_players;
+            unsigned int rnd_num = rng_uint(local_rng(world)) % n_players;
             if ((rnd_num < rx->n_reactants) || (rx_players[rnd_num] == NULL) ||
                 (rx_players[rnd_num]->flags & NOT_FREE) == 0) {
              continue;
@@ -796,7 +790,7 @@ static int outcome_products_random(struct volume *world, struct wall *w,
       assert(rxn_uv_idx != -1);
 
       while (true) {
-        unsigned int rnd_num = rng_uint(world->rng) % (n_players);
+        unsigned int rnd_num = rng_uint(local_rng(world)) % (n_players);
         if (rnd_num <= 1 || (rx_players[rnd_num] == NULL) ||
             (rx_players[rnd_num]->flags & NOT_FREE) == 0) {
           continue;
@@ -840,7 +834,7 @@ static int outcome_products_random(struct volume *world, struct wall *w,
           }
 
           /* randomly pick a tile from the list */
-          unsigned int rnd_num = rng_uint(world->rng) % num_vacant_tiles;
+          unsigned int rnd_num = rng_uint(local_rng(world)) % num_vacant_tiles;
           int tile_idx = -1; /* index of the tile on the grid */
           tile_grid = NULL;
           if (get_tile_neighbor_from_list_of_vacant_neighbors(
@@ -878,7 +872,7 @@ static int outcome_products_random(struct volume *world, struct wall *w,
 
   /* Determine the location of the reaction for count purposes. */
   struct vector3 count_pos_xyz;
-  struct periodic_image *periodic_box = ((struct volume_molecule *)reacA)->periodic_box;
+  struct periodic_image *periodic_box = &((struct volume_molecule *)reacA)->periodic_box;
   if (hitpt != NULL) {
     count_pos_xyz = *hitpt;
   } else if (sm_reactant) {
@@ -932,7 +926,7 @@ static int outcome_products_random(struct volume *world, struct wall *w,
                                   reac_idx, &prod_uv_pos);
           } else {
             grid2uv_random(product_grid[n_product], product_grid_idx[n_product],
-                           &prod_uv_pos, world->rng);
+                           &prod_uv_pos, local_rng(world));
           }
           break;
 
@@ -947,7 +941,7 @@ static int outcome_products_random(struct volume *world, struct wall *w,
       this_product = (struct abstract_molecule *)place_sm_product(
           world, product_species, product_grid[n_product],
           product_grid_idx[n_product], &prod_uv_pos, product_orient[n_product],
-          t, reacA->periodic_box);
+          t, &reacA->periodic_box);
     } else { /* else place the molecule in space. */
       /* For either a unimolecular reaction, or a reaction between two surface
          molecules we don't have a hitpoint. */
@@ -971,35 +965,35 @@ static int outcome_products_random(struct volume *world, struct wall *w,
 
       this_product = (struct abstract_molecule *)place_volume_product(
           world, product_species, sm_reactant, w, product_subvol, hitpt,
-          product_orient[n_product], t, reacA->periodic_box);
+          product_orient[n_product], t, &reacA->periodic_box);
 
       if (((struct volume_molecule *)this_product)->index < DISSOCIATION_MAX)
         update_dissociation_index = true;
     }
 
     /* Update molecule counts */
-    ++product_species->population;
+    THREADED_ADD(product_species->population, 1);
     if (product_species->flags & (COUNT_CONTENTS | COUNT_ENCLOSED))
-      count_region_from_scratch(world, this_product, NULL, 1, NULL, NULL, t, this_product->periodic_box);
+      count_region_from_scratch(world, this_product, NULL, 1, NULL, NULL, t, &this_product->periodic_box);
 
     /* preserve molecule id if rxn is unimolecular with one product */
     if (is_unimol && (n_players == 1)) {
       this_product->id = reacA->id;
-      world->current_mol_id--; /* give back id we used */
+      return_molecule_id(world); /* give back id we used */
       continue;
     }
     /* preserve molecule id if rxn is surface rxn with one product */
     if ((n_players == 3) && product_type[1] == PLAYER_WALL) {
       this_product->id = reacA->id;
-      world->current_mol_id--; /* give back id we used */
+      return_molecule_id(world); /* give back id we used */
       continue;
     }
   }
 
   /* If necessary, update the dissociation index. */
   if (update_dissociation_index) {
-    if (--world->dissociation_index < DISSOCIATION_MIN)
-      world->dissociation_index = DISSOCIATION_MAX;
+    thread_atomic_cycle_down(&world->dissociation_index, DISSOCIATION_MIN,
+                             DISSOCIATION_MAX);
   }
 
   /* Handle events triggered off of named reactions */
@@ -1073,8 +1067,8 @@ int outcome_unimolecular(struct volume *world, struct rxn *rx, int path,
     return RX_BLOCKED;
 
   if (result != RX_BLOCKED) {
-    rx->info[path].count++;
-    rx->n_occurred++;
+    THREADED_ADD_DOUBLE(rx->info[path].count, 1);
+    THREADED_ADD(rx->n_occurred, 1);
   }
 
   struct species *who_am_i = rx->players[rx->product_idx[path]];
@@ -1086,33 +1080,34 @@ int outcome_unimolecular(struct volume *world, struct rxn *rx, int path,
         vm->subvol->local_storage->timer->defunct_count++;
       if (vm->properties->flags & COUNT_SOME_MASK) {
         count_region_from_scratch(world, (struct abstract_molecule *)vm, NULL,
-                                  -1, &(vm->pos), NULL, vm->t, vm->periodic_box);
+                                  -1, &(vm->pos), NULL, vm->t, &vm->periodic_box);
       }
     } else {
-      remove_surfmol_from_list(&sm->grid->sm_list[sm->grid_index], sm);
-      sm->grid->n_occupied--;
+      remove_surfmol_from_list(tile_sm_slot(sm->grid, sm->grid_index), sm);
+      update_tile_occupancy(sm->grid, sm->grid_index);
+      THREADED_ADD(sm->grid->n_occupied, -1);
       if (sm->flags & IN_SCHEDULE) {
-        sm->grid->subvol->local_storage->timer->defunct_count++;
+        tally_defunct_surface_molecule(sm);
       }
       if (sm->properties->flags & COUNT_SOME_MASK) {
         count_region_from_scratch(world, (struct abstract_molecule *)sm, NULL,
-                                  -1, NULL, NULL, sm->t, sm->periodic_box);
+                                  -1, NULL, NULL, sm->t, &sm->periodic_box);
       }
     }
 
-    free(reac->periodic_box);
-    who_was_i->n_deceased++;
+    THREADED_ADD(who_was_i->n_deceased, 1);
     double t_time = convert_iterations_to_seconds(
         world->start_iterations, world->time_unit,
         world->simulation_start_seconds, t);
-    who_was_i->cum_lifetime_seconds += t_time - reac->birthday;
+    THREADED_ADD_DOUBLE(who_was_i->cum_lifetime_seconds,
+                        t_time - reac->birthday);
 
-    who_was_i->population--;
+    THREADED_ADD(who_was_i->population, -1);
     if (vm != NULL)
       collect_molecule(vm);
     else {
       reac->properties = NULL;
-      mem_put(reac->birthplace, reac);
+      mem_put(mem_birthplace(reac), reac);
     }
     return RX_DESTROY;
   } else if (who_am_i != who_was_i) {
@@ -1147,7 +1142,7 @@ int outcome_bimolecular(struct volume *world, struct rxn *rx, int path,
                         short orientB, double t, struct vector3 *hitpt,
                         struct vector3 *loc_okay) {
 
-  assert(periodic_boxes_are_identical(reacA->periodic_box, reacB->periodic_box));
+  assert(periodic_boxes_are_identical(&reacA->periodic_box, &reacB->periodic_box));
 
   struct surface_molecule *sm = NULL;
   struct volume_molecule *vm = NULL;
@@ -1173,8 +1168,8 @@ int outcome_bimolecular(struct volume *world, struct rxn *rx, int path,
   if (result == RX_BLOCKED)
     return RX_BLOCKED;
 
-  rx->n_occurred++;
-  rx->info[path].count++;
+  THREADED_ADD(rx->n_occurred, 1);
+  THREADED_ADD_DOUBLE(rx->info[path].count, 1);
 
   /* Figure out if either of the reactants was destroyed */
   if (rx->players[0] == reacA->properties) {
@@ -1190,12 +1185,13 @@ int outcome_bimolecular(struct volume *world, struct rxn *rx, int path,
     if ((reacB->properties->flags & ON_GRID) != 0) {
       sm = (struct surface_molecule *)reacB;
 
-      remove_surfmol_from_list(&sm->grid->sm_list[sm->grid_index], sm);
-      sm->grid->n_occupied--;
+      remove_surfmol_from_list(tile_sm_slot(sm->grid, sm->grid_index), sm);
+      update_tile_occupancy(sm->grid, sm->grid_index);
+      THREADED_ADD(sm->grid->n_occupied, -1);
       if (sm->flags & IN_SURFACE)
         sm->flags -= IN_SURFACE;
       if (sm->flags & IN_SCHEDULE) {
-        sm->grid->subvol->local_storage->timer->defunct_count++;
+        tally_defunct_surface_molecule(sm);
       }
     } else if ((reacB->properties->flags & NOT_FREE) == 0) {
       vm = (struct volume_molecule *)reacB;
@@ -1207,16 +1203,16 @@ int outcome_bimolecular(struct volume *world, struct rxn *rx, int path,
     }
 
     if ((reacB->properties->flags & (COUNT_CONTENTS | COUNT_ENCLOSED)) != 0) {
-      count_region_from_scratch(world, reacB, NULL, -1, NULL, NULL, t, reacB->periodic_box);
+      count_region_from_scratch(world, reacB, NULL, -1, NULL, NULL, t, &reacB->periodic_box);
     }
 
-    free(reacB->periodic_box);
-    reacB->properties->n_deceased++;
+    THREADED_ADD(reacB->properties->n_deceased, 1);
     double t_time = convert_iterations_to_seconds(
         world->start_iterations, world->time_unit,
         world->simulation_start_seconds, t);
-    reacB->properties->cum_lifetime_seconds += t_time - reacB->birthday;
-    reacB->properties->population--;
+    THREADED_ADD_DOUBLE(reacB->properties->cum_lifetime_seconds,
+                        t_time - reacB->birthday);
+    THREADED_ADD(reacB->properties->population, -1);
 
     if (vm != NULL)
       collect_molecule(vm);
@@ -1229,10 +1225,11 @@ int outcome_bimolecular(struct volume *world, struct rxn *rx, int path,
     if ((reacA->properties->flags & ON_GRID) != 0) {
       sm = (struct surface_molecule *)reacA;
 
-      remove_surfmol_from_list(&sm->grid->sm_list[sm->grid_index], sm);
-      sm->grid->n_occupied--;
+      remove_surfmol_from_list(tile_sm_slot(sm->grid, sm->grid_index), sm);
+      update_tile_occupancy(sm->grid, sm->grid_index);
+      THREADED_ADD(sm->grid->n_occupied, -1);
       if (sm->flags & IN_SCHEDULE) {
-        sm->grid->subvol->local_storage->timer->defunct_count++;
+        tally_defunct_surface_molecule(sm);
       }
     } else if ((reacA->properties->flags & NOT_FREE) == 0) {
       vm = (struct volume_molecule *)reacA;
@@ -1248,7 +1245,7 @@ int outcome_bimolecular(struct volume *world, struct rxn *rx, int path,
       if (reacA->properties->flags &
           COUNT_SOME_MASK) /* If we're ever counted, try to count us now */
       {
-        count_region_from_scratch(world, reacA, NULL, -1, NULL, NULL, t, reacA->periodic_box);
+        count_region_from_scratch(world, reacA, NULL, -1, NULL, NULL, t, &reacA->periodic_box);
       }
     } else if (reacA->flags & COUNT_ME) {
       /* Subtlety: we made it up to hitpt, but our position is wherever we were
@@ -1257,7 +1254,7 @@ int outcome_bimolecular(struct volume *world, struct rxn *rx, int path,
           (reacB->properties != NULL &&
            (reacB->properties->flags & NOT_FREE) == 0)) {
         /* Vol-vol rx should be counted at hitpt */
-        count_region_from_scratch(world, reacA, NULL, -1, hitpt, NULL, t, reacA->periodic_box);
+        count_region_from_scratch(world, reacA, NULL, -1, hitpt, NULL, t, &reacA->periodic_box);
       } else /* Vol-surf but don't want to count exactly on a wall or we might
                 count on the wrong side */
       {
@@ -1273,17 +1270,17 @@ int outcome_bimolecular(struct volume *world, struct rxn *rx, int path,
         fake_hitpt.y = 0.5 * hitpt->y + 0.5 * loc_okay->y;
         fake_hitpt.z = 0.5 * hitpt->z + 0.5 * loc_okay->z;
 
-        count_region_from_scratch(world, reacA, NULL, -1, &fake_hitpt, NULL, t, reacA->periodic_box);
+        count_region_from_scratch(world, reacA, NULL, -1, &fake_hitpt, NULL, t, &reacA->periodic_box);
       }
     }
 
-    free(reacA->periodic_box);
-    reacA->properties->n_deceased++;
+    THREADED_ADD(reacA->properties->n_deceased, 1);
     double t_time = convert_iterations_to_seconds(
         world->start_iterations, world->time_unit,
         world->simulation_start_seconds, t);
-    reacA->properties->cum_lifetime_seconds += t_time - reacA->birthday;
-    reacA->properties->population--;
+    THREADED_ADD_DOUBLE(reacA->properties->cum_lifetime_seconds,
+                        t_time - reacA->birthday);
+    THREADED_ADD(reacA->properties->population, -1);
 
     if (vm != NULL)
       collect_molecule(vm);
@@ -1320,7 +1317,7 @@ int outcome_intersect(struct volume *world, struct rxn *rx, int path,
                       struct vector3 *loc_okay) {
 
   if (rx->n_pathways <= RX_SPECIAL) {
-    rx->n_occurred++;
+    THREADED_ADD(rx->n_occurred, 1);
     if (rx->n_pathways == RX_REFLEC)
       return RX_A_OK;
     else
@@ -1349,8 +1346,8 @@ int outcome_intersect(struct volume *world, struct rxn *rx, int path,
     if (result == RX_BLOCKED)
       return RX_A_OK; /* reflect the molecule */
 
-    rx->info[path].count++;
-    rx->n_occurred++;
+    THREADED_ADD_DOUBLE(rx->info[path].count, 1);
+    THREADED_ADD(rx->n_occurred, 1);
 
     if (rx->players[idx] == NULL) {
       /* The code below is also valid for the special reaction of the type
@@ -1359,7 +1356,7 @@ int outcome_intersect(struct volume *world, struct rxn *rx, int path,
       if (world->place_waypoints_flag && (reac->flags & COUNT_ME)) {
         if (hitpt == NULL) {
           count_region_from_scratch(
-            world, reac, NULL, -1, NULL, NULL, t, reac->periodic_box);
+            world, reac, NULL, -1, NULL, NULL, t, &reac->periodic_box);
         } else {
           struct vector3 fake_hitpt;
 
@@ -1372,16 +1369,16 @@ int outcome_intersect(struct volume *world, struct rxn *rx, int path,
           fake_hitpt.z = 0.5 * hitpt->z + 0.5 * loc_okay->z;
 
           count_region_from_scratch(world, reac, NULL, -1, &fake_hitpt, NULL,
-                                    t, reac->periodic_box);
+                                    t, &reac->periodic_box);
         }
       }
-      free(reac->periodic_box);
-      reac->properties->n_deceased++;
+      THREADED_ADD(reac->properties->n_deceased, 1);
       double t_time = convert_iterations_to_seconds(
           world->start_iterations, world->time_unit,
           world->simulation_start_seconds, t);
-      reac->properties->cum_lifetime_seconds += t_time - reac->birthday;
-      reac->properties->population--;
+      THREADED_ADD_DOUBLE(reac->properties->cum_lifetime_seconds,
+                          t_time - reac->birthday);
+      THREADED_ADD(reac->properties->population, -1);
       if (vm->flags & IN_SCHEDULE) {
         vm->subvol->local_storage->timer->defunct_count++;
       }
@@ -72,11 +72,11 @@ static int outcome_products_trimol_reaction_random(
     short orientA, short orientB, short orientC) {
 
   if (reacA != NULL && reacB != NULL) {
-    assert(periodic_boxes_are_identical(reacA->periodic_box, reacB->periodic_box));
+    assert(periodic_boxes_are_identical(&reacA->periodic_box, &reacB->periodic_box));
   } else if (reacA != NULL && reacC != NULL) {
-    assert(periodic_boxes_are_identical(reacA->periodic_box, reacC->periodic_box));
+    assert(periodic_boxes_are_identical(&reacA->periodic_box, &reacC->periodic_box));
   } else if (reacB != NULL && reacC != NULL) {
-    assert(periodic_boxes_are_identical(reacB->periodic_box, reacC->periodic_box));
+    assert(periodic_boxes_are_identical(&reacB->periodic_box, &reacC->periodic_box));
   }
 
   bool update_dissociation_index =
@@ -687,8 +687,7 @@ static int outcome_products_trimol_reaction_random(
       /* Create list of vacant tiles */
       for (tile_nbr = tile_nbr_head; tile_nbr != NULL;
            tile_nbr = tile_nbr->next) {
-        struct surface_molecule_list *sm_list = tile_nbr->grid->sm_list[tile_nbr->idx];
-        if (sm_list == NULL || sm_list->sm == NULL) {
+        if (!tile_occupied(tile_nbr->grid, tile_nbr->idx)) {
           num_vacant_tiles++;
           push_tile_neighbor_to_list(&tile_vacant_nbr_head, tile_nbr->grid,
                                      tile_nbr->idx);
@@ -754,7 +753,7 @@ static int outcome_products_trimol_reaction_random(
 
       /* Geometry of 0 means "random orientation" */
       if (this_geometry == 0)
-        product_orient[n_product] = (rng_uint(world->rng) & 1) ? 1 : -1;
+        product_orient[n_product] = (rng_uint(local_rng(world)) & 1) ? 1 : -1;
       else {
         /* Geometry < 0 means inverted orientation */
         if (this_geometry < 0) {
@@ -945,7 +944,7 @@ static int outcome_products_trimol_reaction_random(
       } else if (two_to_replace) {
         /* replace one of the two reactants randomly */
         while (true) {
-          rnd_num = rng_uint(world->rng) % (rx->n_reactants);
+          rnd_num = rng_uint(local_rng(world)) % (rx->n_reactants);
 
           if ((rnd_num == 0) && replace_p1)
             break;
@@ -1036,7 +1035,7 @@ static int outcome_products_trimol_reaction_random(
         if (num_surface_static_products >= num_surface_static_reactants) {
           count = 0;
           while (count < num_surface_static_reactants) {
-            rnd_num = rng_uint(world->rng) % n_players;
+            rnd_num = rng_uint(local_rng(world)) % n_players;
             /* pass reactants */
             if (rnd_num < 3)
               continue;
@@ -1085,7 +1084,7 @@ static int outcome_products_trimol_reaction_random(
         } else { /*(num_surface_static_products<num_surface_static_reactants)*/
           count = 0;
           while (count < num_surface_static_products) {
-            rnd_num = rng_uint(world->rng) % n_players;
+            rnd_num = rng_uint(local_rng(world)) % n_players;
             /* pass reactants */
             if (rnd_num < 3)
               continue;
@@ -1167,7 +1166,7 @@ static int outcome_products_trimol_reaction_random(
           if (surf_prod_left >= surf_reactant_left) {
             count = 0;
             while (count < surf_reactant_left) {
-              rnd_num = rng_uint(world->rng) % n_players;
+              rnd_num = rng_uint(local_rng(world)) % n_players;
               /* pass reactants */
               if (rnd_num < 3)
                 continue;
@@ -1214,7 +1213,7 @@ static int outcome_products_trimol_reaction_random(
           } else { /* surf_prod_left < surf_reactant_left */
             count = 0;
             while (count < surf_prod_left) {
-              rnd_num = rng_uint(world->rng) % n_players;
+              rnd_num = rng_uint(local_rng(world)) % n_players;
               /* pass reactants */
               if (rnd_num < 3)
                 continue;
@@ -1291,7 +1290,7 @@ static int outcome_products_trimol_reaction_random(
           }
 
           /* randomly pick a tile from the list */
-          rnd_num = rng_uint(world->rng) % num_vacant_tiles;
+          rnd_num = rng_uint(local_rng(world)) % num_vacant_tiles;
           tile_idx = -1;
           tile_grid = NULL;
 
@@ -1658,7 +1657,7 @@ static int outcome_products_trimol_reaction_random(
 
         case PRODUCT_FLAG_USE_RANDOM:
           grid2uv_random(product_grid[n_product], product_grid_idx[n_product],
-                         &prod_uv_pos, world->rng);
+                         &prod_uv_pos, local_rng(world));
           break;
 
         default:
@@ -1672,7 +1671,7 @@ static int outcome_products_trimol_reaction_random(
       this_product = (struct abstract_molecule *)place_sm_product(
           world, product_species, product_grid[n_product],
           product_grid_idx[n_product], &prod_uv_pos, product_orient[n_product],
-          t, reacA->periodic_box);
+          t, &reacA->periodic_box);
     }
 
     /* else place the molecule in space. */
@@ -1698,22 +1697,22 @@ static int outcome_products_trimol_reaction_random(
 
       this_product = (struct abstract_molecule *)place_volume_product(
           world, product_species, sm_reactant, w, product_subvol, hitpt,
-          product_orient[n_product], t, reacA->periodic_box);
+          product_orient[n_product], t, &reacA->periodic_box);
 
       if (((struct volume_molecule *)this_product)->index < DISSOCIATION_MAX)
         update_dissociation_index = true;
     }
 
     /* Update molecule counts */
-    ++product_species->population;
+    THREADED_ADD(product_species->population, 1);
     if (product_species->flags & (COUNT_CONTENTS | COUNT_ENCLOSED))
       count_region_from_scratch(world, this_product, NULL, 1, NULL, NULL, t, NULL);
   }
 
   /* If necessary, update the dissociation index. */
   if (update_dissociation_index) {
-    if (--world->dissociation_index < DISSOCIATION_MIN)
-      world->dissociation_index = DISSOCIATION_MAX;
+    thread_atomic_cycle_down(&world->dissociation_index, DISSOCIATION_MIN,
+                             DISSOCIATION_MAX);
   }
 
   /* Handle events triggered off of named reactions */
@@ -1808,8 +1807,8 @@ int outcome_trimolecular(struct volume *world, struct rxn *rx, int path,
   if (result == RX_BLOCKED)
     return RX_BLOCKED;
 
-  rx->n_occurred++;
-  rx->info[path].count++;
+  THREADED_ADD(rx->n_occurred, 1);
+  THREADED_ADD_DOUBLE(rx->info[path].count, 1);
 
   /* Figure out if either of the reactants was destroyed */
 
@@ -1849,13 +1848,14 @@ int outcome_trimolecular(struct volume *world, struct rxn *rx, int path,
     vm = NULL;
     if ((reacC->properties->flags & ON_GRID) != 0) {
       sm = (struct surface_molecule *)reacC;
-      remove_surfmol_from_list(&sm->grid->sm_list[sm->grid_index], sm);
-      sm->grid->n_occupied--;
+      remove_surfmol_from_list(tile_sm_slot(sm->grid, sm->grid_index), sm);
+      update_tile_occupancy(sm->grid, sm->grid_index);
+      THREADED_ADD(sm->grid->n_occupied, -1);
       if (sm->flags & IN_SURFACE)
         sm->flags -= IN_SURFACE;
 
       if (sm->flags & IN_SCHEDULE) {
-        sm->grid->subvol->local_storage->timer->defunct_count++;
+        tally_defunct_surface_molecule(sm);
       }
     } else {
       vm = (struct volume_molecule *)reacC;
@@ -1869,18 +1869,19 @@ int outcome_trimolecular(struct volume *world, struct rxn *rx, int path,
       count_region_from_scratch(world, reacC, NULL, -1, NULL, NULL, t, NULL);
     }
 
-    reacC->properties->n_deceased++;
+    THREADED_ADD(reacC->properties->n_deceased, 1);
     double t_time = convert_iterations_to_seconds(
         world->start_iterations, world->time_unit,
         world->simulation_start_seconds, t);
-    reacC->properties->cum_lifetime_seconds += t_time - reacC->birthday;
-    reacC->properties->population--;
+    THREADED_ADD_DOUBLE(reacC->properties->cum_lifetime_seconds,
+                        t_time - reacC->birthday);
+    THREADED_ADD(reacC->properties->population, -1);
     if (vm != NULL)
       collect_molecule(vm);
     else {
       reacC->properties = NULL;
       if ((reacC->flags & IN_MASK) == 0)
-        mem_put(reacC->birthplace, reacC);
+        mem_put(mem_birthplace(reacC), reacC);
     }
   }
 
@@ -1888,13 +1889,14 @@ int outcome_trimolecular(struct volume *world, struct rxn *rx, int path,
     vm = NULL;
     if ((reacB->properties->flags & ON_GRID) != 0) {
       sm = (struct surface_molecule *)reacB;
-      remove_surfmol_from_list(&sm->grid->sm_list[sm->grid_index], sm);
-      sm->grid->n_occupied--;
+      remove_surfmol_from_list(tile_sm_slot(sm->grid, sm->grid_index), sm);
+      update_tile_occupancy(sm->grid, sm->grid_index);
+      THREADED_ADD(sm->grid->n_occupied, -1);
       if (sm->flags & IN_SURFACE)
         sm->flags -= IN_SURFACE;
 
       if (sm->flags & IN_SCHEDULE) {
-        sm->grid->subvol->local_storage->timer->defunct_count++;
+        tally_defunct_surface_molecule(sm);
       }
     } else {
       vm = (struct volume_molecule *)reacB;
@@ -1908,18 +1910,19 @@ int outcome_trimolecular(struct volume *world, struct rxn *rx, int path,
       count_region_from_scratch(world, reacB, NULL, -1, NULL, NULL, t, NULL);
     }
 
-    reacB->properties->n_deceased++;
+    THREADED_ADD(reacB->properties->n_deceased, 1);
     double t_time = convert_iterations_to_seconds(
         world->start_iterations, world->time_unit,
         world->simulation_start_seconds, t);
-    reacB->properties->cum_lifetime_seconds += t_time - reacB->birthday;
-    reacB->properties->population--;
+    THREADED_ADD_DOUBLE(reacB->properties->cum_lifetime_seconds,
+                        t_time - reacB->birthday);
+    THREADED_ADD(reacB->properties->population, -1);
     if (vm != NULL)
       collect_molecule(vm);
     else {
       reacB->properties = NULL;
       if ((reacB->flags & IN_MASK) == 0)
-        mem_put(reacB->birthplace, reacB);
+        mem_put(mem_birthplace(reacB), reacB);
     }
   }
 
@@ -1927,13 +1930,14 @@ int outcome_trimolecular(struct volume *world, struct rxn *rx, int path,
     vm = NULL;
     if ((reacA->properties->flags & ON_GRID) != 0) {
       sm = (struct surface_molecule *)reacA;
-      remove_surfmol_from_list(&sm->grid->sm_list[sm->grid_index], sm);
-      sm->grid->n_occupied--;
+      remove_surfmol_from_list(tile_sm_slot(sm->grid, sm->grid_index), sm);
+      update_tile_occupancy(sm->grid, sm->grid_index);
+      THREADED_ADD(sm->grid->n_occupied, -1);
       if (sm->flags & IN_SURFACE)
         sm->flags -= IN_SURFACE;
 
       if (sm->flags & IN_SCHEDULE) {
-        sm->grid->subvol->local_storage->timer->defunct_count++;
+        tally_defunct_surface_molecule(sm);
       }
     } else {
       vm = (struct volume_molecule *)reacA;
@@ -1976,12 +1980,13 @@ int outcome_trimolecular(struct volume *world, struct rxn *rx, int path,
         count_region_from_scratch(world, reacA, NULL, -1, &fake_hitpt, NULL, t, NULL);
       }
     }
-    reacA->properties->n_deceased++;
+    THREADED_ADD(reacA->properties->n_deceased, 1);
     double t_time = convert_iterations_to_seconds(
         world->start_iterations, world->time_unit,
         world->simulation_start_seconds, t);
-    reacA->properties->cum_lifetime_seconds += t_time - reacA->birthday;
-    reacA->properties->population--;
+    THREADED_ADD_DOUBLE(reacA->properties->cum_lifetime_seconds,
+                        t_time - reacA->birthday);
+    THREADED_ADD(reacA->properties->population, -1);
     if (vm != NULL)
       collect_molecule(vm);
     else
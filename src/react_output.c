@@ -37,6 +37,8 @@
 #include "sched_util.h"
 #include "mcell_structs.h"
 #include "react_output.h"
+#include "count_util.h"
+#include "domain_util.h"
 #include "mdlparse_util.h"
 #include "strfunc.h"
 
@@ -210,7 +212,7 @@ static int emergency_output(struct volume *world) {
   struct storage_list *mem;
 
   /* PANIC--delete everything we can get our pointers on! */
-  delete_mem(world->coll_mem);
+  delete_scratch(&world->scratch);
   delete_mem(world->exdv_mem);
   for (mem = world->storage_head; mem != NULL; mem = mem->next) {
     delete_mem(mem->store->list);
@@ -477,6 +479,7 @@ int update_reaction_output(struct volume *world, struct output_block *block) {
   }
 
   /* update all counters */
+  merge_count_deltas(world);
 
   block->t /= (1. + EPS_C);
   if (world->chkpt_seq_num == 1) {
@@ -501,6 +504,10 @@ int update_reaction_output(struct volume *world, struct output_block *block) {
     }
   }
 
+  /* In a distributed run every process holds part of each count */
+  if (world->domain != NULL)
+    domain_sum_output(world, block, i);
+
   struct output_set *set;
   struct output_column *column;
   // Each file
@@ -535,6 +542,8 @@ int update_reaction_output(struct volume *world, struct output_block *block) {
       }
     }
   }
+  if (world->domain != NULL)
+    domain_restore_output(world);
   block->buf_index++;
 
   int final_chunk_flag = 0; // flag signaling an end to the scheduled
@@ -778,6 +787,10 @@ int write_reaction_output(struct volume *world, struct output_set *set) {
   u_int n_output;
   u_int i;
 
+  /* Only the first process of a distributed run writes output */
+  if (world->procnum != 0)
+    return 0;
+
   switch (set->file_flags) {
   case FILE_OVERWRITE:
   case FILE_CREATE:
@@ -31,13 +31,67 @@
 
 #include "config.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "logging.h"
+#include "mem_util.h"
 #include "mcell_structs.h"
 #include "react.h"
 #include "vol_util.h"
 
+/* A reaction two species may undergo together, while the tables of
+   reaction partners are being built */
+struct rxn_pair_entry {
+  u_int a, b;      /* species_id of the two species */
+  int trimol;      /* 1 if this is for the trimolecular list */
+  int order;       /* Position of the reaction in the reaction hash */
+  struct rxn *rx;
+};
+
+/*************************************************************************
+find_rxn_pair:
+   In: two species whose reactions have been tabulated
+   Out: the reactions the two may undergo together, or NULL if there are
+        none
+*************************************************************************/
+static struct rxn_pair *find_rxn_pair(struct species *reacA,
+                                      struct species *reacB) {
+  int lo = 0, hi = reacA->n_rx_pairs - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    struct rxn_pair *pair = &reacA->rx_pairs[mid];
+    if (pair->partner == reacB->species_id)
+      return pair;
+    if (pair->partner < reacB->species_id)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return NULL;
+}
+
+/*************************************************************************
+trimol_rxn_hash:
+   In: hash values and species of three reactants
+   Out: the unmasked reaction hash value under which a trimolecular
+        reaction between them is stored, from the two reactants whose names
+        sort first
+*************************************************************************/
+static u_int trimol_rxn_hash(u_int hashA, u_int hashB, u_int hashC,
+                             struct species *reacA, struct species *reacB,
+                             struct species *reacC) {
+  if (strcmp(reacA->sym->name, reacB->sym->name) < 0) {
+    if (strcmp(reacB->sym->name, reacC->sym->name) < 0)
+      return (hashA + hashB);
+    else
+      return (hashA + hashC);
+  } else if (strcmp(reacA->sym->name, reacC->sym->name) < 0)
+    return (hashB + hashA);
+  else
+    return (hashB + hashC);
+}
+
 /*************************************************************************
 trigger_unimolecular:
    In: hash value of molecule's species
@@ -107,6 +161,14 @@ int trigger_bimolecular_preliminary(struct rxn **reaction_hash, int rx_hashsize,
                                     u_int hashA, u_int hashB,
                                     struct species *reacA,
                                     struct species *reacB) {
+  if (reacA->n_rx_pairs >= 0 && reacB->n_rx_pairs >= 0) {
+    if (reacA->rx_partner_bits != NULL)
+      return (reacA->rx_partner_bits[reacB->species_id >> 5] >>
+              (reacB->species_id & 31)) & 1;
+    struct rxn_pair *pair = find_rxn_pair(reacA, reacB);
+    return pair != NULL && pair->rxns[0] != NULL;
+  }
+
   u_int hash = (hashA + hashB) & (rx_hashsize - 1);
   for (struct rxn *inter = reaction_hash[hash]; inter != NULL; inter = inter->next) {
     /* Enough reactants? (3=>wall also) */
@@ -148,13 +210,27 @@ int trigger_bimolecular(struct rxn **reaction_hash, int rx_hashsize,
   /*struct surf_class_list *scl, *scl2;*/
 
   // reactions between reacA and reacB only happen if both are in the same periodic box
-  if (!periodic_boxes_are_identical(reacA->periodic_box, reacB->periodic_box)) {
+  if (!periodic_boxes_are_identical(&reacA->periodic_box, &reacB->periodic_box)) {
     return 0;
   }
 
+  /* Walk the tabulated reactions of the pair if there are any, otherwise
+     the reaction hash chain */
+  struct rxn **cands = NULL;
+  struct rxn *first;
+  if (reacA->properties->n_rx_pairs >= 0 &&
+      reacB->properties->n_rx_pairs >= 0) {
+    struct rxn_pair *pair = find_rxn_pair(reacA->properties, reacB->properties);
+    if (pair == NULL)
+      return 0;
+    cands = pair->rxns;
+    first = cands[0];
+  } else
+    first = reaction_hash[(hashA + hashB) & (rx_hashsize - 1)];
+
   int num_matching_rxns = 0; /* number of matching reactions */
-  u_int hash = (hashA + hashB) & (rx_hashsize - 1); /* index in the reaction hash table */
-  for (struct rxn *inter = reaction_hash[hash]; inter != NULL; inter = inter->next) {
+  for (struct rxn *inter = first; inter != NULL;
+       inter = (cands != NULL) ? *++cands : inter->next) {
     int right_walls_surf_classes = 0;  /* flag to check whether SURFACE_CLASSES
                                           of the walls for one or both reactants
                                           match the SURFACE_CLASS of the reaction
@@ -338,26 +414,26 @@ int trigger_trimolecular(struct rxn **reaction_hash, int rx_hashsize,
                          struct species *reacA, struct species *reacB,
                          struct species *reacC, int orientA, int orientB,
                          int orientC, struct rxn **matching_rxns) {
-  u_int rawhash = 0;
-  u_int hash = 0;            /* index in the reaction hash table */
   int num_matching_rxns = 0; /* number of matching reactions */
   short geomA = SHRT_MIN, geomB = SHRT_MIN, geomC = SHRT_MIN;
   struct rxn *inter;
+  struct rxn **cands = NULL;
   int correct_players_flag;
   int correct_orientation_flag;
 
-  if (strcmp(reacA->sym->name, reacB->sym->name) < 0) {
-    if (strcmp(reacB->sym->name, reacC->sym->name) < 0)
-      rawhash = (hashA + hashB);
-    else
-      rawhash = (hashA + hashC);
-  } else if (strcmp(reacA->sym->name, reacC->sym->name) < 0)
-    rawhash = (hashB + hashA);
-  else
-    rawhash = (hashB + hashC);
-  hash = rawhash & (rx_hashsize - 1);
-
-  inter = reaction_hash[hash];
+  /* Walk the tabulated reactions of the first two if there are any,
+     otherwise the reaction hash chain */
+  if (reacA->n_rx_pairs >= 0 && reacB->n_rx_pairs >= 0) {
+    struct rxn_pair *pair = find_rxn_pair(reacA, reacB);
+    if (pair == NULL)
+      return 0;
+    cands = pair->trimol_rxns;
+    inter = cands[0];
+  } else {
+    u_int hash = trimol_rxn_hash(hashA, hashB, hashC, reacA, reacB, reacC) &
+                 (rx_hashsize - 1);
+    inter = reaction_hash[hash];
+  }
 
   while (inter != NULL) {
     if (inter->n_reactants == 3) /* Enough reactants?  */
@@ -538,7 +614,7 @@ int trigger_trimolecular(struct rxn **reaction_hash, int rx_hashsize,
         num_matching_rxns++;
       }
     }
-    inter = inter->next;
+    inter = (cands != NULL) ? *++cands : inter->next;
   }
 
   if (num_matching_rxns > MAX_MATCHING_RXNS) {
@@ -549,6 +625,184 @@ int trigger_trimolecular(struct rxn **reaction_hash, int rx_hashsize,
   return num_matching_rxns;
 }
 
+/*************************************************************************
+compare_rxn_pair_entries:
+   qsort ordering by species pair, then list, then reaction hash position.
+*************************************************************************/
+static int compare_rxn_pair_entries(void const *a, void const *b) {
+  struct rxn_pair_entry const *ea = (struct rxn_pair_entry const *)a;
+  struct rxn_pair_entry const *eb = (struct rxn_pair_entry const *)b;
+  if (ea->a != eb->a)
+    return (ea->a < eb->a) ? -1 : 1;
+  if (ea->b != eb->b)
+    return (ea->b < eb->b) ? -1 : 1;
+  if (ea->trimol != eb->trimol)
+    return ea->trimol - eb->trimol;
+  return ea->order - eb->order;
+}
+
+/*************************************************************************
+init_reaction_pairs:
+   In: the reaction hash table and its size
+       array of all species, indexed by species_id
+       number of species
+   Out: 0 on success, 1 if memory ran out.  Each species gets the table of
+        reactions it may undergo with every partner species, holding
+        exactly the reactions the trigger functions would accept from the
+        reaction hash chain, in chain order.  Pairs of species that cannot
+        react are then rejected without walking the chain.  If some reactant
+        is not in the species array, nothing is tabulated.
+*************************************************************************/
+int init_reaction_pairs(struct rxn **reaction_hash, int rx_hashsize,
+                        struct species **species_list, int n_species) {
+  int n_entries = 0;
+  for (int i = 0; i < rx_hashsize; i++) {
+    for (struct rxn *rx = reaction_hash[i]; rx != NULL; rx = rx->next) {
+      if (rx->n_reactants < 2)
+        continue;
+      for (u_int j = 0; j < rx->n_reactants; j++) {
+        struct species *sp = rx->players[j];
+        if (sp->species_id >= (u_int)n_species ||
+            species_list[sp->species_id] != sp)
+          return 0;
+      }
+      n_entries += (rx->n_reactants == 3) ? 8 : 2;
+    }
+  }
+
+  struct rxn_pair_entry *entries = NULL;
+  if (n_entries > 0) {
+    entries = CHECKED_MALLOC_ARRAY_NODIE(struct rxn_pair_entry, n_entries,
+                                         "reaction pair entries");
+    if (entries == NULL)
+      return 1;
+  }
+
+  /* Record each reaction under the pairs whose lookups would find it */
+  int n = 0;
+  int order = 0;
+  for (int i = 0; i < rx_hashsize; i++) {
+    for (struct rxn *rx = reaction_hash[i]; rx != NULL; rx = rx->next, order++) {
+      if (rx->n_reactants < 2)
+        continue;
+
+      struct species **p = rx->players;
+      if ((int)((p[0]->hashval + p[1]->hashval) & (rx_hashsize - 1)) == i) {
+        for (int k = 0; k < ((p[0] == p[1]) ? 1 : 2); k++) {
+          entries[n].a = p[k]->species_id;
+          entries[n].b = p[1 - k]->species_id;
+          entries[n].trimol = 0;
+          entries[n].order = order;
+          entries[n].rx = rx;
+          n++;
+        }
+      }
+
+      if (rx->n_reactants == 3 &&
+          (int)(trimol_rxn_hash(p[0]->hashval, p[1]->hashval, p[2]->hashval,
+                                p[0], p[1], p[2]) &
+                (rx_hashsize - 1)) == i) {
+        for (int j = 0; j < 3; j++) {
+          for (int k = 0; k < 3; k++) {
+            if (j == k)
+              continue;
+            entries[n].a = p[j]->species_id;
+            entries[n].b = p[k]->species_id;
+            entries[n].trimol = 1;
+            entries[n].order = order;
+            entries[n].rx = rx;
+            n++;
+          }
+        }
+      }
+    }
+  }
+  if (n > 1)
+    qsort(entries, n, sizeof(struct rxn_pair_entry), compare_rxn_pair_entries);
+
+  /* Drop repeats, from reactants named twice */
+  int n_unique = 0;
+  for (int i = 0; i < n; i++) {
+    if (n_unique > 0 && entries[n_unique - 1].rx == entries[i].rx &&
+        entries[n_unique - 1].a == entries[i].a &&
+        entries[n_unique - 1].b == entries[i].b &&
+        entries[n_unique - 1].trimol == entries[i].trimol)
+      continue;
+    entries[n_unique++] = entries[i];
+  }
+  n = n_unique;
+
+  u_int *bits = NULL;
+  int n_words = (n_species + 31) / 32;
+  if (n_species <= RX_PAIR_BITS_MAX_SPECIES) {
+    bits = CHECKED_MALLOC_ARRAY_NODIE(u_int, n_species * n_words,
+                                      "reaction partner bits");
+    if (bits == NULL) {
+      free(entries);
+      return 1;
+    }
+    memset(bits, 0, n_species * n_words * sizeof(u_int));
+  }
+
+  /* Give each species its row of the table */
+  int first = 0;
+  for (int id = 0; id < n_species; id++) {
+    struct species *sp = species_list[id];
+    int last = first;
+    int n_pairs = 0;
+    while (last < n && entries[last].a == (u_int)id) {
+      if (last == first || entries[last].b != entries[last - 1].b)
+        n_pairs++;
+      last++;
+    }
+
+    sp->rx_pairs = NULL;
+    sp->rx_partner_bits = (bits != NULL) ? bits + id * n_words : NULL;
+    if (n_pairs > 0) {
+      /* Each pair's lists end in NULL */
+      struct rxn **rxns = CHECKED_MALLOC_ARRAY_NODIE(
+          struct rxn *, (last - first) + 2 * n_pairs, "reaction pair lists");
+      sp->rx_pairs = CHECKED_MALLOC_ARRAY_NODIE(struct rxn_pair, n_pairs,
+                                                "reaction pairs");
+      if (rxns == NULL || sp->rx_pairs == NULL) {
+        free(entries);
+        return 1;
+      }
+
+      struct rxn_pair *pair = sp->rx_pairs - 1;
+      for (int i = first; i < last; i++) {
+        if (i == first || entries[i].b != pair->partner) {
+          pair++;
+          pair->partner = entries[i].b;
+          pair->rxns = rxns;
+          pair->trimol_rxns = NULL;
+        }
+        if (entries[i].trimol && pair->trimol_rxns == NULL) {
+          *rxns++ = NULL;
+          pair->trimol_rxns = rxns;
+        }
+        *rxns++ = entries[i].rx;
+        if (!entries[i].trimol && bits != NULL)
+          sp->rx_partner_bits[entries[i].b >> 5] |= 1u << (entries[i].b & 31);
+
+        /* Close the lists at the end of the pair */
+        if (i + 1 == last || entries[i + 1].b != pair->partner) {
+          if (pair->trimol_rxns == NULL) {
+            *rxns++ = NULL;
+            pair->trimol_rxns = rxns;
+          }
+          *rxns++ = NULL;
+        }
+      }
+    }
+    sp->n_rx_pairs = n_pairs;
+    first = last;
+  }
+
+  free(entries);
+  return 0;
+}
+
 /*************************************************************************
 trigger_intersect:
    In: hash value of molecule's species
@@ -911,7 +1165,7 @@ void compute_lifetime(struct volume *state,
   if (r != NULL) {
     double tt = FOREVER;
 
-    am->t2 = timeof_unimolecular(r, am, state->rng);
+    am->t2 = timeof_unimolecular(r, am, local_rng(state));
     if (r->prob_t != NULL) {
       tt = r->prob_t->time;
     }
@@ -955,7 +1209,7 @@ int check_for_unimolecular_reaction(struct volume *state,
     int i = 0;
     int j = 0;
     if (r != NULL) {
-      i = which_unimolecular(r, am, state->rng);
+      i = which_unimolecular(r, am, local_rng(state));
       j = outcome_unimolecular(state, r, i, am, am->t);
     } else {
       j = RX_NO_RX;
@@ -1018,7 +1272,7 @@ struct rxn *pick_unimolecular_reaction(struct volume *state,
   if (num_matching_rxns == 1) {
     r2 = matching_rxns[0];
   } else if (num_matching_rxns > 1) {
-    r2 = test_many_unimol(matching_rxns, num_matching_rxns, am, state->rng);
+    r2 = test_many_unimol(matching_rxns, num_matching_rxns, am, local_rng(state));
   }
 
   return r2;
@@ -24,10 +24,26 @@
 #include "config.h"
 
 #include <math.h>
+#include <stddef.h>
 
 #include "rng.h"
 #include "mcell_structs.h"
 
+#if !defined(USE_MINIMAL_RNG)
+/*************************************************************************
+rng_init_stream:
+  In: rng: generator state
+      seed: seed of the run
+      stream: which of the independent streams derived from seed to use
+  Out: No return value.  Both the isaac64 and the Philox generator are
+       seeded; which one is drawn from is left unchanged.
+*************************************************************************/
+void rng_init_stream(struct rng_state *rng, ub4 seed, ub4 stream) {
+  isaac64_init_stream(&rng->isaac, seed, stream);
+  philox_init(&rng->philox, seed, stream);
+}
+#endif
+
 /*************************************************************************
  * Ziggurat Gaussian generator
  *
@@ -217,3 +233,56 @@ double rng_gauss(struct rng_state *rng) {
 
   return sign * x;
 }
+
+/*************************************************************************
+rng_gauss_block:
+  In:  struct rng_state *rng - uniform RNG state
+       double *out - where to store the variates
+       int n - how many variates to draw
+  Out: No return value.  out holds n Gaussian variates, exactly the ones n
+       calls to rng_gauss would have returned.
+  Note: Nearly every Ziggurat draw is accepted by the quick test on its first
+        word.  When the next n words are already in the generator's buffer,
+        all n variates are computed from them in one branch-free pass (which
+        the compiler can vectorize), and the words are only consumed if every
+        one of them passes.  Otherwise nothing has been drawn and we fall
+        back to rng_gauss, so the sequence is unchanged either way.
+ *************************************************************************/
+void rng_gauss_block(struct rng_state *rng, double *out, int n) {
+#if !defined(USE_MINIMAL_RNG)
+  const uint32_t *words = NULL;
+  ptrdiff_t step = 1;
+  if (rng->counter_based) {
+    struct philox_position *p = &rng->philox.pos;
+    if (p->filled - p->next >= (unsigned int)n)
+      words = p->block + p->next;
+  } else if (rng->isaac.randcnt >= (unsigned int)n) {
+    /* isaac64_uint32 hands out its buffer from the top down */
+    words = (const uint32_t *)rng->isaac.randrsl + rng->isaac.randcnt - 1;
+    step = -1;
+  }
+
+  if (words != NULL) {
+    int rejected = 0;
+    for (int k = 0; k < n; ++k) {
+      unsigned long bits = words[k * step];
+      unsigned long region = bits & 0x0000007f;
+      unsigned long pos_within_region = bits & 0xffffff00;
+      double x = pos_within_region * WTAB[region];
+      out[k] = ((bits & 0x80) ? -1.0 : 1.0) * x;
+      rejected |= (pos_within_region >= KTAB[region]);
+    }
+    if (!rejected) {
+      if (rng->counter_based) {
+        rng->philox.pos.next += n;
+        rng->philox.used += n;
+      } else
+        rng->isaac.randcnt -= n;
+      return;
+    }
+  }
+#endif
+
+  for (int k = 0; k < n; ++k)
+    out[k] = rng_gauss(rng);
+}
@@ -25,25 +25,65 @@
 
 #define ONE_OVER_2_TO_THE_33RD 1.16415321826934814453125e-10
 
+/* Sequences of a molecule's step that rng_seek can point the generator at */
+#define RNG_UNIMOLECULAR 0 /* the check for a unimolecular reaction */
+#define RNG_STEP 1         /* diffusion and everything after it */
+
 #if defined(USE_MINIMAL_RNG)
 #include "minrng.h"
 #define rng_state mrng_state
 
 #define rng_init(x, y) mrng_init((x), (y))
+#define rng_init_stream(x, y, s) mrng_init_stream((x), (y), (s))
 #define rng_dbl(x) mrng_dbl32((x))
 #define rng_uint(x) mrng_uint32((x))
 
+/* Only the default build can switch to the counter-based generator */
+#define rng_set_counter_based(x, on) ((void)(x), (void)(on))
+#define rng_seek(x, id, t, substream) ((void)(x))
+#define rng_resume(x) ((void)(x))
+
 #else
-/*******************ISAAC64*********************/
+/*************ISAAC64 or Philox4x32*************/
 #include "isaac64.h"
+#include "philox.h"
 
-#define rng_state isaac64_state
+/* Both generators are seeded; counter_based picks the one to draw from.  The
+   Philox sequence can additionally be pointed at the step of one molecule
+   with rng_seek, so the numbers that step uses do not depend on the order in
+   which molecules are processed. */
+struct rng_state {
+  int counter_based;
+  struct isaac64_state isaac;
+  struct philox_state philox;
+};
 
 #define rng_uses(x)                                                            \
-  ((RANDMAX *((x)->rngblocks - 1)) + (long long)(RANDMAX - (x)->randcnt))
-#define rng_init(x, y) isaac64_init((x), (y))
-#define rng_dbl(x) isaac64_dbl32((x))
-#define rng_uint(x) isaac64_uint32((x))
+  ((x)->counter_based                                                          \
+       ? (x)->philox.used                                                      \
+       : (RANDMAX * ((long long)(x)->isaac.rngblocks - 1)) +                   \
+             (long long)(RANDMAX - (x)->isaac.randcnt))
+#define rng_init(x, y) rng_init_stream((x), (y), 0)
+#define rng_dbl(x)                                                             \
+  ((x)->counter_based ? philox_dbl32(&(x)->philox)                             \
+                      : isaac64_dbl32((&(x)->isaac)))
+#define rng_uint(x)                                                            \
+  ((x)->counter_based ? philox_uint32(&(x)->philox)                            \
+                      : isaac64_uint32((&(x)->isaac)))
+
+#define rng_set_counter_based(x, on) ((x)->counter_based = (on))
+#define rng_seek(x, id, t, substream)                                          \
+  do {                                                                         \
+    if ((x)->counter_based)                                                    \
+      philox_seek(&(x)->philox, (id), (t), (substream));                       \
+  } while (0)
+#define rng_resume(x)                                                          \
+  do {                                                                         \
+    if ((x)->counter_based)                                                    \
+      philox_resume(&(x)->philox);                                             \
+  } while (0)
+
+void rng_init_stream(struct rng_state *rng, ub4 seed, ub4 stream);
 /***********************************************/
 
 #endif
@@ -51,3 +91,4 @@
 #define rng_open_dbl(x) (rng_dbl(x) + ONE_OVER_2_TO_THE_33RD)
 
 double rng_gauss(struct rng_state *rng);
+void rng_gauss_block(struct rng_state *rng, double *out, int n);
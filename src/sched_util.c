@@ -24,11 +24,21 @@
 #include "config.h"
 
 #include <float.h>
+#include <math.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include "sched_util.h"
 
+/* A new rung of a ladder queue gets one bucket per item spread into it,
+   within these bounds, so that a few items far apart do not need a rung
+   for every halving of their spread */
+#define LADDER_MIN_BUCKETS 64
+#define LADDER_MAX_BUCKETS (1 << 24)
+
+/* Items this many laps ahead or more are all kept as if in the same lap */
+#define LADDER_MAX_LAP (1LL << 52)
+
 /*************************************************************************
 ae_list_sort:
   In: head of a linked list of abstract_elements
@@ -152,6 +162,45 @@ struct abstract_element *ae_list_sort(struct abstract_element *ae) {
   return stack[0];
 }
 
+/*************************************************************************
+alloc_scale:
+  In: timestep per slot
+      number of slots
+      start time of the first slot
+  Out: a scheduler with a single scale and nothing in it, or NULL if out
+       of memory.
+*************************************************************************/
+
+static struct schedule_helper *alloc_scale(double dt, int len, double now) {
+  struct schedule_helper *sh = NULL;
+  sh = (struct schedule_helper *)malloc(sizeof(struct schedule_helper));
+  if (sh == NULL)
+    return NULL;
+  memset(sh, 0, sizeof(struct schedule_helper));
+
+  sh->dt = dt;
+  sh->dt_1 = 1 / dt;
+
+  sh->now = now;
+  sh->buf_len = len;
+
+  sh->circ_buf_count = (int *)calloc(len, sizeof(int));
+  if (sh->circ_buf_count == NULL)
+    goto failure;
+
+  sh->circ_buf_head = (struct abstract_element **)calloc(
+      len * 2, sizeof(struct abstract_element*));
+  if (sh->circ_buf_head == NULL)
+    goto failure;
+  sh->circ_buf_tail = sh->circ_buf_head + len;
+
+  return sh;
+
+failure:
+  delete_scheduler(sh);
+  return NULL;
+}
+
 /*************************************************************************
 create_scheduler:
   In: timestep per slot in this scheduler
@@ -176,27 +225,9 @@ struct schedule_helper *create_scheduler(double dt_min, double dt_max,
   if (len < 2)
     len = 2;
 
-  struct schedule_helper *sh = NULL;
-  sh = (struct schedule_helper *)malloc(sizeof(struct schedule_helper));
+  struct schedule_helper *sh = alloc_scale(dt_min, len, start_iterations);
   if (sh == NULL)
     return NULL;
-  memset(sh, 0, sizeof(struct schedule_helper));
-
-  sh->dt = dt_min;
-  sh->dt_1 = 1 / dt_min;
-
-  sh->now = start_iterations;
-  sh->buf_len = len;
-
-  sh->circ_buf_count = (int *)calloc(len, sizeof(int));
-  if (sh->circ_buf_count == NULL)
-    goto failure;
-
-  sh->circ_buf_head = (struct abstract_element **)calloc(
-      len * 2, sizeof(struct abstract_element*));
-  if (sh->circ_buf_head == NULL)
-    goto failure;
-  sh->circ_buf_tail = sh->circ_buf_head + len;
 
   if (sh->dt * sh->buf_len < dt_max) {
     sh->next_scale =
@@ -214,6 +245,301 @@ failure:
   return NULL;
 }
 
+/*************************************************************************
+create_ladder_scheduler:
+  In: timestep per slot
+      number of slots in a lap
+      the current time
+  Out: pointer to a new instance of schedule_helper holding a ladder
+       queue, to be used like one from create_scheduler.  Returns NULL if
+       out of memory.
+
+       The first scale only takes items for the rest of its current lap.
+       Later items go to a rung covering their time or, past the last
+       rung, to the unsorted top.  When a lap starts, the bucket holding
+       it is spread into the slots, or into a new rung with about one
+       bucket per item if it covers several laps; the top is spread into
+       a new rung once every rung is used up.  As rungs are only as fine
+       as the items in them call for, an item is usually moved once or
+       twice however far ahead it is, where the multi-scale scheduler
+       moves it down through every coarser scale in turn.
+*************************************************************************/
+
+struct schedule_helper *create_ladder_scheduler(double dt, int len,
+                                                double start_iterations) {
+  if (len < 2)
+    len = 2;
+
+  struct schedule_helper *sh = alloc_scale(dt, len, start_iterations);
+  if (sh == NULL)
+    return NULL;
+  sh->ladder = 1;
+  sh->origin = start_iterations;
+
+  struct schedule_helper *top =
+      alloc_scale(dt * len, 1, start_iterations + dt * len);
+  if (top == NULL) {
+    delete_scheduler(sh);
+    return NULL;
+  }
+  top->ladder = 1;
+  top->depth = 1;
+  top->span = 1;
+  top->lap = top->lap_end = 1;
+  sh->next_scale = top;
+
+  return sh;
+}
+
+/*************************************************************************
+ladder_lap:
+  In: first scale of a ladder queue
+      a time
+  Out: the lap of the first scale holding the time; times before the
+       current lap are counted in it.
+*************************************************************************/
+
+static long long ladder_lap(struct schedule_helper *sh, double t) {
+  double lap = floor((t - sh->origin) / (sh->dt * sh->buf_len));
+
+  if (lap <= (double)sh->lap)
+    return sh->lap;
+  if (lap >= (double)LADDER_MAX_LAP)
+    return LADDER_MAX_LAP;
+  return (long long)lap;
+}
+
+/*************************************************************************
+ladder_slot:
+  In: first scale of a ladder queue
+      a time in its current lap
+  Out: the slot for the time; times before now go in the current slot.
+*************************************************************************/
+
+static int ladder_slot(struct schedule_helper *sh, double t) {
+  double nsteps = (t - sh->now) * sh->dt_1;
+
+  if (nsteps < 1.0)
+    return sh->index;
+  if (nsteps >= (double)(sh->buf_len - sh->index))
+    return sh->buf_len - 1;
+  return sh->index + (int)nsteps;
+}
+
+/*************************************************************************
+ladder_place:
+  In: first scale of a ladder queue
+      a time
+      the slot for the time (return value)
+      the lap of the time (return value)
+  Out: the scale of the ladder queue that holds the time
+*************************************************************************/
+
+static struct schedule_helper *ladder_place(struct schedule_helper *sh,
+                                            double t, int *slot,
+                                            long long *lap) {
+  struct schedule_helper *p;
+  double nsteps = (t - sh->now) * sh->dt_1;
+
+  if (nsteps < (double)(sh->buf_len - sh->index)) {
+    *slot = (nsteps < 1.0) ? sh->index : sh->index + (int)nsteps;
+    *lap = sh->lap;
+    return sh;
+  }
+
+  *lap = ladder_lap(sh, t);
+  if (*lap == sh->lap)
+    *lap = sh->lap + 1;
+
+  for (p = sh->next_scale; p->next_scale != NULL; p = p->next_scale) {
+    if (*lap < p->lap_end) {
+      long long b = (*lap - p->lap) / p->span;
+      *slot = (b < p->index) ? p->index : (int)b;
+      return p;
+    }
+  }
+
+  *slot = 0;
+  return p;
+}
+
+/*************************************************************************
+ladder_append:
+  In: a scale of a ladder queue
+      one of its slots
+      item to add
+  Out: No return value.  The item is put at the end of the slot.
+*************************************************************************/
+
+static void ladder_append(struct schedule_helper *sh, int i,
+                          struct abstract_element *ae) {
+  ae->next = NULL;
+  if (sh->circ_buf_tail[i] == NULL)
+    sh->circ_buf_head[i] = ae;
+  else
+    sh->circ_buf_tail[i]->next = ae;
+  sh->circ_buf_tail[i] = ae;
+  sh->circ_buf_count[i]++;
+}
+
+/*************************************************************************
+ladder_insert:
+  In: first scale of a ladder queue
+      item to schedule
+  Out: No return value.  The item is put at the end of the slot or bucket
+       for its time, and counted in every scale up to that one.
+*************************************************************************/
+
+static void ladder_insert(struct schedule_helper *sh,
+                          struct abstract_element *ae) {
+  struct schedule_helper *p, *q;
+  long long lap;
+  int i;
+
+  p = ladder_place(sh, ae->t, &i, &lap);
+  for (q = sh; q != p; q = q->next_scale)
+    q->count++;
+  p->count++;
+  ladder_append(p, i, ae);
+
+  if (p->next_scale == NULL && lap >= p->lap_end)
+    p->lap_end = lap + 1;
+}
+
+/*************************************************************************
+ladder_spill:
+  In: first scale of a ladder queue
+      the scale after it
+      a slot of that scale whose items are all in the current lap
+  Out: No return value.  The items are moved to the slots of the first
+       scale, in order.
+*************************************************************************/
+
+static void ladder_spill(struct schedule_helper *sh, struct schedule_helper *p,
+                         int i) {
+  struct abstract_element *ae, *next;
+
+  for (ae = p->circ_buf_head[i]; ae != NULL; ae = next) {
+    next = ae->next;
+    ladder_append(sh, ladder_slot(sh, ae->t), ae);
+  }
+
+  p->count -= p->circ_buf_count[i];
+  p->circ_buf_count[i] = 0;
+  p->circ_buf_head[i] = p->circ_buf_tail[i] = NULL;
+}
+
+/*************************************************************************
+ladder_spawn:
+  In: first scale of a ladder queue
+      the scale after it
+      a slot of that scale whose items are all in laps first to last
+      first lap
+      last lap
+  Out: 0 on success, 1 if out of memory.  A new rung covering the laps is
+       put after the first scale, and the items are moved into it.
+*************************************************************************/
+
+static int ladder_spawn(struct schedule_helper *sh, struct schedule_helper *p,
+                        int i, long long first, long long last) {
+  long long laps = last - first + 1;
+  long long n_buckets = p->circ_buf_count[i];
+  long long span;
+  double lap_dt = sh->dt * sh->buf_len;
+  struct schedule_helper *r;
+  struct abstract_element *ae, *next;
+
+  if (n_buckets < LADDER_MIN_BUCKETS)
+    n_buckets = LADDER_MIN_BUCKETS;
+  if (n_buckets > LADDER_MAX_BUCKETS)
+    n_buckets = LADDER_MAX_BUCKETS;
+  if (n_buckets > laps)
+    n_buckets = laps;
+  span = (laps + n_buckets - 1) / n_buckets;
+  n_buckets = (laps + span - 1) / span;
+
+  r = alloc_scale(lap_dt * span, (int)n_buckets, sh->origin + first * lap_dt);
+  if (r == NULL)
+    return 1;
+  r->ladder = 1;
+  r->depth = 1;
+  r->span = span;
+  r->lap = first;
+  r->lap_end = last + 1;
+
+  for (ae = p->circ_buf_head[i]; ae != NULL; ae = next) {
+    long long b = (ladder_lap(sh, ae->t) - first) / span;
+    next = ae->next;
+    if (b >= n_buckets)
+      b = n_buckets - 1;
+    ladder_append(r, (int)b, ae);
+  }
+
+  r->count = p->count;
+  p->count -= p->circ_buf_count[i];
+  p->circ_buf_count[i] = 0;
+  p->circ_buf_head[i] = p->circ_buf_tail[i] = NULL;
+
+  r->next_scale = p;
+  sh->next_scale = r;
+  return 0;
+}
+
+/*************************************************************************
+ladder_refill:
+  In: first scale of a ladder queue, at the start of a lap
+  Out: 0 on success, 1 if out of memory.  The items of the lap are moved
+       into the slots of the first scale, spawning rungs as needed.
+*************************************************************************/
+
+static int ladder_refill(struct schedule_helper *sh) {
+  long long lap = sh->lap;
+  long long last;
+  struct schedule_helper *p;
+  int i;
+
+  while (1) {
+    p = sh->next_scale;
+
+    if (p->next_scale == NULL) {
+      /* Only the top is left */
+      if (p->count == 0) {
+        p->lap = p->lap_end = lap + 1;
+        p->now = sh->origin + p->lap * sh->dt * sh->buf_len;
+        return 0;
+      }
+      i = 0;
+      last = p->lap_end - 1;
+      p->lap = p->lap_end;
+      p->now = sh->origin + p->lap * sh->dt * sh->buf_len;
+    } else {
+      if (lap >= p->lap_end) {
+        /* The rung is used up */
+        sh->next_scale = p->next_scale;
+        p->next_scale = NULL;
+        delete_scheduler(p);
+        continue;
+      }
+
+      i = (int)((lap - p->lap) / p->span);
+      p->index = i;
+      if (p->circ_buf_count[i] == 0)
+        return 0;
+      p->index = i + 1;
+      last = p->lap + (i + 1) * p->span - 1;
+      if (last >= p->lap_end)
+        last = p->lap_end - 1;
+    }
+
+    if (last <= lap) {
+      ladder_spill(sh, p, i);
+      return 0;
+    }
+    if (ladder_spawn(sh, p, i, lap, last))
+      return 1;
+  }
+}
+
 /*************************************************************************
 schedule_insert:
   In: scheduler that we are using
@@ -244,6 +570,11 @@ int schedule_insert(struct schedule_helper *sh, void *data,
   }
 
   /* insert item into future lists */
+  if (sh->ladder) {
+    ladder_insert(sh, ae);
+    return 0;
+  }
+
   sh->count++;
   double nsteps = (ae->t - sh->now) * sh->dt_1;
 
@@ -298,6 +629,49 @@ int schedule_insert(struct schedule_helper *sh, void *data,
   return 0;
 }
 
+/*************************************************************************
+schedule_locate:
+  In: multi-scale scheduler that we are using
+      time of an item
+      depth of the scale that would hold the item (return value)
+      slot of that scale that would hold the item (return value)
+  Out: No return value.  Finds where schedule_insert would put an item
+       scheduled at time t, without inserting it.  Coarser scales that do
+       not exist yet are counted as schedule_insert would create them.
+*************************************************************************/
+
+void schedule_locate(struct schedule_helper *sh, double t, int *depth,
+                     int *slot) {
+  double dt = sh->dt, dt_1 = sh->dt_1, now = sh->now;
+  int len = sh->buf_len, index = sh->index;
+
+  for (*depth = 0;; ++*depth) {
+    double nsteps = (t - now) * dt_1;
+    if (nsteps < (double)len) {
+      int i = (nsteps < 0.0) ? index : (int)nsteps + index;
+      if (i >= len)
+        i -= len;
+      *slot = i;
+      return;
+    }
+
+    if (sh != NULL)
+      sh = sh->next_scale;
+    if (sh != NULL) {
+      dt = sh->dt;
+      dt_1 = sh->dt_1;
+      now = sh->now;
+      len = sh->buf_len;
+      index = sh->index;
+    } else {
+      now += dt * (len - index);
+      dt *= len;
+      dt_1 = 1 / dt;
+      index = 0;
+    }
+  }
+}
+
 /*************************************************************************
 unlink_list_item:
   Removes a specific item from the linked list.
@@ -327,6 +701,40 @@ static int unlink_list_item(struct abstract_element **hd,
   return 1;
 }
 
+/*************************************************************************
+ladder_deschedule:
+  In: first scale of a ladder queue
+      item to remove
+  Out: 0 on success, 1 if the item was not found
+*************************************************************************/
+
+static int ladder_deschedule(struct schedule_helper *sh,
+                             struct abstract_element *ae) {
+  struct schedule_helper *p, *q;
+  long long lap;
+  int i;
+
+  p = ladder_place(sh, ae->t, &i, &lap);
+  if (unlink_list_item(&p->circ_buf_head[i], &p->circ_buf_tail[i], ae)) {
+    /* The item's time may have been rounded differently when it was put
+       in, so look for it everywhere */
+    for (p = sh; p != NULL; p = p->next_scale) {
+      for (i = 0; i < p->buf_len; i++) {
+        if (!unlink_list_item(&p->circ_buf_head[i], &p->circ_buf_tail[i], ae))
+          goto found;
+      }
+    }
+    return 1;
+  }
+
+found:
+  for (q = sh; q != p; q = q->next_scale)
+    q->count--;
+  p->count--;
+  p->circ_buf_count[i]--;
+  return 0;
+}
+
 /*************************************************************************
 schedule_deschedule:
   Removes an item from the schedule.
@@ -347,6 +755,9 @@ int schedule_deschedule(struct schedule_helper *sh, void *data) {
     return 0;
   }
 
+  if (sh->ladder)
+    return ladder_deschedule(sh, ae);
+
   double nsteps = (ae->t - sh->now) * sh->dt_1;
   if (nsteps < ((double)sh->buf_len)) {
     int list_idx;
@@ -436,7 +847,11 @@ int schedule_advance(struct schedule_helper *sh, struct abstract_element **head,
     /* Move events from coarser time scale to this time scale */
 
     sh->index = 0;
-    if (sh->next_scale != NULL) {
+    if (sh->ladder) {
+      sh->lap++;
+      if (ladder_refill(sh))
+        return -1;
+    } else if (sh->next_scale != NULL) {
       /* Save our depth */
       int old_depth = sh->depth;
       int conservecount = sh->count;
@@ -471,6 +886,42 @@ int schedule_advance(struct schedule_helper *sh, struct abstract_element **head,
   return n;
 }
 
+/*************************************************************************
+schedule_skip:
+  In: scheduler that we are using, with nothing scheduled in it
+      number of time slots to skip
+  Out: No return value.  The scheduler is left exactly as n calls to
+       schedule_next would have left it, without visiting every slot.
+*************************************************************************/
+
+void schedule_skip(struct schedule_helper *sh, long long n) {
+  if (sh->ladder) {
+    long long slots = sh->index + n;
+    sh->index = (int)(slots % sh->buf_len);
+    sh->now += n * sh->dt;
+    sh->lap += slots / sh->buf_len;
+
+    /* The rungs are empty, so they can go */
+    while (sh->next_scale->next_scale != NULL) {
+      struct schedule_helper *p = sh->next_scale;
+      sh->next_scale = p->next_scale;
+      p->next_scale = NULL;
+      delete_scheduler(p);
+    }
+    sh->next_scale->lap = sh->next_scale->lap_end = sh->lap + 1;
+    sh->next_scale->now = sh->origin + (sh->lap + 1) * sh->dt * sh->buf_len;
+    return;
+  }
+
+  for (; sh != NULL && n > 0; sh = sh->next_scale) {
+    long long slots = sh->index + n;
+    sh->index = (int)(slots % sh->buf_len);
+    sh->now += n * sh->dt;
+    /* Every wrap-around advances the next coarser scale by one slot */
+    n = slots / sh->buf_len;
+  }
+}
+
 /*************************************************************************
 schedule_next:
   In: scheduler that we are using
@@ -515,6 +966,30 @@ int schedule_anticipate(struct schedule_helper *sh, double *t) {
   } else if (sh->count == 0)
     return 0;
 
+  if (sh->ladder) {
+    for (i = sh->index; i < sh->buf_len; i++) {
+      if (sh->circ_buf_count[i] > 0) {
+        *t = sh->now + sh->dt * (i - sh->index);
+        return 1;
+      }
+    }
+    /* Items in later scales are at least as late as the start of their
+       bucket and of the next lap */
+    for (struct schedule_helper *p = sh->next_scale; p != NULL;
+         p = p->next_scale) {
+      for (i = p->index; i < p->buf_len; i++) {
+        if (p->circ_buf_count[i] > 0) {
+          long long lap = p->lap + i * p->span;
+          if (lap <= sh->lap)
+            lap = sh->lap + 1;
+          *t = sh->origin + lap * sh->dt * sh->buf_len;
+          return 1;
+        }
+      }
+    }
+    return 0;
+  }
+
   while (sh->next_scale != NULL && sh->count == sh->next_scale->count)
     sh = sh->next_scale;
 
@@ -540,6 +1015,71 @@ int schedule_anticipate(struct schedule_helper *sh, double *t) {
     return 0;
 }
 
+/*************************************************************************
+cleanup_slot:
+  In: first scale of the scheduler
+      scale holding the slot
+      index of the slot
+      pointer to a function that will return 0 if an abstract_element is
+        okay, or 1 if it is defunct
+      list of defunct items to add to
+      number of defunct items removed (incremented)
+  Out: number of items looked at.  The defunct items of the slot are moved
+       onto the defunct list, and the counts of the scales are updated.
+*************************************************************************/
+
+static int cleanup_slot(struct schedule_helper *top, struct schedule_helper *sh,
+                        int i, int (*is_defunct)(struct abstract_element *),
+                        struct abstract_element **defunct_list,
+                        int *n_removed) {
+  struct abstract_element *ae;
+  struct abstract_element *temp;
+  struct schedule_helper *shp;
+  int n_visited = 0;
+
+  /* Remove defunct elements from beginning of list */
+  while (sh->circ_buf_head[i] != NULL &&
+         (*is_defunct)(sh->circ_buf_head[i])) {
+    n_visited++;
+    temp = sh->circ_buf_head[i]->next;
+    sh->circ_buf_head[i]->next = *defunct_list;
+    *defunct_list = sh->circ_buf_head[i];
+    sh->circ_buf_head[i] = temp;
+    sh->circ_buf_count[i]--;
+    sh->count--;
+    for (shp = top; shp != sh; shp = shp->next_scale)
+      shp->count--;
+    ++*n_removed;
+  }
+
+  if (sh->circ_buf_head[i] == NULL) {
+    sh->circ_buf_tail[i] = NULL;
+  } else {
+    /* Now remove defunct elements from later in list */
+    for (ae = sh->circ_buf_head[i]; ae != NULL; ae = ae->next) {
+      n_visited++;
+      while (ae->next != NULL && (*is_defunct)(ae->next)) {
+        n_visited++;
+        temp = ae->next->next;
+        ae->next->next = *defunct_list;
+        *defunct_list = ae->next;
+        ae->next = temp;
+        sh->circ_buf_count[i]--;
+        sh->count--;
+        for (shp = top; shp != sh; shp = shp->next_scale)
+          shp->count--;
+        ++*n_removed;
+      }
+      if (ae->next == NULL) {
+        sh->circ_buf_tail[i] = ae;
+        break;
+      }
+    }
+  }
+
+  return n_visited;
+}
+
 /*************************************************************************
 schedule_cleanup:
   In: scheduler that we are using
@@ -554,10 +1094,8 @@ struct abstract_element *
 schedule_cleanup(struct schedule_helper *sh,
                  int (*is_defunct)(struct abstract_element*)) {
   struct abstract_element *defunct_list;
-  struct abstract_element *ae;
-  struct abstract_element *temp;
   struct schedule_helper *top;
-  struct schedule_helper *shp;
+  int n_removed = 0;
   int i;
 
   defunct_list = NULL;
@@ -566,43 +1104,65 @@ schedule_cleanup(struct schedule_helper *sh,
   for (; sh != NULL; sh = sh->next_scale) {
     sh->defunct_count = 0;
 
-    for (i = 0; i < sh->buf_len; i++) {
-      /* Remove defunct elements from beginning of list */
-      while (sh->circ_buf_head[i] != NULL &&
-             (*is_defunct)(sh->circ_buf_head[i])) {
-        temp = sh->circ_buf_head[i]->next;
-        sh->circ_buf_head[i]->next = defunct_list;
-        defunct_list = sh->circ_buf_head[i];
-        sh->circ_buf_head[i] = temp;
-        sh->circ_buf_count[i]--;
-        sh->count--;
-        for (shp = top; shp != sh; shp = shp->next_scale)
-          shp->count--;
-      }
+    for (i = 0; i < sh->buf_len; i++)
+      cleanup_slot(top, sh, i, is_defunct, &defunct_list, &n_removed);
+  }
 
-      if (sh->circ_buf_head[i] == NULL) {
-        sh->circ_buf_tail[i] = NULL;
-      } else {
-        /* Now remove defunct elements from later in list */
-        for (ae = sh->circ_buf_head[i]; ae != NULL; ae = ae->next) {
-          while (ae->next != NULL && (*is_defunct)(ae->next)) {
-            temp = ae->next->next;
-            ae->next->next = defunct_list;
-            defunct_list = ae->next;
-            ae->next = temp;
-            sh->circ_buf_count[i]--;
-            sh->count--;
-            for (shp = top; shp != sh; shp = shp->next_scale)
-              shp->count--;
-          }
-          if (ae->next == NULL) {
-            sh->circ_buf_tail[i] = ae;
-            break;
-          }
-        }
+  return defunct_list;
+}
+
+/*************************************************************************
+schedule_sweep:
+  In: scheduler that we are using
+      pointer to a function that will return 0 if an abstract_element is
+        okay, or 1 if it is defunct
+      number of items to look at before stopping
+      number of defunct items removed (return value)
+  Out: the defunct items of the slots swept are removed from the scheduler
+       and returned as a linked list, like schedule_cleanup.  Whole slots
+       are swept, starting where the previous call stopped and going on
+       through every scale in turn, until max_visits items have been
+       looked at or every slot has been swept once.  defunct_count is left
+       to the caller.
+*************************************************************************/
+
+struct abstract_element *
+schedule_sweep(struct schedule_helper *sh,
+               int (*is_defunct)(struct abstract_element *), int max_visits,
+               int *n_removed) {
+  struct abstract_element *defunct_list = NULL;
+  struct schedule_helper *top = sh;
+  int n_slots = 0;
+  int n_visited = 0;
+  int depth;
+
+  for (struct schedule_helper *shp = top; shp != NULL; shp = shp->next_scale)
+    n_slots += shp->buf_len;
+
+  /* Scales may have come and gone since the last sweep */
+  for (depth = 0; sh != NULL && depth < top->sweep_depth; depth++)
+    sh = sh->next_scale;
+  if (sh == NULL || top->sweep_slot >= sh->buf_len) {
+    sh = top;
+    depth = 0;
+    top->sweep_slot = 0;
+  }
+
+  *n_removed = 0;
+  for (; n_slots > 0 && n_visited < max_visits; n_slots--) {
+    n_visited += cleanup_slot(top, sh, top->sweep_slot, is_defunct,
+                              &defunct_list, n_removed);
+    if (++top->sweep_slot >= sh->buf_len) {
+      top->sweep_slot = 0;
+      sh = sh->next_scale;
+      depth++;
+      if (sh == NULL) {
+        sh = top;
+        depth = 0;
       }
     }
   }
+  top->sweep_depth = depth;
 
   return defunct_list;
 }
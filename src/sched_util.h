@@ -30,7 +30,11 @@ struct abstract_element {
   double t; /* Time at which the element is scheduled */
 };
 
-/* Implements a multi-scale, discretized event scheduler */
+/* Implements a multi-scale, discretized event scheduler.  The same
+ * structure also holds a ladder queue (see create_ladder_scheduler): the
+ * first scale is then a single lap of slots, the next scales are rungs of
+ * buckets whose number follows the number of items spread into them, and
+ * the last scale is an unsorted list of the items furthest in the future. */
 struct schedule_helper {
   struct schedule_helper *next_scale; /* Next coarser time scale */
 
@@ -55,17 +59,31 @@ struct schedule_helper {
   struct abstract_element *current_tail; /* Tail of list of items */
 
   int defunct_count; /* Number of defunct items (set by user)*/
+  int sweep_depth;   /* Scale and slot where schedule_sweep goes on */
+  int sweep_slot;
   int error;         /* Error code (1 - on error, 0 - no errors) */
   int depth;         /* "Tier" of scheduler in timescale hierarchy, 0-based */
+
+  /* Ladder queues only */
+  int ladder;         /* Nonzero if this scale belongs to a ladder queue */
+  long long span;     /* Laps of the first scale per bucket of a rung */
+  long long lap;      /* Current lap of the first scale, or first lap of a
+                         rung or of the top */
+  long long lap_end;  /* Lap after the last one in a rung or the top */
+  double origin;      /* Start time of lap 0 of the first scale */
 };
 
 struct abstract_element *ae_list_sort(struct abstract_element *ae);
 
 struct schedule_helper *create_scheduler(double dt_min, double dt_max,
                                          int maxlen, double start_iterations);
+struct schedule_helper *create_ladder_scheduler(double dt, int len,
+                                                double start_iterations);
 
 int schedule_insert(struct schedule_helper *sh, void *data,
                     int put_neg_in_current);
+void schedule_locate(struct schedule_helper *sh, double t, int *depth,
+                     int *slot);
 int schedule_deschedule(struct schedule_helper *sh, void *data);
 int schedule_reschedule(struct schedule_helper *sh, void *data, double new_t);
 /*void schedule_excert(struct schedule_helper *sh,void *data,void *blank,int
@@ -74,11 +92,16 @@ int schedule_advance(struct schedule_helper *sh, struct abstract_element **head,
                      struct abstract_element **tail);
 
 void *schedule_next(struct schedule_helper *sh);
+void schedule_skip(struct schedule_helper *sh, long long n);
 #define schedule_add(x, y) schedule_insert((x), (y), 1)
 
 int schedule_anticipate(struct schedule_helper *sh, double *t);
 struct abstract_element *
 schedule_cleanup(struct schedule_helper *sh,
                  int (*is_defunct)(struct abstract_element *e));
+struct abstract_element *
+schedule_sweep(struct schedule_helper *sh,
+               int (*is_defunct)(struct abstract_element *e), int max_visits,
+               int *n_removed);
 
 void delete_scheduler(struct schedule_helper *sh);
@@ -219,6 +219,10 @@ struct species *new_species(void) {
   specp->absorb_mols = NULL;
   specp->clamp_conc_mols = NULL;
 
+  specp->n_rx_pairs = -1;
+  specp->rx_pairs = NULL;
+  specp->rx_partner_bits = NULL;
+
   return specp;
 }
 
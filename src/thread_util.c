@@ -0,0 +1,437 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2006-2017 by
+ * The Salk Institute for Biological Studies and
+ * Pittsburgh Supercomputing Center, Carnegie Mellon University
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ *
+******************************************************************************/
+
+/**************************************************************************\
+ ** File: thread_util.c                                                  **
+ **                                                                      **
+ ** Purpose: Worker thread pool used to run the timesteps of several     **
+ **   memory partitions (storages) at once, plus the locking helpers     **
+ **   needed by code that may be called from those workers.              **
+\**************************************************************************/
+
+#include "config.h"
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "logging.h"
+#include "mcell_structs.h"
+#include "thread_util.h"
+
+_Thread_local struct thread_state *current_thread = NULL;
+
+#define QUEUE_NEXT(q) ((uint32_t)(q))
+#define QUEUE_END(q) ((uint32_t)((q) >> 32))
+#define QUEUE_PACK(next, end) (((uint64_t)(end) << 32) | (uint64_t)(next))
+
+/* find_neighbor_tiles looks at the ring of tiles around the reacting tile,
+   and the partner found there may in turn look at its own ring. */
+#define SURFACE_SEARCH_RINGS 2
+
+/*************************************************************************
+wall_time:
+  In: No arguments.
+  Out: Seconds on a monotonic clock.
+*************************************************************************/
+static double wall_time(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/*************************************************************************
+claim_task:
+  In: pool: the thread pool
+      owner: thread whose queue to take a task from
+      steal: 0 to take the front task (the owner's end), 1 to take the
+             back task (a thief's end)
+  Out: The index of the task taken, or -1 if the queue is empty.
+*************************************************************************/
+static int claim_task(struct thread_pool *pool, struct thread_state *owner,
+                      int steal) {
+  uint64_t q = __atomic_load_n(&owner->queue, __ATOMIC_ACQUIRE);
+  for (;;) {
+    uint32_t next = QUEUE_NEXT(q), end = QUEUE_END(q);
+    if (next >= end)
+      return -1;
+
+    uint32_t slot = steal ? end - 1 : next;
+    uint64_t rest = steal ? QUEUE_PACK(next, end - 1)
+                          : QUEUE_PACK(next + 1, end);
+    if (__atomic_compare_exchange_n(&owner->queue, &q, rest, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      return owner->index + (int)slot * pool->n_threads;
+  }
+}
+
+/*************************************************************************
+run_tasks:
+  In: pool: the thread pool
+      ts: state of the calling thread
+  Out: No return value.  Tasks are taken from the calling thread's own
+       queue first.  Once it is empty, tasks are stolen from the back of
+       the other threads' queues until every queue is empty.
+*************************************************************************/
+static void run_tasks(struct thread_pool *pool, struct thread_state *ts) {
+  current_thread = ts;
+  for (;;) {
+    int task = claim_task(pool, ts, 0);
+    for (int i = 1; task < 0 && i < pool->n_threads; i++) {
+      task = claim_task(
+          pool, &pool->states[(ts->index + i) % pool->n_threads], 1);
+      if (task >= 0)
+        ts->tasks_stolen++;
+    }
+    if (task < 0)
+      break;
+
+    double start = wall_time();
+    pool->fn(pool->data, task, ts);
+    ts->busy_time += wall_time() - start;
+    ts->tasks_run++;
+  }
+  current_thread = NULL;
+}
+
+/*************************************************************************
+thread_worker:
+  In: arg: the thread_state of this worker
+  Out: NULL.  Waits for batches posted by thread_pool_run and helps to
+       run them until the pool is shut down.
+*************************************************************************/
+static void *thread_worker(void *arg) {
+  struct thread_state *ts = (struct thread_state *)arg;
+  struct thread_pool *pool = ts->pool;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (pool->generation == seen && !pool->shutdown)
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    if (pool->shutdown)
+      break;
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+
+    run_tasks(pool, ts);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->n_busy == 0)
+      pthread_cond_signal(&pool->finished);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+/*************************************************************************
+create_thread_pool:
+  In: world: simulation state
+      n_threads: total number of threads, including the calling thread
+  Out: The new pool.  n_threads - 1 workers are started; the calling
+       thread takes part in every batch as thread 0.  Threads draw random
+       numbers from the stream of whichever storage they are running.
+*************************************************************************/
+struct thread_pool *create_thread_pool(struct volume *world, int n_threads) {
+  struct thread_pool *pool =
+      CHECKED_MALLOC_STRUCT(struct thread_pool, "thread pool");
+  memset(pool, 0, sizeof(struct thread_pool));
+  pool->n_threads = n_threads;
+  pool->states = CHECKED_MALLOC_ARRAY(struct thread_state, n_threads,
+                                      "thread states");
+  memset(pool->states, 0, n_threads * sizeof(struct thread_state));
+
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&pool->shared_lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->finished, NULL);
+
+  pool->margin = thread_interaction_margin(world);
+
+  for (int i = 0; i < n_threads; i++) {
+    pool->states[i].index = i;
+    pool->states[i].pool = pool;
+  }
+
+  if (n_threads > 1) {
+    pool->threads = CHECKED_MALLOC_ARRAY(pthread_t, n_threads - 1,
+                                         "worker threads");
+    for (int i = 1; i < n_threads; i++) {
+      int err = pthread_create(&pool->threads[i - 1], NULL, thread_worker,
+                               &pool->states[i]);
+      if (err != 0)
+        mcell_perror(err, "Failed to start worker thread %d", i);
+    }
+  }
+  return pool;
+}
+
+/*************************************************************************
+destroy_thread_pool:
+  In: pool: the thread pool
+  Out: No return value.  Worker threads are joined and all memory owned
+       by the pool is freed.
+*************************************************************************/
+void destroy_thread_pool(struct thread_pool *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (int i = 1; i < pool->n_threads; i++)
+    pthread_join(pool->threads[i - 1], NULL);
+
+  pthread_cond_destroy(&pool->finished);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_mutex_destroy(&pool->shared_lock);
+  for (int i = 0; i < pool->n_threads; i++)
+    delete_scratch(&pool->states[i].scratch);
+  free(pool->threads);
+  free(pool->states);
+  free(pool);
+}
+
+/*************************************************************************
+thread_pool_run:
+  In: pool: the thread pool
+      n_tasks: number of tasks in the batch
+      fn: function to call for each task
+      data: passed through to fn
+  Out: No return value.  fn has been called exactly once for every task
+       index in [0, n_tasks) by some thread of the pool, and all of those
+       calls have completed.
+  Note: Tasks are dealt round-robin, so thread i starts with tasks i,
+        i + n_threads, ...  Callers should list the most expensive tasks
+        first; threads that run out of work steal the cheapest remaining
+        tasks of the others.
+*************************************************************************/
+void thread_pool_run(struct thread_pool *pool, int n_tasks, thread_task_fn fn,
+                     void *data) {
+  if (n_tasks <= 0)
+    return;
+
+  double start = wall_time();
+  pthread_mutex_lock(&pool->lock);
+  pool->fn = fn;
+  pool->data = data;
+  pool->n_tasks = n_tasks;
+  for (int i = 0; i < pool->n_threads; i++) {
+    int n_slots = (i < n_tasks)
+        ? (n_tasks - i + pool->n_threads - 1) / pool->n_threads : 0;
+    __atomic_store_n(&pool->states[i].queue, QUEUE_PACK(0, n_slots),
+                     __ATOMIC_RELEASE);
+  }
+  pool->n_busy = pool->n_threads - 1;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  run_tasks(pool, &pool->states[0]);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->n_busy > 0)
+    pthread_cond_wait(&pool->finished, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+
+  pool->n_batches++;
+  pool->batch_time += wall_time() - start;
+}
+
+/*************************************************************************
+print_thread_utilization:
+  In: pool: the thread pool
+  Out: No return value.  For every thread, the number of tasks it ran and
+       stole and the share of the time spent in batches that it was busy
+       are logged.
+*************************************************************************/
+void print_thread_utilization(struct thread_pool *pool) {
+  mcell_log("Thread pool ran %lld batches in %.3f seconds.", pool->n_batches,
+            pool->batch_time);
+  for (int i = 0; i < pool->n_threads; i++) {
+    struct thread_state *ts = &pool->states[i];
+    double busy = (pool->batch_time > 0.0)
+        ? 100.0 * ts->busy_time / pool->batch_time : 0.0;
+    mcell_log("  Thread %d: %lld tasks (%lld stolen), busy %.1f%% of the "
+              "time", i, ts->tasks_run, ts->tasks_stolen, busy);
+  }
+}
+
+/*************************************************************************
+thread_interaction_margin:
+  In: world: simulation state
+  Out: How far beyond the end of a step a molecule may touch simulation
+       data.  A step may reach one reaction radius beyond its end point,
+       reactions place products up to the vacancy search distance away
+       and surface neighbor searches look SURFACE_SEARCH_RINGS rings of
+       tiles further, each at most world->max_tile_edge across (see
+       init_storage_colors).
+*************************************************************************/
+double thread_interaction_margin(struct volume *world) {
+  return 2.0 * world->rx_radius_3d + sqrt(world->vacancy_search_dist2) +
+         SURFACE_SEARCH_RINGS * world->max_tile_edge;
+}
+
+/*************************************************************************
+thread_shared_lock:
+  In: world: simulation state
+  Out: No return value.  If called from a pool task, the world-level
+       lock is taken (it may be taken recursively).  Outside of pool
+       tasks this does nothing.
+*************************************************************************/
+void thread_shared_lock(struct volume *world) {
+  if (current_thread != NULL)
+    pthread_mutex_lock(&world->thread_pool->shared_lock);
+}
+
+/*************************************************************************
+thread_shared_unlock:
+  In: world: simulation state
+  Out: No return value.  Releases a lock taken by thread_shared_lock.
+*************************************************************************/
+void thread_shared_unlock(struct volume *world) {
+  if (current_thread != NULL)
+    pthread_mutex_unlock(&world->thread_pool->shared_lock);
+}
+
+/*************************************************************************
+thread_atomic_add_double:
+  In: target: the value to update
+      value: amount to add
+  Out: No return value.  value is added to *target atomically.
+*************************************************************************/
+void thread_atomic_add_double(double *target, double value) {
+  double old, sum;
+  __atomic_load(target, &old, __ATOMIC_RELAXED);
+  do {
+    sum = old + value;
+  } while (!__atomic_compare_exchange(target, &old, &sum, 1, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED));
+}
+
+/*************************************************************************
+thread_atomic_cycle_down:
+  In: target: a counter running down from hi to lo
+      lo, hi: range of the counter
+  Out: No return value.  *target is decremented, or set back to hi if it
+       would drop below lo, atomically.
+*************************************************************************/
+void thread_atomic_cycle_down(int *target, int lo, int hi) {
+  int old, next;
+  __atomic_load(target, &old, __ATOMIC_RELAXED);
+  do {
+    next = (old - 1 < lo) ? hi : old - 1;
+  } while (!__atomic_compare_exchange(target, &old, &next, 1, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED));
+}
+
+/*************************************************************************
+thread_step_is_local:
+  In: world: simulation state
+      pos: where the molecule currently is
+      reach: how far it is about to move
+  Out: 1 if everything the move may touch (plus the pool's interaction
+       margin) lies within the reach box of the calling thread (normally
+       that of the storage it runs), 0 otherwise.  Always 1 outside of pool
+       tasks.
+  Note: Storages that run concurrently have disjoint reach boxes, so a
+        local move never touches data another task may be using.
+*************************************************************************/
+int thread_step_is_local(struct volume *world, struct vector3 *pos,
+                         double reach) {
+  if (current_thread == NULL || current_thread->store == NULL)
+    return 1;
+
+  struct vector3 *llf = &current_thread->reach_llf;
+  struct vector3 *urb = &current_thread->reach_urb;
+  double r = reach + world->thread_pool->margin;
+  return (pos->x - r > llf->x && pos->x + r < urb->x &&
+          pos->y - r > llf->y && pos->y + r < urb->y &&
+          pos->z - r > llf->z && pos->z + r < urb->z);
+}
+
+/*************************************************************************
+next_molecule_id:
+  In: world: simulation state
+  Out: A new unique molecule id.  While a storage is being run the id
+       comes from that storage's counter, so ids do not depend on the
+       order in which concurrently running storages create molecules.
+*************************************************************************/
+u_long next_molecule_id(struct volume *world) {
+  u_long *counter = &world->current_mol_id;
+  if (thread_can_defer())
+    counter = &current_thread->store->stream->next_mol_id;
+
+  u_long id = *counter;
+  *counter += world->mol_id_stride;
+  return id;
+}
+
+/*************************************************************************
+return_molecule_id:
+  In: world: simulation state
+  Out: No return value.  The id handed out by the last call to
+       next_molecule_id from the same context is given back.
+*************************************************************************/
+void return_molecule_id(struct volume *world) {
+  if (thread_can_defer())
+    current_thread->store->stream->next_mol_id -= world->mol_id_stride;
+  else
+    world->current_mol_id -= world->mol_id_stride;
+}
+
+/*************************************************************************
+merge_storage_stats:
+  In: world: simulation state
+  Out: No return value.  The event counters of every storage stream are
+       added to the world's counters and reset.  Must not be called while
+       storages are being run.
+  Note: The streams are visited in storage order, so the floating point
+        sums come out the same whatever the number of threads.
+*************************************************************************/
+void merge_storage_stats(struct volume *world) {
+  struct sim_stats *total = &world->stats;
+  for (int i = 0; i < world->n_storage_streams; i++) {
+    struct sim_stats *s = &world->storage_streams[i].stats;
+    total->diffusion_number += s->diffusion_number;
+    total->diffusion_cumtime += s->diffusion_cumtime;
+    total->ray_voxel_tests += s->ray_voxel_tests;
+    total->ray_polygon_tests += s->ray_polygon_tests;
+    total->ray_polygon_colls += s->ray_polygon_colls;
+    total->vol_vol_colls += s->vol_vol_colls;
+    total->vol_surf_colls += s->vol_surf_colls;
+    total->surf_surf_colls += s->surf_surf_colls;
+    total->vol_wall_colls += s->vol_wall_colls;
+    total->vol_vol_vol_colls += s->vol_vol_vol_colls;
+    total->vol_vol_surf_colls += s->vol_vol_surf_colls;
+    total->vol_surf_surf_colls += s->vol_surf_surf_colls;
+    total->surf_surf_surf_colls += s->surf_surf_surf_colls;
+    memset(s, 0, sizeof(struct sim_stats));
+  }
+}
@@ -0,0 +1,153 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2006-2017 by
+ * The Salk Institute for Biological Studies and
+ * Pittsburgh Supercomputing Center, Carnegie Mellon University
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ *
+******************************************************************************/
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "mem_util.h"
+#include "rng.h"
+#include "vector.h"
+
+struct volume;
+struct storage;
+struct thread_pool;
+struct sim_stats;
+struct count_shard;
+
+/* Data written by different threads is kept at least this far apart */
+#define CACHE_LINE_SIZE 64
+
+/* Per-thread state of a worker executing simulation code */
+struct thread_state {
+  int index;                /* 0 is the main thread */
+  struct thread_pool *pool; /* Pool this thread belongs to */
+  struct rng_state *rng;    /* Stream of the storage being run */
+  struct storage *store;    /* Storage whose timestep is being run, or NULL
+                               during the serial pass over deferred steps */
+  struct vector3 reach_llf; /* Steps of store must stay within this box: */
+  struct vector3 reach_urb; /* its reach box, or a wider one in the serial
+                               passes of a distributed run */
+  struct sim_stats *stats;  /* Event counters of the storage being run */
+  struct count_shard *counts; /* Region count updates of that storage */
+  struct scratch_arena scratch; /* Collision lists of the diffusion step
+                                   being taken */
+
+  /* Tasks of the current batch dealt to this thread: slots next to end - 1
+     (end in the high 32 bits), slot k holding task index + k * n_threads.
+     The owner claims from the front and idle threads steal from the back,
+     both with a single compare-and-swap. */
+  uint64_t queue;
+
+  /* Utilization statistics */
+  long long tasks_run;    /* Tasks run by this thread */
+  long long tasks_stolen; /* ... of which were taken from another thread */
+  double busy_time;       /* Seconds spent running tasks */
+  char pad[CACHE_LINE_SIZE];
+};
+
+/* Work function run by the pool, once per task index */
+typedef void (*thread_task_fn)(void *data, int task, struct thread_state *ts);
+
+/* Fixed set of worker threads which run batches of tasks */
+struct thread_pool {
+  int n_threads;               /* Number of threads including the caller */
+  pthread_t *threads;          /* Background workers (n_threads - 1) */
+  struct thread_state *states; /* One per thread, states[0] is the caller */
+
+  pthread_mutex_t lock;     /* Protects the fields below */
+  pthread_cond_t wake;      /* Signalled when a new batch is posted */
+  pthread_cond_t finished;  /* Signalled when the last worker goes idle */
+  unsigned long generation; /* Incremented for every posted batch */
+  int n_busy;               /* Background workers still in the batch */
+  int shutdown;             /* Set to make the workers exit */
+
+  thread_task_fn fn; /* Current batch */
+  void *data;
+  int n_tasks;
+
+  long long n_batches; /* Batches run so far */
+  double batch_time;   /* Seconds from posting to completion of batches */
+
+  pthread_mutex_t shared_lock; /* Serializes world-level bookkeeping */
+  double margin; /* Interaction range added to every locality check */
+};
+
+/* The thread_state of the calling thread while it runs pool tasks */
+extern _Thread_local struct thread_state *current_thread;
+
+struct thread_pool *create_thread_pool(struct volume *world, int n_threads);
+void destroy_thread_pool(struct thread_pool *pool);
+void thread_pool_run(struct thread_pool *pool, int n_tasks, thread_task_fn fn,
+                     void *data);
+void print_thread_utilization(struct thread_pool *pool);
+
+double thread_interaction_margin(struct volume *world);
+
+void thread_shared_lock(struct volume *world);
+void thread_shared_unlock(struct volume *world);
+void thread_atomic_add_double(double *target, double value);
+void thread_atomic_cycle_down(int *target, int lo, int hi);
+
+int thread_step_is_local(struct volume *world, struct vector3 *pos,
+                         double reach);
+
+u_long next_molecule_id(struct volume *world);
+void return_molecule_id(struct volume *world);
+
+void merge_storage_stats(struct volume *world);
+
+/* Whether the calling code runs a storage concurrently with others, and so
+   has to hand steps reaching outside of the storage to the serial pass */
+#define thread_can_defer()                                                     \
+  (current_thread != NULL && current_thread->store != NULL)
+
+/* The random number stream to draw from in the calling context */
+#define local_rng(world)                                                       \
+  (current_thread != NULL ? current_thread->rng : (world)->rng)
+
+/* The event counters to update in the calling context */
+#define local_stats(world)                                                     \
+  (current_thread != NULL ? current_thread->stats : &(world)->stats)
+
+/* The scratch arena for collision lists in the calling context */
+#define local_scratch(world)                                                   \
+  (current_thread != NULL ? &current_thread->scratch : &(world)->scratch)
+
+/* Add to a world-level tally, atomically when called from a pool task */
+#define THREADED_ADD(lval, n)                                                  \
+  do {                                                                         \
+    if (current_thread != NULL)                                                \
+      __atomic_fetch_add(&(lval), (n), __ATOMIC_RELAXED);                      \
+    else                                                                       \
+      (lval) += (n);                                                           \
+  } while (0)
+
+#define THREADED_ADD_DOUBLE(lval, n)                                           \
+  do {                                                                         \
+    if (current_thread != NULL)                                                \
+      thread_atomic_add_double(&(lval), (n));                                  \
+    else                                                                       \
+      (lval) += (n);                                                           \
+  } while (0)
@@ -152,43 +152,34 @@ static int sort_molecules_by_species(struct volume *world,
 
   /* Sort molecules by species id */
   for (slp = world->storage_head; slp != NULL; slp = slp->next) {
-    struct storage *sp = slp->store;
-    struct schedule_helper *shp;
+    struct storage_walk walk;
     struct abstract_molecule *amp;
-    int sched_slot_index;
-    for (shp = sp->timer; shp != NULL; shp = shp->next_scale) {
-      for (sched_slot_index = -1; sched_slot_index < shp->buf_len;
-           ++sched_slot_index) {
-        for (amp = (struct abstract_molecule *)((sched_slot_index < 0)
-                                                    ? shp->current
-                                                    : shp->circ_buf_head
-                                                          [sched_slot_index]);
-             amp != NULL; amp = amp->next) {
-          u_int spec_id;
-          if (amp->properties == NULL)
-            continue;
-
-          spec_id = amp->properties->species_id;
-          if (vizblk->species_viz_states[spec_id] == EXCLUDE_OBJ)
-            continue;
-
-          if (!include_grid && (amp->flags & TYPE_MASK) != TYPE_VOL)
-            continue;
-
-          if (!include_volume && (amp->flags & TYPE_MASK) == TYPE_VOL)
-            continue;
-
-          if (counts[spec_id] < amp->properties->population)
-            (*viz_molpp)[spec_id][counts[spec_id]++] = amp;
-          else {
-            mcell_warn("Molecule count disagreement!\n"
-                       "  Species %s  population = %d  count = %d",
-                       amp->properties->sym->name, amp->properties->population,
-                       counts[spec_id]);
-          }
-        }
+    for (amp = first_storage_molecule(&walk, slp->store); amp != NULL;
+         amp = next_storage_molecule(&walk)) {
+      u_int spec_id;
+      if (amp->properties == NULL)
+        continue;
+
+      spec_id = amp->properties->species_id;
+      if (vizblk->species_viz_states[spec_id] == EXCLUDE_OBJ)
+        continue;
+
+      if (!include_grid && (amp->flags & TYPE_MASK) != TYPE_VOL)
+        continue;
+
+      if (!include_volume && (amp->flags & TYPE_MASK) == TYPE_VOL)
+        continue;
+
+      if (counts[spec_id] < amp->properties->population)
+        (*viz_molpp)[spec_id][counts[spec_id]++] = amp;
+      else {
+        mcell_warn("Molecule count disagreement!\n"
+                   "  Species %s  population = %d  count = %d",
+                   amp->properties->sym->name, amp->properties->population,
+                   counts[spec_id]);
       }
     }
+    end_storage_walk(&walk);
   }
 
   return 0;
@@ -325,14 +316,12 @@ static int output_ascii_molecules(struct volume *world,
   FILE *custom_file;
   char *cf_name;
   struct storage_list *slp;
-  struct schedule_helper *shp;
-  struct abstract_element *aep;
   struct abstract_molecule *amp;
   struct volume_molecule *mp;
   struct surface_molecule *gmp;
   short orient = 0;
 
-  int ndigits, i;
+  int ndigits;
   long long lli;
 
   struct vector3 where, norm;
@@ -365,57 +354,54 @@ static int output_ascii_molecules(struct volume *world,
     cf_name = NULL;
 
     for (slp = world->storage_head; slp != NULL; slp = slp->next) {
-      for (shp = slp->store->timer; shp != NULL; shp = shp->next_scale) {
-        for (i = -1; i < shp->buf_len; i++) {
-          for (aep = (i < 0) ? shp->current : shp->circ_buf_head[i];
-               aep != NULL; aep = aep->next) {
-            amp = (struct abstract_molecule *)aep;
-            if (amp->properties == NULL)
-              continue;
-
-            int id = vizblk->species_viz_states[amp->properties->species_id];
-            if (id == EXCLUDE_OBJ)
-              continue;
-
-            if ((amp->properties->flags & NOT_FREE) == 0) {
-              mp = (struct volume_molecule *)amp;
-              where.x = mp->pos.x;
-              where.y = mp->pos.y;
-              where.z = mp->pos.z;
-              norm.x = 0;
-              norm.y = 0;
-              norm.z = 0;
-            } else if ((amp->properties->flags & ON_GRID) != 0) {
-              gmp = (struct surface_molecule *)amp;
-              uv2xyz(&(gmp->s_pos), gmp->grid->surface, &where);
-              orient = gmp->orient;
-              norm.x = orient * gmp->grid->surface->normal.x;
-              norm.y = orient * gmp->grid->surface->normal.y;
-              norm.z = orient * gmp->grid->surface->normal.z;
-            } else
-              continue;
-
-            where.x *= world->length_unit;
-            where.y *= world->length_unit;
-            where.z *= world->length_unit;
-            /*
-                        fprintf(custom_file,"%d %15.8e %15.8e %15.8e
-               %2d\n",id,where.x,where.y,where.z,orient);
-            */
-            if (id == INCLUDE_OBJ) {
-              /* write name of molecule */
-              fprintf(custom_file, "%s %lu %.9g %.9g %.9g %.9g %.9g %.9g\n",
-                      amp->properties->sym->name, amp->id, where.x, where.y,
-                      where.z, norm.x, norm.y, norm.z);
-            } else {
-              /* write state value of molecule */
-              fprintf(custom_file, "%d %lu %.9g %.9g %.9g %.9g %.9g %.9g\n", id,
-                      amp->id, where.x, where.y, where.z, norm.x, norm.y,
-                      norm.z);
-            }
-          }
+      struct storage_walk walk;
+      for (amp = first_storage_molecule(&walk, slp->store); amp != NULL;
+           amp = next_storage_molecule(&walk)) {
+        if (amp->properties == NULL)
+          continue;
+
+        int id = vizblk->species_viz_states[amp->properties->species_id];
+        if (id == EXCLUDE_OBJ)
+          continue;
+
+        if ((amp->properties->flags & NOT_FREE) == 0) {
+          mp = (struct volume_molecule *)amp;
+          where.x = mp->pos.x;
+          where.y = mp->pos.y;
+          where.z = mp->pos.z;
+          norm.x = 0;
+          norm.y = 0;
+          norm.z = 0;
+        } else if ((amp->properties->flags & ON_GRID) != 0) {
+          gmp = (struct surface_molecule *)amp;
+          uv2xyz(&(gmp->s_pos), gmp->grid->surface, &where);
+          orient = gmp->orient;
+          norm.x = orient * gmp->grid->surface->normal.x;
+          norm.y = orient * gmp->grid->surface->normal.y;
+          norm.z = orient * gmp->grid->surface->normal.z;
+        } else
+          continue;
+
+        where.x *= world->length_unit;
+        where.y *= world->length_unit;
+        where.z *= world->length_unit;
+        /*
+                    fprintf(custom_file,"%d %15.8e %15.8e %15.8e
+           %2d\n",id,where.x,where.y,where.z,orient);
+        */
+        if (id == INCLUDE_OBJ) {
+          /* write name of molecule */
+          fprintf(custom_file, "%s %lu %.9g %.9g %.9g %.9g %.9g %.9g\n",
+                  amp->properties->sym->name, amp->id, where.x, where.y,
+                  where.z, norm.x, norm.y, norm.z);
+        } else {
+          /* write state value of molecule */
+          fprintf(custom_file, "%d %lu %.9g %.9g %.9g %.9g %.9g %.9g\n", id,
+                  amp->id, where.x, where.y, where.z, norm.x, norm.y,
+                  norm.z);
         }
       }
+      end_storage_walk(&walk);
     }
     fclose(custom_file);
   }
@@ -560,7 +546,7 @@ static int output_cellblender_molecules(struct volume *world,
           struct vector3 pos_output = {0.0, 0.0, 0.0};
           if (!convert_relative_to_abs_PBC_coords(
               world->periodic_box_obj,
-              mp->periodic_box,
+              &mp->periodic_box,
               world->periodic_traditional,
               &mp->pos,
               &pos_output)) {
@@ -581,7 +567,7 @@ static int output_cellblender_molecules(struct volume *world,
           struct vector3 pos_output = {0.0, 0.0, 0.0};
           if (!convert_relative_to_abs_PBC_coords(
               world->periodic_box_obj,
-              gmp->periodic_box,
+              &gmp->periodic_box,
               world->periodic_traditional,
               &where,
               &pos_output)) {
@@ -616,13 +602,13 @@ static int output_cellblender_molecules(struct volume *world,
           float norm_z = orient * gmp->grid->surface->normal.z;
 
           if (world->periodic_box_obj && !(world->periodic_traditional)) {
-            if (gmp->periodic_box->x % 2 != 0) {
+            if (gmp->periodic_box.x % 2 != 0) {
               norm_x *= -1;
             }
-            if (gmp->periodic_box->y % 2 != 0) {
+            if (gmp->periodic_box.y % 2 != 0) {
               norm_y *= -1;
             }
-            if (gmp->periodic_box->z % 2 != 0) {
+            if (gmp->periodic_box.z % 2 != 0) {
               norm_z *= -1;
             }
           }
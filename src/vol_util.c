@@ -33,12 +33,15 @@
 
 #include <assert.h>
 #include <math.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "diffuse.h"
 #include "vector.h"
+#include "thread_util.h"
 #include "logging.h"
 #include "rng.h"
 #include "mem_util.h"
@@ -51,6 +54,13 @@
 
 static int test_max_release(double num_to_release, char *name);
 
+static void unpack_molecule(struct volume_molecule *vm);
+
+static int filed_cell(struct mol_grid *grid, struct volume_molecule *vm);
+
+static void mol_grid_remove(struct mol_grid *grid, struct volume_molecule *vm,
+                            int c);
+
 static int check_release_probability(double release_prob, struct volume *state,
                                      struct release_event_queue *req,
                                      struct release_pattern *rpat);
@@ -383,6 +393,314 @@ int is_defunct_molecule(struct abstract_element *e) {
   return ((struct abstract_molecule *)e)->properties == NULL;
 }
 
+/*************************************************************************
+wake_storage:
+  In: world: simulation state
+      store: an idle storage
+  Out: No return value.  The storage's scheduler is brought up to the
+       storage time of the world, or created if it has none, and the
+       storage joins the list of active storages, which is kept in the
+       order of world->storage_head.
+  Note: Pool tasks only ever wake storages within their reach box, so only
+        the list itself needs the lock.
+*************************************************************************/
+static void wake_storage(struct volume *world, struct storage *store) {
+  if (store->timer == NULL) {
+    if (world->ladder_scheduler)
+      store->timer = create_ladder_scheduler(1.0, 100, world->storage_time);
+    else
+      store->timer =
+          create_scheduler(1.0, 100.0, 100, world->storage_time);
+    if (store->timer == NULL)
+      mcell_allocfailed("Failed to create molecule scheduler.");
+    store->current_time = world->storage_time;
+  }
+  schedule_skip(store->timer,
+                (long long)(world->storage_time - store->current_time));
+  store->current_time = world->storage_time;
+  store->active = 1;
+
+  thread_shared_lock(world);
+  struct storage **active = world->active_stores;
+  int lo = 0, hi = world->n_active_stores;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (active[mid]->index > store->index)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  memmove(&active[lo + 1], &active[lo],
+          (world->n_active_stores - lo) * sizeof(struct storage *));
+  active[lo] = store;
+  world->n_active_stores++;
+  thread_shared_unlock(world);
+}
+
+/*************************************************************************
+storage_schedule_add:
+  In: world: simulation state
+      store: the storage to schedule in
+      data: molecule to schedule
+  Out: 0 on success, 1 on memory allocation failure.  Like schedule_add on
+       the storage's scheduler, but wakes the storage first if it was idle.
+*************************************************************************/
+int storage_schedule_add(struct volume *world, struct storage *store,
+                         void *data) {
+  if (!store->active)
+    wake_storage(world, store);
+  return schedule_add(store->timer, data);
+}
+
+/*************************************************************************
+skip_dormant_time:
+  In: am: a dormant molecule
+      dt: how far the scheduler would have pushed it back
+  Out: No return value.  The time of the molecule is advanced by dt and,
+       like run_timestep does, moved onto an integer boundary it is within
+       EPS_C of.
+*************************************************************************/
+static void skip_dormant_time(struct abstract_molecule *am, double dt) {
+  am->t += dt;
+  double t = ceil(am->t) * (1.0 + 0.1 * EPS_C);
+  if (!distinguishable(t, am->t, EPS_C))
+    am->t = t;
+}
+
+/*************************************************************************
+storage_make_dormant:
+  In: store: the storage whose scheduler last held the molecule
+      am: a molecule that can neither move nor react by itself
+  Out: No return value.  Instead of being scheduled again, the molecule is
+       kept on the dormant list of the storage until it is woken by
+       wake_dormant_molecules.  It stays flagged IN_SCHEDULE, so it is not
+       freed while on the list.  Its time is still advanced to when the
+       scheduler would have looked at it again, MAX_UNI_TIMESKIP later if
+       it is inert or its lifetime t2 later if no unimolecular reaction
+       applies, so walks over the storage find it where the scheduler
+       would hold it.
+  Note: Only bimolecular partners can react with such a molecule, and they
+        find it through the subvolume and grid lists, not the scheduler.
+*************************************************************************/
+void storage_make_dormant(struct storage *store,
+                          struct abstract_molecule *am) {
+  skip_dormant_time(am, (am->t2 == 0) ? MAX_UNI_TIMESKIP : am->t2);
+  am->t2 = 0;
+  am->flags |= IN_SCHEDULE;
+  am->next = store->dormant;
+  store->dormant = am;
+}
+
+/*************************************************************************
+sweep_dormant_molecules:
+  In: store: a storage
+  Out: The number of defunct molecules taken off the dormant list of the
+       storage.  They are freed unless they are still on another list.
+*************************************************************************/
+int sweep_dormant_molecules(struct storage *store) {
+  struct abstract_molecule **amp = &store->dormant;
+  int n_removed = 0;
+
+  while (*amp != NULL) {
+    struct abstract_molecule *am = *amp;
+    if (am->properties != NULL) {
+      amp = &am->next;
+      continue;
+    }
+
+    *amp = am->next;
+    n_removed++;
+    if ((am->flags & IN_MASK) == IN_SCHEDULE) {
+      am->next = NULL;
+      mem_put(mem_birthplace(am), am);
+    } else
+      am->flags &= ~IN_SCHEDULE;
+  }
+  return n_removed;
+}
+
+/*************************************************************************
+wake_dormant_molecules:
+  In: world: simulation state
+      store: a storage
+  Out: No return value.  The dormant molecules of the storage are scheduled
+       again, no earlier than the current storage time, so that code
+       walking the schedulers for every molecule finds them.  Defunct ones
+       are dropped.
+*************************************************************************/
+void wake_dormant_molecules(struct volume *world, struct storage *store) {
+  struct abstract_molecule *am, *next;
+
+  sweep_dormant_molecules(store);
+  am = store->dormant;
+  store->dormant = NULL;
+  for (; am != NULL; am = next) {
+    next = am->next;
+    if (am->t < world->storage_time)
+      am->t = world->storage_time;
+    if (storage_schedule_add(world, store, am))
+      mcell_allocfailed("Failed to add a '%s' molecule to scheduler after "
+                        "waking it.",
+                        am->properties->sym->name);
+  }
+}
+
+/*************************************************************************
+wake_all_dormant_molecules:
+  In: world: simulation state
+  Out: No return value.  The dormant molecules of every storage are
+       scheduled again (see wake_dormant_molecules).
+*************************************************************************/
+void wake_all_dormant_molecules(struct volume *world) {
+  for (struct storage_list *sl = world->storage_head; sl != NULL;
+       sl = sl->next)
+    wake_dormant_molecules(world, sl->store);
+}
+
+/*************************************************************************
+set_walk_slot:
+  In: w: walk over the molecules of a storage
+  Out: No return value.  The walk is set to the start of the slot it is at.
+*************************************************************************/
+static void set_walk_slot(struct storage_walk *w) {
+  if (w->sh == NULL)
+    w->next = NULL;
+  else if (w->slot < 0)
+    w->next = w->sh->current;
+  else
+    w->next = w->sh->circ_buf_head[w->slot];
+
+  w->next_dormant = w->end_dormant = 0;
+  if (w->first != NULL && w->slot < w->n_slots) {
+    int key = w->depth * (w->n_slots + 1) + w->slot + 1;
+    w->next_dormant = w->first[key];
+    w->end_dormant = w->first[key + 1];
+  }
+}
+
+/*************************************************************************
+first_storage_molecule:
+  In: w: walk to set up
+      store: a storage
+  Out: The first molecule held for the storage, or NULL if there is none.
+       next_storage_molecule gives the others.  Scheduled molecules come
+       in scheduler order, and dormant ones where the scheduler would hold
+       them (see storage_make_dormant), so that walks over every molecule
+       do not depend on which ones are dormant.  Defunct molecules are
+       included.  A dormant molecule that the scheduler would have looked
+       at already has its time advanced by MAX_UNI_TIMESKIP, as its step
+       would have done.
+  Note: end_storage_walk must be called once the walk is over.
+*************************************************************************/
+struct abstract_molecule *first_storage_molecule(struct storage_walk *w,
+                                                 struct storage *store) {
+  struct schedule_helper *top = store->timer;
+  memset(w, 0, sizeof(struct storage_walk));
+  w->sh = top;
+  w->slot = -1;
+  w->n_slots = top->buf_len;
+  for (struct schedule_helper *sh = top; sh != NULL; sh = sh->next_scale)
+    w->n_depths++;
+
+  int n_dormant = 0;
+  for (struct abstract_molecule *am = store->dormant; am != NULL;
+       am = am->next)
+    n_dormant++;
+
+  if (n_dormant > 0) {
+    /* Group the dormant molecules by slot, keeping their order within each
+       slot, as the coarser scales of the scheduler push new items at the
+       front of a slot */
+    int *keys = CHECKED_MALLOC_ARRAY(int, n_dormant, "dormant molecule slots");
+    int i = 0;
+    int n_depths = w->n_depths;
+    for (struct abstract_molecule *am = store->dormant; am != NULL;
+         am = am->next, i++) {
+      int depth, slot;
+      if (top->ladder) {
+        /* Ladder queues keep no comparable order, so these go last */
+        depth = w->n_depths;
+        slot = -1;
+      } else {
+        while (am->properties != NULL && am->t < top->now)
+          skip_dormant_time(am, MAX_UNI_TIMESKIP);
+        schedule_locate(top, am->t, &depth, &slot);
+      }
+      keys[i] = depth * (w->n_slots + 1) + slot + 1;
+      if (depth >= n_depths)
+        n_depths = depth + 1;
+    }
+    w->n_depths = n_depths;
+
+    int n_keys = n_depths * (w->n_slots + 1);
+    w->first = CHECKED_MALLOC_ARRAY(int, n_keys + 1, "dormant slot index");
+    memset(w->first, 0, (n_keys + 1) * sizeof(int));
+    for (i = 0; i < n_dormant; i++)
+      w->first[keys[i] + 1]++;
+    for (i = 0; i < n_keys; i++)
+      w->first[i + 1] += w->first[i];
+
+    int *fill = CHECKED_MALLOC_ARRAY(int, n_keys, "dormant slot index");
+    memcpy(fill, w->first, n_keys * sizeof(int));
+    w->dormant = CHECKED_MALLOC_ARRAY(struct abstract_molecule *, n_dormant,
+                                      "dormant molecule walk");
+    i = 0;
+    for (struct abstract_molecule *am = store->dormant; am != NULL;
+         am = am->next, i++)
+      w->dormant[fill[keys[i]]++] = am;
+    free(fill);
+    free(keys);
+  }
+
+  set_walk_slot(w);
+  return next_storage_molecule(w);
+}
+
+/*************************************************************************
+next_storage_molecule:
+  In: w: walk set up by first_storage_molecule
+  Out: The next molecule held for the storage, or NULL at the end of the
+       walk.  In the first scale, whose slots are first in first out,
+       dormant molecules come after the scheduled ones of their slot, and
+       in coarser scales before them.
+*************************************************************************/
+struct abstract_molecule *next_storage_molecule(struct storage_walk *w) {
+  for (;;) {
+    if (w->depth > 0 && w->next_dormant < w->end_dormant)
+      return w->dormant[w->next_dormant++];
+    if (w->next != NULL) {
+      struct abstract_element *ae = w->next;
+      w->next = ae->next;
+      return (struct abstract_molecule *)ae;
+    }
+    if (w->next_dormant < w->end_dormant)
+      return w->dormant[w->next_dormant++];
+
+    /* On to the next slot */
+    int n_slots = (w->sh != NULL) ? w->sh->buf_len : w->n_slots;
+    if (++w->slot >= n_slots) {
+      if (++w->depth >= w->n_depths)
+        return NULL;
+      w->slot = -1;
+      if (w->sh != NULL)
+        w->sh = w->sh->next_scale;
+    }
+    set_walk_slot(w);
+  }
+}
+
+/*************************************************************************
+end_storage_walk:
+  In: w: walk set up by first_storage_molecule
+  Out: No return value.  Memory held by the walk is freed.
+*************************************************************************/
+void end_storage_walk(struct storage_walk *w) {
+  free(w->dormant);
+  free(w->first);
+  w->dormant = NULL;
+  w->first = NULL;
+}
+
 /*struct surface_molecule **/
 /*place_surface_molecule(struct volume *state, struct species *s,*/
 /*                       struct vector3 *loc, short orient, double search_diam,*/
@@ -415,20 +733,29 @@ struct wall* find_closest_wall(
       struct mesh_transparency *)pointer_hash_lookup(state->species_mesh_transp,
                                                      key, keyhash);
 
+  /* Only walls reaching into this box can be close enough */
+  double search_r = sqrt(search_d2);
+  struct vector3 search_llf = { loc->x - search_r, loc->y - search_r,
+                                loc->z - search_r };
+  struct vector3 search_urb = { loc->x + search_r, loc->y + search_r,
+                                loc->z + search_r };
+
   double best_d2 = search_d2 * 2 + 1;
   struct wall *best_w = NULL;
-  struct wall_list *wl;
-  for (wl = sv->wall_head; wl != NULL; wl = wl->next) {
+  struct wall_cursor cursor;
+  struct wall *w;
+  wall_cursor_box(&cursor, sv, &search_llf, &search_urb);
+  while ((w = wall_cursor_next(&cursor)) != NULL) {
     if (verify_wall_regions_match(
-        mesh_name, reg_names, wl->this_wall, regions_to_ignore, mesh_transp,
+        mesh_name, reg_names, w, regions_to_ignore, mesh_transp,
         species_name)) {
       continue; 
     }
 
-    d2 = closest_interior_point(loc, wl->this_wall, &s_loc, search_d2);
+    d2 = closest_interior_point(loc, w, &s_loc, search_d2);
     if (d2 <= search_d2 && d2 < best_d2) {
       best_d2 = d2;
-      best_w = wl->this_wall;
+      best_w = w;
       best_uv->u = s_loc.u;
       best_uv->v = s_loc.v;
     }
@@ -511,19 +838,19 @@ struct wall* find_closest_wall(
             if (this_sv == sv_index)
               continue;
 
-            for (wl = state->subvol[this_sv].wall_head; wl != NULL;
-                 wl = wl->next) {
+            wall_cursor_box(&cursor, &state->subvol[this_sv], &search_llf,
+                            &search_urb);
+            while ((w = wall_cursor_next(&cursor)) != NULL) {
               if (verify_wall_regions_match(
-                  mesh_name, reg_names, wl->this_wall, regions_to_ignore,
+                  mesh_name, reg_names, w, regions_to_ignore,
                   mesh_transp, species_name)) {
                 continue; 
               }
 
-              d2 =
-                  closest_interior_point(loc, wl->this_wall, &s_loc, search_d2);
+              d2 = closest_interior_point(loc, w, &s_loc, search_d2);
               if (d2 <= search_d2 && d2 < best_d2) {
                 best_d2 = d2;
-                best_w = wl->this_wall;
+                best_w = w;
                 best_uv->u = s_loc.u;
                 best_uv->v = s_loc.v;
               }
@@ -552,8 +879,7 @@ struct wall* find_closest_wall(
     *grid_index = uv2grid(best_uv, best_w->grid);
   } else {
     *grid_index = uv2grid(best_uv, best_w->grid);
-    struct surface_molecule_list *sm_list = best_w->grid->sm_list[*grid_index];
-    if (sm_list && sm_list->sm) {
+    if (tile_occupied(best_w->grid, *grid_index)) {
       // XXX: this isn't good enough. we should only return this if the PB of
       // sm isn't represented in the PB list.
       if (state->periodic_box_obj && !state->periodic_traditional) {
@@ -570,7 +896,7 @@ struct wall* find_closest_wall(
         }
 
         if (state->randomize_smol_pos)
-          grid2uv_random(best_w->grid, *grid_index, best_uv, state->rng);
+          grid2uv_random(best_w->grid, *grid_index, best_uv, local_rng(state));
         else
           grid2uv(best_w->grid, *grid_index, best_uv);
       }
@@ -624,7 +950,7 @@ place_surface_molecule(struct volume *state, struct species *s,
       return NULL;
     }
   }
-  struct surface_molecule_list *sm_list = best_w->grid->sm_list[grid_index];
+  struct surface_molecule_list *sm_list = tile_sm_list(best_w->grid, grid_index);
   if (state->periodic_box_obj && periodicbox_in_surfmol_list(periodic_box, sm_list)) {
     return NULL;
   }
@@ -635,19 +961,15 @@ place_surface_molecule(struct volume *state, struct species *s,
 
   struct surface_molecule *sm;
   sm = CHECKED_MEM_GET(sv->local_storage->smol, "surface molecule");
-  sm->mesh_name = NULL;
-  sm->birthplace = sv->local_storage->smol;
   sm->birthday = convert_iterations_to_seconds(
       state->start_iterations, state->time_unit,
       state->simulation_start_seconds, t);
-  sm->id = state->current_mol_id++;
+  sm->id = next_molecule_id(state);
   sm->properties = s;
   s->population++;
-  sm->periodic_box = CHECKED_MALLOC_STRUCT(struct periodic_image,
-    "periodic image descriptor");
-  sm->periodic_box->x = periodic_box->x;
-  sm->periodic_box->y = periodic_box->y;
-  sm->periodic_box->z = periodic_box->z;
+  sm->periodic_box.x = periodic_box->x;
+  sm->periodic_box.y = periodic_box->y;
+  sm->periodic_box.z = periodic_box->z;
 
   sm->flags = TYPE_SURF | ACT_NEWBIE | IN_SCHEDULE;
   if (s->space_step > 0)
@@ -669,9 +991,10 @@ place_surface_molecule(struct volume *state, struct species *s,
   if (sm_list == NULL) {
     return NULL; 
   }
-  sm->grid->sm_list[sm->grid_index] = sm_list;
+  *tile_sm_slot(sm->grid, sm->grid_index) = sm_list;
+  update_tile_occupancy(sm->grid, sm->grid_index);
   
-  sm->grid->n_occupied++;
+  THREADED_ADD(sm->grid->n_occupied, 1);
   sm->flags |= IN_SURFACE;
 
   if ((s->flags & COUNT_ENCLOSED) != 0)
@@ -708,16 +1031,16 @@ insert_surface_molecule(struct volume *state, struct species *s,
     return NULL;
 
   if (periodic_box != NULL) {
-    sm->periodic_box->x = periodic_box->x;
-    sm->periodic_box->y = periodic_box->y;
-    sm->periodic_box->z = periodic_box->z;
+    sm->periodic_box.x = periodic_box->x;
+    sm->periodic_box.y = periodic_box->y;
+    sm->periodic_box.z = periodic_box->z;
   }
 
   if (sm->properties->flags & (COUNT_CONTENTS | COUNT_ENCLOSED))
     count_region_from_scratch(state, (struct abstract_molecule *)sm, NULL, 1,
                               NULL, sm->grid->surface, sm->t, NULL);
 
-  if (schedule_add(sv->local_storage->timer, sm))
+  if (storage_schedule_add(state, sv->local_storage, sm))
     mcell_allocfailed("Failed to add surface molecule to scheduler.");
 
   return sm;
@@ -762,58 +1085,34 @@ struct volume_molecule *insert_volume_molecule(
   struct volume_molecule *new_vm;
   new_vm = CHECKED_MEM_GET(sv->local_storage->mol, "volume molecule");
   memcpy(new_vm, vm, sizeof(struct volume_molecule));
-  new_vm->mesh_name = NULL;
-  new_vm->birthplace = sv->local_storage->mol;
-  new_vm->id = state->current_mol_id++;
-  new_vm->prev_v = NULL;
-  new_vm->next_v = NULL;
+  new_vm->id = next_molecule_id(state);
   new_vm->next = NULL;
   new_vm->subvol = sv;
   ht_add_molecule_to_list(&sv->mol_by_species, new_vm);
   sv->mol_count++;
   new_vm->properties->population++;
-  new_vm->periodic_box = CHECKED_MALLOC_STRUCT(struct periodic_image,
-    "periodic image descriptor");
-  new_vm->periodic_box->x = vm->periodic_box->x;
-  new_vm->periodic_box->y = vm->periodic_box->y;
-  new_vm->periodic_box->z = vm->periodic_box->z;
 
   if ((new_vm->properties->flags & COUNT_SOME_MASK) != 0)
     new_vm->flags |= COUNT_ME;
   if (new_vm->properties->flags & (COUNT_CONTENTS | COUNT_ENCLOSED)) {
     count_region_from_scratch(state, (struct abstract_molecule *)new_vm, NULL,
                               1, &(new_vm->pos), NULL, new_vm->t,
-                              new_vm->periodic_box);
+                              &new_vm->periodic_box);
   }
 
-  if (schedule_add(sv->local_storage->timer, new_vm))
+  if (storage_schedule_add(state, sv->local_storage, new_vm))
     mcell_allocfailed("Failed to add volume molecule to scheduler.");
   return new_vm;
 }
 
 static int remove_from_list(struct volume_molecule *it) {
-  if (it->prev_v) {
-#ifdef DEBUG_LIST_CHECKS
-    if (*it->prev_v != it) {
-      mcell_error_nodie("Stale previous pointer!");
-    }
-#endif
-    *(it->prev_v) = it->next_v;
-  } else {
-#ifdef DEBUG_LIST_CHECKS
-    mcell_error_nodie("No previous pointer.");
-#endif
-  }
-  if (it->next_v) {
+  if (it->species_list != NULL)
+    unpack_molecule(it);
+  else {
 #ifdef DEBUG_LIST_CHECKS
-    if (it->next_v->prev_v != &it->next_v) {
-      mcell_error_nodie("Stale next pointer!");
-    }
+    mcell_error_nodie("Molecule is in no species list.");
 #endif
-    it->next_v->prev_v = it->prev_v;
   }
-  it->prev_v = NULL;
-  it->next_v = NULL;
   return 1;
 }
 
@@ -841,10 +1140,6 @@ struct volume_molecule *migrate_volume_molecule(struct volume_molecule *vm,
 
   new_vm = CHECKED_MEM_GET(new_sv->local_storage->mol, "volume molecule");
   memcpy(new_vm, vm, sizeof(struct volume_molecule));
-  new_vm->birthplace = new_sv->local_storage->mol;
-  new_vm->mesh_name = NULL;
-  new_vm->prev_v = NULL;
-  new_vm->next_v = NULL;
   new_vm->next = NULL;
   new_vm->subvol = new_sv;
 
@@ -965,6 +1260,11 @@ static int vacuum_inside_regions(struct volume *state,
   struct vector3 *origin;
   struct wall_list *wl;
 
+  /* The molecules to choose from may live on any process */
+  if (state->domain != NULL)
+    mcell_error("Releases removing molecules are not supported in runs "
+                "distributed over several processes.");
+
   rrd = rso->region_data;
   mh = create_mem(sizeof(struct void_list), 1024);
   if (mh == NULL)
@@ -992,7 +1292,8 @@ static int vacuum_inside_regions(struct volume *state,
                 &sv->mol_by_species, vm->properties, vm->properties->hashval);
 
         if (psl != NULL) {
-          for (mp = psl->head; mp != NULL; mp = mp->next_v) {
+          for (int i = psl->n_packed - 1; i >= 0; i--) {
+            mp = psl->packed[i];
             extra_in = extra_out = NULL;
             wp = &(state->waypoints[this_sv]);
             origin = &(wp->loc);
@@ -1003,9 +1304,9 @@ static int vacuum_inside_regions(struct volume *state,
             for (wl = sv->wall_head; wl != NULL; wl = wl->next) {
               int hitcode = collide_wall(origin, &delta, wl->this_wall, &t,
                                          &hit, 0, state->rng, state->notify,
-                                         &(state->ray_polygon_tests));
+                                         &local_stats(state)->ray_polygon_tests);
               if (hitcode != COLLIDE_MISS) {
-                state->ray_polygon_colls++;
+                local_stats(state)->ray_polygon_colls++;
 
                 for (rl = wl->this_wall->counting_regions; rl != NULL;
                      rl = rl->next) {
@@ -1119,10 +1420,11 @@ static int is_point_inside_region(struct volume *state,
     double hit_time;
     int hit_check =
         collide_wall(origin, &delta, wl->this_wall, &hit_time, &hit_pos, 0,
-                     state->rng, state->notify, &(state->ray_polygon_tests));
+                     state->rng, state->notify,
+                     &local_stats(state)->ray_polygon_tests);
 
     if (hit_check != COLLIDE_MISS) {
-      state->ray_polygon_colls++;
+      local_stats(state)->ray_polygon_colls++;
 
       if ((hit_time > -EPS_C && hit_time < EPS_C) ||
           (hit_time > 1.0 - EPS_C && hit_time < 1.0 + EPS_C)) {
@@ -1228,9 +1530,9 @@ static int release_inside_regions(struct volume *state,
 
     /* Actually place the molecule */
     vm->subvol = sv;
-    vm->periodic_box->x = rso->periodic_box->x;
-    vm->periodic_box->y = rso->periodic_box->y;
-    vm->periodic_box->z = rso->periodic_box->z;
+    vm->periodic_box.x = rso->periodic_box->x;
+    vm->periodic_box.y = rso->periodic_box->y;
+    vm->periodic_box.z = rso->periodic_box->z;
     new_vm = insert_volume_molecule(state, vm, new_vm);
     if (new_vm == NULL)
       return 1;
@@ -1284,18 +1586,13 @@ int release_molecules(struct volume *state, struct release_event_queue *req) {
   }
 
   // Set molecule characteristics.
-  vm.mesh_name = NULL;
   vm.t = req->event_time;
   vm.properties = rso->mol_type;
   vm.t2 = 0.0;
   vm.birthday = convert_iterations_to_seconds(
       state->start_iterations, state->time_unit,
       state->simulation_start_seconds, vm.t);
-  struct periodic_image periodic_box = { .x = rso->periodic_box->x,
-                                         .y = rso->periodic_box->y,
-                                         .z = rso->periodic_box->z
-                                       };
-  vm.periodic_box = &periodic_box;
+  vm.periodic_box = *rso->periodic_box;
 
   struct abstract_molecule *ap = (struct abstract_molecule *)(&vm);
 
@@ -1366,9 +1663,9 @@ int release_molecules(struct volume *state, struct release_event_queue *req) {
         vm_guess = insert_volume_molecule(state, &vm, vm_guess);
         if (vm_guess == NULL)
           return 1;
-        vm.periodic_box->x = rso->periodic_box->x;
-        vm.periodic_box->y = rso->periodic_box->y;
-        vm.periodic_box->z = rso->periodic_box->z;
+        vm.periodic_box.x = rso->periodic_box->x;
+        vm.periodic_box.y = rso->periodic_box->y;
+        vm.periodic_box.z = rso->periodic_box->z;
       }
       if (state->notify->release_events == NOTIFY_FULL) {
         mcell_log("Released %d %s from \"%s\" at iteration %lld.", number,
@@ -1461,9 +1758,9 @@ int release_ellipsoid_or_rectcuboid(struct volume *state,
     vm->pos.z = location[0][2];
     struct volume_molecule *guess = NULL;
     /* Insert copy of vm into state */
-    vm->periodic_box->x = rso->periodic_box->x;
-    vm->periodic_box->y = rso->periodic_box->y;
-    vm->periodic_box->z = rso->periodic_box->z;
+    vm->periodic_box.x = rso->periodic_box->x;
+    vm->periodic_box.y = rso->periodic_box->y;
+    vm->periodic_box.z = rso->periodic_box->z;
     guess = insert_volume_molecule(state, vm, guess); 
     if (guess == NULL)
       return 1;
@@ -1522,9 +1819,9 @@ int release_by_list(struct volume *state, struct release_event_queue *req,
       i++;
       if (vm_guess == NULL)
         return 1;
-      vm_guess->periodic_box->x = rso->periodic_box->x;
-      vm_guess->periodic_box->y = rso->periodic_box->y;
-      vm_guess->periodic_box->z = rso->periodic_box->z;
+      vm_guess->periodic_box.x = rso->periodic_box->x;
+      vm_guess->periodic_box.y = rso->periodic_box->y;
+      vm_guess->periodic_box.z = rso->periodic_box->z;
       i++;
     } else {
       double diam;
@@ -2069,44 +2366,359 @@ void path_bounding_box(struct vector3 *loc, struct vector3 *displacement,
 }
 
 /***************************************************************************
- collect_molecule:
-    Perform garbage collection on a discarded molecule.  If the molecule is no
-    longer in any lists, it will be freed.
+ grow_packed_molecules:
+    Double the room in the packed arrays of a per-species list, moving them
+    out of the list itself.
 
- In: vm: the molecule
- Out: Nothing.  Molecule is unlinked from its list in the subvolume, and
-      possibly returned to its birthplace.
+ In: list: the per-species list
+ Out: Nothing.
 ***************************************************************************/
-void collect_molecule(struct volume_molecule *vm) {
-  /* Unlink from the previous item */
-  if (vm->prev_v != NULL) {
-#ifdef DEBUG_LIST_CHECKS
-    if (*vm->prev_v != vm) {
-      mcell_error_nodie("Stale previous pointer!  ACK!  THRBBPPPPT!");
-    }
+static void grow_packed_molecules(struct per_species_list *list) {
+  int n = list->n_packed;
+  int max = 2 * list->max_packed;
+  struct volume_molecule **packed = (struct volume_molecule **)CHECKED_MALLOC(
+      max * PACKED_SLOT_SIZE, "packed per-species molecule list");
+  memcpy(packed, list->packed, n * sizeof(struct volume_molecule *));
+#ifdef MCELL_COMPACT_MOLECULES
+  int *cells = (int *)(packed + max);
+  memcpy(cells, list->packed_cell, n * sizeof(int));
+  list->packed_cell = cells;
+#else
+  struct vector3 *pos = (struct vector3 *)(packed + max);
+  memcpy(pos, list->packed_pos, n * sizeof(struct vector3));
+  list->packed_pos = pos;
 #endif
-    *(vm->prev_v) = vm->next_v;
+  if (list->max_packed > MIN_PACKED_MOLECULES)
+    free(list->packed);
+  list->packed = packed;
+  list->max_packed = max;
+}
+
+/***************************************************************************
+ unpack_molecule:
+    Remove a molecule from the packed arrays of its per-species list, moving
+    the last molecule of the arrays into its slot, and from the molecule
+    grid of its subvolume.
+
+ In: vm: the molecule, still in its per-species list
+ Out: Nothing.  The molecule's species_list is cleared.
+***************************************************************************/
+static void unpack_molecule(struct volume_molecule *vm) {
+  struct per_species_list *list = vm->species_list;
+  struct mol_grid *grid = vm->subvol->mol_grid;
+  if (grid != NULL)
+    mol_grid_remove(grid, vm, filed_cell(grid, vm));
+
+  int i = vm->packed_index;
+  int last = --list->n_packed;
+  if (i != last) {
+    struct volume_molecule *moved = list->packed[last];
+    list->packed[i] = moved;
+#ifdef MCELL_COMPACT_MOLECULES
+    list->packed_cell[i] = list->packed_cell[last];
+#else
+    list->packed_pos[i] = list->packed_pos[last];
+#endif
+    moved->packed_index = i;
   }
+  vm->species_list = NULL;
+}
 
-  /* Unlink from the following item */
-  if (vm->next_v != NULL) {
-#ifdef DEBUG_LIST_CHECKS
-    if (vm->next_v->prev_v != &vm->next_v) {
-      mcell_error_nodie("Stale next pointer!  ACK!  THRBBPPPPT!");
-    }
+/***************************************************************************
+ mol_grid_cell_of:
+    Find the cell of a molecule grid holding a point.  Points outside the
+    grid belong to the nearest cell.
+
+ In: grid: the molecule grid
+     pos: the point
+ Out: The index of the cell.
+***************************************************************************/
+static int mol_grid_axis_cell(double p, double llf, double scale, int n) {
+  double f = (p - llf) * scale;
+  if (!(f > 0.0))
+    return 0;
+  if (f >= n)
+    return n - 1;
+  return (int)f;
+}
+
+static int mol_grid_cell_of(struct mol_grid *grid,
+                            struct vector3 const *pos) {
+  int ix = mol_grid_axis_cell(pos->x, grid->llf.x, grid->cell_scale.x,
+                              grid->nx);
+  int iy = mol_grid_axis_cell(pos->y, grid->llf.y, grid->cell_scale.y,
+                              grid->ny);
+  int iz = mol_grid_axis_cell(pos->z, grid->llf.z, grid->cell_scale.z,
+                              grid->nz);
+  return iz + grid->nz * (iy + grid->ny * ix);
+}
+
+/***************************************************************************
+ filed_cell:
+    Find the cell of a molecule grid a molecule was filed in.  Compact
+    builds note it in the packed arrays; otherwise it is the cell of the
+    copy of its position there, which is only updated together with the
+    grid.
+
+ In: grid: the molecule grid of the molecule's subvolume
+     vm: the molecule, in its per-species list
+ Out: The index of the cell.
+***************************************************************************/
+static int filed_cell(struct mol_grid *grid, struct volume_molecule *vm) {
+#ifdef MCELL_COMPACT_MOLECULES
+  UNUSED(grid);
+  return vm->species_list->packed_cell[vm->packed_index];
+#else
+  return mol_grid_cell_of(grid, PACKED_POS(vm->species_list, vm->packed_index));
+#endif
+}
+
+/***************************************************************************
+ filed_index:
+    Find the slot of a molecule in its cell of a molecule grid.  Cells are
+    about one diffusion step wide and hold few molecules, so a search is
+    cheaper than a slot index in every molecule.
+
+ In: cell: the cell the molecule was filed in
+     vm: the molecule
+ Out: The index of the slot.
+***************************************************************************/
+static int filed_index(struct mol_cell *cell, struct volume_molecule *vm) {
+  int i = 0;
+  while (cell->mols[i] != vm)
+    i++;
+  return i;
+}
+
+/***************************************************************************
+ mol_grid_add:
+    Append a molecule to the cell of a molecule grid holding a position.
+
+ In: grid: the molecule grid
+     vm: the molecule
+     pos: where to file the molecule (its position, or its packed copy)
+ Out: Nothing.
+***************************************************************************/
+static void mol_grid_add(struct mol_grid *grid, struct volume_molecule *vm,
+                         struct vector3 *pos) {
+  int c = mol_grid_cell_of(grid, pos);
+  struct mol_cell *cell = &grid->cells[c];
+  if (cell->n_mols == cell->max_mols) {
+    int max = (cell->max_mols > 0) ? 2 * cell->max_mols : MIN_PACKED_MOLECULES;
+    struct volume_molecule **mols = (struct volume_molecule **)CHECKED_MALLOC(
+        max * CELL_SLOT_SIZE, "molecule grid cell");
+    if (cell->n_mols > 0)
+      memcpy(mols, cell->mols,
+             cell->n_mols * sizeof(struct volume_molecule *));
+#ifndef MCELL_COMPACT_MOLECULES
+    struct vector3 *cell_pos = (struct vector3 *)(mols + max);
+    if (cell->n_mols > 0)
+      memcpy(cell_pos, cell->pos, cell->n_mols * sizeof(struct vector3));
+    cell->pos = cell_pos;
+#endif
+    free(cell->mols);
+    cell->mols = mols;
+    cell->max_mols = max;
+  }
+
+  int i = cell->n_mols++;
+  cell->mols[i] = vm;
+#ifdef MCELL_COMPACT_MOLECULES
+  vm->species_list->packed_cell[vm->packed_index] = c;
+#else
+  cell->pos[i] = *pos;
+#endif
+}
+
+/***************************************************************************
+ mol_grid_remove:
+    Remove a molecule from its cell of a molecule grid, moving the last
+    molecule of the cell into its slot.
+
+ In: grid: the molecule grid
+     vm: the molecule
+     c: the cell it was filed in
+ Out: Nothing.
+***************************************************************************/
+static void mol_grid_remove(struct mol_grid *grid, struct volume_molecule *vm,
+                            int c) {
+  struct mol_cell *cell = &grid->cells[c];
+  int i = filed_index(cell, vm);
+  int last = --cell->n_mols;
+  if (i != last) {
+    struct volume_molecule *moved = cell->mols[last];
+    cell->mols[i] = moved;
+#ifndef MCELL_COMPACT_MOLECULES
+    cell->pos[i] = cell->pos[last];
 #endif
-    vm->next_v->prev_v = vm->prev_v;
   }
+}
+
+/***************************************************************************
+ build_mol_grid:
+    Bin the volume molecules of a subvolume into a molecule grid, if the
+    subvolume is large enough to hold several cells.  From then on the grid
+    is kept up to date along with the per-species lists.
+
+ In: world: simulation state
+     sv: the subvolume, without a grid yet
+ Out: Nothing.  sv->mol_grid is set if a grid was built.
+***************************************************************************/
+void build_mol_grid(struct volume *world, struct subvolume *sv) {
+  if (world->mol_grid_cell <= 0.0)
+    return;
 
-  /* Clear our next/prev pointers */
-  vm->prev_v = NULL;
-  vm->next_v = NULL;
+  struct vector3 llf, urb;
+  llf.x = world->x_fineparts[sv->llf.x];
+  llf.y = world->y_fineparts[sv->llf.y];
+  llf.z = world->z_fineparts[sv->llf.z];
+  urb.x = world->x_fineparts[sv->urb.x];
+  urb.y = world->y_fineparts[sv->urb.y];
+  urb.z = world->z_fineparts[sv->urb.z];
+
+  /* Cells about mol_grid_cell wide, fewer if there would be too many */
+  double fx = min2d((urb.x - llf.x) / world->mol_grid_cell, MOL_GRID_MAX_CELLS);
+  double fy = min2d((urb.y - llf.y) / world->mol_grid_cell, MOL_GRID_MAX_CELLS);
+  double fz = min2d((urb.z - llf.z) / world->mol_grid_cell, MOL_GRID_MAX_CELLS);
+  fx = max2d(fx, 1.0);
+  fy = max2d(fy, 1.0);
+  fz = max2d(fz, 1.0);
+  if (fx * fy * fz > MOL_GRID_MAX_CELLS) {
+    double shrink = cbrt(MOL_GRID_MAX_CELLS / (fx * fy * fz));
+    fx = max2d(fx * shrink, 1.0);
+    fy = max2d(fy * shrink, 1.0);
+    fz = max2d(fz * shrink, 1.0);
+  }
+  int nx = (int)fx, ny = (int)fy, nz = (int)fz;
+  if (nx * ny * nz < 8)
+    return;
+
+  struct mol_grid *grid =
+      CHECKED_MALLOC_STRUCT(struct mol_grid, "molecule grid");
+  grid->nx = nx;
+  grid->ny = ny;
+  grid->nz = nz;
+  grid->llf = llf;
+  grid->cell_scale.x = nx / (urb.x - llf.x);
+  grid->cell_scale.y = ny / (urb.y - llf.y);
+  grid->cell_scale.z = nz / (urb.z - llf.z);
+  grid->cells = CHECKED_MALLOC_ARRAY(struct mol_cell, nx * ny * nz,
+                                     "molecule grid cells");
+  memset(grid->cells, 0, nx * ny * nz * sizeof(struct mol_cell));
+
+  for (struct per_species_list *psl = sv->species_head; psl != NULL;
+       psl = psl->next) {
+    for (int j = 0; j < psl->n_packed; j++)
+      mol_grid_add(grid, psl->packed[j], PACKED_POS(psl, j));
+  }
+  sv->mol_grid = grid;
+}
+
+/***************************************************************************
+ destroy_mol_grid:
+    Free the molecule grid of a subvolume, if it has one.
+
+ In: sv: the subvolume
+ Out: Nothing.
+***************************************************************************/
+void destroy_mol_grid(struct subvolume *sv) {
+  struct mol_grid *grid = sv->mol_grid;
+  if (grid == NULL)
+    return;
+  for (int c = 0; c < grid->nx * grid->ny * grid->nz; c++)
+    free(grid->cells[c].mols);
+  free(grid->cells);
+  free(grid);
+  sv->mol_grid = NULL;
+}
+
+static int compare_mol_grid_hits(void const *a, void const *b) {
+  struct mol_grid_hit const *ha = (struct mol_grid_hit const *)a;
+  struct mol_grid_hit const *hb = (struct mol_grid_hit const *)b;
+  if (ha->rank != hb->rank)
+    return ha->rank - hb->rank;
+  return ha->index - hb->index;
+}
+
+/***************************************************************************
+ find_grid_partners:
+    Look up the molecules of a subvolume inside a box, through its molecule
+    grid.  Only molecules of species lists with a scan_rank are wanted.
+
+ In: sv: the subvolume, which has a molecule grid
+     llf, urb: corners of the box
+     self: molecule to leave out, or NULL
+     found: array to fill in
+     max_found: room in the array
+ Out: The number of molecules found, or -1 if there are more than
+      max_found.  They are sorted by the scan_rank of their species list and
+      then by packed_index, the order of a scan of the packed arrays.
+***************************************************************************/
+int find_grid_partners(struct subvolume *sv, struct vector3 *llf,
+                       struct vector3 *urb, struct volume_molecule *self,
+                       struct mol_grid_hit *found, int max_found) {
+  struct mol_grid *grid = sv->mol_grid;
+  int x0 = mol_grid_axis_cell(llf->x, grid->llf.x, grid->cell_scale.x,
+                              grid->nx);
+  int x1 = mol_grid_axis_cell(urb->x, grid->llf.x, grid->cell_scale.x,
+                              grid->nx);
+  int y0 = mol_grid_axis_cell(llf->y, grid->llf.y, grid->cell_scale.y,
+                              grid->ny);
+  int y1 = mol_grid_axis_cell(urb->y, grid->llf.y, grid->cell_scale.y,
+                              grid->ny);
+  int z0 = mol_grid_axis_cell(llf->z, grid->llf.z, grid->cell_scale.z,
+                              grid->nz);
+  int z1 = mol_grid_axis_cell(urb->z, grid->llf.z, grid->cell_scale.z,
+                              grid->nz);
+
+  int n_found = 0;
+  for (int ix = x0; ix <= x1; ix++) {
+    for (int iy = y0; iy <= y1; iy++) {
+      struct mol_cell *cell = &grid->cells[z0 + grid->nz * (iy + grid->ny * ix)];
+      for (int iz = z0; iz <= z1; iz++, cell++) {
+        for (int i = 0; i < cell->n_mols; i++) {
+          struct vector3 const *p = MOL_CELL_POS(cell, i);
+          if (p->x < llf->x || p->x > urb->x || p->y < llf->y ||
+              p->y > urb->y || p->z < llf->z || p->z > urb->z)
+            continue;
+          struct volume_molecule *mp = cell->mols[i];
+          if (mp == self || mp->species_list->scan_rank < 0)
+            continue;
+          if (n_found == max_found)
+            return -1;
+          found[n_found].rank = mp->species_list->scan_rank;
+          found[n_found].index = mp->packed_index;
+          found[n_found].mp = mp;
+          n_found++;
+        }
+      }
+    }
+  }
+
+  if (n_found > 1)
+    qsort(found, n_found, sizeof(struct mol_grid_hit), compare_mol_grid_hits);
+  return n_found;
+}
+
+/***************************************************************************
+ collect_molecule:
+    Perform garbage collection on a discarded molecule.  If the molecule is no
+    longer in any lists, it will be freed.
+
+ In: vm: the molecule
+ Out: Nothing.  Molecule is unlinked from its list in the subvolume, and
+      possibly returned to its pool.
+***************************************************************************/
+void collect_molecule(struct volume_molecule *vm) {
+  /* Take it out of its species list */
+  if (vm->species_list != NULL)
+    unpack_molecule(vm);
 
   /* Dispose of the molecule */
   vm->properties = NULL;
   vm->flags &= ~IN_VOLUME;
   if ((vm->flags & IN_MASK) == 0)
-    mem_put(vm->birthplace, vm);
+    mem_put(mem_birthplace(vm), vm);
 }
 
 /***************************************************************************
@@ -2139,7 +2751,15 @@ void ht_add_molecule_to_list(struct pointer_hash *h,
     list = (struct per_species_list *)CHECKED_MEM_GET(
         vm->subvol->local_storage->pslv, "per-species molecule list");
     list->properties = vm->properties;
-    list->head = NULL;
+    list->n_packed = 0;
+    list->max_packed = MIN_PACKED_MOLECULES;
+    list->packed = list->small_packed;
+#ifdef MCELL_COMPACT_MOLECULES
+    list->packed_cell = list->small_cell;
+#else
+    list->packed_pos = list->small_pos;
+#endif
+    list->scan_rank = -1;
     if (pointer_hash_add(h, vm->properties, vm->properties->hashval, list))
       mcell_allocfailed("Failed to add species to subvolume species table.");
 
@@ -2147,12 +2767,67 @@ void ht_add_molecule_to_list(struct pointer_hash *h,
     vm->subvol->species_head = list;
   }
 
-  /* Link the molecule into the list */
-  vm->next_v = list->head;
-  if (list->head)
-    list->head->prev_v = &vm->next_v;
-  vm->prev_v = &list->head;
-  list->head = vm;
+  /* Append the molecule to the packed arrays of the list */
+  if (list->n_packed == list->max_packed)
+    grow_packed_molecules(list);
+  int i = list->n_packed++;
+  list->packed[i] = vm;
+#ifndef MCELL_COMPACT_MOLECULES
+  list->packed_pos[i] = vm->pos;
+#endif
+  vm->species_list = list;
+  vm->packed_index = i;
+
+  /* ... and to the molecule grid */
+  if (vm->subvol->mol_grid != NULL)
+    mol_grid_add(vm->subvol->mol_grid, vm, &vm->pos);
+}
+
+/***************************************************************************
+ ht_update_molecule_position:
+    Copy the position of a molecule which moved within its subvolume to the
+    packed arrays of its per-species list, and move it to its new cell of
+    the molecule grid.  Molecules moving to another subvolume are taken care
+    of by migrate_volume_molecule.
+
+ In: vm: the molecule, linked into its subvolume's molecule lists
+ Out: Nothing.
+***************************************************************************/
+void ht_update_molecule_position(struct volume_molecule *vm) {
+  struct mol_grid *grid = vm->subvol->mol_grid;
+  if (grid != NULL) {
+    int c = filed_cell(grid, vm);
+    if (mol_grid_cell_of(grid, &vm->pos) != c) {
+      mol_grid_remove(grid, vm, c);
+      mol_grid_add(grid, vm, &vm->pos);
+    }
+#ifndef MCELL_COMPACT_MOLECULES
+    else {
+      struct mol_cell *cell = &grid->cells[c];
+      cell->pos[filed_index(cell, vm)] = vm->pos;
+    }
+#endif
+  }
+
+#ifndef MCELL_COMPACT_MOLECULES
+  vm->species_list->packed_pos[vm->packed_index] = vm->pos;
+#endif
+}
+
+/***************************************************************************
+ free_species_list:
+    Dispose of an empty per-species list which has already been unlinked
+    from its subvolume's list of species.
+
+ In: sv: the subvolume
+     psl: the species list
+ Out: Nothing.
+***************************************************************************/
+void free_species_list(struct subvolume *sv, struct per_species_list *psl) {
+  ht_remove(&sv->mol_by_species, psl);
+  if (psl->max_packed > MIN_PACKED_MOLECULES)
+    free(psl->packed);
+  mem_put(sv->local_storage->pslv, psl);
 }
 
 /***************************************************************************
@@ -2541,7 +3216,7 @@ struct surface_molecule_list* add_surfmol_with_unique_pb_to_list(
   else {
     for (; sm_list != NULL; sm_list = sm_list->next) {
       if (sm && periodic_boxes_are_identical(
-          sm_list->sm->periodic_box, sm->periodic_box)) {
+          &sm_list->sm->periodic_box, &sm->periodic_box)) {
         free(sm_entry);
         return NULL;
       }
@@ -2593,3 +3268,406 @@ void remove_surfmol_from_list(
   }
   return;
 }
+
+/* A molecule on one of the scheduler lists of a storage being reordered */
+struct sched_entry {
+  uint64_t key;                 /* Place along the space-filling curve */
+  struct abstract_molecule *am; /* Where the molecule is stored */
+  int list;                     /* Which scheduler list it is on... */
+  int rank;                     /* ...and where on that list */
+};
+
+/* The head and tail pointers of one scheduler list */
+struct sched_list {
+  struct abstract_element **head;
+  struct abstract_element **tail;
+};
+
+/*************************************************************************
+spread_bits_3d:
+  In: v: a number below 2^21
+  Out: v with two zero bits inserted after each of its bits, so that three
+       such numbers can be interleaved into a Morton code
+*************************************************************************/
+static uint64_t spread_bits_3d(uint64_t v) {
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffffULL;
+  v = (v | v << 16) & 0x1f0000ff0000ffULL;
+  v = (v | v << 8) & 0x100f00f00f00f00fULL;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+  v = (v | v << 2) & 0x1249249249249249ULL;
+  return v;
+}
+
+/*************************************************************************
+can_reorder:
+  In: am: a scheduled molecule
+  Out: 1 if the molecule is alive and may be moved to another address,
+       0 if it is defunct and waits for the scheduler to dispose of it
+*************************************************************************/
+static int can_reorder(struct abstract_molecule *am) {
+  if (am->properties == NULL)
+    return 0;
+  if (am->flags & TYPE_VOL)
+    return 1;
+  return ((struct surface_molecule *)am)->grid != NULL;
+}
+
+/*************************************************************************
+reorder_position:
+  In: am: a molecule that can_reorder
+      pos: place to store its position
+      sv: place to store its subvolume
+  Out: No return value.  The position and subvolume are stored.
+*************************************************************************/
+static void reorder_position(struct abstract_molecule *am,
+                             struct vector3 *pos, struct subvolume **sv) {
+  if (am->flags & TYPE_VOL) {
+    struct volume_molecule *vm = (struct volume_molecule *)am;
+    *pos = vm->pos;
+    *sv = vm->subvol;
+  } else {
+    struct surface_molecule *sm = (struct surface_molecule *)am;
+    uv2xyz(&sm->s_pos, sm->grid->surface, pos);
+    *sv = sm->grid->subvol;
+  }
+}
+
+/*************************************************************************
+count_sched_switches:
+  In: entries: scheduled molecules, in scheduling order
+      n: how many
+      pages: counter of changes of memory page to add to
+      subvols: counter of changes of subvolume to add to
+  Out: No return value.  Defunct molecules are not counted.
+*************************************************************************/
+static void count_sched_switches(struct sched_entry *entries, int n,
+                                 long long *pages, long long *subvols) {
+  uintptr_t last_page = 0;
+  struct subvolume *last_sv = NULL;
+  for (int i = 0; i < n; i++) {
+    struct abstract_molecule *am = entries[i].am;
+    if (!can_reorder(am))
+      continue;
+
+    struct vector3 pos;
+    struct subvolume *sv;
+    reorder_position(am, &pos, &sv);
+    uintptr_t page = (uintptr_t)am >> 12; /* 4 KiB pages */
+    if (last_sv != NULL) {
+      *pages += (page != last_page);
+      *subvols += (sv != last_sv);
+    }
+    last_page = page;
+    last_sv = sv;
+  }
+}
+
+static int compare_sched_entries(void const *a, void const *b) {
+  struct sched_entry const *ea = (struct sched_entry const *)a;
+  struct sched_entry const *eb = (struct sched_entry const *)b;
+  if (ea->list != eb->list)
+    return (ea->list < eb->list) ? -1 : 1;
+  if (ea->key != eb->key)
+    return (ea->key < eb->key) ? -1 : 1;
+  return ea->rank - eb->rank;
+}
+
+static int compare_addresses(void const *a, void const *b) {
+  uintptr_t pa = (uintptr_t)*(void *const *)a;
+  uintptr_t pb = (uintptr_t)*(void *const *)b;
+  return (pa < pb) ? -1 : (pa > pb);
+}
+
+/*************************************************************************
+find_slot:
+  In: slots: addresses, sorted
+      n: how many
+      p: an address
+  Out: the index of p among the slots, or -1 if it is not one of them
+*************************************************************************/
+static int find_slot(void **slots, int n, uintptr_t p) {
+  int lo = 0, hi = n - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    uintptr_t s = (uintptr_t)slots[mid];
+    if (s == p)
+      return mid;
+    if (s < p)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return -1;
+}
+
+/*************************************************************************
+volume_molecule_refs:
+  In: vm: a volume molecule
+      refs: room for the places pointing at it
+  Out: No return value.  refs[0] is its slot in the packed arrays of its
+       species list and refs[1] its slot in the molecule grid of its
+       subvolume, or NULL if it has none.
+*************************************************************************/
+static void volume_molecule_refs(struct volume_molecule *vm,
+                                 struct volume_molecule **refs[2]) {
+  refs[0] = refs[1] = NULL;
+  if (vm->species_list == NULL)
+    return;
+
+  refs[0] = &vm->species_list->packed[vm->packed_index];
+  struct mol_grid *grid = vm->subvol->mol_grid;
+  if (grid != NULL) {
+    struct mol_cell *cell = &grid->cells[filed_cell(grid, vm)];
+    refs[1] = &cell->mols[filed_index(cell, vm)];
+  }
+}
+
+/*************************************************************************
+redirect_surface_molecule:
+  In: sm: a surface molecule about to be moved
+      new_sm: where it goes
+  Out: No return value.  Its grid tile now points at new_sm.
+*************************************************************************/
+static void redirect_surface_molecule(struct surface_molecule *sm,
+                                      struct surface_molecule *new_sm) {
+  for (struct surface_molecule_list *sml = tile_sm_list(sm->grid, sm->grid_index);
+       sml != NULL; sml = sml->next) {
+    if (sml->sm == sm)
+      sml->sm = new_sm;
+  }
+}
+
+/*************************************************************************
+relocate_molecules:
+  In: order: scheduled molecules of one type, all of which can_reorder, in
+        the order they should be stored in
+      n: how many
+      size: size of one molecule
+  Out: No return value.  The molecules are permuted among the addresses
+       they occupy, so that the addresses ascend along the given order.
+       Every address stays in its pool, and the entries are updated.
+       References to the molecules are fixed up, except for the scheduler
+       links, which the caller rebuilds.
+*************************************************************************/
+static void relocate_molecules(struct sched_entry **order, int n,
+                               size_t size) {
+  if (n == 0)
+    return;
+
+  void **slots = CHECKED_MALLOC_ARRAY(void *, 2 * n, "molecule addresses");
+  void **dest = slots + n;
+  int *src = CHECKED_MALLOC_ARRAY(int, n, "molecule permutation");
+  struct volume_molecule ***refs = CHECKED_MALLOC_ARRAY(
+      struct volume_molecule **, 2 * n, "molecule references");
+  unsigned char *tmp = CHECKED_MALLOC_ARRAY(unsigned char, size,
+                                            "molecule being moved");
+
+  for (int k = 0; k < n; k++)
+    slots[k] = order[k]->am;
+  qsort(slots, n, sizeof(void *), compare_addresses);
+
+  /* The k-th molecule along the order goes to the k-th lowest address */
+  for (int k = 0; k < n; k++) {
+    int p = find_slot(slots, n, (uintptr_t)order[k]->am);
+    dest[p] = slots[k];
+    src[k] = p;
+  }
+
+  /* Find every reference before changing any, since a molecule may be
+     looked for by its address in a cell of a molecule grid */
+  for (int p = 0; p < n; p++) {
+    struct abstract_molecule *am = (struct abstract_molecule *)slots[p];
+    if (am->flags & TYPE_VOL)
+      volume_molecule_refs((struct volume_molecule *)am, &refs[2 * p]);
+  }
+  for (int p = 0; p < n; p++) {
+    struct abstract_molecule *am = (struct abstract_molecule *)slots[p];
+    if (am->flags & TYPE_VOL) {
+      for (int r = 2 * p; r < 2 * p + 2; r++) {
+        if (refs[r] != NULL)
+          *refs[r] = (struct volume_molecule *)dest[p];
+      }
+    } else
+      redirect_surface_molecule((struct surface_molecule *)am,
+                                (struct surface_molecule *)dest[p]);
+  }
+
+  /* Follow the cycles of the permutation; a finished slot is marked by
+     pointing src at itself */
+  for (int k = 0; k < n; k++) {
+    if (src[k] == k)
+      continue;
+    memcpy(tmp, slots[k], size);
+    int q = k;
+    while (src[q] != k) {
+      int from = src[q];
+      memcpy(slots[q], slots[from], size);
+      src[q] = q;
+      q = from;
+    }
+    memcpy(slots[q], tmp, size);
+    src[q] = q;
+  }
+
+  for (int k = 0; k < n; k++)
+    order[k]->am = (struct abstract_molecule *)slots[k];
+
+  free(tmp);
+  free(refs);
+  free(src);
+  free(slots);
+}
+
+/*************************************************************************
+reorder_storage:
+  In: world: simulation state
+      local: a storage with nothing deferred
+  Out: No return value.  Every list of the storage's scheduler is sorted
+       along a Morton curve through the positions of its molecules, and
+       the molecules are moved among the addresses they occupy so that
+       they are stored in scheduling order.  Defunct molecules stay where
+       they are, at the end of their lists.
+*************************************************************************/
+static void reorder_storage(struct volume *world, struct storage *local) {
+  struct schedule_helper *timer = local->timer;
+  int n_lists = 1;
+  int n = 0;
+  for (struct schedule_helper *sh = timer; sh != NULL; sh = sh->next_scale)
+    n_lists += sh->buf_len;
+
+  struct sched_list *lists =
+      CHECKED_MALLOC_ARRAY(struct sched_list, n_lists, "scheduler lists");
+
+  /* Number the lists in the order the scheduler will get to them */
+  lists[0].head = &timer->current;
+  lists[0].tail = &timer->current_tail;
+  int l = 1;
+  for (struct schedule_helper *sh = timer; sh != NULL; sh = sh->next_scale) {
+    for (int i = 0; i < sh->buf_len; i++) {
+      int j = (sh->index + i) % sh->buf_len;
+      lists[l].head = &sh->circ_buf_head[j];
+      lists[l].tail = &sh->circ_buf_tail[j];
+      l++;
+    }
+  }
+  for (l = 0; l < n_lists; l++) {
+    for (struct abstract_element *ae = *lists[l].head; ae != NULL;
+         ae = ae->next)
+      n++;
+  }
+  if (n == 0) {
+    free(lists);
+    return;
+  }
+
+  struct sched_entry *entries =
+      CHECKED_MALLOC_ARRAY(struct sched_entry, n, "scheduled molecules");
+  int n_vol = 0, n_surf = 0;
+  struct vector3 llf = { GIGANTIC, GIGANTIC, GIGANTIC };
+  struct vector3 urb = { -GIGANTIC, -GIGANTIC, -GIGANTIC };
+  int i = 0;
+  for (l = 0; l < n_lists; l++) {
+    int rank = 0;
+    for (struct abstract_element *ae = *lists[l].head; ae != NULL;
+         ae = ae->next) {
+      struct abstract_molecule *am = (struct abstract_molecule *)ae;
+      entries[i].am = am;
+      entries[i].list = l;
+      entries[i].rank = rank++;
+      if (can_reorder(am)) {
+        struct vector3 pos;
+        struct subvolume *sv;
+        reorder_position(am, &pos, &sv);
+        llf.x = min2d(llf.x, pos.x);
+        llf.y = min2d(llf.y, pos.y);
+        llf.z = min2d(llf.z, pos.z);
+        urb.x = max2d(urb.x, pos.x);
+        urb.y = max2d(urb.y, pos.y);
+        urb.z = max2d(urb.z, pos.z);
+        if (am->flags & TYPE_VOL)
+          n_vol++;
+        else
+          n_surf++;
+      } else
+        entries[i].key = UINT64_MAX;
+      i++;
+    }
+  }
+
+  struct reorder_stats *stats = &world->reorder_stats;
+  count_sched_switches(entries, n, &stats->page_switches_before,
+                       &stats->subvol_switches_before);
+
+  /* Quantize positions to 21 bits per axis within the molecules' box */
+  double const cells = (double)0x1fffff;
+  struct vector3 scale;
+  scale.x = (urb.x > llf.x) ? cells / (urb.x - llf.x) : 0.0;
+  scale.y = (urb.y > llf.y) ? cells / (urb.y - llf.y) : 0.0;
+  scale.z = (urb.z > llf.z) ? cells / (urb.z - llf.z) : 0.0;
+  for (i = 0; i < n; i++) {
+    if (!can_reorder(entries[i].am))
+      continue;
+    struct vector3 pos;
+    struct subvolume *sv;
+    reorder_position(entries[i].am, &pos, &sv);
+    uint64_t x = (uint64_t)((pos.x - llf.x) * scale.x);
+    uint64_t y = (uint64_t)((pos.y - llf.y) * scale.y);
+    uint64_t z = (uint64_t)((pos.z - llf.z) * scale.z);
+    entries[i].key = spread_bits_3d(x) | spread_bits_3d(y) << 1 |
+                     spread_bits_3d(z) << 2;
+  }
+  qsort(entries, n, sizeof(struct sched_entry), compare_sched_entries);
+
+  struct sched_entry **order = CHECKED_MALLOC_ARRAY(
+      struct sched_entry *, n_vol + n_surf, "molecules to relocate");
+  int k = 0;
+  for (i = 0; i < n; i++) {
+    if (can_reorder(entries[i].am) && (entries[i].am->flags & TYPE_VOL))
+      order[k++] = &entries[i];
+  }
+  relocate_molecules(order, n_vol, sizeof(struct volume_molecule));
+  k = 0;
+  for (i = 0; i < n; i++) {
+    if (can_reorder(entries[i].am) && (entries[i].am->flags & TYPE_SURF))
+      order[k++] = &entries[i];
+  }
+  relocate_molecules(order, n_surf, sizeof(struct surface_molecule));
+  free(order);
+
+  /* Link the lists up again in their new order */
+  for (i = 0; i < n; i++) {
+    struct abstract_element *ae = (struct abstract_element *)entries[i].am;
+    if (i == 0 || entries[i - 1].list != entries[i].list)
+      *lists[entries[i].list].head = ae;
+    if (i == n - 1 || entries[i + 1].list != entries[i].list) {
+      *lists[entries[i].list].tail = ae;
+      ae->next = NULL;
+    } else
+      ae->next = (struct abstract_element *)entries[i + 1].am;
+  }
+
+  count_sched_switches(entries, n, &stats->page_switches_after,
+                       &stats->subvol_switches_after);
+  stats->molecules += n_vol + n_surf;
+
+  free(entries);
+  free(lists);
+}
+
+/*************************************************************************
+reorder_molecules:
+  In: world: simulation state, between two iterations
+  Out: No return value.  The molecules scheduled in every active storage
+       are sorted along a space-filling curve through their positions, in
+       the order they will be run and in memory, so that consecutive
+       molecules tend to share subvolumes, walls and cache lines.
+*************************************************************************/
+void reorder_molecules(struct volume *world) {
+  world->reorder_stats.passes++;
+  for (int i = 0; i < world->n_active_stores; i++) {
+    struct storage *local = world->active_stores[i];
+    if (local->deferred == NULL)
+      reorder_storage(world, local);
+  }
+}
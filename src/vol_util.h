@@ -48,6 +48,39 @@ double collide_sv_time(struct vector3 *point, struct vector3 *move,
 
 int is_defunct_molecule(struct abstract_element *e);
 
+int storage_schedule_add(struct volume *world, struct storage *store,
+                         void *data);
+
+void storage_make_dormant(struct storage *store, struct abstract_molecule *am);
+
+int sweep_dormant_molecules(struct storage *store);
+
+void wake_dormant_molecules(struct volume *world, struct storage *store);
+
+void wake_all_dormant_molecules(struct volume *world);
+
+/* Walk over the molecules held for a storage, scheduled or dormant (see
+   first_storage_molecule) */
+struct storage_walk {
+  struct schedule_helper *sh;   /* Scale being walked, or NULL past the
+                                   coarsest one */
+  int depth;                    /* Depth of that scale */
+  int slot;                     /* Slot being walked, -1 for current items */
+  int n_slots;                  /* Slots per scale */
+  int n_depths;                 /* Scales to walk, counting ones that only
+                                   dormant molecules would need */
+  struct abstract_element *next; /* Next scheduled item of the slot */
+  struct abstract_molecule **dormant; /* Dormant molecules grouped by slot */
+  int *first;                   /* Start of each slot's group in dormant */
+  int next_dormant;             /* Next dormant molecule of the slot */
+  int end_dormant;              /* End of the slot's group */
+};
+
+struct abstract_molecule *first_storage_molecule(struct storage_walk *w,
+                                                 struct storage *store);
+struct abstract_molecule *next_storage_molecule(struct storage_walk *w);
+void end_storage_walk(struct storage_walk *w);
+
 struct wall* find_closest_wall(
     struct volume *state, struct vector3 *loc, double search_diam,
     struct vector2 *best_uv, int *grid_index, struct species *s, char *mesh_name,
@@ -119,6 +152,21 @@ void path_bounding_box(struct vector3 *loc, struct vector3 *displacement,
 
 void ht_add_molecule_to_list(struct pointer_hash *h, struct volume_molecule *vm);
 void ht_remove(struct pointer_hash *h, struct per_species_list *psl);
+void ht_update_molecule_position(struct volume_molecule *vm);
+void free_species_list(struct subvolume *sv, struct per_species_list *psl);
+
+/* A molecule found by find_grid_partners */
+struct mol_grid_hit {
+  int rank;  /* scan_rank of its species list */
+  int index; /* Its packed_index */
+  struct volume_molecule *mp;
+};
+
+void build_mol_grid(struct volume *world, struct subvolume *sv);
+void destroy_mol_grid(struct subvolume *sv);
+int find_grid_partners(struct subvolume *sv, struct vector3 *llf,
+                       struct vector3 *urb, struct volume_molecule *self,
+                       struct mol_grid_hit *found, int max_found);
 
 void collect_molecule(struct volume_molecule *vm);
 
@@ -139,3 +187,5 @@ struct surface_molecule_list* add_surfmol_with_unique_pb_to_list(
 void remove_surfmol_from_list(
     struct surface_molecule_list **sm_head,
     struct surface_molecule *sm);
+
+void reorder_molecules(struct volume *world);
@@ -185,8 +185,8 @@ static int produce_mol_counts(struct volume *wrld, FILE *out_file,
             if (!check_nonreacting)
               continue;
             else {
-              for (curmol = psl->head; curmol != NULL;
-                   curmol = curmol->next_v) {
+              for (int n = psl->n_packed - 1; n >= 0; n--) {
+                curmol = psl->packed[n];
                 /* See if we're interested in this molecule */
                 if (vo->num_molecules == 1) {
                   if (*vo->molecules != curmol->properties)
@@ -223,7 +223,8 @@ static int produce_mol_counts(struct volume *wrld, FILE *out_file,
                 continue;
             }
 
-            for (curmol = psl->head; curmol != NULL; curmol = curmol->next_v) {
+            for (int n = psl->n_packed - 1; n >= 0; n--) {
+              curmol = psl->packed[n];
               /* Skip molecules not in our slab */
               if (curmol->pos.z < z || curmol->pos.z >= z_lim_slab)
                 continue;
@@ -23,6 +23,7 @@
 
 #include "config.h"
 
+#include <limits.h>
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
@@ -1007,7 +1008,7 @@ int collide_wall(struct vector3 *point, struct vector3 *move, struct wall *face,
   struct vector3 local;
 
   if (notify->final_summary == NOTIFY_FULL) {
-    (*ray_polygon_tests)++;
+    THREADED_ADD(*ray_polygon_tests, 1);
   }
 
   nx = face->normal.x;
@@ -1753,9 +1754,444 @@ int distribute_world(struct volume *world) {
       return 1;
   }
 
+  build_wall_tables(world);
   return 0;
 }
 
+/***************************************************************************
+set_wall_entry:
+  In: wt: a wall table
+      k: entry to fill in
+      w: the wall, or NULL for padding
+  Out: No return value.  Entry k holds the wall and its plane.
+***************************************************************************/
+static void set_wall_entry(struct wall_table *wt, int k, struct wall *w) {
+  wt->walls[k] = w;
+  if (w != NULL) {
+    wt->nx[k] = w->normal.x;
+    wt->ny[k] = w->normal.y;
+    wt->nz[k] = w->normal.z;
+    wt->d[k] = w->d;
+  } else {
+    /* Every point is far above this plane */
+    wt->nx[k] = wt->ny[k] = wt->nz[k] = 0.0;
+    wt->d[k] = -GIGANTIC;
+  }
+}
+
+/* A wall waiting to be placed in a hierarchy */
+struct wall_bvh_item {
+  struct wall *w;
+  int order;          /* Position in wall_head */
+  struct vector3 llf; /* Padded bounding box */
+  struct vector3 urb;
+  double key;         /* Centroid along the axis being split */
+};
+
+struct wall_bvh_build {
+  struct wall_table *wt;
+  int n_batches;      /* Leaves placed so far */
+};
+
+static int compare_wall_bvh_items(void const *a, void const *b) {
+  struct wall_bvh_item const *ia = (struct wall_bvh_item const *)a;
+  struct wall_bvh_item const *ib = (struct wall_bvh_item const *)b;
+  if (ia->key < ib->key)
+    return -1;
+  if (ia->key > ib->key)
+    return 1;
+  return ia->order - ib->order;
+}
+
+/***************************************************************************
+build_wall_bvh_node:
+  In: build: the table being built and the leaves placed in it so far
+      items: walls to place below this node
+      n: number of walls (at least 1)
+      node: index of the node to fill in
+  Out: No return value.  The node and everything below it are filled in,
+       and each leaf's walls are written to its batch of the table.
+  Note: Splits at a multiple of WALL_BATCH near the median of the longest
+        axis, so every leaf but the last one in the table is full.
+***************************************************************************/
+static void build_wall_bvh_node(struct wall_bvh_build *build,
+                                struct wall_bvh_item *items, int n,
+                                int node) {
+  struct wall_table *wt = build->wt;
+  struct wall_bvh_node *nd = &wt->nodes[node];
+
+  nd->llf = items[0].llf;
+  nd->urb = items[0].urb;
+  for (int i = 1; i < n; i++) {
+    nd->llf.x = min2d(nd->llf.x, items[i].llf.x);
+    nd->llf.y = min2d(nd->llf.y, items[i].llf.y);
+    nd->llf.z = min2d(nd->llf.z, items[i].llf.z);
+    nd->urb.x = max2d(nd->urb.x, items[i].urb.x);
+    nd->urb.y = max2d(nd->urb.y, items[i].urb.y);
+    nd->urb.z = max2d(nd->urb.z, items[i].urb.z);
+  }
+
+  if (n <= WALL_BATCH) {
+    nd->leaf = 1;
+    nd->first = build->n_batches++ * WALL_BATCH;
+    for (int k = 0; k < WALL_BATCH; k++) {
+      set_wall_entry(wt, nd->first + k, (k < n) ? items[k].w : NULL);
+      wt->order[nd->first + k] = (k < n) ? items[k].order : INT_MAX;
+    }
+    return;
+  }
+
+  /* Split along the longest axis of the box */
+  double dx = nd->urb.x - nd->llf.x;
+  double dy = nd->urb.y - nd->llf.y;
+  double dz = nd->urb.z - nd->llf.z;
+  for (int i = 0; i < n; i++) {
+    if (dx >= dy && dx >= dz)
+      items[i].key = items[i].llf.x + items[i].urb.x;
+    else if (dy >= dz)
+      items[i].key = items[i].llf.y + items[i].urb.y;
+    else
+      items[i].key = items[i].llf.z + items[i].urb.z;
+  }
+  qsort(items, n, sizeof(struct wall_bvh_item), compare_wall_bvh_items);
+
+  int n_left = (n / 2 + WALL_BATCH - 1) / WALL_BATCH * WALL_BATCH;
+  nd->leaf = 0;
+  nd->first = wt->n_nodes;
+  wt->n_nodes += 2;
+  build_wall_bvh_node(build, items, n_left, nd->first);
+  build_wall_bvh_node(build, items + n_left, n - n_left, nd->first + 1);
+}
+
+/***************************************************************************
+build_wall_bvh:
+  In: wt: a wall table with room for its walls
+      sv: the subvolume it belongs to
+      n: number of walls in the subvolume
+  Out: No return value.  The table holds the walls in the leaf order of a
+       new bounding volume hierarchy.
+***************************************************************************/
+static void build_wall_bvh(struct wall_table *wt, struct subvolume *sv,
+                           int n) {
+  struct wall_bvh_item *items =
+      CHECKED_MALLOC_ARRAY(struct wall_bvh_item, n, "wall hierarchy items");
+  int k = 0;
+  for (struct wall_list *wl = sv->wall_head; wl != NULL; wl = wl->next, k++) {
+    struct wall *w = wl->this_wall;
+    struct wall_bvh_item *it = &items[k];
+    it->w = w;
+    it->order = k;
+    it->llf = *w->vert[0];
+    it->urb = *w->vert[0];
+    for (int j = 1; j < 3; j++) {
+      it->llf.x = min2d(it->llf.x, w->vert[j]->x);
+      it->llf.y = min2d(it->llf.y, w->vert[j]->y);
+      it->llf.z = min2d(it->llf.z, w->vert[j]->z);
+      it->urb.x = max2d(it->urb.x, w->vert[j]->x);
+      it->urb.y = max2d(it->urb.y, w->vert[j]->y);
+      it->urb.z = max2d(it->urb.z, w->vert[j]->z);
+    }
+
+    /* collide_wall reports hits and edge grazes a little outside the
+       triangle, so leave generous room for rounding */
+    double size = max2d(it->urb.x - it->llf.x,
+                        max2d(it->urb.y - it->llf.y, it->urb.z - it->llf.z));
+    double far = max2d(max2d(fabs(it->llf.x), fabs(it->urb.x)),
+                       max2d(max2d(fabs(it->llf.y), fabs(it->urb.y)),
+                             max2d(fabs(it->llf.z), fabs(it->urb.z))));
+    double pad = 1e-4 * size + 16 * EPS_C * (1.0 + far);
+    it->llf.x -= pad;
+    it->llf.y -= pad;
+    it->llf.z -= pad;
+    it->urb.x += pad;
+    it->urb.y += pad;
+    it->urb.z += pad;
+  }
+
+  int n_leaves = (n + WALL_BATCH - 1) / WALL_BATCH;
+  wt->nodes = CHECKED_MALLOC_ARRAY(struct wall_bvh_node, 2 * n_leaves - 1,
+                                   "wall hierarchy");
+  wt->order = CHECKED_MALLOC_ARRAY(int, wt->n_walls, "wall hierarchy order");
+  wt->n_nodes = 1;
+
+  struct wall_bvh_build build;
+  build.wt = wt;
+  build.n_batches = 0;
+  build_wall_bvh_node(&build, items, n, 0);
+
+  free(items);
+}
+
+/***************************************************************************
+build_wall_tables:
+  In: world: simulation state
+  Out: No return value.  Every subvolume with walls gets a wall_table
+       mirroring its wall list, with a hierarchy over it if the subvolume
+       has at least WALL_BVH_MIN_WALLS walls.
+***************************************************************************/
+void build_wall_tables(struct volume *world) {
+  for (int i = 0; i < world->n_subvols; i++) {
+    struct subvolume *sv = &world->subvol[i];
+    destroy_wall_table(sv);
+
+    int n = 0;
+    for (struct wall_list *wl = sv->wall_head; wl != NULL; wl = wl->next)
+      n++;
+    if (n == 0)
+      continue;
+    int n_padded = (n + WALL_BATCH - 1) / WALL_BATCH * WALL_BATCH;
+
+    struct wall_table *wt =
+        CHECKED_MALLOC_STRUCT(struct wall_table, "subvolume wall table");
+    wt->n_walls = n_padded;
+    wt->walls = CHECKED_MALLOC_ARRAY(struct wall *, n_padded,
+                                     "subvolume wall table");
+    wt->nx = CHECKED_MALLOC_ARRAY(double, 4 * n_padded,
+                                  "subvolume wall table planes");
+    wt->ny = wt->nx + n_padded;
+    wt->nz = wt->ny + n_padded;
+    wt->d = wt->nz + n_padded;
+    wt->nodes = NULL;
+    wt->n_nodes = 0;
+    wt->order = NULL;
+
+    if (n >= WALL_BVH_MIN_WALLS)
+      build_wall_bvh(wt, sv, n);
+    else {
+      int k = 0;
+      for (struct wall_list *wl = sv->wall_head; wl != NULL;
+           wl = wl->next, k++)
+        set_wall_entry(wt, k, wl->this_wall);
+      for (; k < n_padded; k++)
+        set_wall_entry(wt, k, NULL);
+    }
+    sv->wall_table = wt;
+  }
+}
+
+/***************************************************************************
+destroy_wall_table:
+  In: sv: a subvolume
+  Out: No return value.  The subvolume's wall table, if any, is freed.
+***************************************************************************/
+void destroy_wall_table(struct subvolume *sv) {
+  if (sv->wall_table == NULL)
+    return;
+  free(sv->wall_table->walls);
+  free(sv->wall_table->nx);
+  free(sv->wall_table->nodes);
+  free(sv->wall_table->order);
+  free(sv->wall_table);
+  sv->wall_table = NULL;
+}
+
+/***************************************************************************
+screen_wall_batch:
+  In: wt: a subvolume's wall table
+      first: index of the first wall of the batch (a multiple of WALL_BATCH)
+      point: starting coordinate
+      move: vector to move along
+      may_hit: array of WALL_BATCH flags to fill in
+  Out: No return value.  may_hit[k] is cleared for each wall first+k which
+       collide_wall would report as COLLIDE_MISS because the ray starts and
+       ends on the same side of its plane, and set for all the others.
+  Note: This repeats the plane test at the top of collide_wall with the
+        same arithmetic, so the two always agree.  The loop has a fixed trip
+        count over contiguous arrays so that it stays cheap per wall.
+***************************************************************************/
+static void screen_wall_batch(struct wall_table *wt, int first,
+                              struct vector3 *point, struct vector3 *move,
+                              unsigned char *may_hit) {
+  for (int k = 0; k < WALL_BATCH; k++) {
+    double dp = wt->nx[first + k] * point->x + wt->ny[first + k] * point->y +
+                wt->nz[first + k] * point->z;
+    double dv = wt->nx[first + k] * move->x + wt->ny[first + k] * move->y +
+                wt->nz[first + k] * move->z;
+    double dd = dp - wt->d[first + k];
+    double d_eps;
+    int miss;
+    if (dd > 0.0) {
+      d_eps = (dd < EPS_C) ? 0.5 * dd : EPS_C;
+      miss = (dd + dv > d_eps);
+    } else {
+      d_eps = (dd > -EPS_C) ? 0.5 * dd : -EPS_C;
+      miss = (dd < 0.0 && dd + dv < d_eps);
+    }
+    may_hit[k] = !miss;
+  }
+}
+
+/***************************************************************************
+clip_segment_to_slab:
+  In: p: start of the segment along one axis
+      m: movement along that axis
+      lo, hi: the slab
+      t0, t1: range of the segment (in units of m) still inside the box
+  Out: 0 if the segment misses the slab, 1 otherwise.  The range is
+       narrowed to the part inside the slab.
+***************************************************************************/
+static int clip_segment_to_slab(double p, double m, double lo, double hi,
+                                double *t0, double *t1) {
+  if (m == 0.0)
+    return (lo <= p && p <= hi);
+
+  double a = (lo - p) / m;
+  double b = (hi - p) / m;
+  if (a > b) {
+    double c = a;
+    a = b;
+    b = c;
+  }
+  if (a > *t0)
+    *t0 = a;
+  if (b < *t1)
+    *t1 = b;
+  return (*t0 <= *t1);
+}
+
+/***************************************************************************
+wall_cursor_collect:
+  In: cur: a cursor whose query has been set up
+      segment: 1 to follow the segment of the query, 0 for its box
+  Out: No return value.  Walls the hierarchy cannot rule out are gathered
+       in wall_head order, or, if there are too many, the cursor is
+       switched over to scanning the whole table.
+***************************************************************************/
+static void wall_cursor_collect(struct wall_cursor *cur, int segment) {
+  struct wall_table *wt = cur->wt;
+  int stack[64];
+  int n_stack = 0;
+
+  cur->n_found = 0;
+  stack[n_stack++] = 0;
+  while (n_stack > 0) {
+    struct wall_bvh_node *nd = &wt->nodes[stack[--n_stack]];
+    if (segment) {
+      double t0 = 0.0, t1 = 1.0;
+      if (!clip_segment_to_slab(cur->point.x, cur->move.x, nd->llf.x,
+                                nd->urb.x, &t0, &t1) ||
+          !clip_segment_to_slab(cur->point.y, cur->move.y, nd->llf.y,
+                                nd->urb.y, &t0, &t1) ||
+          !clip_segment_to_slab(cur->point.z, cur->move.z, nd->llf.z,
+                                nd->urb.z, &t0, &t1))
+        continue;
+    } else if (nd->urb.x < cur->llf.x || nd->llf.x > cur->urb.x ||
+               nd->urb.y < cur->llf.y || nd->llf.y > cur->urb.y ||
+               nd->urb.z < cur->llf.z || nd->llf.z > cur->urb.z)
+      continue;
+
+    if (!nd->leaf) {
+      stack[n_stack++] = nd->first + 1;
+      stack[n_stack++] = nd->first;
+      continue;
+    }
+
+    unsigned char may_hit[WALL_BATCH];
+    if (segment)
+      screen_wall_batch(wt, nd->first, &cur->point, &cur->move, may_hit);
+    for (int k = 0; k < WALL_BATCH; k++) {
+      if (wt->walls[nd->first + k] == NULL)
+        continue;
+      if (segment && !may_hit[k]) {
+        cur->n_screened++;
+        continue;
+      }
+      if (cur->n_found == WALL_CURSOR_SIZE) {
+        cur->n_found = -1;
+        cur->n_screened = 0;
+        return;
+      }
+      cur->found[cur->n_found++] = nd->first + k;
+    }
+  }
+
+  /* Hand the walls out in the same order as a scan of wall_head would */
+  for (int i = 1; i < cur->n_found; i++) {
+    int k = cur->found[i];
+    int j = i;
+    for (; j > 0 && wt->order[cur->found[j - 1]] > wt->order[k]; j--)
+      cur->found[j] = cur->found[j - 1];
+    cur->found[j] = k;
+  }
+}
+
+/***************************************************************************
+wall_cursor_segment:
+  In: cur: cursor to set up
+      sv: subvolume whose walls to visit
+      point: starting coordinate
+      move: vector to move along
+  Out: No return value.  wall_cursor_next will hand out, in wall_head
+       order, every wall of sv that collide_wall might not report as
+       COLLIDE_MISS for this movement.
+***************************************************************************/
+void wall_cursor_segment(struct wall_cursor *cur, struct subvolume *sv,
+                         struct vector3 *point, struct vector3 *move) {
+  cur->wt = sv->wall_table;
+  cur->segment = 1;
+  cur->point = *point;
+  cur->move = *move;
+  cur->next = 0;
+  cur->n_found = -1;
+  cur->n_screened = 0;
+  if (cur->wt != NULL && cur->wt->nodes != NULL)
+    wall_cursor_collect(cur, 1);
+}
+
+/***************************************************************************
+wall_cursor_box:
+  In: cur: cursor to set up
+      sv: subvolume whose walls to visit
+      llf, urb: corners of a box
+  Out: No return value.  wall_cursor_next will hand out, in wall_head
+       order, at least every wall of sv that overlaps the box.
+***************************************************************************/
+void wall_cursor_box(struct wall_cursor *cur, struct subvolume *sv,
+                     struct vector3 *llf, struct vector3 *urb) {
+  cur->wt = sv->wall_table;
+  cur->segment = 0;
+  cur->llf = *llf;
+  cur->urb = *urb;
+  cur->next = 0;
+  cur->n_found = -1;
+  cur->n_screened = 0;
+  if (cur->wt != NULL && cur->wt->nodes != NULL)
+    wall_cursor_collect(cur, 0);
+}
+
+/***************************************************************************
+wall_cursor_next:
+  In: cur: a cursor
+  Out: The next wall of the query, or NULL once there are no more.
+***************************************************************************/
+struct wall *wall_cursor_next(struct wall_cursor *cur) {
+  struct wall_table *wt = cur->wt;
+  if (wt == NULL)
+    return NULL;
+
+  if (cur->n_found >= 0) {
+    if (cur->next == cur->n_found)
+      return NULL;
+    return wt->walls[cur->found[cur->next++]];
+  }
+
+  /* No hierarchy, or too many walls to sort: scan the table */
+  while (cur->next < wt->n_walls) {
+    int k = cur->next % WALL_BATCH;
+    if (k == 0 && cur->segment)
+      screen_wall_batch(wt, cur->next, &cur->point, &cur->move, cur->may_hit);
+    struct wall *w = wt->walls[cur->next++];
+    if (w == NULL)
+      continue;
+    if (cur->segment && !cur->may_hit[k]) {
+      cur->n_screened++;
+      continue;
+    }
+    return w;
+  }
+  return NULL;
+}
+
 /***************************************************************************
 closest_pt_point_triangle:
   In:  p - point
@@ -1901,6 +2337,11 @@ static int vacuum_from_regions(struct volume *world,
   struct wall *w;
   struct surface_molecule *smp;
 
+  /* The molecules to choose from may live on any process */
+  if (world->domain != NULL)
+    mcell_error("Releases removing molecules are not supported in runs "
+                "distributed over several processes.");
+
   rrd = rso->region_data;
 
   mh = create_mem(sizeof(struct reg_rel_helper_data), 1024);
@@ -1923,9 +2364,9 @@ static int vacuum_from_regions(struct volume *world,
         continue;
 
       for (unsigned int n_tile = 0; n_tile < w->grid->n_tiles; n_tile++) {
-        struct surface_molecule_list *sm_list = w->grid->sm_list[n_tile];
+        struct surface_molecule_list *sm_list = tile_sm_list(w->grid, n_tile);
         if (sm_list && sm_list->sm) {
-          smp = w->grid->sm_list[n_tile]->sm;
+          smp = tile_sm_list(w->grid, n_tile)->sm;
           if (smp != NULL) {
             if (smp->properties == sm->properties) {
               p = CHECKED_MEM_GET_NODIE(mh, "release region helper data");
@@ -1947,13 +2388,14 @@ static int vacuum_from_regions(struct volume *world,
 
   for (p = rrhd_head; n < 0 && n_rrhd > 0 && p != NULL; p = p->next, n_rrhd--) {
     if (rng_dbl(world->rng) < ((double)(-n)) / ((double)n_rrhd)) {
-      smp = p->grid->sm_list[p->index]->sm;
+      smp = tile_sm_list(p->grid, p->index)->sm;
       smp->properties->population--;
       if ((smp->properties->flags & (COUNT_CONTENTS | COUNT_ENCLOSED)) != 0)
         count_region_from_scratch(world, (struct abstract_molecule *)smp, NULL,
                                   -1, NULL, smp->grid->surface, smp->t, NULL);
       smp->properties = NULL;
-      p->grid->sm_list[p->index]->sm = NULL;
+      tile_sm_list(p->grid, p->index)->sm = NULL;
+      update_tile_occupancy(p->grid, p->index);
       p->grid->n_occupied--;
       if (smp->flags & IN_SCHEDULE) {
         smp->grid->subvol->local_storage->timer->defunct_count++; /* Tally for
@@ -2033,15 +2475,14 @@ int release_onto_regions(struct volume *world, struct release_site_obj *rso,
         grid_index = w->grid->n_tiles - 1;
       }
 
-      struct surface_molecule_list *sm_list = w->grid->sm_list[grid_index];
-      if (sm_list && sm_list->sm) {
+      if (tile_occupied(w->grid, grid_index)) {
         failure++;
       }
       else {
         struct vector3 pos3d = {.x = 0, .y = 0, .z = 0};
         if (place_single_molecule(world, w, grid_index, sm->properties,
                                   sm->flags, rso->orientation, sm->t, sm->t2,
-                                  sm->birthday, sm->periodic_box, &pos3d) == NULL) {
+                                  sm->birthday, &sm->periodic_box, &pos3d) == NULL) {
           struct vector3 llf, urb;
           if (world->periodic_box_obj) {
             struct polygon_object *p = (struct polygon_object*)(world->periodic_box_obj->contents);
@@ -2091,22 +2532,22 @@ int release_onto_regions(struct volume *world, struct release_site_obj *rso,
 
           A = w->area / (w->grid->n_tiles);
 
-          for (unsigned int n_tile = 0; n_tile < w->grid->n_tiles; n_tile++) {
-            if (w->grid->sm_list[n_tile] == NULL || w->grid->sm_list[n_tile]->sm == NULL) {
-              struct reg_rel_helper_data *new_rrd =
-                  CHECKED_MEM_GET_NODIE(mh, "release region helper data");
-              if (new_rrd == NULL)
-                return 1;
+          for (unsigned int n_tile = next_free_tile(w->grid, 0);
+               n_tile < w->grid->n_tiles;
+               n_tile = next_free_tile(w->grid, n_tile + 1)) {
+            struct reg_rel_helper_data *new_rrd =
+                CHECKED_MEM_GET_NODIE(mh, "release region helper data");
+            if (new_rrd == NULL)
+              return 1;
 
-              new_rrd->next = rrhd_head;
-              new_rrd->grid = w->grid;
-              new_rrd->index = n_tile;
-              new_rrd->my_area = A;
-              max_A += A;
+            new_rrd->next = rrhd_head;
+            new_rrd->grid = w->grid;
+            new_rrd->index = n_tile;
+            new_rrd->my_area = A;
+            max_A += A;
 
-              rrhd_head = new_rrd;
-              n_rrhd++;
-            }
+            rrhd_head = new_rrd;
+            n_rrhd++;
           }
         }
       }
@@ -2119,7 +2560,7 @@ int release_onto_regions(struct volume *world, struct release_site_obj *rso,
           if (place_single_molecule(world, this_rrd->grid->surface,
                                     this_rrd->index, sm->properties, sm->flags,
                                     rso->orientation, sm->t, sm->t2,
-                                    sm->birthday, sm->periodic_box, &pos3d) == NULL) {
+                                    sm->birthday, &sm->periodic_box, &pos3d) == NULL) {
             return 1;
           }
 
@@ -2210,17 +2651,12 @@ struct surface_molecule *place_single_molecule(struct volume *state,
   new_sm->t = t;
   new_sm->t2 = t2;
   new_sm->birthday = birthday;
-  new_sm->birthplace = w->birthplace->smol;
-  new_sm->id = state->current_mol_id++;
+  new_sm->id = next_molecule_id(state);
   new_sm->grid_index = grid_index;
   new_sm->s_pos.u = s_pos.u;
   new_sm->s_pos.v = s_pos.v;
   new_sm->properties = spec;
-  new_sm->periodic_box = CHECKED_MALLOC_STRUCT(struct periodic_image,
-    "periodic image descriptor");
-  new_sm->periodic_box->x = periodic_box->x;
-  new_sm->periodic_box->y = periodic_box->y;
-  new_sm->periodic_box->z = periodic_box->z;
+  new_sm->periodic_box = *periodic_box;
 
   if (orientation == 0)
     new_sm->orient = (rng_uint(state->rng) & 1) ? 1 : -1;
@@ -2229,13 +2665,14 @@ struct surface_molecule *place_single_molecule(struct volume *state,
 
   new_sm->grid = w->grid;
 
-  if (w->grid->sm_list[grid_index] == NULL) {
+  if (tile_sm_list(w->grid, grid_index) == NULL) {
     struct surface_molecule_list *sm_entry = CHECKED_MALLOC_STRUCT(
       struct surface_molecule_list, "surface molecule list");
     sm_entry->next = NULL;
-    w->grid->sm_list[grid_index] = sm_entry;
+    *tile_sm_slot(w->grid, grid_index) = sm_entry;
   }
-  w->grid->sm_list[grid_index]->sm = new_sm;
+  tile_sm_list(w->grid, grid_index)->sm = new_sm;
+  update_tile_occupancy(w->grid, grid_index);
   w->grid->n_occupied++;
   new_sm->properties->population++;
 
@@ -2250,9 +2687,9 @@ struct surface_molecule *place_single_molecule(struct volume *state,
   if (new_sm->properties->flags & (COUNT_CONTENTS | COUNT_ENCLOSED))
     count_region_from_scratch(state, (struct abstract_molecule *)new_sm, NULL,
                               1, NULL, new_sm->grid->surface, new_sm->t,
-                              new_sm->periodic_box);
+                              &new_sm->periodic_box);
 
-  if (schedule_add(gsv->local_storage->timer, new_sm)) {
+  if (storage_schedule_add(state, gsv->local_storage, new_sm)) {
     mcell_allocfailed("Failed to add volume molecule '%s' to scheduler.",
                       new_sm->properties->sym->name);
     return NULL;
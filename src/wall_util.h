@@ -25,6 +25,26 @@
 
 #include "mcell_structs.h"
 
+/* Walls found through a subvolume's hierarchy before falling back to a scan
+   of the whole wall table */
+#define WALL_CURSOR_SIZE 64
+
+/* Walls of a subvolume near a segment or a box.  Set up with
+   wall_cursor_segment or wall_cursor_box, then call wall_cursor_next. */
+struct wall_cursor {
+  struct wall_table *wt;
+  int segment;                     /* Following a segment, or a box? */
+  struct vector3 point;            /* The segment... */
+  struct vector3 move;
+  struct vector3 llf;              /* ...or the box */
+  struct vector3 urb;
+  int n_found;                     /* Walls in found, or -1 to scan wt */
+  int found[WALL_CURSOR_SIZE];     /* Table entries, in wall_head order */
+  int next;                        /* Next index into found, or into wt */
+  unsigned char may_hit[WALL_BATCH]; /* Screen of the batch being scanned */
+  long long n_screened;            /* Walls the plane test ruled out */
+};
+
 /* Temporary data stored about an edge of a polygon */
 struct poly_edge {
   struct poly_edge *next; /* Next edge in a hash table. */
@@ -112,6 +132,14 @@ int distribute_object(struct volume *world, struct object *parent);
 
 int distribute_world(struct volume *world);
 
+void build_wall_tables(struct volume *world);
+void destroy_wall_table(struct subvolume *sv);
+void wall_cursor_segment(struct wall_cursor *cur, struct subvolume *sv,
+                         struct vector3 *point, struct vector3 *move);
+void wall_cursor_box(struct wall_cursor *cur, struct subvolume *sv,
+                     struct vector3 *llf, struct vector3 *urb);
+struct wall *wall_cursor_next(struct wall_cursor *cur);
+
 void closest_pt_point_triangle(struct vector3 *p, struct vector3 *a,
                                struct vector3 *b, struct vector3 *c,
                                struct vector3 *final_result);
@@ -0,0 +1,225 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2006-2017 by
+ * The Salk Institute for Biological Studies and
+ * Pittsburgh Supercomputing Center, Carnegie Mellon University
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ *
+******************************************************************************/
+
+/* Compares the multi-scale scheduler with the ladder queue on the molecule
+ * timer workload: every item is taken out when its timestep comes up and
+ * put back after a delay drawn from a distribution of event times.
+ *
+ * Usage: sched_bench [-n items] [-steps n] [delay_file]
+ *
+ * delay_file holds one delay (in timesteps) per line, such as the lifetimes
+ * recorded from a simulation.  Without it, half of the items are diffusing
+ * molecules rescheduled every timestep, and the others have exponential
+ * lifetimes with mean times spread from 10 to 10^6 timesteps. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sched_util.h"
+
+struct bench_item {
+  struct abstract_element ae;
+  double lifetime; /* Mean lifetime, or 0 for a diffusing molecule */
+};
+
+struct delay_source {
+  double *delays;   /* Recorded delays, or NULL for the built-in mix */
+  long n_delays;
+  unsigned long long state; /* xorshift state */
+};
+
+/*************************************************************************
+next_random:
+  In: source of delays
+  Out: a uniform 64-bit random number
+*************************************************************************/
+static unsigned long long next_random(struct delay_source *src) {
+  src->state ^= src->state << 13;
+  src->state ^= src->state >> 7;
+  src->state ^= src->state << 17;
+  return src->state;
+}
+
+/*************************************************************************
+next_delay:
+  In: source of delays
+      item to schedule
+  Out: the delay until the next event of the item, in timesteps
+*************************************************************************/
+static double next_delay(struct delay_source *src, struct bench_item *it) {
+  unsigned long long r = next_random(src);
+
+  if (src->delays != NULL)
+    return src->delays[r % src->n_delays];
+
+  if (it->lifetime == 0.0)
+    return 1.0;
+
+  double u = ((r >> 11) + 0.5) / 9007199254740992.0;
+  return -it->lifetime * log(u);
+}
+
+/*************************************************************************
+read_delays:
+  In: name of a file with one delay per line
+      source to fill in
+  Out: 0 on success, 1 on failure
+*************************************************************************/
+static int read_delays(char const *name, struct delay_source *src) {
+  FILE *f = fopen(name, "r");
+  if (f == NULL) {
+    fprintf(stderr, "Cannot open %s\n", name);
+    return 1;
+  }
+
+  long max_delays = 1024;
+  double d;
+  src->delays = (double *)malloc(max_delays * sizeof(double));
+  src->n_delays = 0;
+  while (src->delays != NULL && fscanf(f, "%lf", &d) == 1) {
+    if (src->n_delays == max_delays) {
+      max_delays *= 2;
+      double *more = (double *)realloc(src->delays, max_delays * sizeof(double));
+      if (more == NULL) {
+        free(src->delays);
+        src->delays = NULL;
+        break;
+      }
+      src->delays = more;
+    }
+    src->delays[src->n_delays++] = (d < 0.0) ? 0.0 : d;
+  }
+  fclose(f);
+
+  if (src->delays == NULL || src->n_delays == 0) {
+    fprintf(stderr, "No delays read from %s\n", name);
+    return 1;
+  }
+  return 0;
+}
+
+/*************************************************************************
+run_bench:
+  In: nonzero to use a ladder queue
+      number of items
+      number of timesteps to run
+      source of delays (seeded identically for both schedulers)
+      number of events taken out (return value)
+      number of events taken out in the wrong timestep (return value)
+  Out: seconds taken, or a negative number on failure
+*************************************************************************/
+static double run_bench(int ladder, long n_items, long n_steps,
+                        struct delay_source *src, long long *n_events,
+                        long long *n_wrong) {
+  struct bench_item *items =
+      (struct bench_item *)malloc(n_items * sizeof(struct bench_item));
+  struct schedule_helper *sh = ladder
+                                   ? create_ladder_scheduler(1.0, 100, 0.0)
+                                   : create_scheduler(1.0, 100.0, 100, 0.0);
+  if (items == NULL || sh == NULL) {
+    free(items);
+    delete_scheduler(sh);
+    return -1.0;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (long i = 0; i < n_items; i++) {
+    items[i].lifetime = (i & 1) ? pow(10.0, 1 + (i >> 1) % 6) : 0.0;
+    items[i].ae.t = next_delay(src, &items[i]);
+    if (schedule_add(sh, &items[i]))
+      return -1.0;
+  }
+
+  *n_events = 0;
+  *n_wrong = 0;
+  for (long step = 0; step < n_steps; step++) {
+    struct bench_item *it;
+    while ((it = (struct bench_item *)schedule_next(sh)) != NULL) {
+      ++*n_events;
+      if (it->ae.t >= sh->now || it->ae.t < sh->now - 2 * sh->dt)
+        ++*n_wrong;
+      it->ae.t = sh->now + next_delay(src, it);
+      if (schedule_add(sh, it))
+        return -1.0;
+    }
+    if (sh->error)
+      return -1.0;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  delete_scheduler(sh);
+  free(items);
+  return (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+}
+
+int main(int argc, char **argv) {
+  long n_items = 1000000;
+  long n_steps = 1000;
+  struct delay_source src;
+  memset(&src, 0, sizeof(src));
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      n_items = atol(argv[++i]);
+    else if (strcmp(argv[i], "-steps") == 0 && i + 1 < argc)
+      n_steps = atol(argv[++i]);
+    else if (argv[i][0] != '-' && src.delays == NULL) {
+      if (read_delays(argv[i], &src))
+        return 1;
+    } else {
+      fprintf(stderr, "Usage: %s [-n items] [-steps n] [delay_file]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (n_items < 1 || n_steps < 1) {
+    fprintf(stderr, "Item and timestep counts must be positive\n");
+    return 1;
+  }
+
+  char const *names[2] = { "multiscale", "ladder" };
+  for (int ladder = 0; ladder < 2; ladder++) {
+    long long n_events;
+    long long n_wrong;
+    src.state = 88172645463325252ULL;
+    double secs =
+        run_bench(ladder, n_items, n_steps, &src, &n_events, &n_wrong);
+    if (secs < 0.0) {
+      fprintf(stderr, "Out of memory running the %s scheduler\n",
+              names[ladder]);
+      return 1;
+    }
+    printf("%-10s %12lld events %8.3f s %8.1f ns/event %lld out of order\n",
+           names[ladder], n_events, secs,
+           n_events > 0 ? 1e9 * secs / n_events : 0.0, n_wrong);
+  }
+
+  free(src.delays);
+  return 0;
+}